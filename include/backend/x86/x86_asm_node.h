@@ -57,18 +57,21 @@ public:
         bool int64 : 1;
         bool float32 : 1;
         bool float64 : 1;
+        bool packedInt : 1; /// integer vectors of up to 16 bytes
         constexpr PhysicalRegisterKindMask(bool int8,
                                             bool int16,
                                             bool int32,
                                             bool int64,
                                             bool float32,
-                                            bool float64)
+                                            bool float64,
+                                            bool packedInt)
             : int8(int8),
               int16(int16),
               int32(int32),
               int64(int64),
               float32(float32),
-              float64(float64)
+              float64(float64),
+              packedInt(packedInt)
         {
         }
         constexpr PhysicalRegisterKindMask()
@@ -77,19 +80,21 @@ public:
               int32(false),
               int64(false),
               float32(false),
-              float64(false)
+              float64(false),
+              packedInt(false)
         {
         }
-        static constexpr PhysicalRegisterKindMask None() {return PhysicalRegisterKindMask(false, false, false, false, false, false);}
-        static constexpr PhysicalRegisterKindMask All() {return PhysicalRegisterKindMask(true, true, true, true, true, true);}
-        static constexpr PhysicalRegisterKindMask Int() {return PhysicalRegisterKindMask(true, true, true, true, false, false);}
-        static constexpr PhysicalRegisterKindMask Float() {return PhysicalRegisterKindMask(false, false, false, false, true, true);}
-        static constexpr PhysicalRegisterKindMask Int8() {return PhysicalRegisterKindMask(true, false, false, false, false, false);}
-        static constexpr PhysicalRegisterKindMask Int16() {return PhysicalRegisterKindMask(false, true, false, false, false, false);}
-        static constexpr PhysicalRegisterKindMask Int32() {return PhysicalRegisterKindMask(false, false, true, false, false, false);}
-        static constexpr PhysicalRegisterKindMask Int64() {return PhysicalRegisterKindMask(false, false, false, true, false, false);}
-        static constexpr PhysicalRegisterKindMask Float32() {return PhysicalRegisterKindMask(false, false, false, false, true, false);}
-        static constexpr PhysicalRegisterKindMask Float64() {return PhysicalRegisterKindMask(false, false, false, false, false, true);}
+        static constexpr PhysicalRegisterKindMask None() {return PhysicalRegisterKindMask(false, false, false, false, false, false, false);}
+        static constexpr PhysicalRegisterKindMask All() {return PhysicalRegisterKindMask(true, true, true, true, true, true, true);}
+        static constexpr PhysicalRegisterKindMask Int() {return PhysicalRegisterKindMask(true, true, true, true, false, false, false);}
+        static constexpr PhysicalRegisterKindMask Float() {return PhysicalRegisterKindMask(false, false, false, false, true, true, false);}
+        static constexpr PhysicalRegisterKindMask Int8() {return PhysicalRegisterKindMask(true, false, false, false, false, false, false);}
+        static constexpr PhysicalRegisterKindMask Int16() {return PhysicalRegisterKindMask(false, true, false, false, false, false, false);}
+        static constexpr PhysicalRegisterKindMask Int32() {return PhysicalRegisterKindMask(false, false, true, false, false, false, false);}
+        static constexpr PhysicalRegisterKindMask Int64() {return PhysicalRegisterKindMask(false, false, false, true, false, false, false);}
+        static constexpr PhysicalRegisterKindMask Float32() {return PhysicalRegisterKindMask(false, false, false, false, true, false, false);}
+        static constexpr PhysicalRegisterKindMask Float64() {return PhysicalRegisterKindMask(false, false, false, false, false, true, false);}
+        static constexpr PhysicalRegisterKindMask PackedInt() {return PhysicalRegisterKindMask(false, false, false, false, false, false, true);}
         constexpr PhysicalRegisterKindMask operator |(PhysicalRegisterKindMask rt) const
         {
             return PhysicalRegisterKindMask(int8 | rt.int8,
@@ -97,7 +102,8 @@ public:
                                             int32 | rt.int32,
                                             int64 | rt.int64,
                                             float32 | rt.float32,
-                                            float64 | rt.float64);
+                                            float64 | rt.float64,
+                                            packedInt | rt.packedInt);
         }
         constexpr PhysicalRegisterKindMask operator &(PhysicalRegisterKindMask rt) const
         {
@@ -106,11 +112,12 @@ public:
                                             int32 & rt.int32,
                                             int64 & rt.int64,
                                             float32 & rt.float32,
-                                            float64 & rt.float64);
+                                            float64 & rt.float64,
+                                            packedInt & rt.packedInt);
         }
         explicit constexpr operator bool() const
         {
-            return int8 | int16 | int32 | int64 | float32 | float64;
+            return int8 | int16 | int32 | int64 | float32 | float64 | packedInt;
         }
         constexpr bool operator !() const
         {
@@ -123,11 +130,12 @@ public:
                                             ~int32,
                                             ~int64,
                                             ~float32,
-                                            ~float64);
+                                            ~float64,
+                                            ~packedInt);
         }
         constexpr bool operator ==(PhysicalRegisterKindMask rt) const
         {
-            return int8 == rt.int8 && int16 == rt.int16 && int32 == rt.int32 && int64 == rt.int64 && float32 == rt.float32 && float64 == rt.float64;
+            return int8 == rt.int8 && int16 == rt.int16 && int32 == rt.int32 && int64 == rt.int64 && float32 == rt.float32 && float64 == rt.float64 && packedInt == rt.packedInt;
         }
         constexpr bool operator !=(PhysicalRegisterKindMask rt) const
         {
@@ -136,7 +144,7 @@ public:
         std::size_t getHash() const
         {
             std::size_t retval = 0;
-            for(bool v : {int8, int16, int32, int64, float32, float64})
+            for(bool v : {int8, int16, int32, int64, float32, float64, packedInt})
             {
                 retval *= 2;
                 if(v)
@@ -146,6 +154,8 @@ public:
         }
         std::uint64_t getSpillSize() const
         {
+            if(packedInt)
+                return 16;
             if(float64 || int64)
                 return 8;
             if(float32 || int32)
@@ -158,7 +168,7 @@ public:
         }
         std::uint64_t getSaveSize() const
         {
-            if(float32 || float64)
+            if(float32 || float64 || packedInt)
                 return 16;
             if(int64)
                 return 8;
@@ -429,7 +439,7 @@ public:
                     std::ostringstream ss;
                     ss << "xmm" << i;
                     std::string name = ss.str();
-                    std::shared_ptr<X86AsmRegister> r = makePhysicalRegister(context, backend, name, PhysicalRegisterKindMask::Float64() | PhysicalRegisterKindMask::Float32(), false, false);
+                    std::shared_ptr<X86AsmRegister> r = makePhysicalRegister(context, backend, name, PhysicalRegisterKindMask::Float64() | PhysicalRegisterKindMask::Float32() | PhysicalRegisterKindMask::PackedInt(), false, false);
                     r->saveRegister = r;
                     retval->push_back(r);
                 }
@@ -449,7 +459,7 @@ public:
                                                             retval,
                                                             "e" + baseName,
                                                             baseName,
-                                                            true, true);
+                                                            baseName == "sp" || !backend->omitFramePointer, true);
                 }
                 return *retval;
             }
@@ -496,7 +506,7 @@ public:
                     std::ostringstream ss;
                     ss << "xmm" << i;
                     std::string name = ss.str();
-                    std::shared_ptr<X86AsmRegister> r = makePhysicalRegister(context, backend, name, PhysicalRegisterKindMask::Float64() | PhysicalRegisterKindMask::Float32(), false, false);
+                    std::shared_ptr<X86AsmRegister> r = makePhysicalRegister(context, backend, name, PhysicalRegisterKindMask::Float64() | PhysicalRegisterKindMask::Float32() | PhysicalRegisterKindMask::PackedInt(), false, false);
                     r->saveRegister = r;
                     retval->push_back(r);
                 }
@@ -520,7 +530,7 @@ public:
                                                             "e" + baseName,
                                                             baseName,
                                                             baseName + "l",
-                                                            true, true);
+                                                            baseName == "sp" || !backend->omitFramePointer, true);
                 }
                 return *retval;
             }
@@ -559,6 +569,25 @@ public:
         assert(false);
         return nullptr;
     }
+    static std::shared_ptr<X86AsmRegister> getStackPointer(CompilerContext *context, const BackendX86 *backend)
+    {
+        switch(backend->architecture)
+        {
+        case BackendX86::X86_32:
+            return getPhysicalRegister(context, backend, "esp");
+        case BackendX86::X86_64:
+            return getPhysicalRegister(context, backend, "rsp");
+        }
+        assert(false);
+        return nullptr;
+    }
+    /// the register locals are addressed from
+    static std::shared_ptr<X86AsmRegister> getFrameRegister(CompilerContext *context, const BackendX86 *backend)
+    {
+        if(backend->omitFramePointer)
+            return getStackPointer(context, backend);
+        return getBasePointer(context, backend);
+    }
 };
 
 namespace std
@@ -580,6 +609,7 @@ class X86TypeToPhysicalRegisterKindMask final : public TypeVisitor
 private:
     bool isGood = true, isEmpty = true;
     bool isFloatingPoint = false;
+    bool isPackedInteger = false;
     std::size_t sizeInBytes = 0;
     const BackendX86 *const backend;
     X86TypeToPhysicalRegisterKindMask(const BackendX86 *backend)
@@ -590,6 +620,17 @@ private:
     {
         if(isEmpty || !isGood)
             throw std::runtime_error("invalid type mask");
+        if(isPackedInteger)
+        {
+            switch(sizeInBytes)
+            {
+            case 4:
+            case 8:
+            case 16:
+                return X86AsmRegister::PhysicalRegisterKindMask::PackedInt();
+            }
+            throw std::runtime_error("invalid type mask");
+        }
         switch(sizeInBytes)
         {
         case 1:
@@ -689,6 +730,13 @@ public:
             break;
         }
     }
+    virtual void visitTypeVector(std::shared_ptr<TypeVector> node) override
+    {
+        isGood = isGood && isEmpty && dynamic_cast<const TypeInteger *>(node->getElementType().get()) != nullptr;
+        isEmpty = false;
+        isPackedInteger = true;
+        sizeInBytes += node->getTypeProperties().size;
+    }
     static X86AsmRegister::PhysicalRegisterKindMask run(std::shared_ptr<TypeNode> type, const BackendX86 *backend)
     {
         return X86TypeToPhysicalRegisterKindMask(backend).visit(type).getMask();
@@ -717,6 +765,16 @@ public:
         return false;
     }
     virtual void replaceRegister(std::shared_ptr<X86AsmRegister> originalRegister, std::shared_ptr<X86AsmRegister> newRegister) = 0;
+    /// returns a copy of this node writing dest if it can be recomputed at any point from always available operands, otherwise nullptr
+    virtual std::shared_ptr<X86AsmNode> makeRematerializedNode(std::shared_ptr<X86AsmRegister> dest) const
+    {
+        return nullptr;
+    }
+    /// returns true if rematerializing this node and rt produce the same value
+    virtual bool isSameRematerializedValue(const X86AsmNode &rt) const
+    {
+        return false;
+    }
 };
 
 class X86AsmBasicBlock;
@@ -733,6 +791,7 @@ public:
         return std::unordered_set<std::shared_ptr<X86AsmRegister>>{};
     }
     virtual std::list<std::weak_ptr<X86AsmBasicBlock>> targets() const = 0;
+    virtual void replaceTarget(std::shared_ptr<X86AsmBasicBlock> originalTarget, std::shared_ptr<X86AsmBasicBlock> newTarget) = 0;
     virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const = 0;
     virtual void visit(X86AsmNodeVisitor &visitor) = 0;
 };
@@ -778,6 +837,7 @@ public:
 class X86AsmNodeJump;
 class X86AsmNodeCompareAgainstConstantAndJump;
 class X86AsmNodeMove;
+class X86AsmNodeConditionalMove;
 class X86AsmNodeLoadConstant;
 class X86AsmNodeLoad;
 class X86AsmNodeStore;
@@ -787,6 +847,11 @@ class X86AsmNodeCompare;
 class X86AsmNodeTypeCast;
 class X86AsmNodeAdd;
 class X86AsmNodeMul;
+class X86AsmNodeVectorLoad;
+class X86AsmNodeVectorStore;
+class X86AsmNodeVectorAdd;
+class X86AsmNodeRepeatMove;
+class X86AsmNodeRepeatStore;
 
 class X86AsmNodeVisitor
 {
@@ -794,6 +859,7 @@ public:
     virtual void visitX86AsmNodeJump(std::shared_ptr<X86AsmNodeJump> node) = 0;
     virtual void visitX86AsmNodeCompareAgainstConstantAndJump(std::shared_ptr<X86AsmNodeCompareAgainstConstantAndJump> node) = 0;
     virtual void visitX86AsmNodeMove(std::shared_ptr<X86AsmNodeMove> node) = 0;
+    virtual void visitX86AsmNodeConditionalMove(std::shared_ptr<X86AsmNodeConditionalMove> node) = 0;
     virtual void visitX86AsmNodeLoadConstant(std::shared_ptr<X86AsmNodeLoadConstant> node) = 0;
     virtual void visitX86AsmNodeLoad(std::shared_ptr<X86AsmNodeLoad> node) = 0;
     virtual void visitX86AsmNodeStore(std::shared_ptr<X86AsmNodeStore> node) = 0;
@@ -803,6 +869,11 @@ public:
     virtual void visitX86AsmNodeTypeCast(std::shared_ptr<X86AsmNodeTypeCast> node) = 0;
     virtual void visitX86AsmNodeAdd(std::shared_ptr<X86AsmNodeAdd> node) = 0;
     virtual void visitX86AsmNodeMul(std::shared_ptr<X86AsmNodeMul> node) = 0;
+    virtual void visitX86AsmNodeVectorLoad(std::shared_ptr<X86AsmNodeVectorLoad> node) = 0;
+    virtual void visitX86AsmNodeVectorStore(std::shared_ptr<X86AsmNodeVectorStore> node) = 0;
+    virtual void visitX86AsmNodeVectorAdd(std::shared_ptr<X86AsmNodeVectorAdd> node) = 0;
+    virtual void visitX86AsmNodeRepeatMove(std::shared_ptr<X86AsmNodeRepeatMove> node) = 0;
+    virtual void visitX86AsmNodeRepeatStore(std::shared_ptr<X86AsmNodeRepeatStore> node) = 0;
 };
 
 class X86AsmNodeJump final : public X86AsmControlTransfer
@@ -817,6 +888,11 @@ public:
     {
         return std::list<std::weak_ptr<X86AsmBasicBlock>>{target};
     }
+    virtual void replaceTarget(std::shared_ptr<X86AsmBasicBlock> originalTarget, std::shared_ptr<X86AsmBasicBlock> newTarget) override
+    {
+        if(target.lock() == originalTarget)
+            target = newTarget;
+    }
     virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
     {
         return std::unordered_set<std::shared_ptr<X86AsmRegister>>{};
@@ -887,7 +963,7 @@ inline X86ConditionType X86InvertCondition(X86ConditionType c)
     case X86ConditionType::GE:
         return X86ConditionType::L;
     case X86ConditionType::G:
-        return X86ConditionType::GE;
+        return X86ConditionType::LE;
     case X86ConditionType::E:
         return X86ConditionType::NE;
     case X86ConditionType::NE:
@@ -1007,6 +1083,13 @@ public:
     {
         return std::list<std::weak_ptr<X86AsmBasicBlock>>{trueTarget, falseTarget};
     }
+    virtual void replaceTarget(std::shared_ptr<X86AsmBasicBlock> originalTarget, std::shared_ptr<X86AsmBasicBlock> newTarget) override
+    {
+        if(trueTarget.lock() == originalTarget)
+            trueTarget = newTarget;
+        if(falseTarget.lock() == originalTarget)
+            falseTarget = newTarget;
+    }
     virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
     {
         return std::unordered_set<std::shared_ptr<X86AsmRegister>>{lhs};
@@ -1052,6 +1135,40 @@ public:
     }
 };
 
+/// moves source to dest if the boolean in condition is true
+class X86AsmNodeConditionalMove final : public X86AsmNode
+{
+public:
+    std::shared_ptr<X86AsmRegister> dest;
+    std::shared_ptr<X86AsmRegister> condition;
+    std::shared_ptr<X86AsmRegister> source;
+    explicit X86AsmNodeConditionalMove(std::shared_ptr<X86AsmRegister> dest, std::shared_ptr<X86AsmRegister> condition, std::shared_ptr<X86AsmRegister> source)
+        : X86AsmNode(dest->context, dest->backend), dest(dest), condition(condition), source(source)
+    {
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{dest, condition, source};
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> outputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{dest};
+    }
+    virtual void visit(X86AsmNodeVisitor &visitor) override
+    {
+        visitor.visitX86AsmNodeConditionalMove(std::static_pointer_cast<X86AsmNodeConditionalMove>(shared_from_this()));
+    }
+    virtual void replaceRegister(std::shared_ptr<X86AsmRegister> originalRegister, std::shared_ptr<X86AsmRegister> newRegister) override
+    {
+        if(dest == originalRegister)
+            dest = newRegister;
+        if(condition == originalRegister)
+            condition = newRegister;
+        if(source == originalRegister)
+            source = newRegister;
+    }
+};
+
 class X86AsmNodeTypeCast final : public X86AsmNode
 {
 public:
@@ -1159,7 +1276,7 @@ public:
     }
     virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
     {
-        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{X86AsmRegister::getBasePointer(context, backend)};
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{X86AsmRegister::getFrameRegister(context, backend)};
     }
     virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> outputSet() const override
     {
@@ -1187,7 +1304,7 @@ public:
     }
     virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
     {
-        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{X86AsmRegister::getBasePointer(context, backend), value};
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{X86AsmRegister::getFrameRegister(context, backend), value};
     }
     virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> outputSet() const override
     {
@@ -1268,6 +1385,17 @@ public:
         if(dest == originalRegister)
             dest = newRegister;
     }
+    virtual std::shared_ptr<X86AsmNode> makeRematerializedNode(std::shared_ptr<X86AsmRegister> dest) const override
+    {
+        return std::make_shared<X86AsmNodeLoadConstant>(dest, value);
+    }
+    virtual bool isSameRematerializedValue(const X86AsmNode &rt) const override
+    {
+        const X86AsmNodeLoadConstant *rtLoadConstant = dynamic_cast<const X86AsmNodeLoadConstant *>(&rt);
+        if(rtLoadConstant == nullptr)
+            return false;
+        return *value == *rtLoadConstant->value;
+    }
 };
 
 class X86AsmNodeAdd final : public X86AsmNode
@@ -1330,4 +1458,182 @@ public:
     }
 };
 
+/// loads the low sizeInBytes bytes of a xmm register from memory that doesn't need to be aligned
+class X86AsmNodeVectorLoad final : public X86AsmNode
+{
+public:
+    std::shared_ptr<X86AsmRegister> dest;
+    std::shared_ptr<X86AsmRegister> address;
+    std::uint64_t sizeInBytes;
+    explicit X86AsmNodeVectorLoad(std::shared_ptr<X86AsmRegister> dest, std::shared_ptr<X86AsmRegister> address, std::uint64_t sizeInBytes)
+        : X86AsmNode(dest->context, dest->backend), dest(dest), address(address), sizeInBytes(sizeInBytes)
+    {
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{address};
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> outputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{dest};
+    }
+    virtual void visit(X86AsmNodeVisitor &visitor) override
+    {
+        visitor.visitX86AsmNodeVectorLoad(std::static_pointer_cast<X86AsmNodeVectorLoad>(shared_from_this()));
+    }
+    virtual void replaceRegister(std::shared_ptr<X86AsmRegister> originalRegister, std::shared_ptr<X86AsmRegister> newRegister) override
+    {
+        if(address == originalRegister)
+            address = newRegister;
+        if(dest == originalRegister)
+            dest = newRegister;
+    }
+};
+
+/// stores the low sizeInBytes bytes of a xmm register to memory that doesn't need to be aligned
+class X86AsmNodeVectorStore final : public X86AsmNode
+{
+public:
+    std::shared_ptr<X86AsmRegister> address;
+    std::shared_ptr<X86AsmRegister> value;
+    std::uint64_t sizeInBytes;
+    explicit X86AsmNodeVectorStore(std::shared_ptr<X86AsmRegister> address, std::shared_ptr<X86AsmRegister> value, std::uint64_t sizeInBytes)
+        : X86AsmNode(address->context, address->backend), address(address), value(value), sizeInBytes(sizeInBytes)
+    {
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{address, value};
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> outputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{};
+    }
+    virtual void visit(X86AsmNodeVisitor &visitor) override
+    {
+        visitor.visitX86AsmNodeVectorStore(std::static_pointer_cast<X86AsmNodeVectorStore>(shared_from_this()));
+    }
+    virtual bool hasSideEffects() const override
+    {
+        return true;
+    }
+    virtual void replaceRegister(std::shared_ptr<X86AsmRegister> originalRegister, std::shared_ptr<X86AsmRegister> newRegister) override
+    {
+        if(address == originalRegister)
+            address = newRegister;
+        if(value == originalRegister)
+            value = newRegister;
+    }
+};
+
+/// adds each elementSize byte element of rhs to dest
+class X86AsmNodeVectorAdd final : public X86AsmNode
+{
+public:
+    std::shared_ptr<X86AsmRegister> dest;
+    std::shared_ptr<X86AsmRegister> rhs;
+    std::uint64_t elementSize;
+    explicit X86AsmNodeVectorAdd(std::shared_ptr<X86AsmRegister> dest, std::shared_ptr<X86AsmRegister> rhs, std::uint64_t elementSize)
+        : X86AsmNode(dest->context, dest->backend), dest(dest), rhs(rhs), elementSize(elementSize)
+    {
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{dest, rhs};
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> outputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{dest};
+    }
+    virtual void visit(X86AsmNodeVisitor &visitor) override
+    {
+        visitor.visitX86AsmNodeVectorAdd(std::static_pointer_cast<X86AsmNodeVectorAdd>(shared_from_this()));
+    }
+    virtual void replaceRegister(std::shared_ptr<X86AsmRegister> originalRegister, std::shared_ptr<X86AsmRegister> newRegister) override
+    {
+        if(dest == originalRegister)
+            dest = newRegister;
+        if(rhs == originalRegister)
+            rhs = newRegister;
+    }
+};
+
+/// rep movs : dest, source and count have to be the physical registers rdi, rsi and rcx, which are all left changed
+class X86AsmNodeRepeatMove final : public X86AsmNode
+{
+public:
+    std::shared_ptr<X86AsmRegister> dest;
+    std::shared_ptr<X86AsmRegister> source;
+    std::shared_ptr<X86AsmRegister> count;
+    std::uint64_t elementSize;
+    explicit X86AsmNodeRepeatMove(std::shared_ptr<X86AsmRegister> dest, std::shared_ptr<X86AsmRegister> source, std::shared_ptr<X86AsmRegister> count, std::uint64_t elementSize)
+        : X86AsmNode(dest->context, dest->backend), dest(dest), source(source), count(count), elementSize(elementSize)
+    {
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{dest, source, count};
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> outputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{dest, source, count};
+    }
+    virtual void visit(X86AsmNodeVisitor &visitor) override
+    {
+        visitor.visitX86AsmNodeRepeatMove(std::static_pointer_cast<X86AsmNodeRepeatMove>(shared_from_this()));
+    }
+    virtual bool hasSideEffects() const override
+    {
+        return true;
+    }
+    virtual void replaceRegister(std::shared_ptr<X86AsmRegister> originalRegister, std::shared_ptr<X86AsmRegister> newRegister) override
+    {
+        if(dest == originalRegister)
+            dest = newRegister;
+        if(source == originalRegister)
+            source = newRegister;
+        if(count == originalRegister)
+            count = newRegister;
+    }
+};
+
+/// rep stos : dest, value and count have to be the physical registers rdi, rax and rcx, dest and count are left changed
+class X86AsmNodeRepeatStore final : public X86AsmNode
+{
+public:
+    std::shared_ptr<X86AsmRegister> dest;
+    std::shared_ptr<X86AsmRegister> value;
+    std::shared_ptr<X86AsmRegister> count;
+    std::uint64_t elementSize;
+    explicit X86AsmNodeRepeatStore(std::shared_ptr<X86AsmRegister> dest, std::shared_ptr<X86AsmRegister> value, std::shared_ptr<X86AsmRegister> count, std::uint64_t elementSize)
+        : X86AsmNode(dest->context, dest->backend), dest(dest), value(value), count(count), elementSize(elementSize)
+    {
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> inputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{dest, value, count};
+    }
+    virtual std::unordered_set<std::shared_ptr<X86AsmRegister>> outputSet() const override
+    {
+        return std::unordered_set<std::shared_ptr<X86AsmRegister>>{dest, count};
+    }
+    virtual void visit(X86AsmNodeVisitor &visitor) override
+    {
+        visitor.visitX86AsmNodeRepeatStore(std::static_pointer_cast<X86AsmNodeRepeatStore>(shared_from_this()));
+    }
+    virtual bool hasSideEffects() const override
+    {
+        return true;
+    }
+    virtual void replaceRegister(std::shared_ptr<X86AsmRegister> originalRegister, std::shared_ptr<X86AsmRegister> newRegister) override
+    {
+        if(dest == originalRegister)
+            dest = newRegister;
+        if(value == originalRegister)
+            value = newRegister;
+        if(count == originalRegister)
+            count = newRegister;
+    }
+};
+
 #endif // X86_ASM_NODE_H_INCLUDED
@@ -20,11 +20,14 @@
 #define X86_ASM_WRITER_H_INCLUDED
 
 #include "backend/x86/x86_asm_nodes.h"
+#include "backend/x86/x86_shrink_wrapping.h"
+#include "backend/x86/x86_block_layout.h"
 #include <ostream>
 #include <string>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
+#include <cassert>
 
 class X86AsmWriter_GAS_Intel final : public X86AsmNodeVisitor
 {
@@ -33,7 +36,6 @@ private:
     std::ostream &os;
     bool doBlockJoining = true;
     std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, std::string> blockLabelMap;
-    std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, bool> blockJoinMap;
     std::size_t nextLabelIndex = 0;
     std::string getBlockLabel(std::shared_ptr<X86AsmBasicBlock> block)
     {
@@ -52,14 +54,26 @@ private:
         : backend(backend), os(os)
     {
     }
-    enum class Phase
-    {
-        CreateBlockJoinMap,
-        Write
-    };
-    Phase phase = Phase::CreateBlockJoinMap;
     std::shared_ptr<X86AsmBasicBlock> currentBlock, nextBlock;
-    std::uint64_t alignedLocalsSize = 0;
+    std::int64_t localsOffset = 0; /// offset from the frame register to the start of the locals
+    std::int64_t canonicalFrameAddressOffset = 0; /// offset from the frame register to the CFA
+    std::uint64_t stackAdjustment = 0; /// subtracted from the stack pointer in the prologue
+    std::string getLocalAddress(CompilerContext *context, std::uint64_t start) const
+    {
+        std::ostringstream ss;
+        std::int64_t offset = localsOffset + static_cast<std::int64_t>(start);
+        ss << "[%" << X86AsmRegister::getFrameRegister(context, backend)->name;
+        if(offset > 0)
+            ss << " + " << offset;
+        else if(offset < 0)
+            ss << " - " << -offset;
+        ss << "]";
+        return ss.str();
+    }
+    std::int64_t getCanonicalFrameAddressOffset(std::uint64_t start) const
+    {
+        return localsOffset + static_cast<std::int64_t>(start) - canonicalFrameAddressOffset;
+    }
     struct SavedRegister final
     {
         std::shared_ptr<X86AsmRegister> r;
@@ -71,63 +85,87 @@ private:
         }
     };
     std::list<SavedRegister> savedRegisters;
-public:
-    virtual void visitX86AsmNodeJump(std::shared_ptr<X86AsmNodeJump> node) override
+    X86ShrinkWrapping shrinkWrapping;
+    X86BlockLayout blockLayout;
+    bool areRegistersSavedForCFI = false; /// what the unwind info says at the current point in the output
+    void writeSavedRegistersCFI(bool areSaved)
     {
-        switch(phase)
+        areRegistersSavedForCFI = areSaved;
+        for(const SavedRegister &r : savedRegisters)
         {
-        case Phase::CreateBlockJoinMap:
-            if(node->target.lock() == nextBlock)
-            {
-                blockJoinMap[nextBlock] = true;
-            }
-            break;
-        case Phase::Write:
-            if(!doBlockJoining || node->target.lock() != nextBlock)
-                os << "    jmp " << getBlockLabel(node->target.lock()) << "\n";
-            break;
+            if(r.isFloatingPoint)
+                continue;
+            if(areSaved)
+                os << "    .cfi_offset %" << r.r->name << ", " << getCanonicalFrameAddressOffset(r.saveLocationStart) << "\n";
+            else
+                os << "    .cfi_restore %" << r.r->name << "\n";
         }
     }
-    virtual void visitX86AsmNodeCompareAgainstConstantAndJump(std::shared_ptr<X86AsmNodeCompareAgainstConstantAndJump> node) override
+    void writeSaves(CompilerContext *context)
     {
-        switch(phase)
+        for(const SavedRegister &r : savedRegisters)
         {
-        case Phase::CreateBlockJoinMap:
-            if(node->trueTarget.lock() == nextBlock || node->falseTarget.lock() == nextBlock)
+            if(r.isFloatingPoint)
             {
-                blockJoinMap[nextBlock] = true;
+                os << "    movaps " << getLocalAddress(context, r.saveLocationStart) << ", %" << r.r->name << "\n";
             }
-            break;
-        case Phase::Write:
-        {
-            bool reversed = false;
-            bool skipFinalJump = false;
-            if(doBlockJoining && node->trueTarget.lock() == nextBlock)
+            else
             {
-                skipFinalJump = true;
-                reversed = true;
+                os << "    mov " << getLocalAddress(context, r.saveLocationStart) << ", %" << r.r->name << "\n";
+                os << "    .cfi_offset %" << r.r->name << ", " << getCanonicalFrameAddressOffset(r.saveLocationStart) << "\n";
             }
-            if(doBlockJoining && node->falseTarget.lock() == nextBlock)
+        }
+        areRegistersSavedForCFI = true;
+    }
+    void writeRestores(CompilerContext *context)
+    {
+        for(const SavedRegister &r : savedRegisters)
+        {
+            if(r.isFloatingPoint)
             {
-                skipFinalJump = true;
+                os << "    movaps %" << r.r->name << ", " << getLocalAddress(context, r.saveLocationStart) << "\n";
             }
-            std::shared_ptr<ValueBoolean> rhs = std::dynamic_pointer_cast<ValueBoolean>(node->rhs);
-            if(rhs == nullptr)
-                throw NotImplementedException("type not implemented");
-            os << "    cmp %" << node->lhs->name << ", " << (rhs->value ? "1" : "0") << "\n";
-            if(reversed)
-                os << "    " << X86GetJmpName(X86InvertCondition(node->conditionType)) << " " << getBlockLabel(node->falseTarget.lock()) << "\n";
             else
-                os << "    " << X86GetJmpName(node->conditionType) << " " << getBlockLabel(node->trueTarget.lock()) << "\n";
-            if(!skipFinalJump)
             {
-                if(reversed)
-                    os << "    jmp " << getBlockLabel(node->trueTarget.lock()) << "\n";
-                else
-                    os << "    jmp " << getBlockLabel(node->falseTarget.lock()) << "\n";
+                os << "    mov %" << r.r->name << ", " << getLocalAddress(context, r.saveLocationStart) << "\n";
+                os << "    .cfi_restore %" << r.r->name << "\n";
             }
-            break;
         }
+        areRegistersSavedForCFI = false;
+    }
+public:
+    virtual void visitX86AsmNodeJump(std::shared_ptr<X86AsmNodeJump> node) override
+    {
+        if(!doBlockJoining || node->target.lock() != nextBlock)
+            os << "    jmp " << getBlockLabel(node->target.lock()) << "\n";
+    }
+    virtual void visitX86AsmNodeCompareAgainstConstantAndJump(std::shared_ptr<X86AsmNodeCompareAgainstConstantAndJump> node) override
+    {
+        bool reversed = false;
+        bool skipFinalJump = false;
+        if(doBlockJoining && node->trueTarget.lock() == nextBlock)
+        {
+            skipFinalJump = true;
+            reversed = true;
+        }
+        if(doBlockJoining && node->falseTarget.lock() == nextBlock)
+        {
+            skipFinalJump = true;
+        }
+        std::shared_ptr<ValueBoolean> rhs = std::dynamic_pointer_cast<ValueBoolean>(node->rhs);
+        if(rhs == nullptr)
+            throw NotImplementedException("type not implemented");
+        os << "    cmp %" << node->lhs->name << ", " << (rhs->value ? "1" : "0") << "\n";
+        if(reversed)
+            os << "    " << X86GetJmpName(X86InvertCondition(node->conditionType)) << " " << getBlockLabel(node->falseTarget.lock()) << "\n";
+        else
+            os << "    " << X86GetJmpName(node->conditionType) << " " << getBlockLabel(node->trueTarget.lock()) << "\n";
+        if(!skipFinalJump)
+        {
+            if(reversed)
+                os << "    jmp " << getBlockLabel(node->trueTarget.lock()) << "\n";
+            else
+                os << "    jmp " << getBlockLabel(node->falseTarget.lock()) << "\n";
         }
     }
     virtual void visitX86AsmNodeCompare(std::shared_ptr<X86AsmNodeCompare> node) override
@@ -137,7 +175,15 @@ public:
     }
     virtual void visitX86AsmNodeMove(std::shared_ptr<X86AsmNodeMove> node) override
     {
-        os << "    mov %" << node->dest->name << ", %" << node->source->name << "\n";
+        if(isXmmRegister(node->dest))
+            os << "    movdqa %" << node->dest->name << ", %" << node->source->name << "\n";
+        else
+            os << "    mov %" << node->dest->name << ", %" << node->source->name << "\n";
+    }
+    virtual void visitX86AsmNodeConditionalMove(std::shared_ptr<X86AsmNodeConditionalMove> node) override
+    {
+        os << "    test %" << node->condition->name << ", %" << node->condition->name << "\n";
+        os << "    cmovnz %" << node->dest->name << ", %" << node->source->name << "\n";
     }
     virtual void visitX86AsmNodeAdd(std::shared_ptr<X86AsmNodeAdd> node) override
     {
@@ -149,6 +195,13 @@ public:
     }
     virtual void visitX86AsmNodeTypeCast(std::shared_ptr<X86AsmNodeTypeCast> node) override
     {
+        std::shared_ptr<TypeVector> sourceTypeVector = std::dynamic_pointer_cast<TypeVector>(node->sourceType->toNonConstant()->toNonVolatile());
+        std::shared_ptr<TypeVector> destTypeVector = std::dynamic_pointer_cast<TypeVector>(node->destType->toNonConstant()->toNonVolatile());
+        if(sourceTypeVector && destTypeVector)
+        {
+            writeVectorTypeCast(node, destTypeVector, sourceTypeVector);
+            return;
+        }
         if(node->destType->toNonConstant()->toNonVolatile() == node->sourceType->toNonConstant()->toNonVolatile())
         {
             os << "    mov %" << node->dest->name << ", %" << node->source->name << "\n";
@@ -295,7 +348,7 @@ public:
             os << "    mov %" << node->dest->name << ", " << (valueBoolean->value ? "1" : "0") << "\n";
         else if(std::shared_ptr<ValueVariablePointer> valueVariablePointer = std::dynamic_pointer_cast<ValueVariablePointer>(node->value))
         {
-            os << "    lea %" << node->dest->name << ", [%" << X86AsmRegister::getBasePointer(node->context, backend)->name << " - " << (alignedLocalsSize - valueVariablePointer->location.getStart()) << "]\n";
+            os << "    lea %" << node->dest->name << ", " << getLocalAddress(node->context, valueVariablePointer->location.getStart()) << "\n";
         }
         else if(std::shared_ptr<ValueNullPointer> valueNullPointer = std::dynamic_pointer_cast<ValueNullPointer>(node->value))
             os << "    mov %" << node->dest->name << ", 0\n";
@@ -319,52 +372,147 @@ public:
     }
     virtual void visitX86AsmNodeLoadLocal(std::shared_ptr<X86AsmNodeLoadLocal> node) override
     {
-        os << "    mov %" << node->dest->name << ", [%" << X86AsmRegister::getBasePointer(node->context, backend)->name << " - " << (alignedLocalsSize - node->location.getStart()) << "]\n";
+        if(isXmmRegister(node->dest))
+            os << "    movdqu %" << node->dest->name << ", " << getLocalAddress(node->context, node->location.getStart()) << "\n";
+        else
+            os << "    mov %" << node->dest->name << ", " << getLocalAddress(node->context, node->location.getStart()) << "\n";
     }
     virtual void visitX86AsmNodeStoreLocal(std::shared_ptr<X86AsmNodeStoreLocal> node) override
     {
-        os << "    mov [%" << X86AsmRegister::getBasePointer(node->context, backend)->name << " - " << (alignedLocalsSize - node->location.getStart()) << "], %" << node->value->name << "\n";
+        if(isXmmRegister(node->value))
+            os << "    movdqu " << getLocalAddress(node->context, node->location.getStart()) << ", %" << node->value->name << "\n";
+        else
+            os << "    mov " << getLocalAddress(node->context, node->location.getStart()) << ", %" << node->value->name << "\n";
+    }
+    virtual void visitX86AsmNodeVectorLoad(std::shared_ptr<X86AsmNodeVectorLoad> node) override
+    {
+        os << "    " << getVectorMoveName(node->sizeInBytes) << " %" << node->dest->name << ", [%" << node->address->name << "]\n";
+    }
+    virtual void visitX86AsmNodeVectorStore(std::shared_ptr<X86AsmNodeVectorStore> node) override
+    {
+        os << "    " << getVectorMoveName(node->sizeInBytes) << " [%" << node->address->name << "], %" << node->value->name << "\n";
+    }
+    virtual void visitX86AsmNodeVectorAdd(std::shared_ptr<X86AsmNodeVectorAdd> node) override
+    {
+        os << "    padd" << getPackedSuffix(node->elementSize) << " %" << node->dest->name << ", %" << node->rhs->name << "\n";
+    }
+    virtual void visitX86AsmNodeRepeatMove(std::shared_ptr<X86AsmNodeRepeatMove> node) override
+    {
+        os << "    rep movs" << getStringSuffix(node->elementSize) << "\n";
+    }
+    virtual void visitX86AsmNodeRepeatStore(std::shared_ptr<X86AsmNodeRepeatStore> node) override
+    {
+        os << "    rep stos" << getStringSuffix(node->elementSize) << "\n";
     }
 private:
+    static bool isXmmRegister(std::shared_ptr<X86AsmRegister> r)
+    {
+        return static_cast<bool>(r->physicalRegisterKindMask & X86AsmRegister::PhysicalRegisterKindMask::PackedInt());
+    }
+    static const char *getVectorMoveName(std::uint64_t sizeInBytes)
+    {
+        switch(sizeInBytes)
+        {
+        case 4:
+            return "movd";
+        case 8:
+            return "movq";
+        case 16:
+            return "movdqu";
+        }
+        throw std::runtime_error("vector size is not implemented");
+    }
+    static const char *getStringSuffix(std::uint64_t elementSize)
+    {
+        switch(elementSize)
+        {
+        case 1:
+            return "b";
+        case 2:
+            return "w";
+        case 4:
+            return "d";
+        case 8:
+            return "q";
+        }
+        throw std::runtime_error("invalid string instruction element size");
+    }
+    static const char *getPackedSuffix(std::uint64_t elementSize)
+    {
+        switch(elementSize)
+        {
+        case 1:
+            return "b";
+        case 2:
+            return "w";
+        case 4:
+            return "d";
+        case 8:
+            return "q";
+        }
+        throw std::runtime_error("vector element size is not implemented");
+    }
+    /// SSE2 has no pmovzx/pmovsx, so each element is widened by interleaving the vector with itself and shifting the copy out
+    void writeVectorTypeCast(std::shared_ptr<X86AsmNodeTypeCast> node, std::shared_ptr<TypeVector> destType, std::shared_ptr<TypeVector> sourceType)
+    {
+        std::uint64_t destSize = destType->getElementType()->getTypeProperties().size;
+        std::uint64_t sourceSize = sourceType->getElementType()->getTypeProperties().size;
+        std::shared_ptr<TypeInteger> sourceTypeInteger = std::dynamic_pointer_cast<TypeInteger>(sourceType->getElementType());
+        if(destType->elementCount != sourceType->elementCount || destSize < sourceSize || sourceTypeInteger == nullptr)
+            throw std::runtime_error("type cast is not implemented");
+        if(node->dest != node->source)
+            os << "    movdqa %" << node->dest->name << ", %" << node->source->name << "\n";
+        if(destSize == sourceSize)
+            return;
+        if(!sourceTypeInteger->isUnsigned && destSize > 4)
+            throw std::runtime_error("type cast is not implemented");
+        static const char *const unpackNames[] = {"punpcklbw", "punpcklwd", "punpckldq"};
+        std::size_t unpackIndex = 0;
+        for(std::uint64_t size = 1; size < sourceSize; size *= 2)
+            unpackIndex++;
+        for(std::uint64_t size = sourceSize; size < destSize; size *= 2)
+            os << "    " << unpackNames[unpackIndex++] << " %" << node->dest->name << ", %" << node->dest->name << "\n";
+        os << "    " << (sourceTypeInteger->isUnsigned ? "psrl" : "psra") << getPackedSuffix(destSize) << " %" << node->dest->name << ", " << (destSize - sourceSize) * 8 << "\n";
+    }
     void visitX86AsmBasicBlock(std::shared_ptr<X86AsmBasicBlock> block, bool writeAlign)
     {
         currentBlock = block;
-        switch(phase)
+        if(writeAlign)
         {
-        case Phase::CreateBlockJoinMap:
+            os << "    .align 16, 0x90\n";
+        }
+        writeBlockLabel(block);
+        bool isSavedAtStart = shrinkWrapping.savedAtStartBlocks.count(block) != 0;
+        if(isSavedAtStart != areRegistersSavedForCFI) // the previous block in the output isn't a predecessor in the same state
+            writeSavedRegistersCFI(isSavedAtStart);
+        if(block == shrinkWrapping.saveBlock && !isSavedAtStart)
+            writeSaves(block->context);
+        for(std::shared_ptr<X86AsmNode> node : block->instructions)
         {
-            if(block->controlTransferInstruction != nullptr)
-            {
-                block->controlTransferInstruction->visit(*this);
-            }
-            break;
+            if(node == block->controlTransferInstruction && shrinkWrapping.restoreBlocks.count(block) != 0)
+                writeRestores(block->context);
+            node->visit(*this);
         }
-        case Phase::Write:
+        if(block->controlTransferInstruction == nullptr) // final block
         {
-            if(writeAlign && (!doBlockJoining || !blockJoinMap[block]))
+            os << "    .cfi_remember_state\n";
+            bool wereRegistersSavedForCFI = areRegistersSavedForCFI;
+            if(shrinkWrapping.restoreBlocks.count(block) != 0)
+                writeRestores(block->context);
+            areRegistersSavedForCFI = wereRegistersSavedForCFI; // undone by .cfi_restore_state
+            if(backend->omitFramePointer)
             {
-                os << "    .align 16, 0x90\n";
-            }
-            writeBlockLabel(block);
-            for(std::shared_ptr<X86AsmNode> node : block->instructions)
-            {
-                node->visit(*this);
-            }
-            if(block->controlTransferInstruction == nullptr) // final block
-            {
-                os << "    .cfi_remember_state\n";
-                for(const SavedRegister &r : savedRegisters)
+                std::shared_ptr<X86AsmRegister> stackPointer = X86AsmRegister::getStackPointer(block->context, backend);
+                if(stackAdjustment != 0)
                 {
-                    if(r.isFloatingPoint)
-                    {
-                        os << "    movaps %" << r.r->name << ", [%" << X86AsmRegister::getBasePointer(block->context, backend)->name << " - " << (alignedLocalsSize - r.saveLocationStart) << "]\n";
-                    }
-                    else
-                    {
-                        os << "    mov %" << r.r->name << ", [%" << X86AsmRegister::getBasePointer(block->context, backend)->name << " - " << (alignedLocalsSize - r.saveLocationStart) << "]\n";
-                        os << "    .cfi_restore %" << r.r->name << "\n";
-                    }
+                    os << "    add %" << stackPointer->name << ", " << stackAdjustment << "\n";
+                    os << "    .cfi_def_cfa_offset " << (canonicalFrameAddressOffset - static_cast<std::int64_t>(stackAdjustment)) << "\n";
                 }
+                os << "    ret\n";
+                os << "    .cfi_restore_state\n";
+            }
+            else
+            {
                 switch(backend->architecture)
                 {
                 case BackendX86::X86_32:
@@ -383,10 +531,8 @@ private:
                     break;
                 }
             }
-            os << "\n";
-            break;
-        }
         }
+        os << "\n";
     }
     void visitX86AsmFunction(std::shared_ptr<X86AsmFunction> function)
     {
@@ -396,23 +542,6 @@ private:
         os << "    .type main, @function\n";
         os << "main:\n";
         os << "    .cfi_startproc\n";
-        switch(backend->architecture)
-        {
-        case BackendX86::X86_32:
-            os << "    push %ebp\n";
-            os << "    .cfi_def_cfa_offset 8\n";
-            os << "    mov %ebp, %esp\n";
-            os << "    .cfi_offset %ebp, -8\n";
-            os << "    .cfi_def_cfa_register %ebp\n";
-            break;
-        case BackendX86::X86_64:
-            os << "    push %rbp\n";
-            os << "    .cfi_def_cfa_offset 16\n";
-            os << "    .cfi_offset %rbp, -16\n";
-            os << "    mov %rbp, %rsp\n";
-            os << "    .cfi_def_cfa_register %rbp\n";
-            break;
-        }
         savedRegisters.clear();
         std::unordered_set<std::shared_ptr<X86AsmRegister>> savedRegistersSet;
         for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
@@ -432,66 +561,70 @@ private:
         {
             savedRegisters.push_front(SavedRegister(r, r->physicalRegisterKindMask.createSaveLocation(function->localVariablesSize), static_cast<bool>(r->physicalRegisterKindMask & X86AsmRegister::PhysicalRegisterKindMask::Float())));
         }
+        shrinkWrapping.visitX86AsmFunction(function, savedRegistersSet);
+        blockLayout.visitX86AsmFunction(function);
         savedRegistersSet.clear();
         const std::uint64_t stackAlign = 16;
-        alignedLocalsSize = ((function->localVariablesSize + (stackAlign - 1)) / stackAlign) * stackAlign;
+        std::int64_t returnAddressSize = 0;
         switch(backend->architecture)
         {
         case BackendX86::X86_32:
-            if(alignedLocalsSize != 0)
-                os << "    sub %esp, " << alignedLocalsSize << "\n";
-            for(const SavedRegister &r : savedRegisters)
-            {
-                if(r.isFloatingPoint)
-                {
-                    os << "    movaps [%ebp - " << (alignedLocalsSize - r.saveLocationStart) << "], %" << r.r->name << "\n";
-                }
-                else
-                {
-                    os << "    mov [%ebp - " << (alignedLocalsSize - r.saveLocationStart) << "], %" << r.r->name << "\n";
-                    os << "    .cfi_rel_offset %" << r.r->name << ", " << (alignedLocalsSize - r.saveLocationStart) << "\n";
-                }
-            }
+            returnAddressSize = 4;
             break;
         case BackendX86::X86_64:
-            if(alignedLocalsSize != 0)
-                os << "    sub %rsp, " << alignedLocalsSize << "\n";
-            for(const SavedRegister &r : savedRegisters)
-            {
-                if(r.isFloatingPoint)
-                {
-                    os << "    movaps [%rbp - " << (alignedLocalsSize - r.saveLocationStart) << "], %" << r.r->name << "\n";
-                }
-                else
-                {
-                    os << "    mov [%rbp - " << (alignedLocalsSize - r.saveLocationStart) << "], %" << r.r->name << "\n";
-                    os << "    .cfi_rel_offset %" << r.r->name << ", " << (alignedLocalsSize - r.saveLocationStart) << "\n";
-                }
-            }
+            returnAddressSize = 8;
             break;
         }
-        os << "\n";
-        std::vector<std::shared_ptr<X86AsmBasicBlock>> blocks;
-        blocks.reserve(function->blocks.size());
-        blocks.push_back(function->startBlock);
-        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        std::shared_ptr<X86AsmRegister> stackPointer = X86AsmRegister::getStackPointer(function->context, backend);
+        if(backend->omitFramePointer)
         {
-            blockJoinMap[block] = false;
-            if(block == function->startBlock)
-                continue;
-            blocks.push_back(block);
+            std::uint64_t frameSize = 0;
+            if(function->localVariablesSize != 0) // keep the stack pointer aligned as it was before the call
+                frameSize = ((function->localVariablesSize + returnAddressSize + (stackAlign - 1)) / stackAlign) * stackAlign - returnAddressSize;
+            const std::uint64_t redZoneSize = 128;
+            // there are no call nodes, so every function is a leaf and can keep its frame in the x86-64 red zone
+            bool useRedZone = backend->architecture == BackendX86::X86_64 && frameSize <= redZoneSize;
+            stackAdjustment = useRedZone ? 0 : frameSize;
+            localsOffset = static_cast<std::int64_t>(stackAdjustment) - static_cast<std::int64_t>(frameSize);
+            canonicalFrameAddressOffset = returnAddressSize + static_cast<std::int64_t>(stackAdjustment);
+            if(stackAdjustment != 0)
+            {
+                os << "    sub %" << stackPointer->name << ", " << stackAdjustment << "\n";
+                os << "    .cfi_def_cfa_offset " << canonicalFrameAddressOffset << "\n";
+            }
         }
-        phase = Phase::CreateBlockJoinMap;
-        for(std::size_t i = 0; i < blocks.size(); i++)
+        else
         {
-            std::shared_ptr<X86AsmBasicBlock> block = blocks[i];
-            if(i + 1 >= blocks.size())
-                nextBlock = nullptr;
-            else
-                nextBlock = blocks[i + 1];
-            visitX86AsmBasicBlock(block, block != function->startBlock);
+            switch(backend->architecture)
+            {
+            case BackendX86::X86_32:
+                os << "    push %ebp\n";
+                os << "    .cfi_def_cfa_offset 8\n";
+                os << "    mov %ebp, %esp\n";
+                os << "    .cfi_offset %ebp, -8\n";
+                os << "    .cfi_def_cfa_register %ebp\n";
+                break;
+            case BackendX86::X86_64:
+                os << "    push %rbp\n";
+                os << "    .cfi_def_cfa_offset 16\n";
+                os << "    .cfi_offset %rbp, -16\n";
+                os << "    mov %rbp, %rsp\n";
+                os << "    .cfi_def_cfa_register %rbp\n";
+                break;
+            }
+            std::uint64_t alignedLocalsSize = ((function->localVariablesSize + (stackAlign - 1)) / stackAlign) * stackAlign;
+            stackAdjustment = alignedLocalsSize;
+            localsOffset = -static_cast<std::int64_t>(alignedLocalsSize);
+            canonicalFrameAddressOffset = 2 * returnAddressSize;
+            if(alignedLocalsSize != 0)
+                os << "    sub %" << stackPointer->name << ", " << alignedLocalsSize << "\n";
         }
-        phase = Phase::Write;
+        areRegistersSavedForCFI = false;
+        if(shrinkWrapping.saveBlock == function->startBlock)
+            writeSaves(function->context);
+        os << "\n";
+        std::vector<std::shared_ptr<X86AsmBasicBlock>> blocks(function->blocks.begin(), function->blocks.end()); // the layout puts the start block first
+        assert(blocks.front() == function->startBlock);
         for(std::size_t i = 0; i < blocks.size(); i++)
         {
             std::shared_ptr<X86AsmBasicBlock> block = blocks[i];
@@ -499,7 +632,7 @@ private:
                 nextBlock = nullptr;
             else
                 nextBlock = blocks[i + 1];
-            visitX86AsmBasicBlock(block, block != function->startBlock);
+            visitX86AsmBasicBlock(block, blockLayout.loopTopBlocks.count(block) != 0);
         }
         os << "    .cfi_endproc\n";
         os << "\n\n";
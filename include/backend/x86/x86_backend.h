@@ -38,8 +38,9 @@ public:
         X86_64,
     };
     const Architecture architecture;
-    explicit BackendX86(AssemblyDialect assemblyDialect, Architecture architecture)
-        : assemblyDialect(assemblyDialect), architecture(architecture)
+    const bool omitFramePointer; /// address locals off the stack pointer and allocate the base pointer like any other register
+    explicit BackendX86(AssemblyDialect assemblyDialect, Architecture architecture, bool omitFramePointer = true)
+        : assemblyDialect(assemblyDialect), architecture(architecture), omitFramePointer(omitFramePointer)
     {
     }
     virtual void outputAsAssembly(std::ostream &os, std::list<std::shared_ptr<RTLFunction>> functions) const override;
@@ -0,0 +1,221 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef X86_BLOCK_LAYOUT_H_INCLUDED
+#define X86_BLOCK_LAYOUT_H_INCLUDED
+
+#include "backend/x86/x86_asm_nodes.h"
+#include "backend/x86/x86_loops.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+/** orders the blocks of a function so the likely successor of each block falls through
+ *
+ * Edge weights come from static heuristics : a block runs 8 times as often for each loop it's in,
+ * and of two successors the one taking a back edge is likely while the one leaving a loop is unlikely.
+ * Chains of blocks are joined along the heaviest edges first (Pettis-Hansen) and then placed
+ * starting with the start block's chain, each time picking the chain most strongly connected to what's already placed.
+ */
+class X86BlockLayout final
+{
+public:
+    std::unordered_set<std::shared_ptr<X86AsmBasicBlock>> loopTopBlocks; /// the first block of each loop in the new order
+private:
+    struct Edge final
+    {
+        std::size_t source;
+        std::size_t dest;
+        std::uint64_t weight;
+        Edge(std::size_t source, std::size_t dest, std::uint64_t weight)
+            : source(source), dest(dest), weight(weight)
+        {
+        }
+    };
+    std::vector<std::shared_ptr<X86AsmBasicBlock>> blocks;
+    std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, std::size_t> blockIndexMap;
+    std::vector<Edge> edges;
+    std::vector<std::vector<std::size_t>> outgoingEdges; /// indexes into edges for each block
+    std::vector<std::vector<std::size_t>> chains;
+    std::vector<std::size_t> chainIndexes; /// the chain each block is in
+    /// +1 for a back edge and -1 for each loop the edge leaves
+    static int getEdgeHint(const std::vector<X86Loop> &loops, std::shared_ptr<X86AsmBasicBlock> sourceBlock, std::shared_ptr<X86AsmBasicBlock> destBlock)
+    {
+        int retval = 0;
+        for(const X86Loop &loop : loops)
+        {
+            if(loop.blocks.count(sourceBlock) == 0)
+                continue;
+            if(loop.header == destBlock)
+                retval++;
+            else if(loop.blocks.count(destBlock) == 0)
+                retval--;
+        }
+        return retval;
+    }
+    void calculateEdges(const std::vector<X86Loop> &loops)
+    {
+        const std::uint64_t probabilityScale = 8;
+        std::vector<std::size_t> loopDepths(blocks.size(), 0);
+        for(const X86Loop &loop : loops)
+        {
+            for(std::shared_ptr<X86AsmBasicBlock> block : loop.blocks)
+                loopDepths[blockIndexMap[block]]++;
+        }
+        edges.clear();
+        for(std::size_t blockIndex = 0; blockIndex < blocks.size(); blockIndex++)
+        {
+            std::shared_ptr<X86AsmBasicBlock> block = blocks[blockIndex];
+            std::uint64_t frequency = 1;
+            for(std::size_t i = 0; i < loopDepths[blockIndex] && i < 8; i++)
+                frequency *= 8;
+            std::vector<std::shared_ptr<X86AsmBasicBlock>> destBlocks;
+            for(std::weak_ptr<X86AsmBasicBlock> destBlock : block->destBlocks)
+                destBlocks.push_back(destBlock.lock());
+            if(destBlocks.size() == 2 && destBlocks[0] != destBlocks[1])
+            {
+                int hint0 = getEdgeHint(loops, block, destBlocks[0]);
+                int hint1 = getEdgeHint(loops, block, destBlocks[1]);
+                std::uint64_t probability0 = probabilityScale / 2;
+                if(hint0 > hint1)
+                    probability0 = probabilityScale - 1;
+                else if(hint0 < hint1)
+                    probability0 = 1;
+                edges.emplace_back(blockIndex, blockIndexMap[destBlocks[0]], frequency * probability0);
+                edges.emplace_back(blockIndex, blockIndexMap[destBlocks[1]], frequency * (probabilityScale - probability0));
+                continue;
+            }
+            for(std::shared_ptr<X86AsmBasicBlock> destBlock : destBlocks)
+                edges.emplace_back(blockIndex, blockIndexMap[destBlock], frequency * probabilityScale / destBlocks.size());
+        }
+        std::stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b)
+        {
+            return a.weight > b.weight;
+        });
+        outgoingEdges.assign(blocks.size(), std::vector<std::size_t>());
+        for(std::size_t edgeIndex = 0; edgeIndex < edges.size(); edgeIndex++)
+            outgoingEdges[edges[edgeIndex].source].push_back(edgeIndex);
+    }
+    void buildChains()
+    {
+        chains.assign(blocks.size(), std::vector<std::size_t>());
+        chainIndexes.resize(blocks.size());
+        for(std::size_t blockIndex = 0; blockIndex < blocks.size(); blockIndex++)
+        {
+            chains[blockIndex].push_back(blockIndex);
+            chainIndexes[blockIndex] = blockIndex;
+        }
+        for(const Edge &edge : edges)
+        {
+            if(edge.dest == 0) // the start block has to stay at the start of its chain
+                continue;
+            std::size_t sourceChain = chainIndexes[edge.source];
+            std::size_t destChain = chainIndexes[edge.dest];
+            if(sourceChain == destChain)
+                continue;
+            if(chains[sourceChain].back() != edge.source || chains[destChain].front() != edge.dest)
+                continue;
+            for(std::size_t blockIndex : chains[destChain])
+            {
+                chains[sourceChain].push_back(blockIndex);
+                chainIndexes[blockIndex] = sourceChain;
+            }
+            chains[destChain].clear();
+        }
+    }
+    std::vector<std::size_t> placeChains()
+    {
+        std::vector<std::size_t> retval;
+        retval.reserve(blocks.size());
+        std::vector<bool> isChainPlaced(chains.size(), false);
+        std::vector<std::uint64_t> connectionWeights(chains.size(), 0); /// weight of the edges from placed blocks into each chain
+        std::size_t chainIndex = chainIndexes[0];
+        while(true)
+        {
+            isChainPlaced[chainIndex] = true;
+            for(std::size_t blockIndex : chains[chainIndex])
+            {
+                retval.push_back(blockIndex);
+                for(std::size_t edgeIndex : outgoingEdges[blockIndex])
+                {
+                    const Edge &edge = edges[edgeIndex];
+                    connectionWeights[chainIndexes[edge.dest]] += edge.weight;
+                }
+            }
+            bool found = false;
+            for(std::size_t i = 0; i < chains.size(); i++)
+            {
+                if(isChainPlaced[i] || chains[i].empty())
+                    continue;
+                if(!found || connectionWeights[i] > connectionWeights[chainIndex])
+                    chainIndex = i;
+                found = true;
+            }
+            if(!found)
+                break;
+        }
+        return retval;
+    }
+public:
+    void visitX86AsmFunction(std::shared_ptr<X86AsmFunction> function)
+    {
+        loopTopBlocks.clear();
+        blocks.clear();
+        blockIndexMap.clear();
+        blocks.push_back(function->startBlock);
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            if(block != function->startBlock)
+                blocks.push_back(block);
+        }
+        for(std::size_t blockIndex = 0; blockIndex < blocks.size(); blockIndex++)
+            blockIndexMap[blocks[blockIndex]] = blockIndex;
+        const std::vector<X86Loop> loops = X86FindLoops(function);
+        calculateEdges(loops);
+        buildChains();
+        std::vector<std::size_t> order = placeChains();
+        std::vector<std::size_t> positions(blocks.size());
+        function->blocks.clear();
+        for(std::size_t i = 0; i < order.size(); i++)
+        {
+            positions[order[i]] = i;
+            function->blocks.push_back(blocks[order[i]]);
+        }
+        for(const X86Loop &loop : loops)
+        {
+            std::shared_ptr<X86AsmBasicBlock> loopTopBlock = loop.header;
+            for(std::shared_ptr<X86AsmBasicBlock> block : loop.blocks)
+            {
+                if(positions[blockIndexMap[block]] < positions[blockIndexMap[loopTopBlock]])
+                    loopTopBlock = block;
+            }
+            loopTopBlocks.insert(loopTopBlock);
+        }
+        blocks.clear();
+        blockIndexMap.clear();
+        edges.clear();
+        outgoingEdges.clear();
+        chains.clear();
+        chainIndexes.clear();
+    }
+};
+
+#endif // X86_BLOCK_LAYOUT_H_INCLUDED
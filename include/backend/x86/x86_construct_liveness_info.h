@@ -20,6 +20,9 @@
 #define X86_CONSTRUCT_LIVENESS_INFO_H_INCLUDED
 
 #include "backend/x86/x86_asm_nodes.h"
+#include "util/dataflow.h"
+#include <unordered_map>
+#include <vector>
 
 class X86ConstructLivenessInfo final
 {
@@ -46,33 +49,48 @@ public:
                 block->liveRegistersAtStart = block->usedRegistersAtStart;
             }
         }
-        bool done = false;
-        while(!done)
+        std::vector<std::shared_ptr<X86AsmRegister>> registers;
+        std::unordered_map<std::shared_ptr<X86AsmRegister>, std::size_t> registerIndexMap;
+        auto getRegisterIndex = [&](std::shared_ptr<X86AsmRegister> r)
         {
-            done = true;
-            for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+            auto iter = registerIndexMap.find(r);
+            if(iter != registerIndexMap.end())
+                return std::get<1>(*iter);
+            std::size_t index = registers.size();
+            registers.push_back(r);
+            registerIndexMap[r] = index;
+            return index;
+        };
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            for(std::shared_ptr<X86AsmRegister> r : block->usedRegistersAtStart)
+                getRegisterIndex(r);
+            for(std::shared_ptr<X86AsmRegister> r : block->assignedRegisters)
+                getRegisterIndex(r);
+        }
+        DataflowSolver<X86AsmBasicBlock> solver(function->startBlock, function->blocks, DataflowDirection::Backward);
+        std::vector<bit_vector> generated(solver.getBlockCount(), bit_vector(registers.size()));
+        std::vector<bit_vector> killed(solver.getBlockCount(), bit_vector(registers.size()));
+        for(std::size_t blockIndex = 0; blockIndex < solver.getBlockCount(); blockIndex++)
+        {
+            std::shared_ptr<X86AsmBasicBlock> block = solver.getBlock(blockIndex);
+            for(std::shared_ptr<X86AsmRegister> r : block->usedRegistersAtStart)
+                generated[blockIndex].set(registerIndexMap[r]);
+            for(std::shared_ptr<X86AsmRegister> r : block->assignedRegisters)
+                killed[blockIndex].set(registerIndexMap[r]);
+        }
+        solver.solve(generated, killed, registers.size());
+        for(std::size_t blockIndex = 0; blockIndex < solver.getBlockCount(); blockIndex++)
+        {
+            std::shared_ptr<X86AsmBasicBlock> block = solver.getBlock(blockIndex);
+            solver.getValueAtStart(blockIndex).for_each_set_bit([&](std::size_t index)
             {
-                for(std::shared_ptr<X86AsmRegister> r : block->liveRegistersAtEnd)
-                {
-                    if(block->assignedRegisters.count(r) != 0)
-                        continue;
-                    if(std::get<1>(block->liveRegistersAtStart.insert(r)))
-                    {
-                        done = false;
-                    }
-                }
-                for(std::weak_ptr<X86AsmBasicBlock> targetW : block->destBlocks)
-                {
-                    std::shared_ptr<X86AsmBasicBlock> target = targetW.lock();
-                    for(std::shared_ptr<X86AsmRegister> r : target->liveRegistersAtStart)
-                    {
-                        if(std::get<1>(block->liveRegistersAtEnd.insert(r)))
-                        {
-                            done = false;
-                        }
-                    }
-                }
-            }
+                block->liveRegistersAtStart.insert(registers[index]);
+            });
+            solver.getValueAtEnd(blockIndex).for_each_set_bit([&](std::size_t index)
+            {
+                block->liveRegistersAtEnd.insert(registers[index]);
+            });
         }
     }
 };
@@ -21,6 +21,7 @@
 
 #include "backend/x86/x86_backend.h"
 #include "backend/x86/x86_asm_nodes.h"
+#include "util/dataflow.h"
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -29,6 +30,16 @@ class X86DeadCodeElimination final
 {
 private:
     const BackendX86 *const backend;
+    struct NodeInfo final
+    {
+        std::shared_ptr<X86AsmNode> node;
+        std::size_t blockIndex;
+        bool isUsed = false;
+        std::vector<std::size_t> inputs;
+        /// the node in the same block that defines each input or noDefinition if the input comes from the block start
+        std::vector<std::size_t> inputDefinitionNodes;
+        std::vector<std::size_t> outputs;
+    };
 public:
     explicit X86DeadCodeElimination(const BackendX86 *backend)
         : backend(backend)
@@ -36,61 +47,115 @@ public:
     }
     void visitX86AsmFunction(std::shared_ptr<X86AsmFunction> function)
     {
-        std::unordered_set<std::shared_ptr<X86AsmNode>> usedNodesSet;
-        std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, std::unordered_set<std::shared_ptr<X86AsmRegister>>> blockUsedRegistersAtEndSetMap;
-        bool done = false;
-        while(!done)
+        const std::size_t noDefinition = ~(std::size_t)0;
+        std::unordered_map<std::shared_ptr<X86AsmRegister>, std::size_t> registerIndexMap;
+        auto getRegisterIndex = [&](std::shared_ptr<X86AsmRegister> r)
+        {
+            auto iter = registerIndexMap.find(r);
+            if(iter != registerIndexMap.end())
+                return std::get<1>(*iter);
+            std::size_t index = registerIndexMap.size();
+            registerIndexMap[r] = index;
+            return index;
+        };
+        DataflowSolver<X86AsmBasicBlock> solver(function->startBlock, function->blocks, DataflowDirection::Forward);
+        std::vector<NodeInfo> nodes;
+        std::vector<std::size_t> worklist;
+        std::vector<std::size_t> definitionNodes; // definition index -> node index
+        std::vector<std::vector<std::size_t>> registerDefinitions; // register index -> definition indexes
+        std::vector<std::unordered_map<std::size_t, std::size_t>> blockLastDefinitions; // block index -> register index -> definition index
+        blockLastDefinitions.resize(solver.getBlockCount());
+        for(std::size_t blockIndex = 0; blockIndex < solver.getBlockCount(); blockIndex++)
         {
-            done = true;
-            for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+            std::shared_ptr<X86AsmBasicBlock> block = solver.getBlock(blockIndex);
+            std::unordered_map<std::size_t, std::size_t> &lastDefinitions = blockLastDefinitions[blockIndex];
+            for(std::shared_ptr<X86AsmNode> node : block->instructions)
             {
-                if(block->controlTransferInstruction != nullptr)
-                    if(std::get<1>(usedNodesSet.insert(block->controlTransferInstruction)))
-                        done = false;
-                std::unordered_set<std::shared_ptr<X86AsmRegister>> usedRegistersSet = blockUsedRegistersAtEndSetMap[block];
-                for(auto i = block->instructions.rbegin(); i != block->instructions.rend(); ++i)
+                std::size_t nodeIndex = nodes.size();
+                nodes.push_back(NodeInfo());
+                NodeInfo &nodeInfo = nodes.back();
+                nodeInfo.node = node;
+                nodeInfo.blockIndex = blockIndex;
+                for(std::shared_ptr<X86AsmRegister> r : node->inputSet())
                 {
-                    std::shared_ptr<X86AsmNode> node = *i;
-                    if(node->hasSideEffects())
-                        if(std::get<1>(usedNodesSet.insert(node)))
-                            done = false;
-                    for(std::shared_ptr<X86AsmRegister> r : node->outputSet())
-                    {
-                        if(usedRegistersSet.erase(r) > 0)
-                            if(std::get<1>(usedNodesSet.insert(node)))
-                                done = false;
-                    }
-                    if(usedNodesSet.count(node) > 0)
-                    {
-                        for(std::shared_ptr<X86AsmRegister> r : node->inputSet())
-                        {
-                            usedRegistersSet.insert(r);
-                        }
-                    }
+                    std::size_t registerIndex = getRegisterIndex(r);
+                    nodeInfo.inputs.push_back(registerIndex);
+                    auto iter = lastDefinitions.find(registerIndex);
+                    if(iter == lastDefinitions.end())
+                        nodeInfo.inputDefinitionNodes.push_back(noDefinition);
+                    else
+                        nodeInfo.inputDefinitionNodes.push_back(definitionNodes[std::get<1>(*iter)]);
                 }
-                for(std::weak_ptr<X86AsmBasicBlock> predecessorBlockW : block->sourceBlocks)
+                for(std::shared_ptr<X86AsmRegister> r : node->outputSet())
                 {
-                    std::shared_ptr<X86AsmBasicBlock> predecessorBlock = predecessorBlockW.lock();
-                    std::unordered_set<std::shared_ptr<X86AsmRegister>> &predecessorBlockUsedRegistersSet = blockUsedRegistersAtEndSetMap[predecessorBlock];
-                    for(std::shared_ptr<X86AsmRegister> r : usedRegistersSet)
-                    {
-                        if(std::get<1>(predecessorBlockUsedRegistersSet.insert(r)))
-                            done = false;
-                    }
+                    std::size_t registerIndex = getRegisterIndex(r);
+                    nodeInfo.outputs.push_back(registerIndex);
+                    if(registerIndex >= registerDefinitions.size())
+                        registerDefinitions.resize(registerIndex + 1);
+                    registerDefinitions[registerIndex].push_back(definitionNodes.size());
+                    lastDefinitions[registerIndex] = definitionNodes.size();
+                    definitionNodes.push_back(nodeIndex);
+                }
+                if(node == block->controlTransferInstruction || node->hasSideEffects())
+                {
+                    nodeInfo.isUsed = true;
+                    worklist.push_back(nodeIndex);
                 }
             }
         }
-        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        registerDefinitions.resize(registerIndexMap.size());
+
+        // reaching definitions are only needed for inputs that aren't defined earlier in the same block
+        std::vector<bit_vector> generated(solver.getBlockCount(), bit_vector(definitionNodes.size()));
+        std::vector<bit_vector> killed(solver.getBlockCount(), bit_vector(definitionNodes.size()));
+        for(std::size_t blockIndex = 0; blockIndex < solver.getBlockCount(); blockIndex++)
         {
-            for(auto i = block->instructions.begin(); i != block->instructions.end(); )
+            for(const std::pair<const std::size_t, std::size_t> &p : blockLastDefinitions[blockIndex])
             {
-                const std::shared_ptr<X86AsmNode> &node = *i;
-                if(usedNodesSet.count(node) > 0)
-                    ++i;
-                else
-                    i = block->instructions.erase(i);
+                for(std::size_t definition : registerDefinitions[std::get<0>(p)])
+                    killed[blockIndex].set(definition);
+                generated[blockIndex].set(std::get<1>(p));
             }
         }
+        solver.solve(generated, killed, definitionNodes.size());
+
+        while(!worklist.empty())
+        {
+            std::size_t nodeIndex = worklist.back();
+            worklist.pop_back();
+            auto markUsed = [&](std::size_t definitionNode)
+            {
+                if(nodes[definitionNode].isUsed)
+                    return;
+                nodes[definitionNode].isUsed = true;
+                worklist.push_back(definitionNode);
+            };
+            const NodeInfo &nodeInfo = nodes[nodeIndex];
+            const bit_vector &reachingAtStart = solver.getValueAtStart(nodeInfo.blockIndex);
+            for(std::size_t i = 0; i < nodeInfo.inputs.size(); i++)
+            {
+                if(nodeInfo.inputDefinitionNodes[i] != noDefinition)
+                {
+                    markUsed(nodeInfo.inputDefinitionNodes[i]);
+                    continue;
+                }
+                for(std::size_t definition : registerDefinitions[nodeInfo.inputs[i]])
+                {
+                    if(reachingAtStart.test(definition))
+                        markUsed(definitionNodes[definition]);
+                }
+            }
+        }
+
+        auto nodeIter = nodes.begin();
+        for(std::size_t blockIndex = 0; blockIndex < solver.getBlockCount(); blockIndex++)
+        {
+            solver.getBlock(blockIndex)->instructions.erase_if([&](const std::shared_ptr<X86AsmNode> &node)
+            {
+                assert(nodeIter->node == node);
+                return !(nodeIter++)->isUsed;
+            });
+        }
     }
 };
 
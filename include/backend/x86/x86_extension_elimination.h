@@ -0,0 +1,83 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef X86_EXTENSION_ELIMINATION_H_INCLUDED
+#define X86_EXTENSION_ELIMINATION_H_INCLUDED
+
+#include "backend/x86/x86_backend.h"
+#include "backend/x86/x86_asm_nodes.h"
+#include "backend/x86/x86_known_bits.h"
+
+/** removes the moves, extensions and truncations that don't change their register
+ *
+ * Moves and truncations of a register into itself are always removed. An extension in place is removed if
+ * X86KnownBits knows that every bit it would clear is already zero, and a sign extension of a value with
+ * a zero sign bit into another register becomes a zero extension.
+ */
+class X86ExtensionElimination final
+{
+private:
+    const BackendX86 *const backend;
+    bool isRedundant(const X86KnownBits &knownBits, const X86KnownBits::State &state, std::shared_ptr<X86AsmNode> node) const
+    {
+        if(X86KnownBits::isMoveToSelf(node))
+            return true;
+        std::shared_ptr<X86AsmNodeTypeCast> typeCast = std::dynamic_pointer_cast<X86AsmNodeTypeCast>(node);
+        if(typeCast == nullptr)
+            return false;
+        std::size_t sourceBitCount = X86KnownBits::getBitCount(typeCast->source), destBitCount = X86KnownBits::getBitCount(typeCast->dest);
+        if(sourceBitCount == 0 || destBitCount == 0 || destBitCount <= sourceBitCount)
+            return false;
+        std::uint64_t knownZeroBits = knownBits.read(state, typeCast->source);
+        bool isSignBitZero = (knownZeroBits >> (sourceBitCount - 1)) & 1;
+        if(!X86KnownBits::isSourceUnsigned(typeCast->sourceType) && !isSignBitZero)
+            return false;
+        if(X86KnownBits::getLowerPart(typeCast->dest, sourceBitCount) != typeCast->source)
+        {
+            if(!X86KnownBits::isSourceUnsigned(typeCast->sourceType))
+                typeCast->sourceType = TypeInteger::make(typeCast->context, true, std::static_pointer_cast<TypeInteger>(typeCast->sourceType->toNonConstant()->toNonVolatile())->width);
+            return false;
+        }
+        // writing a 32-bit register also clears the upper half, so those bits have to be known too
+        std::size_t writtenBitCount = destBitCount >= 32 ? knownBits.getWholeRegisterBitCount() : destBitCount;
+        std::uint64_t extendedBits = X86KnownBits::getLowMask(writtenBitCount) & ~X86KnownBits::getLowMask(sourceBitCount);
+        return (knownBits.read(state, typeCast->dest->getSaveRegister()) & extendedBits) == extendedBits;
+    }
+public:
+    explicit X86ExtensionElimination(const BackendX86 *backend)
+        : backend(backend)
+    {
+    }
+    void visitX86AsmFunction(std::shared_ptr<X86AsmFunction> function)
+    {
+        X86KnownBits knownBits(backend, function);
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            X86KnownBits::State state = knownBits.getStateAtStart(block);
+            block->instructions.erase_if([&](const std::shared_ptr<X86AsmNode> &node)
+            {
+                if(isRedundant(knownBits, state, node))
+                    return true;
+                knownBits.transfer(state, node);
+                return false;
+            });
+        }
+    }
+};
+
+#endif // X86_EXTENSION_ELIMINATION_H_INCLUDED
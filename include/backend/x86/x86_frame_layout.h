@@ -0,0 +1,248 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef X86_FRAME_LAYOUT_H_INCLUDED
+#define X86_FRAME_LAYOUT_H_INCLUDED
+
+#include "backend/x86/x86_backend.h"
+#include "backend/x86/x86_asm_nodes.h"
+#include "util/variable.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+
+/// shares stack slots between locals with disjoint lifetimes and packs the frame
+class X86FrameLayout final
+{
+private:
+    const BackendX86 *const backend;
+    typedef std::shared_ptr<VariableDescriptor> Slot;
+    struct SlotData final
+    {
+        std::unordered_set<Slot> intersectingSlots;
+        std::uint64_t referenceCount = 0;
+        bool isAddressTaken = false; /// may be accessed through a pointer so it is live everywhere
+    };
+    struct SlotGroup final
+    {
+        std::vector<Slot> slots;
+        TypeProperties typeProperties;
+        std::uint64_t referenceCount = 0;
+    };
+    static std::uint64_t getMinimumStoreSize(X86AsmRegister::PhysicalRegisterKindMask physicalRegisterKindMask)
+    {
+        if(physicalRegisterKindMask.packedInt) // xmm registers are always stored whole
+            return 16;
+        if(physicalRegisterKindMask.int8)
+            return 1;
+        if(physicalRegisterKindMask.int16)
+            return 2;
+        if(physicalRegisterKindMask.int32 || physicalRegisterKindMask.float32)
+            return 4;
+        return 8;
+    }
+    static bool isFrameSlot(const VariableLocation &location)
+    {
+        return location.good() && location.variable->getKind() == VariableDescriptor::Kind::LocalVariable && !location.variable->needAllocation();
+    }
+    /// returns the slot node reads or nullptr
+    static Slot getLoadedSlot(std::shared_ptr<X86AsmNode> node)
+    {
+        if(const X86AsmNodeLoadLocal *loadNode = dynamic_cast<const X86AsmNodeLoadLocal *>(node.get()))
+        {
+            if(isFrameSlot(loadNode->location))
+                return loadNode->location.variable;
+        }
+        return nullptr;
+    }
+    /// returns the slot node writes or nullptr; isKill is set if the whole slot is overwritten
+    static Slot getStoredSlot(std::shared_ptr<X86AsmNode> node, bool &isKill)
+    {
+        isKill = false;
+        if(const X86AsmNodeStoreLocal *storeNode = dynamic_cast<const X86AsmNodeStoreLocal *>(node.get()))
+        {
+            if(!isFrameSlot(storeNode->location))
+                return nullptr;
+            isKill = storeNode->location.offset == 0 && getMinimumStoreSize(storeNode->value->physicalRegisterKindMask) >= storeNode->location.variable->getSize();
+            return storeNode->location.variable;
+        }
+        return nullptr;
+    }
+    static Slot getAddressedSlot(std::shared_ptr<X86AsmNode> node)
+    {
+        if(const X86AsmNodeLoadConstant *loadNode = dynamic_cast<const X86AsmNodeLoadConstant *>(node.get()))
+        {
+            if(std::shared_ptr<ValueVariablePointer> valueVariablePointer = std::dynamic_pointer_cast<ValueVariablePointer>(loadNode->value))
+            {
+                if(isFrameSlot(valueVariablePointer->location))
+                    return valueVariablePointer->location.variable;
+            }
+        }
+        return nullptr;
+    }
+    static void calculateSlotData(std::shared_ptr<X86AsmFunction> function, std::unordered_map<Slot, SlotData> &slots)
+    {
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            for(std::shared_ptr<X86AsmNode> node : block->instructions)
+            {
+                bool isKill;
+                Slot loadedSlot = getLoadedSlot(node), storedSlot = getStoredSlot(node, isKill), addressedSlot = getAddressedSlot(node);
+                if(loadedSlot != nullptr)
+                    slots[loadedSlot].referenceCount++;
+                if(storedSlot != nullptr)
+                    slots[storedSlot].referenceCount++;
+                if(addressedSlot != nullptr)
+                {
+                    slots[addressedSlot].referenceCount++;
+                    slots[addressedSlot].isAddressTaken = true;
+                }
+            }
+        }
+        std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, std::unordered_set<Slot>> liveSlotsAtEnd;
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+            {
+                std::unordered_set<Slot> liveSlots = liveSlotsAtEnd[block];
+                for(auto i = block->instructions.rbegin(); i != block->instructions.rend(); ++i)
+                {
+                    bool isKill;
+                    Slot storedSlot = getStoredSlot(*i, isKill);
+                    if(storedSlot != nullptr && isKill)
+                        liveSlots.erase(storedSlot);
+                    Slot loadedSlot = getLoadedSlot(*i);
+                    if(loadedSlot != nullptr)
+                        liveSlots.insert(loadedSlot);
+                }
+                for(std::weak_ptr<X86AsmBasicBlock> sourceBlockW : block->sourceBlocks)
+                {
+                    std::unordered_set<Slot> &sourceLiveSlots = liveSlotsAtEnd[sourceBlockW.lock()];
+                    for(Slot slot : liveSlots)
+                    {
+                        if(std::get<1>(sourceLiveSlots.insert(slot)))
+                            done = false;
+                    }
+                }
+            }
+        }
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            std::unordered_set<Slot> liveSlots = liveSlotsAtEnd[block];
+            for(auto i = block->instructions.rbegin(); i != block->instructions.rend(); ++i)
+            {
+                bool isKill;
+                Slot storedSlot = getStoredSlot(*i, isKill);
+                if(storedSlot != nullptr)
+                {
+                    // a store clobbers whatever shares the slot, even if the stored value is dead
+                    for(Slot slot : liveSlots)
+                    {
+                        if(slot == storedSlot)
+                            continue;
+                        slots[slot].intersectingSlots.insert(storedSlot);
+                        slots[storedSlot].intersectingSlots.insert(slot);
+                    }
+                    if(isKill)
+                        liveSlots.erase(storedSlot);
+                }
+                Slot loadedSlot = getLoadedSlot(*i);
+                if(loadedSlot != nullptr)
+                    liveSlots.insert(loadedSlot);
+            }
+        }
+    }
+public:
+    explicit X86FrameLayout(const BackendX86 *backend)
+        : backend(backend)
+    {
+    }
+    void visitX86AsmFunction(std::shared_ptr<X86AsmFunction> function)
+    {
+        std::unordered_map<Slot, SlotData> slots;
+        calculateSlotData(function, slots);
+        std::vector<Slot> sortedSlots;
+        sortedSlots.reserve(slots.size());
+        for(auto &p : slots)
+        {
+            sortedSlots.push_back(std::get<0>(p));
+        }
+        std::sort(sortedSlots.begin(), sortedSlots.end(), [&](Slot a, Slot b)
+        {
+            if(slots[a].referenceCount != slots[b].referenceCount)
+                return slots[a].referenceCount > slots[b].referenceCount;
+            return a->getStart() < b->getStart(); // keep the output deterministic
+        });
+        std::vector<SlotGroup> groups;
+        for(Slot slot : sortedSlots)
+        {
+            const SlotData &slotData = slots[slot];
+            SlotGroup *pickedGroup = nullptr;
+            if(!slotData.isAddressTaken)
+            {
+                for(SlotGroup &group : groups)
+                {
+                    bool canShare = true;
+                    for(Slot groupSlot : group.slots)
+                    {
+                        if(slots[groupSlot].isAddressTaken || slotData.intersectingSlots.count(groupSlot) != 0)
+                        {
+                            canShare = false;
+                            break;
+                        }
+                    }
+                    if(!canShare)
+                        continue;
+                    if(pickedGroup == nullptr || (pickedGroup->typeProperties.size != slot->getSize() && group.typeProperties.size == slot->getSize()))
+                        pickedGroup = &group;
+                }
+            }
+            if(pickedGroup == nullptr)
+            {
+                groups.emplace_back();
+                pickedGroup = &groups.back();
+            }
+            pickedGroup->slots.push_back(slot);
+            pickedGroup->typeProperties.size = std::max(pickedGroup->typeProperties.size, slot->getSize());
+            pickedGroup->typeProperties.alignment = std::max(pickedGroup->typeProperties.alignment, slot->getAlignment());
+            pickedGroup->referenceCount += slotData.referenceCount;
+        }
+        // decreasing alignment doesn't need padding; the densest references end up closest to the frame pointer
+        std::stable_sort(groups.begin(), groups.end(), [](const SlotGroup &a, const SlotGroup &b)
+        {
+            if(a.typeProperties.alignment != b.typeProperties.alignment)
+                return a.typeProperties.alignment > b.typeProperties.alignment;
+            return a.referenceCount * b.typeProperties.size < b.referenceCount * a.typeProperties.size;
+        });
+        std::uint64_t localVariablesSize = 0;
+        for(const SlotGroup &group : groups)
+        {
+            std::uint64_t start = group.typeProperties.allocateVariable(localVariablesSize);
+            for(Slot slot : group.slots)
+            {
+                slot->setStart(start);
+            }
+        }
+        function->localVariablesSize = localVariablesSize;
+    }
+};
+
+#endif // X86_FRAME_LAYOUT_H_INCLUDED
@@ -0,0 +1,287 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef X86_KNOWN_BITS_H_INCLUDED
+#define X86_KNOWN_BITS_H_INCLUDED
+
+#include "backend/x86/x86_backend.h"
+#include "backend/x86/x86_asm_nodes.h"
+#include <unordered_map>
+#include <cstdint>
+
+/** the bits of the integer registers that are known to be zero
+ *
+ * Works on physical registers so it runs after register allocation. The bits are kept for the whole register,
+ * so a write to eax and a read of rax see the same bits. Writing a 32-bit register clears the upper half on x86_64
+ * and writing an 8 or 16-bit register keeps the rest of the register.
+ */
+class X86KnownBits final
+{
+public:
+    typedef std::unordered_map<std::shared_ptr<X86AsmRegister>, std::uint64_t> State; /// whole register -> known zero bits
+private:
+    const BackendX86 *const backend;
+    std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, State> statesAtStart;
+public:
+    static std::uint64_t getLowMask(std::size_t bitCount)
+    {
+        if(bitCount >= 64)
+            return ~static_cast<std::uint64_t>(0);
+        return (static_cast<std::uint64_t>(1) << bitCount) - 1;
+    }
+    /// @return the size of reg in bits or 0 if it's not a physical integer register
+    static std::size_t getBitCount(std::shared_ptr<X86AsmRegister> reg)
+    {
+        if(reg->registerType != X86AsmRegister::RegisterType::Physical || reg->getSaveRegister() == nullptr)
+            return 0;
+        if(reg->physicalRegisterKindMask == X86AsmRegister::PhysicalRegisterKindMask::Int8())
+            return 8;
+        if(reg->physicalRegisterKindMask == X86AsmRegister::PhysicalRegisterKindMask::Int16())
+            return 16;
+        if(reg->physicalRegisterKindMask == X86AsmRegister::PhysicalRegisterKindMask::Int32())
+            return 32;
+        if(reg->physicalRegisterKindMask == X86AsmRegister::PhysicalRegisterKindMask::Int64())
+            return 64;
+        return 0;
+    }
+    /// @return the part of reg that has the low bitCount bits or nullptr
+    static std::shared_ptr<X86AsmRegister> getLowerPart(std::shared_ptr<X86AsmRegister> reg, std::size_t bitCount)
+    {
+        switch(bitCount)
+        {
+        case 8:
+            return reg->getLower8();
+        case 16:
+            return reg->getLower16();
+        case 32:
+            return reg->getLower32();
+        case 64:
+            return reg->getLower64();
+        default:
+            return nullptr;
+        }
+    }
+    static bool isHighByteRegister(std::shared_ptr<X86AsmRegister> reg)
+    {
+        return getBitCount(reg) == 8 && reg->getSaveRegister()->getLower8() != reg;
+    }
+    std::size_t getWholeRegisterBitCount() const
+    {
+        return backend->architecture == BackendX86::X86_64 ? 64 : 32;
+    }
+    /// @return the known zero bits of the value in reg
+    std::uint64_t read(const State &state, std::shared_ptr<X86AsmRegister> reg) const
+    {
+        std::size_t bitCount = getBitCount(reg);
+        if(bitCount == 0)
+            return 0;
+        auto iter = state.find(reg->getSaveRegister());
+        if(iter == state.end())
+            return 0;
+        if(isHighByteRegister(reg))
+            return (std::get<1>(*iter) >> 8) & getLowMask(8);
+        return std::get<1>(*iter) & getLowMask(bitCount);
+    }
+    void write(State &state, std::shared_ptr<X86AsmRegister> reg, std::uint64_t knownZeroBits) const
+    {
+        std::size_t bitCount = getBitCount(reg);
+        if(bitCount == 0)
+            return;
+        std::uint64_t &wholeRegister = state[reg->getSaveRegister()];
+        std::uint64_t lowMask = getLowMask(bitCount);
+        if(isHighByteRegister(reg))
+            wholeRegister = (wholeRegister & ~(lowMask << 8)) | ((knownZeroBits & lowMask) << 8);
+        else if(bitCount >= 32) // the upper half of the 64-bit register is cleared
+            wholeRegister = (knownZeroBits & lowMask) | (getLowMask(getWholeRegisterBitCount()) & ~lowMask);
+        else
+            wholeRegister = (wholeRegister & ~lowMask) | (knownZeroBits & lowMask);
+    }
+    static std::size_t countLeadingKnownZeros(std::uint64_t knownZeroBits, std::size_t bitCount)
+    {
+        std::size_t retval = 0;
+        while(retval < bitCount && (knownZeroBits >> (bitCount - retval - 1)) & 1)
+            retval++;
+        return retval;
+    }
+    static std::size_t countTrailingKnownZeros(std::uint64_t knownZeroBits, std::size_t bitCount)
+    {
+        std::size_t retval = 0;
+        while(retval < bitCount && (knownZeroBits >> retval) & 1)
+            retval++;
+        return retval;
+    }
+    static std::uint64_t makeKnownZeroBits(std::size_t leadingZeros, std::size_t trailingZeros, std::size_t bitCount)
+    {
+        if(leadingZeros > bitCount)
+            leadingZeros = bitCount;
+        if(trailingZeros > bitCount)
+            trailingZeros = bitCount;
+        return (getLowMask(bitCount) & ~getLowMask(bitCount - leadingZeros)) | getLowMask(trailingZeros);
+    }
+    static bool isSourceUnsigned(std::shared_ptr<TypeNode> type)
+    {
+        const TypeInteger *typeInteger = dynamic_cast<const TypeInteger *>(type->toNonConstant()->toNonVolatile().get());
+        return typeInteger == nullptr || typeInteger->isUnsigned;
+    }
+    /** @return true if node is a move or a truncation that reads and writes the same register
+     *
+     * X86ExtensionElimination always removes these, so they don't change the state.
+     */
+    static bool isMoveToSelf(std::shared_ptr<X86AsmNode> node)
+    {
+        if(std::shared_ptr<X86AsmNodeMove> move = std::dynamic_pointer_cast<X86AsmNodeMove>(node))
+            return move->dest == move->source;
+        std::shared_ptr<X86AsmNodeTypeCast> typeCast = std::dynamic_pointer_cast<X86AsmNodeTypeCast>(node);
+        if(typeCast == nullptr)
+            return false;
+        std::size_t sourceBitCount = getBitCount(typeCast->source), destBitCount = getBitCount(typeCast->dest);
+        return sourceBitCount != 0 && destBitCount != 0 && destBitCount <= sourceBitCount && getLowerPart(typeCast->source, destBitCount) == typeCast->dest;
+    }
+    /// changes state to what it is after node
+    void transfer(State &state, std::shared_ptr<X86AsmNode> node) const
+    {
+        if(std::shared_ptr<X86AsmNodeLoadConstant> loadConstant = std::dynamic_pointer_cast<X86AsmNodeLoadConstant>(node))
+        {
+            std::uint64_t knownZeroBits = 0;
+            if(std::shared_ptr<ValueInteger> valueInteger = std::dynamic_pointer_cast<ValueInteger>(loadConstant->value))
+                knownZeroBits = ~static_cast<std::uint64_t>(valueInteger->getSignedValue());
+            else if(std::shared_ptr<ValueBoolean> valueBoolean = std::dynamic_pointer_cast<ValueBoolean>(loadConstant->value))
+                knownZeroBits = valueBoolean->value ? ~static_cast<std::uint64_t>(1) : ~static_cast<std::uint64_t>(0);
+            else if(std::dynamic_pointer_cast<ValueNullPointer>(loadConstant->value) != nullptr)
+                knownZeroBits = ~static_cast<std::uint64_t>(0);
+            write(state, loadConstant->dest, knownZeroBits);
+            return;
+        }
+        if(isMoveToSelf(node))
+            return;
+        if(std::shared_ptr<X86AsmNodeMove> move = std::dynamic_pointer_cast<X86AsmNodeMove>(node))
+        {
+            write(state, move->dest, read(state, move->source));
+            return;
+        }
+        if(std::shared_ptr<X86AsmNodeConditionalMove> conditionalMove = std::dynamic_pointer_cast<X86AsmNodeConditionalMove>(node))
+        {
+            /// cmov writes dest even when the condition is false
+            write(state, conditionalMove->dest, read(state, conditionalMove->dest) & read(state, conditionalMove->source));
+            return;
+        }
+        if(std::shared_ptr<X86AsmNodeTypeCast> typeCast = std::dynamic_pointer_cast<X86AsmNodeTypeCast>(node))
+        {
+            std::size_t sourceBitCount = getBitCount(typeCast->source), destBitCount = getBitCount(typeCast->dest);
+            if(sourceBitCount == 0 || destBitCount == 0)
+            {
+                write(state, typeCast->dest, 0);
+                return;
+            }
+            std::uint64_t knownZeroBits = read(state, typeCast->source);
+            if(destBitCount > sourceBitCount)
+            {
+                if(isSourceUnsigned(typeCast->sourceType) || (knownZeroBits >> (sourceBitCount - 1)) & 1)
+                    knownZeroBits |= getLowMask(destBitCount) & ~getLowMask(sourceBitCount);
+                else
+                    knownZeroBits &= getLowMask(sourceBitCount - 1);
+            }
+            write(state, typeCast->dest, knownZeroBits);
+            return;
+        }
+        if(std::shared_ptr<X86AsmNodeCompare> compare = std::dynamic_pointer_cast<X86AsmNodeCompare>(node))
+        {
+            write(state, compare->dest, ~static_cast<std::uint64_t>(1));
+            return;
+        }
+        if(std::shared_ptr<X86AsmNodeAdd> add = std::dynamic_pointer_cast<X86AsmNodeAdd>(node))
+        {
+            std::size_t bitCount = getBitCount(add->dest);
+            std::uint64_t lhs = read(state, add->dest), rhs = read(state, add->rhs);
+            std::size_t leadingZeros = std::min(countLeadingKnownZeros(lhs, bitCount), countLeadingKnownZeros(rhs, bitCount));
+            std::size_t trailingZeros = std::min(countTrailingKnownZeros(lhs, bitCount), countTrailingKnownZeros(rhs, bitCount));
+            write(state, add->dest, makeKnownZeroBits(leadingZeros > 0 ? leadingZeros - 1 : 0, trailingZeros, bitCount)); // the carry can use one more bit
+            return;
+        }
+        if(std::shared_ptr<X86AsmNodeMul> mul = std::dynamic_pointer_cast<X86AsmNodeMul>(node))
+        {
+            std::size_t bitCount = getBitCount(mul->dest);
+            std::uint64_t lhs = read(state, mul->dest), rhs = read(state, mul->rhs);
+            std::size_t usedBitCount = (bitCount - countLeadingKnownZeros(lhs, bitCount)) + (bitCount - countLeadingKnownZeros(rhs, bitCount));
+            std::size_t trailingZeros = countTrailingKnownZeros(lhs, bitCount) + countTrailingKnownZeros(rhs, bitCount);
+            write(state, mul->dest, makeKnownZeroBits(usedBitCount < bitCount ? bitCount - usedBitCount : 0, trailingZeros, bitCount));
+            return;
+        }
+        for(std::shared_ptr<X86AsmRegister> reg : node->outputSet())
+            write(state, reg, 0);
+    }
+    X86KnownBits(const BackendX86 *backend, std::shared_ptr<X86AsmFunction> function)
+        : backend(backend)
+    {
+        std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, State> statesAtEnd;
+        for(bool done = false; !done;)
+        {
+            done = true;
+            for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+            {
+                State state;
+                bool isFirstSource = true;
+                if(block == function->startBlock)
+                    isFirstSource = false; // nothing is known at the start of the function
+                for(std::weak_ptr<X86AsmBasicBlock> sourceBlock : block->sourceBlocks)
+                {
+                    auto iter = statesAtEnd.find(sourceBlock.lock());
+                    if(iter == statesAtEnd.end()) // not visited yet
+                        continue;
+                    if(isFirstSource)
+                    {
+                        state = std::get<1>(*iter);
+                        isFirstSource = false;
+                        continue;
+                    }
+                    for(auto stateIter = state.begin(); stateIter != state.end();)
+                    {
+                        auto sourceIter = std::get<1>(*iter).find(std::get<0>(*stateIter));
+                        if(sourceIter == std::get<1>(*iter).end())
+                            stateIter = state.erase(stateIter);
+                        else
+                        {
+                            std::get<1>(*stateIter) &= std::get<1>(*sourceIter);
+                            ++stateIter;
+                        }
+                    }
+                }
+                if(isFirstSource && block != function->startBlock) // no source block has been visited
+                    continue;
+                statesAtStart[block] = state;
+                for(std::shared_ptr<X86AsmNode> node : block->instructions)
+                    transfer(state, node);
+                auto iter = statesAtEnd.find(block);
+                if(iter != statesAtEnd.end() && std::get<1>(*iter) == state)
+                    continue;
+                statesAtEnd[block] = std::move(state);
+                done = false;
+            }
+        }
+    }
+    /// @return the known zero bits at the start of block
+    State getStateAtStart(std::shared_ptr<X86AsmBasicBlock> block) const
+    {
+        auto iter = statesAtStart.find(block);
+        if(iter == statesAtStart.end())
+            return State();
+        return std::get<1>(*iter);
+    }
+};
+
+#endif // X86_KNOWN_BITS_H_INCLUDED
@@ -0,0 +1,102 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef X86_LOOPS_H_INCLUDED
+#define X86_LOOPS_H_INCLUDED
+
+#include "backend/x86/x86_asm_nodes.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <vector>
+#include <algorithm>
+
+/// a natural loop : the header and every block that reaches one of its back edges without going through the header
+struct X86Loop final
+{
+    std::shared_ptr<X86AsmBasicBlock> header;
+    std::unordered_set<std::shared_ptr<X86AsmBasicBlock>> blocks;
+    explicit X86Loop(std::shared_ptr<X86AsmBasicBlock> header)
+        : header(header), blocks{header}
+    {
+    }
+};
+
+/// find the natural loops of function, innermost loops first
+inline std::vector<X86Loop> X86FindLoops(std::shared_ptr<X86AsmFunction> function)
+{
+    std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, std::vector<std::shared_ptr<X86AsmBasicBlock>>> backEdges; // header -> latches
+    std::unordered_set<std::shared_ptr<X86AsmBasicBlock>> visitedBlocks, blocksOnStack;
+    std::vector<std::pair<std::shared_ptr<X86AsmBasicBlock>, std::list<std::weak_ptr<X86AsmBasicBlock>>::const_iterator>> stack;
+    visitedBlocks.insert(function->startBlock);
+    blocksOnStack.insert(function->startBlock);
+    stack.emplace_back(function->startBlock, function->startBlock->destBlocks.begin());
+    while(!stack.empty())
+    {
+        std::shared_ptr<X86AsmBasicBlock> block = std::get<0>(stack.back());
+        auto &iter = std::get<1>(stack.back());
+        if(iter == block->destBlocks.end())
+        {
+            blocksOnStack.erase(block);
+            stack.pop_back();
+            continue;
+        }
+        std::shared_ptr<X86AsmBasicBlock> destBlock = (iter++)->lock();
+        if(blocksOnStack.count(destBlock) != 0)
+        {
+            backEdges[destBlock].push_back(block);
+        }
+        else if(std::get<1>(visitedBlocks.insert(destBlock)))
+        {
+            blocksOnStack.insert(destBlock);
+            stack.emplace_back(destBlock, destBlock->destBlocks.begin());
+        }
+    }
+    std::vector<X86Loop> retval;
+    for(auto &p : backEdges)
+    {
+        X86Loop loop(std::get<0>(p));
+        std::vector<std::shared_ptr<X86AsmBasicBlock>> worklist;
+        for(std::shared_ptr<X86AsmBasicBlock> latch : std::get<1>(p))
+        {
+            if(std::get<1>(loop.blocks.insert(latch)))
+                worklist.push_back(latch);
+        }
+        while(!worklist.empty())
+        {
+            std::shared_ptr<X86AsmBasicBlock> block = worklist.back();
+            worklist.pop_back();
+            for(std::weak_ptr<X86AsmBasicBlock> sourceBlockW : block->sourceBlocks)
+            {
+                std::shared_ptr<X86AsmBasicBlock> sourceBlock = sourceBlockW.lock();
+                if(visitedBlocks.count(sourceBlock) == 0) // unreachable
+                    continue;
+                if(std::get<1>(loop.blocks.insert(sourceBlock)))
+                    worklist.push_back(sourceBlock);
+            }
+        }
+        retval.push_back(std::move(loop));
+    }
+    std::sort(retval.begin(), retval.end(), [](const X86Loop &a, const X86Loop &b)
+    {
+        return a.blocks.size() < b.blocks.size();
+    });
+    return retval;
+}
+
+#endif // X86_LOOPS_H_INCLUDED
@@ -20,11 +20,16 @@
 #define X86_REGISTER_ALLOCATOR_H_INCLUDED
 
 #include "backend/x86/x86_asm_nodes.h"
+#include "backend/x86/x86_construct_liveness_info.h"
+#include "backend/x86/x86_slot_indexes.h"
+#include "backend/x86/x86_loops.h"
 #include <unordered_set>
 #include <unordered_map>
 #include <list>
 #include <algorithm>
 #include <vector>
+#include <sstream>
+#include <cassert>
 #include "util/stable_vector.h"
 #include <iostream>
 
@@ -32,27 +37,31 @@ class X86RegisterAllocator final
 {
 private:
     const BackendX86 *const backend;
+    X86SlotIndexes slotIndexes; /// kept up to date as split and spill code is inserted
     struct LiveRangeData final
     {
         std::unordered_set<std::shared_ptr<LiveRangeData>> intersectingLiveRanges;
-        std::shared_ptr<ValueNode> constantValue = nullptr;
-        bool isConstant = true;
+        std::shared_ptr<X86AsmNode> rematerializationNode = nullptr;
+        bool isRematerializable = true; /// every definition recomputes the same value from always available operands
         const std::shared_ptr<X86AsmRegister> originalRegister;
         std::shared_ptr<X86AsmRegister> allocatedRegister;
         std::unordered_set<std::shared_ptr<LiveRangeData>> combinableLiveRanges;
+        std::uint64_t spillCost = 0; /// references weighted by loop depth
+        std::uint64_t definitionSpillCost = 0;
+        bool canRematerialize() const
+        {
+            return isRematerializable && rematerializationNode != nullptr;
+        }
+        std::uint64_t getSpillCost() const
+        {
+            if(canRematerialize()) // definitions are removed instead of stored
+                return spillCost - definitionSpillCost;
+            return spillCost;
+        }
         typedef typename X86AsmBasicBlock::InstructionList::iterator InstructionIterator;
         std::vector<std::pair<std::shared_ptr<X86AsmBasicBlock>, InstructionIterator>> spillLoadPoints;
         std::vector<std::pair<std::shared_ptr<X86AsmBasicBlock>, InstructionIterator>> spillStorePoints;
-        struct LiveRange final
-        {
-            std::shared_ptr<X86AsmBasicBlock> block;
-            InstructionIterator start, end; // defining instruction is start[-1], last using instruction is end[0]
-            LiveRange(std::shared_ptr<X86AsmBasicBlock> block, InstructionIterator start, InstructionIterator end)
-                : block(block), start(start), end(end)
-            {
-            }
-        };
-        std::vector<LiveRange> liveRanges;
+        X86LiveInterval liveInterval;
         explicit LiveRangeData(std::shared_ptr<X86AsmRegister> originalRegister)
             : originalRegister(originalRegister)
         {
@@ -68,91 +77,125 @@ private:
         }
         return retval;
     }
-    void addAllLiveRangeIntersections(const std::unordered_set<std::shared_ptr<X86AsmRegister>> &currentlyLiveRegisters, std::unordered_map<std::shared_ptr<X86AsmRegister>, std::shared_ptr<LiveRangeData>> &registerToLiveRangeMap, std::unordered_set<std::shared_ptr<LiveRangeData>> &liveRanges) const
+    /// live ranges interfere when their intervals overlap; found by sweeping over the segments in order
+    static void addAllLiveRangeIntersections(const std::unordered_set<std::shared_ptr<LiveRangeData>> &liveRanges)
     {
-        for(std::shared_ptr<X86AsmRegister> r1 : currentlyLiveRegisters)
+        typedef X86LiveInterval::SlotIndex SlotIndex;
+        std::vector<std::pair<SlotIndex, std::pair<SlotIndex, std::shared_ptr<LiveRangeData>>>> segments;
+        for(std::shared_ptr<LiveRangeData> liveRange : liveRanges)
+        {
+            for(const X86LiveInterval::Segment &segment : liveRange->liveInterval.getSegments())
+                segments.push_back(std::make_pair(segment.start, std::make_pair(segment.end, liveRange)));
+            if(!liveRange->liveInterval.empty())
+                liveRange->intersectingLiveRanges.insert(liveRange);
+        }
+        std::sort(segments.begin(), segments.end(), [](const std::pair<SlotIndex, std::pair<SlotIndex, std::shared_ptr<LiveRangeData>>> &a, const std::pair<SlotIndex, std::pair<SlotIndex, std::shared_ptr<LiveRangeData>>> &b)
         {
-            std::shared_ptr<LiveRangeData> liveRange1 = getOrMakeLiveRange(registerToLiveRangeMap, r1, liveRanges);
-            for(std::shared_ptr<X86AsmRegister> r2 : currentlyLiveRegisters)
+            return std::get<0>(a) < std::get<0>(b);
+        });
+        std::vector<std::pair<SlotIndex, std::shared_ptr<LiveRangeData>>> activeSegments;
+        for(const auto &segment : segments)
+        {
+            SlotIndex start = std::get<0>(segment);
+            std::shared_ptr<LiveRangeData> liveRange = std::get<1>(std::get<1>(segment));
+            for(std::size_t i = 0; i < activeSegments.size();)
             {
-                std::shared_ptr<LiveRangeData> liveRange2 = getOrMakeLiveRange(registerToLiveRangeMap, r2, liveRanges);
-                liveRange1->intersectingLiveRanges.insert(liveRange2);
-                liveRange1->combinableLiveRanges.erase(liveRange2);
+                if(std::get<0>(activeSegments[i]) <= start)
+                {
+                    activeSegments[i] = activeSegments.back();
+                    activeSegments.pop_back();
+                    continue;
+                }
+                std::shared_ptr<LiveRangeData> activeLiveRange = std::get<1>(activeSegments[i]);
+                liveRange->intersectingLiveRanges.insert(activeLiveRange);
+                activeLiveRange->intersectingLiveRanges.insert(liveRange);
+                i++;
             }
+            activeSegments.push_back(std::get<1>(segment));
         }
     }
-    void calculateLiveRanges(std::shared_ptr<X86AsmFunction> function, std::unordered_set<std::shared_ptr<LiveRangeData>> &liveRanges) const
+    void calculateLiveRanges(std::shared_ptr<X86AsmFunction> function, std::unordered_set<std::shared_ptr<LiveRangeData>> &liveRanges, const std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, std::size_t> &loopDepths) const
     {
+        typedef X86SlotIndexes::SlotIndex SlotIndex;
         std::unordered_map<std::shared_ptr<X86AsmRegister>, std::shared_ptr<LiveRangeData>> registerToLiveRangeMap;
         std::vector<std::shared_ptr<X86AsmRegister>> currentMoveRegisters;
+        std::vector<std::pair<std::shared_ptr<LiveRangeData>, std::shared_ptr<LiveRangeData>>> moveRelatedLiveRanges;
         for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
         {
-            std::unordered_set<std::shared_ptr<X86AsmRegister>> currentlyLiveRegisters = block->liveRegistersAtEnd;
-            addAllLiveRangeIntersections(currentlyLiveRegisters, registerToLiveRangeMap, liveRanges);
-            std::unordered_map<std::shared_ptr<X86AsmRegister>, LiveRangeData::InstructionIterator> liveRangeEnds;
-            for(std::shared_ptr<X86AsmRegister> r : currentlyLiveRegisters)
+            std::uint64_t referenceWeight = 1;
+            auto loopDepthIter = loopDepths.find(block);
+            if(loopDepthIter != loopDepths.end())
+            {
+                for(std::size_t i = 0; i < std::get<1>(*loopDepthIter) && i < 6; i++)
+                    referenceWeight *= 10;
+            }
+            std::unordered_map<std::shared_ptr<X86AsmRegister>, SlotIndex> liveRangeEnds;
+            for(std::shared_ptr<X86AsmRegister> r : block->liveRegistersAtEnd)
             {
-                liveRangeEnds[r] = block->instructions.end();
+                liveRangeEnds[r] = slotIndexes.getBlockEndSlot(block);
             }
             for(auto i = block->instructions.end(); i != block->instructions.begin();)
             {
                 std::shared_ptr<X86AsmNode> node = *--i;
+                SlotIndex index = slotIndexes.getIndex(node);
                 bool isMove = dynamic_cast<const X86AsmNodeMove *>(node.get()) != nullptr;
-                std::shared_ptr<ValueNode> constantValue = nullptr;
-                if(const X86AsmNodeLoadConstant *loadNode = dynamic_cast<const X86AsmNodeLoadConstant *>(node.get()))
-                    constantValue = loadNode->value;
+                std::unordered_set<std::shared_ptr<X86AsmRegister>> outputSet = node->outputSet();
+                bool isRematerializable = outputSet.size() == 1 && node->makeRematerializedNode(*outputSet.begin()) != nullptr;
                 currentMoveRegisters.clear();
-                for(std::shared_ptr<X86AsmRegister> r : node->outputSet())
+                for(std::shared_ptr<X86AsmRegister> r : outputSet)
                 {
                     std::shared_ptr<LiveRangeData> liveRange = getOrMakeLiveRange(registerToLiveRangeMap, r, liveRanges);
-                    if(constantValue != nullptr && liveRange->isConstant && (liveRange->constantValue == nullptr || *liveRange->constantValue == *constantValue))
-                        liveRange->constantValue = constantValue;
+                    if(isRematerializable && liveRange->isRematerializable && (liveRange->rematerializationNode == nullptr || liveRange->rematerializationNode->isSameRematerializedValue(*node)))
+                        liveRange->rematerializationNode = node;
                     else
-                        liveRange->isConstant = false;
-                    currentlyLiveRegisters.erase(r);
+                        liveRange->isRematerializable = false;
                     auto iter = liveRangeEnds.find(r);
                     if(iter != liveRangeEnds.end())
                     {
-                        liveRange->liveRanges.emplace_back(block, i + 1, std::get<1>(*iter));
+                        liveRange->liveInterval.addSegment(X86SlotIndexes::getDefSlot(index), std::get<1>(*iter));
                         liveRangeEnds.erase(iter);
                     }
                     if(isMove)
                         currentMoveRegisters.push_back(r);
                     liveRange->spillStorePoints.emplace_back(block, i);
+                    liveRange->spillCost += referenceWeight;
+                    liveRange->definitionSpillCost += referenceWeight;
                 }
                 for(std::shared_ptr<X86AsmRegister> r : node->inputSet())
                 {
                     std::shared_ptr<LiveRangeData> liveRange = getOrMakeLiveRange(registerToLiveRangeMap, r, liveRanges);
-                    currentlyLiveRegisters.insert(r);
                     if(isMove)
                         currentMoveRegisters.push_back(r);
                     if(liveRangeEnds.count(r) == 0)
-                        liveRangeEnds[r] = i;
+                        liveRangeEnds[r] = X86SlotIndexes::getUseSlot(index) + 1;
                     liveRange->spillLoadPoints.emplace_back(block, i);
+                    liveRange->spillCost += referenceWeight;
                 }
                 if(isMove)
                 {
                     for(std::shared_ptr<X86AsmRegister> r1 : currentMoveRegisters)
                     {
-                        std::shared_ptr<LiveRangeData> liveRange1 = getOrMakeLiveRange(registerToLiveRangeMap, r1, liveRanges);
                         for(std::shared_ptr<X86AsmRegister> r2 : currentMoveRegisters)
                         {
                             if(r1 == r2)
                                 continue;
-                            std::shared_ptr<LiveRangeData> liveRange2 = getOrMakeLiveRange(registerToLiveRangeMap, r2, liveRanges);
-                            if(liveRange1->intersectingLiveRanges.count(liveRange2) == 0)
-                                liveRange1->combinableLiveRanges.insert(liveRange2);
+                            moveRelatedLiveRanges.emplace_back(getOrMakeLiveRange(registerToLiveRangeMap, r1, liveRanges), getOrMakeLiveRange(registerToLiveRangeMap, r2, liveRanges));
                         }
                     }
                 }
-                addAllLiveRangeIntersections(currentlyLiveRegisters, registerToLiveRangeMap, liveRanges);
             }
             for(auto p : liveRangeEnds)
             {
                 std::shared_ptr<LiveRangeData> liveRange = getOrMakeLiveRange(registerToLiveRangeMap, std::get<0>(p), liveRanges);
-                liveRange->liveRanges.emplace_back(block, block->instructions.begin(), std::get<1>(p));
+                liveRange->liveInterval.addSegment(slotIndexes.getBlockStartSlot(block), std::get<1>(p));
             }
         }
+        addAllLiveRangeIntersections(liveRanges);
+        for(auto p : moveRelatedLiveRanges)
+        {
+            if(std::get<0>(p)->intersectingLiveRanges.count(std::get<1>(p)) == 0)
+                std::get<0>(p)->combinableLiveRanges.insert(std::get<1>(p));
+        }
     }
     std::size_t getPhysicalRegisterCount(X86AsmRegister::PhysicalRegisterKindMask v,
                                          std::unordered_map<X86AsmRegister::PhysicalRegisterKindMask, std::size_t> &physicalRegisterCountsMap,
@@ -172,6 +215,210 @@ private:
         }
         return retval;
     }
+    typedef X86Loop Loop;
+    static X86AsmBasicBlock::InstructionList::iterator getBlockEndInsertPosition(std::shared_ptr<X86AsmBasicBlock> block)
+    {
+        if(block->controlTransferInstruction == nullptr)
+            return block->instructions.end();
+        assert(!block->instructions.empty() && block->instructions.back() == block->controlTransferInstruction);
+        return block->instructions.end() - 1;
+    }
+    static bool canInsertOnEdge(std::shared_ptr<X86AsmFunction> function, std::shared_ptr<X86AsmBasicBlock> sourceBlock, std::shared_ptr<X86AsmBasicBlock> destBlock)
+    {
+        if(destBlock->sourceBlocks.size() == 1 && destBlock != function->startBlock)
+            return true;
+        return sourceBlock->destBlocks.size() == 1;
+    }
+    void insertOnEdge(std::shared_ptr<X86AsmFunction> function, std::shared_ptr<X86AsmBasicBlock> sourceBlock, std::shared_ptr<X86AsmBasicBlock> destBlock, std::shared_ptr<X86AsmNode> node)
+    {
+        if(destBlock->sourceBlocks.size() == 1 && destBlock != function->startBlock)
+        {
+            destBlock->instructions.insert(destBlock->instructions.begin(), node);
+            slotIndexes.updateBlock(destBlock);
+        }
+        else
+        {
+            assert(sourceBlock->destBlocks.size() == 1);
+            sourceBlock->instructions.insert(getBlockEndInsertPosition(sourceBlock), node);
+            slotIndexes.updateBlock(sourceBlock);
+        }
+    }
+    static std::size_t getReferenceCount(std::shared_ptr<X86AsmBasicBlock> block, std::shared_ptr<X86AsmRegister> r)
+    {
+        std::size_t retval = 0;
+        for(std::shared_ptr<X86AsmNode> node : block->instructions)
+        {
+            if(node->inputSet().count(r) != 0 || node->outputSet().count(r) != 0)
+                retval++;
+        }
+        return retval;
+    }
+    static bool isAssignedInBlock(std::shared_ptr<X86AsmBasicBlock> block, std::shared_ptr<X86AsmRegister> r)
+    {
+        for(std::shared_ptr<X86AsmNode> node : block->instructions)
+        {
+            if(node->outputSet().count(r) != 0)
+                return true;
+        }
+        return false;
+    }
+    std::size_t nextNewRegisterIndex = 0;
+    std::unordered_map<std::shared_ptr<X86AsmRegister>, std::shared_ptr<X86AsmRegister>> splitRootRegisters;
+    std::unordered_map<std::shared_ptr<X86AsmRegister>, SpillLocation> splitRootSpillLocations; /// all parts of a split live range share a stack slot
+    std::shared_ptr<X86AsmRegister> getSplitRootRegister(std::shared_ptr<X86AsmRegister> r) const
+    {
+        auto iter = splitRootRegisters.find(r);
+        if(iter == splitRootRegisters.end())
+            return r;
+        return std::get<1>(*iter);
+    }
+    /// make a new virtual register for part of r; the result is never split
+    std::shared_ptr<X86AsmRegister> makeNewRegister(std::shared_ptr<X86AsmRegister> r, std::string kind, std::unordered_set<std::shared_ptr<X86AsmRegister>> &splitRegisters)
+    {
+        std::ostringstream ss;
+        ss << r->name << "." << kind << ++nextNewRegisterIndex;
+        std::shared_ptr<X86AsmRegister> retval = X86AsmRegister::getVirtualRegister(r->context, backend, ss.str(), r->physicalRegisterKindMask, r->spillLocation);
+        splitRegisters.insert(retval);
+        splitRootRegisters[retval] = getSplitRootRegister(r);
+        return retval;
+    }
+    /// move the part of r inside loop into a new register joined to r by copies on the loop's entry and exit edges
+    bool splitAroundLoop(std::shared_ptr<X86AsmFunction> function, const Loop &loop, std::shared_ptr<X86AsmRegister> r, std::unordered_set<std::shared_ptr<X86AsmRegister>> &splitRegisters)
+    {
+        bool isReferenced = false;
+        for(std::shared_ptr<X86AsmBasicBlock> block : loop.blocks)
+        {
+            if(getReferenceCount(block, r) != 0)
+            {
+                isReferenced = true;
+                break;
+            }
+        }
+        if(!isReferenced)
+            return false;
+        std::vector<std::pair<std::shared_ptr<X86AsmBasicBlock>, std::shared_ptr<X86AsmBasicBlock>>> entryEdges, exitEdges;
+        for(std::shared_ptr<X86AsmBasicBlock> block : loop.blocks)
+        {
+            for(std::weak_ptr<X86AsmBasicBlock> sourceBlockW : block->sourceBlocks)
+            {
+                std::shared_ptr<X86AsmBasicBlock> sourceBlock = sourceBlockW.lock();
+                if(loop.blocks.count(sourceBlock) != 0)
+                    continue;
+                if(block != loop.header) // not a natural loop
+                    return false;
+                if(block->liveRegistersAtStart.count(r) != 0)
+                    entryEdges.emplace_back(sourceBlock, block);
+            }
+            for(std::weak_ptr<X86AsmBasicBlock> destBlockW : block->destBlocks)
+            {
+                std::shared_ptr<X86AsmBasicBlock> destBlock = destBlockW.lock();
+                if(loop.blocks.count(destBlock) != 0)
+                    continue;
+                if(destBlock->liveRegistersAtStart.count(r) != 0)
+                    exitEdges.emplace_back(block, destBlock);
+            }
+        }
+        if(entryEdges.empty() && exitEdges.empty()) // r is local to the loop
+            return false;
+        for(auto edge : entryEdges)
+        {
+            if(!canInsertOnEdge(function, std::get<0>(edge), std::get<1>(edge)))
+                return false;
+        }
+        for(auto edge : exitEdges)
+        {
+            if(!canInsertOnEdge(function, std::get<0>(edge), std::get<1>(edge)))
+                return false;
+        }
+        std::shared_ptr<X86AsmRegister> newRegister = makeNewRegister(r, "split", splitRegisters);
+        for(std::shared_ptr<X86AsmBasicBlock> block : loop.blocks)
+        {
+            for(std::shared_ptr<X86AsmNode> node : block->instructions)
+            {
+                node->replaceRegister(r, newRegister);
+            }
+        }
+        for(auto edge : entryEdges)
+        {
+            insertOnEdge(function, std::get<0>(edge), std::get<1>(edge), std::make_shared<X86AsmNodeMove>(newRegister, r));
+        }
+        for(auto edge : exitEdges)
+        {
+            insertOnEdge(function, std::get<0>(edge), std::get<1>(edge), std::make_shared<X86AsmNodeMove>(r, newRegister));
+        }
+        X86ConstructLivenessInfo().visitX86AsmFunction(function);
+        return true;
+    }
+    /// move the part of r inside block into a new register joined to r by copies at the block boundaries
+    bool splitAroundBlock(std::shared_ptr<X86AsmFunction> function, std::shared_ptr<X86AsmBasicBlock> block, std::shared_ptr<X86AsmRegister> r, std::unordered_set<std::shared_ptr<X86AsmRegister>> &splitRegisters)
+    {
+        bool isLiveAtStart = block->liveRegistersAtStart.count(r) != 0;
+        bool isLiveAtEnd = block->liveRegistersAtEnd.count(r) != 0;
+        if(!isLiveAtStart && !isLiveAtEnd) // r is local to the block
+            return false;
+        if(getReferenceCount(block, r) < 2) // a copy would cost as much as the spill code it replaces
+            return false;
+        bool needsCopyOut = isLiveAtEnd && isAssignedInBlock(block, r);
+        std::shared_ptr<X86AsmRegister> newRegister = makeNewRegister(r, "split", splitRegisters);
+        for(std::shared_ptr<X86AsmNode> node : block->instructions)
+        {
+            node->replaceRegister(r, newRegister);
+        }
+        if(isLiveAtStart)
+            block->instructions.insert(block->instructions.begin(), std::make_shared<X86AsmNodeMove>(newRegister, r));
+        if(needsCopyOut)
+            block->instructions.insert(getBlockEndInsertPosition(block), std::make_shared<X86AsmNodeMove>(r, newRegister));
+        slotIndexes.updateBlock(block);
+        X86ConstructLivenessInfo().visitX86AsmFunction(function);
+        return true;
+    }
+    bool isHighPressureBlock(std::shared_ptr<X86AsmBasicBlock> block,
+                             X86AsmRegister::PhysicalRegisterKindMask kindMask,
+                             std::unordered_map<X86AsmRegister::PhysicalRegisterKindMask, std::size_t> &physicalRegisterCountsMap,
+                             const std::vector<std::shared_ptr<X86AsmRegister>> &physicalRegisters)
+    {
+        std::size_t matchingRegisterCount = getPhysicalRegisterCount(kindMask, physicalRegisterCountsMap, physicalRegisters);
+        for(const std::unordered_set<std::shared_ptr<X86AsmRegister>> *liveRegisters : {&block->liveRegistersAtStart, &block->liveRegistersAtEnd})
+        {
+            std::size_t liveCount = 0;
+            for(std::shared_ptr<X86AsmRegister> r : *liveRegisters)
+            {
+                if(r->physicalRegisterKindMask & kindMask)
+                    liveCount++;
+            }
+            if(liveCount >= matchingRegisterCount)
+                return true;
+        }
+        return false;
+    }
+    /// split r at loop boundaries, or failing that at high pressure block boundaries
+    bool splitLiveRange(std::shared_ptr<X86AsmFunction> function,
+                        const std::vector<Loop> &loops,
+                        std::shared_ptr<X86AsmRegister> r,
+                        std::unordered_set<std::shared_ptr<X86AsmRegister>> &splitRegisters,
+                        std::unordered_map<X86AsmRegister::PhysicalRegisterKindMask, std::size_t> &physicalRegisterCountsMap,
+                        const std::vector<std::shared_ptr<X86AsmRegister>> &physicalRegisters)
+    {
+        if(r->registerType != X86AsmRegister::RegisterType::Virtual || splitRegisters.count(r) != 0)
+            return false;
+        splitRegisters.insert(r);
+        bool didSplit = false;
+        for(const Loop &loop : loops) // innermost loops first
+        {
+            if(splitAroundLoop(function, loop, r, splitRegisters))
+                didSplit = true;
+        }
+        if(didSplit)
+            return true;
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            if(!isHighPressureBlock(block, r->physicalRegisterKindMask, physicalRegisterCountsMap, physicalRegisters))
+                continue;
+            if(splitAroundBlock(function, block, r, splitRegisters))
+                didSplit = true;
+        }
+        return didSplit;
+    }
 public:
     X86RegisterAllocator(const BackendX86 *backend)
         : backend(backend)
@@ -182,19 +429,33 @@ public:
         const std::vector<std::shared_ptr<X86AsmRegister>> &physicalRegisters = X86AsmRegister::getPhysicalRegisters(function->context, backend);
         std::unordered_map<X86AsmRegister::PhysicalRegisterKindMask, std::size_t> physicalRegisterCountsMap;
         std::unordered_set<std::shared_ptr<LiveRangeData>> liveRanges;
+        const std::vector<Loop> loops = X86FindLoops(function);
+        std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, std::size_t> loopDepths;
+        for(const Loop &loop : loops)
+        {
+            for(std::shared_ptr<X86AsmBasicBlock> block : loop.blocks)
+            {
+                loopDepths[block]++;
+            }
+        }
+        std::unordered_set<std::shared_ptr<X86AsmRegister>> splitRegisters, spillTemporaryRegisters;
+        splitRootRegisters.clear();
+        splitRootSpillLocations.clear();
+        slotIndexes.visitX86AsmFunction(function);
         for(std::size_t tryCount = 0;; tryCount++)
         {
             liveRanges.clear();
-            calculateLiveRanges(function, liveRanges);
-            if(tryCount >= liveRanges.size())
+            calculateLiveRanges(function, liveRanges, loopDepths);
+            if(tryCount != 0 && tryCount >= liveRanges.size())
                 throw std::runtime_error("can't allocate registers");
             std::vector<std::shared_ptr<LiveRangeData>> liveRangeStack;
             std::unordered_set<std::shared_ptr<LiveRangeData>> liveRangesLeft = liveRanges;
             while(!liveRangesLeft.empty())
             {
                 bool processedAny = false;
-                std::shared_ptr<LiveRangeData> minIntersectingLiveRangeCountLiveRange = nullptr;
-                std::size_t minIntersectingLiveRangeCount = 0;
+                std::shared_ptr<LiveRangeData> spillCandidate = nullptr;
+                bool isSpillCandidateTemporary = false;
+                double spillCandidatePriority = 0;
                 for(auto i = liveRangesLeft.begin(); i != liveRangesLeft.end();)
                 {
                     std::shared_ptr<LiveRangeData> liveRange = *i;
@@ -214,20 +475,24 @@ public:
                     }
                     else
                     {
-                        if(minIntersectingLiveRangeCountLiveRange == nullptr || minIntersectingLiveRangeCount > intersectingLiveRangeCount)
+                        // spill cheap, widely interfering live ranges first; spilling spill code doesn't help
+                        bool isTemporary = spillTemporaryRegisters.count(liveRange->originalRegister) != 0;
+                        double priority = static_cast<double>(liveRange->getSpillCost()) / static_cast<double>(intersectingLiveRangeCount + 1);
+                        if(spillCandidate == nullptr || (isSpillCandidateTemporary && !isTemporary) || (isSpillCandidateTemporary == isTemporary && spillCandidatePriority > priority))
                         {
-                            minIntersectingLiveRangeCountLiveRange = liveRange;
-                            minIntersectingLiveRangeCount = intersectingLiveRangeCount;
+                            spillCandidate = liveRange;
+                            isSpillCandidateTemporary = isTemporary;
+                            spillCandidatePriority = priority;
                         }
                         ++i;
                     }
                 }
                 if(!processedAny)
                 {
-                    if(minIntersectingLiveRangeCountLiveRange == nullptr)
+                    if(spillCandidate == nullptr)
                         break;
-                    liveRangeStack.push_back(minIntersectingLiveRangeCountLiveRange);
-                    liveRangesLeft.erase(minIntersectingLiveRangeCountLiveRange);
+                    liveRangeStack.push_back(spillCandidate);
+                    liveRangesLeft.erase(spillCandidate);
                 }
             }
             std::unordered_set<std::shared_ptr<LiveRangeData>> spilledLiveRanges;
@@ -323,71 +588,196 @@ public:
             }
             if(spilledLiveRanges.empty())
                 break;
+            for(std::shared_ptr<LiveRangeData> liveRange : std::vector<std::shared_ptr<LiveRangeData>>(spilledLiveRanges.begin(), spilledLiveRanges.end()))
+            {
+                if(spillTemporaryRegisters.count(liveRange->originalRegister) == 0)
+                    continue;
+                // spilling spill code doesn't make progress, so spill the cheapest long lived range in the way instead
+                std::shared_ptr<LiveRangeData> replacementLiveRange = nullptr;
+                for(std::shared_ptr<LiveRangeData> intersectingLiveRange : liveRange->intersectingLiveRanges)
+                {
+                    if(intersectingLiveRange->originalRegister->registerType != X86AsmRegister::RegisterType::Virtual)
+                        continue;
+                    if(spillTemporaryRegisters.count(intersectingLiveRange->originalRegister) != 0)
+                        continue;
+                    if(!(intersectingLiveRange->originalRegister->physicalRegisterKindMask & X86AsmRegister::PhysicalRegisterKindMask::Int()) != !(liveRange->originalRegister->physicalRegisterKindMask & X86AsmRegister::PhysicalRegisterKindMask::Int()))
+                        continue;
+                    if(replacementLiveRange == nullptr || replacementLiveRange->getSpillCost() > intersectingLiveRange->getSpillCost())
+                        replacementLiveRange = intersectingLiveRange;
+                }
+                if(replacementLiveRange == nullptr)
+                    continue;
+                spilledLiveRanges.erase(liveRange);
+                spilledLiveRanges.insert(replacementLiveRange);
+            }
+            bool didSplit = false;
+            for(std::shared_ptr<LiveRangeData> liveRange : spilledLiveRanges)
+            {
+                if(liveRange->canRematerialize()) // rematerializing is cheaper than copying
+                    continue;
+                if(splitLiveRange(function, loops, liveRange->originalRegister, splitRegisters, physicalRegisterCountsMap, physicalRegisters))
+                    didSplit = true;
+            }
+            if(didSplit) // try coloring again before spilling anything
+                continue;
+            typedef std::pair<std::shared_ptr<X86AsmBasicBlock>, LiveRangeData::InstructionIterator> InstructionPosition;
+            std::unordered_set<std::shared_ptr<X86AsmNode>> erasedNodes;
+            struct PendingInsertion final
+            {
+                InstructionPosition position; /// inserted before position
+                bool isAfterPrevious; /// goes before other nodes inserted at the same position
+                std::shared_ptr<X86AsmNode> node;
+                PendingInsertion(InstructionPosition position, bool isAfterPrevious, std::shared_ptr<X86AsmNode> node)
+                    : position(position), isAfterPrevious(isAfterPrevious), node(node)
+                {
+                }
+            };
+            std::vector<PendingInsertion> pendingInsertions; // inserted all at once so positions stay valid
+            std::unordered_set<std::shared_ptr<X86AsmNode>> spillCodeNodes; /// nodes that don't touch any spilled value
+            std::unordered_map<std::shared_ptr<X86AsmRegister>, std::shared_ptr<LiveRangeData>> spilledRegisters;
+            for(std::shared_ptr<LiveRangeData> liveRange : spilledLiveRanges)
+            {
+                spilledRegisters[liveRange->originalRegister] = liveRange;
+            }
+            auto isSpilledToStack = [&](std::shared_ptr<X86AsmRegister> r)
+            {
+                auto iter = spilledRegisters.find(r);
+                if(iter == spilledRegisters.end())
+                    return false;
+                return !std::get<1>(*iter)->canRematerialize();
+            };
+            for(std::shared_ptr<LiveRangeData> liveRange : spilledLiveRanges)
+            {
+                for(InstructionPosition p : liveRange->spillStorePoints)
+                {
+                    std::shared_ptr<X86AsmNodeMove> moveNode = std::dynamic_pointer_cast<X86AsmNodeMove>(*std::get<1>(p));
+                    if(moveNode == nullptr || erasedNodes.count(moveNode) != 0)
+                        continue;
+                    if(!isSpilledToStack(moveNode->source) || !isSpilledToStack(moveNode->dest))
+                        continue;
+                    if(getSplitRootRegister(moveNode->source) != getSplitRootRegister(moveNode->dest))
+                        continue;
+                    // a copy between parts of a split live range that share a stack slot
+                    erasedNodes.insert(moveNode);
+                    spillCodeNodes.insert(moveNode);
+                }
+            }
             for(std::shared_ptr<LiveRangeData> liveRange : spilledLiveRanges)
             {
+                std::shared_ptr<X86AsmRegister> spilledRegister = liveRange->originalRegister;
+                bool isRematerializable = liveRange->canRematerialize();
                 SpillLocation spillLocation = nullptr;
-                if(!liveRange->isConstant || liveRange->constantValue == nullptr) // if not a constant live range allocate local
-                    spillLocation = liveRange->originalRegister->physicalRegisterKindMask.createSpillLocation(function->localVariablesSize);
-                for(auto p : liveRange->spillLoadPoints)
+                if(!isRematerializable) // if not a rematerializable live range allocate local
+                {
+                    SpillLocation &rootSpillLocation = splitRootSpillLocations[getSplitRootRegister(spilledRegister)];
+                    if(rootSpillLocation.empty())
+                        rootSpillLocation = spilledRegister->physicalRegisterKindMask.createSpillLocation(function->localVariablesSize);
+                    spillLocation = rootSpillLocation;
+                    if(spillLocation.kind != SpillLocation::Kind::LocalVariable)
+                        throw std::runtime_error("register spill location kind not implemented");
+                }
+                std::vector<InstructionPosition> spillPoints = liveRange->spillLoadPoints;
+                spillPoints.insert(spillPoints.end(), liveRange->spillStorePoints.begin(), liveRange->spillStorePoints.end());
+                std::sort(spillPoints.begin(), spillPoints.end(), [&](const InstructionPosition &a, const InstructionPosition &b)
+                {
+                    return slotIndexes.getIndex(*std::get<1>(a)) < slotIndexes.getIndex(*std::get<1>(b));
+                });
+                spillPoints.erase(std::unique(spillPoints.begin(), spillPoints.end()), spillPoints.end());
+                std::shared_ptr<X86AsmRegister> temporaryRegister = nullptr;
+                InstructionPosition lastReference(nullptr, LiveRangeData::InstructionIterator());
+                std::size_t lastStore = 0; // index of the pending store + 1 or 0 if there is none
+                for(InstructionPosition p : spillPoints)
                 {
                     std::shared_ptr<X86AsmBasicBlock> block = std::get<0>(p);
                     auto pos = std::get<1>(p);
-                    bool good = false;
-                    for(LiveRangeData::LiveRange r : liveRange->liveRanges)
+                    std::shared_ptr<X86AsmNode> node = *pos;
+                    if(erasedNodes.count(node) != 0)
+                        continue;
+                    bool isUse = node->inputSet().count(spilledRegister) != 0;
+                    bool isDefinition = node->outputSet().count(spilledRegister) != 0;
+                    if(isRematerializable && !isUse) // recomputed at each use
                     {
-                        if(r.block != block)
-                            continue;
-                        if(r.end == r.start) // from one instruction to it's immediate successor
-                            continue;
-                        if(pos <= r.end && pos + 1 >= r.start)
-                        {
-                            good = true;
-                            break;
-                        }
+                        erasedNodes.insert(node);
+                        spillCodeNodes.insert(node);
+                        continue;
                     }
-                    if(good)
+                    // reuse the previous temporary if nothing but spill code is between the references
+                    bool isAdjacent = std::get<0>(lastReference) == block;
+                    if(isAdjacent)
                     {
-                        if(liveRange->isConstant && liveRange->constantValue)
-                        {
-                            std::shared_ptr<X86AsmNode> node = std::make_shared<X86AsmNodeLoadConstant>(liveRange->originalRegister, liveRange->constantValue);
-                            block->instructions.insert(pos, node);
-                        }
-                        else
+                        for(auto i = std::get<1>(lastReference) + 1; i != pos; ++i)
                         {
-                            if(spillLocation.kind != SpillLocation::Kind::LocalVariable)
-                                throw std::runtime_error("register spill location kind not implemented");
-                            std::shared_ptr<X86AsmNode> node = std::make_shared<X86AsmNodeLoadLocal>(liveRange->originalRegister, VariableLocation(spillLocation.variable));
-                            block->instructions.insert(pos, node);
+                            if(spillCodeNodes.count(*i) == 0)
+                            {
+                                isAdjacent = false;
+                                break;
+                            }
                         }
                     }
-                }
-                for(auto p : liveRange->spillStorePoints)
-                {
-                    std::shared_ptr<X86AsmBasicBlock> block = std::get<0>(p);
-                    auto pos = std::get<1>(p);
-                    bool good = false;
-                    for(LiveRangeData::LiveRange r : liveRange->liveRanges)
+                    if(!isAdjacent)
                     {
-                        if(r.block != block)
-                            continue;
-                        if(r.end == r.start) // from one instruction to it's immediate successor
-                            continue;
-                        if(pos <= r.end && pos + 1 >= r.start)
-                        {
-                            good = true;
-                            break;
-                        }
+                        // each reference gets its own short live range
+                        temporaryRegister = makeNewRegister(spilledRegister, "spill", splitRegisters);
+                        spillTemporaryRegisters.insert(temporaryRegister);
+                        lastStore = 0;
                     }
-                    if(good)
+                    node->replaceRegister(spilledRegister, temporaryRegister);
+                    if(isUse && !isAdjacent)
                     {
-                        if(!liveRange->isConstant || liveRange->constantValue == nullptr) // don't store constants
+                        std::shared_ptr<X86AsmNode> loadNode;
+                        if(isRematerializable)
+                            loadNode = liveRange->rematerializationNode->makeRematerializedNode(temporaryRegister);
+                        else
+                            loadNode = std::make_shared<X86AsmNodeLoadLocal>(temporaryRegister, VariableLocation(spillLocation.variable));
+                        spillCodeNodes.insert(loadNode);
+                        pendingInsertions.push_back(PendingInsertion(p, false, loadNode));
+                    }
+                    if(isDefinition && !isRematerializable)
+                    {
+                        if(lastStore != 0) // overwritten before it is loaded
                         {
-                            if(spillLocation.kind != SpillLocation::Kind::LocalVariable)
-                                throw std::runtime_error("register spill location kind not implemented");
-                            std::shared_ptr<X86AsmNode> node = std::make_shared<X86AsmNodeStoreLocal>(VariableLocation(spillLocation.variable), liveRange->originalRegister);
-                            block->instructions.insert(pos + 1, node);
+                            pendingInsertions[lastStore - 1].node = nullptr;
                         }
+                        std::shared_ptr<X86AsmNode> storeNode = std::make_shared<X86AsmNodeStoreLocal>(VariableLocation(spillLocation.variable), temporaryRegister);
+                        spillCodeNodes.insert(storeNode);
+                        pendingInsertions.push_back(PendingInsertion(InstructionPosition(block, pos + 1), true, storeNode));
+                        lastStore = pendingInsertions.size();
                     }
+                    lastReference = p;
+                }
+            }
+            std::stable_sort(pendingInsertions.begin(), pendingInsertions.end(), [](const PendingInsertion &a, const PendingInsertion &b)
+            {
+                if(std::get<0>(a.position) != std::get<0>(b.position))
+                    return std::get<0>(a.position) < std::get<0>(b.position);
+                if(std::get<1>(a.position) != std::get<1>(b.position))
+                    return std::get<1>(a.position) < std::get<1>(b.position);
+                return a.isAfterPrevious && !b.isAfterPrevious;
+            });
+            std::vector<std::pair<LiveRangeData::InstructionIterator, std::shared_ptr<X86AsmNode>>> blockInsertions;
+            for(auto i = pendingInsertions.begin(); i != pendingInsertions.end(); )
+            {
+                std::shared_ptr<X86AsmBasicBlock> block = std::get<0>(i->position);
+                blockInsertions.clear();
+                for(; i != pendingInsertions.end() && std::get<0>(i->position) == block; ++i)
+                {
+                    if(i->node != nullptr)
+                        blockInsertions.push_back(std::make_pair(std::get<1>(i->position), i->node));
+                }
+                block->instructions.insert_batch(blockInsertions.begin(), blockInsertions.end());
+                slotIndexes.updateBlock(block);
+            }
+            if(!erasedNodes.empty())
+            {
+                for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+                {
+                    block->instructions.erase_if([&](const std::shared_ptr<X86AsmNode> &node)
+                    {
+                        if(erasedNodes.count(node) == 0)
+                            return false;
+                        slotIndexes.removeNode(node);
+                        return true;
+                    });
                 }
             }
             X86ConstructLivenessInfo().visitX86AsmFunction(function);
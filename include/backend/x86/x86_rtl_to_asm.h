@@ -23,6 +23,7 @@
 #include "backend/x86/x86_asm_nodes.h"
 #include <unordered_map>
 #include <unordered_set>
+#include <sstream>
 #include "construct_liveness_info.h"
 #include "backend/x86/x86_construct_liveness_info.h"
 
@@ -43,6 +44,9 @@ private:
     std::unordered_map<std::shared_ptr<RTLBasicBlock>, std::shared_ptr<X86AsmBasicBlock>> blockMap;
     std::unordered_map<std::shared_ptr<RTLFunction>, std::shared_ptr<X86AsmFunction>> functionMap;
     std::unordered_map<std::shared_ptr<RTLRegister>, VariableLocation> registerVariableLocationMap;
+    std::size_t nextTemporaryRegisterIndex = 0;
+    static constexpr std::uint64_t maxUnrolledElementCount = 8; /// more elements use rep movs or rep stos
+    static constexpr std::uint64_t maxUnrolledVectorSize = 64; /// bigger copies of disjoint memory use rep movs
     std::shared_ptr<X86AsmRegister> getOrMakeRegister(std::shared_ptr<RTLRegister> reg, std::shared_ptr<TypeNode> type)
     {
         auto v = std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>(reg, type);
@@ -53,6 +57,47 @@ private:
         }
         return retval;
     }
+    std::shared_ptr<X86AsmRegister> makeTemporaryRegister(std::shared_ptr<RTLRegister> reg, std::string kind, std::shared_ptr<TypeNode> type)
+    {
+        std::ostringstream ss;
+        ss << reg->name << "." << kind << ++nextTemporaryRegisterIndex;
+        return X86AsmRegister::getVirtualRegister(reg->context, backend, ss.str(), X86TypeToPhysicalRegisterKindMask::run(type, backend), nullptr);
+    }
+    std::shared_ptr<X86AsmRegister> getPhysicalRegister(CompilerContext *context, std::string name32, std::string name64)
+    {
+        return X86AsmRegister::getPhysicalRegister(context, backend, backend->architecture == BackendX86::X86_64 ? name64 : name32);
+    }
+    /// @return a register with offset bytes added to addressRegister
+    std::shared_ptr<X86AsmRegister> makeOffsetAddress(std::shared_ptr<RTLRegister> addressRegister, std::shared_ptr<TypeNode> addressType, std::uint64_t offset)
+    {
+        std::shared_ptr<X86AsmRegister> address = getOrMakeRegister(addressRegister, addressType);
+        if(offset == 0)
+            return address;
+        std::shared_ptr<X86AsmRegister> retval = makeTemporaryRegister(addressRegister, "offset", addressType);
+        currentBlock->instructions.push_back(std::make_shared<X86AsmNodeLoadConstant>(retval, std::make_shared<ValueInteger>(addressRegister->context, false, IntegerWidth::IntNativeSize, offset)));
+        currentBlock->instructions.push_back(std::make_shared<X86AsmNodeAdd>(retval, address));
+        return retval;
+    }
+    void addTypeCast(std::shared_ptr<X86AsmRegister> dest, std::shared_ptr<X86AsmRegister> source, std::shared_ptr<TypeNode> destType, std::shared_ptr<TypeNode> sourceType)
+    {
+        if(backend->architecture == BackendX86::X86_32 && !isVectorType(sourceType) && destType->getTypeProperties().size == 1)
+        {
+            /// esi and edi don't have 8-bit parts on x86_32
+            switch(sourceType->getTypeProperties().size)
+            {
+            case 2:
+                currentBlock->instructions.push_back(std::make_shared<X86AsmNodeMove>(getPhysicalRegister(dest->context, "ax", "ax"), source));
+                source = getPhysicalRegister(dest->context, "ax", "ax");
+                break;
+            case 4:
+                currentBlock->instructions.push_back(std::make_shared<X86AsmNodeMove>(getPhysicalRegister(dest->context, "eax", "eax"), source));
+                source = getPhysicalRegister(dest->context, "eax", "eax");
+                break;
+            }
+        }
+        std::shared_ptr<X86AsmNode> newNode = std::make_shared<X86AsmNodeTypeCast>(dest, source, destType, sourceType);
+        currentBlock->instructions.push_back(newNode);
+    }
     std::shared_ptr<X86AsmBasicBlock> getOrMakeBlock(std::shared_ptr<RTLBasicBlock> v)
     {
         std::shared_ptr<X86AsmBasicBlock> &retval = blockMap[v];
@@ -75,6 +120,10 @@ private:
         : backend(backend)
     {
     }
+    static bool isVectorType(std::shared_ptr<TypeNode> type)
+    {
+        return dynamic_cast<const TypeVector *>(type->toNonConstant()->toNonVolatile().get()) != nullptr;
+    }
     void visitRTLNode(std::shared_ptr<RTLNode> node)
     {
         node->visit(*this);
@@ -159,16 +208,40 @@ public:
         std::shared_ptr<X86AsmNode> newNode = std::make_shared<X86AsmNodeMove>(getOrMakeRegister(node->destRegister, node->type), getOrMakeRegister(node->sourceRegister, node->type));
         currentBlock->instructions.push_back(newNode);
     }
+    virtual void visitRTLSelect(std::shared_ptr<RTLSelect> node) override
+    {
+        if(isVectorType(node->type))
+            throw std::runtime_error("select not implemented for vector types");
+        std::shared_ptr<X86AsmRegister> dest = getOrMakeRegister(node->destRegister, node->type);
+        std::shared_ptr<X86AsmRegister> condition = getOrMakeRegister(node->conditionRegister, TypeBoolean::make(node->context));
+        std::shared_ptr<X86AsmRegister> trueValue = getOrMakeRegister(node->trueRegister, node->type);
+        std::shared_ptr<X86AsmRegister> falseValue = getOrMakeRegister(node->falseRegister, node->type);
+        if(node->type->getTypeProperties().size >= 4)
+        {
+            currentBlock->instructions.push_back(std::make_shared<X86AsmNodeMove>(dest, falseValue));
+            currentBlock->instructions.push_back(std::make_shared<X86AsmNodeConditionalMove>(dest, condition, trueValue));
+            return;
+        }
+        /// cmov doesn't have an 8-bit form, so select in 32-bit registers
+        std::shared_ptr<TypeNode> wideType = TypeInteger::make(node->context, true, IntegerWidth::Int32);
+        std::shared_ptr<X86AsmRegister> wideDest = makeTemporaryRegister(node->destRegister, "select", wideType);
+        std::shared_ptr<X86AsmRegister> wideTrueValue = makeTemporaryRegister(node->trueRegister, "select", wideType);
+        addTypeCast(wideDest, falseValue, wideType, node->type);
+        addTypeCast(wideTrueValue, trueValue, wideType, node->type);
+        currentBlock->instructions.push_back(std::make_shared<X86AsmNodeConditionalMove>(wideDest, condition, wideTrueValue));
+        addTypeCast(dest, wideDest, node->type, wideType);
+    }
     virtual void visitRTLTypeCast(std::shared_ptr<RTLTypeCast> node) override
     {
-        std::shared_ptr<X86AsmNode> newNode = std::make_shared<X86AsmNodeTypeCast>(getOrMakeRegister(node->destRegister, node->destType), getOrMakeRegister(node->sourceRegister, node->sourceType), node->destType, node->sourceType);
-        currentBlock->instructions.push_back(newNode);
+        addTypeCast(getOrMakeRegister(node->destRegister, node->destType), getOrMakeRegister(node->sourceRegister, node->sourceType), node->destType, node->sourceType);
     }
     virtual void visitRTLLoad(std::shared_ptr<RTLLoad> node) override
     {
         VariableLocation vl = registerVariableLocationMap[node->addressRegister];
         std::shared_ptr<X86AsmNode> newNode;
-        if(vl.good())
+        if(isVectorType(node->addressType->dereference()))
+            newNode = std::make_shared<X86AsmNodeVectorLoad>(getOrMakeRegister(node->destRegister, node->addressType->dereference()), getOrMakeRegister(node->addressRegister, node->addressType), node->addressType->dereference()->getTypeProperties().size);
+        else if(vl.good())
             newNode = std::make_shared<X86AsmNodeLoadLocal>(getOrMakeRegister(node->destRegister, node->addressType->dereference()), vl);
         else
             newNode = std::make_shared<X86AsmNodeLoad>(getOrMakeRegister(node->destRegister, node->addressType->dereference()), getOrMakeRegister(node->addressRegister, node->addressType));
@@ -178,12 +251,88 @@ public:
     {
         VariableLocation vl = registerVariableLocationMap[node->addressRegister];
         std::shared_ptr<X86AsmNode> newNode;
-        if(vl.good())
+        if(isVectorType(node->addressType->dereference()))
+            newNode = std::make_shared<X86AsmNodeVectorStore>(getOrMakeRegister(node->addressRegister, node->addressType), getOrMakeRegister(node->valueRegister, node->addressType->dereference()), node->addressType->dereference()->getTypeProperties().size);
+        else if(vl.good())
             newNode = std::make_shared<X86AsmNodeStoreLocal>(vl, getOrMakeRegister(node->valueRegister, node->addressType->dereference()));
         else
             newNode = std::make_shared<X86AsmNodeStore>(getOrMakeRegister(node->addressRegister, node->addressType), getOrMakeRegister(node->valueRegister, node->addressType->dereference()));
         currentBlock->instructions.push_back(newNode);
     }
+    virtual void visitRTLMemoryCopy(std::shared_ptr<RTLMemoryCopy> node) override
+    {
+        std::shared_ptr<TypeNode> elementType = node->addressType->dereference();
+        std::uint64_t elementSize = elementType->getTypeProperties().size;
+        std::uint64_t size = elementSize * node->count;
+        std::uint64_t offset = 0;
+        if(!node->mayOverlap && size <= maxUnrolledVectorSize)
+        {
+            // the biggest moves that fit, then single elements for the last few bytes
+            for(std::uint64_t chunkSize : {16, 8, 4})
+            {
+                if(chunkSize <= elementSize)
+                    break;
+                std::shared_ptr<TypeNode> chunkType = TypeVector::make(TypeInteger::make(node->context, true, IntegerWidth::Int8), chunkSize);
+                for(; size - offset >= chunkSize; offset += chunkSize)
+                {
+                    std::shared_ptr<X86AsmRegister> value = makeTemporaryRegister(node->sourceAddressRegister, "copy", chunkType);
+                    currentBlock->instructions.push_back(std::make_shared<X86AsmNodeVectorLoad>(value, makeOffsetAddress(node->sourceAddressRegister, node->addressType, offset), chunkSize));
+                    currentBlock->instructions.push_back(std::make_shared<X86AsmNodeVectorStore>(makeOffsetAddress(node->destAddressRegister, node->addressType, offset), value, chunkSize));
+                }
+            }
+        }
+        else if(node->count > maxUnrolledElementCount || (!node->mayOverlap && size > maxUnrolledVectorSize))
+        {
+            std::shared_ptr<X86AsmRegister> dest = getPhysicalRegister(node->context, "edi", "rdi");
+            std::shared_ptr<X86AsmRegister> source = getPhysicalRegister(node->context, "esi", "rsi");
+            std::shared_ptr<X86AsmRegister> count = getPhysicalRegister(node->context, "ecx", "rcx");
+            currentBlock->instructions.push_back(std::make_shared<X86AsmNodeMove>(dest, getOrMakeRegister(node->destAddressRegister, node->addressType)));
+            currentBlock->instructions.push_back(std::make_shared<X86AsmNodeMove>(source, getOrMakeRegister(node->sourceAddressRegister, node->addressType)));
+            currentBlock->instructions.push_back(std::make_shared<X86AsmNodeLoadConstant>(count, std::make_shared<ValueInteger>(node->context, true, IntegerWidth::IntNativeSize, node->count)));
+            currentBlock->instructions.push_back(std::make_shared<X86AsmNodeRepeatMove>(dest, source, count, elementSize));
+            return;
+        }
+        for(; offset < size; offset += elementSize)
+        {
+            std::shared_ptr<X86AsmRegister> value = makeTemporaryRegister(node->sourceAddressRegister, "copy", elementType);
+            currentBlock->instructions.push_back(std::make_shared<X86AsmNodeLoad>(value, makeOffsetAddress(node->sourceAddressRegister, node->addressType, offset)));
+            currentBlock->instructions.push_back(std::make_shared<X86AsmNodeStore>(makeOffsetAddress(node->destAddressRegister, node->addressType, offset), value));
+        }
+    }
+    virtual void visitRTLMemoryFill(std::shared_ptr<RTLMemoryFill> node) override
+    {
+        std::shared_ptr<TypeNode> elementType = node->addressType->dereference();
+        std::uint64_t elementSize = elementType->getTypeProperties().size;
+        std::shared_ptr<X86AsmRegister> value = getOrMakeRegister(node->valueRegister, elementType);
+        if(node->count <= maxUnrolledElementCount)
+        {
+            for(std::uint64_t i = 0; i < node->count; i++)
+                currentBlock->instructions.push_back(std::make_shared<X86AsmNodeStore>(makeOffsetAddress(node->destAddressRegister, node->addressType, i * elementSize), value));
+            return;
+        }
+        std::shared_ptr<X86AsmRegister> dest = getPhysicalRegister(node->context, "edi", "rdi");
+        std::shared_ptr<X86AsmRegister> count = getPhysicalRegister(node->context, "ecx", "rcx");
+        std::shared_ptr<X86AsmRegister> accumulator;
+        switch(elementSize)
+        {
+        case 1:
+            accumulator = getPhysicalRegister(node->context, "al", "al");
+            break;
+        case 2:
+            accumulator = getPhysicalRegister(node->context, "ax", "ax");
+            break;
+        case 4:
+            accumulator = getPhysicalRegister(node->context, "eax", "eax");
+            break;
+        default:
+            accumulator = getPhysicalRegister(node->context, "eax", "rax");
+            break;
+        }
+        currentBlock->instructions.push_back(std::make_shared<X86AsmNodeMove>(dest, getOrMakeRegister(node->destAddressRegister, node->addressType)));
+        currentBlock->instructions.push_back(std::make_shared<X86AsmNodeMove>(accumulator, value));
+        currentBlock->instructions.push_back(std::make_shared<X86AsmNodeLoadConstant>(count, std::make_shared<ValueInteger>(node->context, true, IntegerWidth::IntNativeSize, node->count)));
+        currentBlock->instructions.push_back(std::make_shared<X86AsmNodeRepeatStore>(dest, accumulator, count, elementSize));
+    }
     virtual void visitRTLUnconditionalJump(std::shared_ptr<RTLUnconditionalJump> node) override
     {
         std::shared_ptr<X86AsmControlTransfer> newNode = std::make_shared<X86AsmNodeJump>(getOrMakeBlock(node->target.lock()));
@@ -289,7 +438,12 @@ public:
         std::shared_ptr<X86AsmNode> newNode = std::make_shared<X86AsmNodeMove>(getOrMakeRegister(node->destRegister, node->destType),
                                                                                         getOrMakeRegister(node->lhsRegister, node->lhsType));
         currentBlock->instructions.push_back(newNode);
-        newNode = std::make_shared<X86AsmNodeAdd>(getOrMakeRegister(node->destRegister, node->destType),
+        if(std::shared_ptr<TypeVector> typeVector = std::dynamic_pointer_cast<TypeVector>(node->destType->toNonConstant()->toNonVolatile()))
+            newNode = std::make_shared<X86AsmNodeVectorAdd>(getOrMakeRegister(node->destRegister, node->destType),
+                                                            getOrMakeRegister(node->rhsRegister, node->rhsType),
+                                                            typeVector->getElementType()->getTypeProperties().size);
+        else
+            newNode = std::make_shared<X86AsmNodeAdd>(getOrMakeRegister(node->destRegister, node->destType),
                                                                                         getOrMakeRegister(node->rhsRegister, node->rhsType));
         currentBlock->instructions.push_back(newNode);
     }
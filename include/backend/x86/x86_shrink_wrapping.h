@@ -0,0 +1,247 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef X86_SHRINK_WRAPPING_H_INCLUDED
+#define X86_SHRINK_WRAPPING_H_INCLUDED
+
+#include "backend/x86/x86_asm_nodes.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+
+/// picks where callee saved registers are saved and restored so paths that don't use them skip the memory traffic
+class X86ShrinkWrapping final
+{
+private:
+    typedef std::unordered_set<std::shared_ptr<X86AsmBasicBlock>> BlockSet;
+    std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, BlockSet> dominatorsMap;
+    void calculateDominators(std::shared_ptr<X86AsmFunction> function)
+    {
+        BlockSet allBlocks(function->blocks.begin(), function->blocks.end());
+        dominatorsMap.clear();
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            if(block == function->startBlock)
+                dominatorsMap[block] = BlockSet{block};
+            else
+                dominatorsMap[block] = allBlocks;
+        }
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+            {
+                if(block == function->startBlock)
+                    continue;
+                BlockSet newDominators = allBlocks;
+                for(std::weak_ptr<X86AsmBasicBlock> sourceBlock : block->sourceBlocks)
+                {
+                    const BlockSet &sourceDominators = dominatorsMap[sourceBlock.lock()];
+                    for(auto i = newDominators.begin(); i != newDominators.end();)
+                    {
+                        if(sourceDominators.count(*i) == 0)
+                            i = newDominators.erase(i);
+                        else
+                            ++i;
+                    }
+                }
+                newDominators.insert(block);
+                if(newDominators.size() != dominatorsMap[block].size())
+                {
+                    dominatorsMap[block] = std::move(newDominators);
+                    done = false;
+                }
+            }
+        }
+    }
+    /// returns the deepest block dominating every block in blocks
+    std::shared_ptr<X86AsmBasicBlock> getNearestCommonDominator(const BlockSet &blocks)
+    {
+        BlockSet commonDominators = dominatorsMap[*blocks.begin()];
+        for(std::shared_ptr<X86AsmBasicBlock> block : blocks)
+        {
+            const BlockSet &blockDominators = dominatorsMap[block];
+            for(auto i = commonDominators.begin(); i != commonDominators.end();)
+            {
+                if(blockDominators.count(*i) == 0)
+                    i = commonDominators.erase(i);
+                else
+                    ++i;
+            }
+        }
+        std::shared_ptr<X86AsmBasicBlock> retval = nullptr;
+        for(std::shared_ptr<X86AsmBasicBlock> block : commonDominators) // the dominators of a block form a chain
+        {
+            if(retval == nullptr || dominatorsMap[block].size() > dominatorsMap[retval].size())
+                retval = block;
+        }
+        return retval;
+    }
+    std::shared_ptr<X86AsmBasicBlock> getImmediateDominator(std::shared_ptr<X86AsmBasicBlock> block)
+    {
+        std::shared_ptr<X86AsmBasicBlock> retval = nullptr;
+        for(std::shared_ptr<X86AsmBasicBlock> dominator : dominatorsMap[block])
+        {
+            if(dominator == block)
+                continue;
+            if(retval == nullptr || dominatorsMap[dominator].size() > dominatorsMap[retval].size())
+                retval = dominator;
+        }
+        return retval;
+    }
+    static bool isInLoop(std::shared_ptr<X86AsmBasicBlock> block)
+    {
+        BlockSet visitedBlocks;
+        std::vector<std::shared_ptr<X86AsmBasicBlock>> worklist(1, block);
+        while(!worklist.empty())
+        {
+            std::shared_ptr<X86AsmBasicBlock> currentBlock = worklist.back();
+            worklist.pop_back();
+            for(std::weak_ptr<X86AsmBasicBlock> destBlockW : currentBlock->destBlocks)
+            {
+                std::shared_ptr<X86AsmBasicBlock> destBlock = destBlockW.lock();
+                if(destBlock == block)
+                    return true;
+                if(std::get<1>(visitedBlocks.insert(destBlock)))
+                    worklist.push_back(destBlock);
+            }
+        }
+        return false;
+    }
+    static bool referencesAny(std::shared_ptr<X86AsmNode> node, const std::unordered_set<std::shared_ptr<X86AsmRegister>> &registers)
+    {
+        for(const std::unordered_set<std::shared_ptr<X86AsmRegister>> &set : {node->inputSet(), node->outputSet()})
+        {
+            for(std::shared_ptr<X86AsmRegister> r : set)
+            {
+                if(registers.count(r->getSaveRegister()) != 0)
+                    return true;
+            }
+        }
+        return false;
+    }
+    /// insert an empty block on the edge from sourceBlock to destBlock
+    static std::shared_ptr<X86AsmBasicBlock> splitEdge(std::shared_ptr<X86AsmFunction> function, std::shared_ptr<X86AsmBasicBlock> sourceBlock, std::shared_ptr<X86AsmBasicBlock> destBlock)
+    {
+        std::shared_ptr<X86AsmBasicBlock> newBlock = std::make_shared<X86AsmBasicBlock>(sourceBlock->context, sourceBlock->backend);
+        newBlock->controlTransferInstruction = std::make_shared<X86AsmNodeJump>(destBlock);
+        newBlock->instructions.push_back(newBlock->controlTransferInstruction);
+        sourceBlock->controlTransferInstruction->replaceTarget(destBlock, newBlock);
+        for(std::weak_ptr<X86AsmBasicBlock> &block : sourceBlock->destBlocks)
+        {
+            if(block.lock() == destBlock)
+                block = newBlock;
+        }
+        for(std::weak_ptr<X86AsmBasicBlock> &block : destBlock->sourceBlocks)
+        {
+            if(block.lock() == sourceBlock)
+                block = newBlock;
+        }
+        newBlock->sourceBlocks.push_back(sourceBlock);
+        newBlock->destBlocks.push_back(destBlock);
+        auto iter = std::find(function->blocks.begin(), function->blocks.end(), sourceBlock);
+        assert(iter != function->blocks.end());
+        function->blocks.insert(++iter, newBlock);
+        return newBlock;
+    }
+public:
+    std::shared_ptr<X86AsmBasicBlock> saveBlock; /// the registers are saved at the start of this block, in the prologue for the start block
+    BlockSet restoreBlocks; /// the registers are restored before the control transfer or return of these blocks
+    BlockSet savedAtStartBlocks; /// blocks entered with the registers already saved
+    void visitX86AsmFunction(std::shared_ptr<X86AsmFunction> function, const std::unordered_set<std::shared_ptr<X86AsmRegister>> &savedRegisters)
+    {
+        saveBlock = function->startBlock;
+        restoreBlocks.clear();
+        savedAtStartBlocks.clear();
+        BlockSet usingBlocks;
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            for(std::shared_ptr<X86AsmNode> node : block->instructions)
+            {
+                if(referencesAny(node, savedRegisters))
+                {
+                    usingBlocks.insert(block);
+                    break;
+                }
+            }
+        }
+        if(!usingBlocks.empty())
+        {
+            calculateDominators(function);
+            saveBlock = getNearestCommonDominator(usingBlocks);
+            // saving again before restoring would overwrite the caller's values; the start block saves in the prologue
+            while(saveBlock != function->startBlock && isInLoop(saveBlock))
+                saveBlock = getImmediateDominator(saveBlock);
+        }
+        // restore on every edge leaving the blocks dominated by saveBlock
+        std::vector<std::pair<std::shared_ptr<X86AsmBasicBlock>, std::shared_ptr<X86AsmBasicBlock>>> splitEdges;
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            if(saveBlock != function->startBlock && dominatorsMap[block].count(saveBlock) == 0)
+                continue;
+            if(block->destBlocks.empty())
+            {
+                restoreBlocks.insert(block);
+                continue;
+            }
+            for(std::weak_ptr<X86AsmBasicBlock> destBlockW : block->destBlocks)
+            {
+                std::shared_ptr<X86AsmBasicBlock> destBlock = destBlockW.lock();
+                if(saveBlock == function->startBlock || dominatorsMap[destBlock].count(saveBlock) != 0)
+                    continue;
+                if(block->destBlocks.size() == 1 && !referencesAny(block->controlTransferInstruction, savedRegisters))
+                    restoreBlocks.insert(block);
+                else
+                    splitEdges.emplace_back(block, destBlock);
+            }
+        }
+        for(auto &edge : splitEdges)
+        {
+            restoreBlocks.insert(splitEdge(function, std::get<0>(edge), std::get<1>(edge)));
+        }
+        dominatorsMap.clear();
+        if(saveBlock == function->startBlock)
+            savedAtStartBlocks.insert(function->startBlock);
+        BlockSet visitedBlocks{function->startBlock};
+        std::vector<std::shared_ptr<X86AsmBasicBlock>> worklist(1, function->startBlock);
+        while(!worklist.empty())
+        {
+            std::shared_ptr<X86AsmBasicBlock> block = worklist.back();
+            worklist.pop_back();
+            bool isSavedAtEnd = (savedAtStartBlocks.count(block) != 0 || block == saveBlock) && restoreBlocks.count(block) == 0;
+            for(std::weak_ptr<X86AsmBasicBlock> destBlockW : block->destBlocks)
+            {
+                std::shared_ptr<X86AsmBasicBlock> destBlock = destBlockW.lock();
+                if(std::get<1>(visitedBlocks.insert(destBlock)))
+                {
+                    if(isSavedAtEnd)
+                        savedAtStartBlocks.insert(destBlock);
+                    worklist.push_back(destBlock);
+                }
+                else
+                {
+                    assert(isSavedAtEnd == (savedAtStartBlocks.count(destBlock) != 0));
+                }
+            }
+        }
+    }
+};
+
+#endif // X86_SHRINK_WRAPPING_H_INCLUDED
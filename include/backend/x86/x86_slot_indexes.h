@@ -0,0 +1,216 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef X86_SLOT_INDEXES_H_INCLUDED
+#define X86_SLOT_INDEXES_H_INCLUDED
+
+#include "backend/x86/x86_asm_nodes.h"
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+/** program point numbering for the instructions of a function
+ *
+ * instructions are numbered in block order with gaps left for inserted code; every instruction has
+ * a use slot (2 * index) where it reads its inputs and a def slot (2 * index + 1) where it writes its outputs.
+ */
+class X86SlotIndexes final
+{
+public:
+    typedef std::uint64_t SlotIndex;
+private:
+    static constexpr SlotIndex instructionSpacing = 1024;
+    struct BlockRange final
+    {
+        SlotIndex start = 0, end = 0; // instruction indexes strictly between start and end belong to the block
+    };
+    std::shared_ptr<X86AsmFunction> function;
+    std::unordered_map<std::shared_ptr<X86AsmNode>, SlotIndex> nodeIndexes;
+    std::unordered_map<std::shared_ptr<X86AsmBasicBlock>, BlockRange> blockRanges;
+    /// number the nodes of block that don't have an index yet; returns false if there isn't enough space
+    bool numberNewNodes(std::shared_ptr<X86AsmBasicBlock> block)
+    {
+        const BlockRange &blockRange = blockRanges.at(block);
+        SlotIndex previousIndex = blockRange.start;
+        std::vector<std::shared_ptr<X86AsmNode>> newNodes;
+        auto numberRun = [&](SlotIndex nextIndex)
+        {
+            if(newNodes.empty())
+                return true;
+            if(nextIndex - previousIndex <= newNodes.size())
+                return false;
+            SlotIndex step = (nextIndex - previousIndex) / (newNodes.size() + 1);
+            for(std::size_t i = 0; i < newNodes.size(); i++)
+                nodeIndexes[newNodes[i]] = previousIndex + step * (i + 1);
+            newNodes.clear();
+            return true;
+        };
+        for(std::shared_ptr<X86AsmNode> node : block->instructions)
+        {
+            auto iter = nodeIndexes.find(node);
+            if(iter == nodeIndexes.end())
+            {
+                newNodes.push_back(node);
+                continue;
+            }
+            if(!numberRun(std::get<1>(*iter)))
+                return false;
+            previousIndex = std::get<1>(*iter);
+        }
+        return numberRun(blockRange.end);
+    }
+public:
+    void visitX86AsmFunction(std::shared_ptr<X86AsmFunction> function)
+    {
+        this->function = function;
+        nodeIndexes.clear();
+        blockRanges.clear();
+        SlotIndex index = 0;
+        for(std::shared_ptr<X86AsmBasicBlock> block : function->blocks)
+        {
+            BlockRange &blockRange = blockRanges[block];
+            blockRange.start = index;
+            for(std::shared_ptr<X86AsmNode> node : block->instructions)
+            {
+                index += instructionSpacing;
+                nodeIndexes[node] = index;
+            }
+            index += instructionSpacing;
+            blockRange.end = index;
+            index += instructionSpacing;
+        }
+    }
+    /// number the instructions inserted into block since it was last numbered
+    void updateBlock(std::shared_ptr<X86AsmBasicBlock> block)
+    {
+        assert(function != nullptr);
+        if(blockRanges.count(block) == 0 || !numberNewNodes(block)) // out of space: start over
+            visitX86AsmFunction(function);
+    }
+    void removeNode(std::shared_ptr<X86AsmNode> node)
+    {
+        nodeIndexes.erase(node);
+    }
+    SlotIndex getIndex(std::shared_ptr<X86AsmNode> node) const
+    {
+        return nodeIndexes.at(node);
+    }
+    static SlotIndex getUseSlot(SlotIndex index)
+    {
+        return 2 * index;
+    }
+    static SlotIndex getDefSlot(SlotIndex index)
+    {
+        return 2 * index + 1;
+    }
+    SlotIndex getBlockStartSlot(std::shared_ptr<X86AsmBasicBlock> block) const
+    {
+        return getUseSlot(blockRanges.at(block).start);
+    }
+    SlotIndex getBlockEndSlot(std::shared_ptr<X86AsmBasicBlock> block) const
+    {
+        return getUseSlot(blockRanges.at(block).end);
+    }
+};
+
+/// set of program points as sorted, disjoint, half-open slot segments
+class X86LiveInterval final
+{
+public:
+    typedef X86SlotIndexes::SlotIndex SlotIndex;
+    struct Segment final
+    {
+        SlotIndex start, end;
+        Segment(SlotIndex start, SlotIndex end)
+            : start(start), end(end)
+        {
+        }
+    };
+private:
+    std::vector<Segment> segments;
+    /// first segment that ends after slot
+    std::vector<Segment>::const_iterator findSegment(SlotIndex slot) const
+    {
+        return std::upper_bound(segments.begin(), segments.end(), slot, [](SlotIndex slot, const Segment &segment)
+        {
+            return slot < segment.end;
+        });
+    }
+public:
+    const std::vector<Segment> &getSegments() const
+    {
+        return segments;
+    }
+    bool empty() const
+    {
+        return segments.empty();
+    }
+    void clear()
+    {
+        segments.clear();
+    }
+    void addSegment(SlotIndex start, SlotIndex end)
+    {
+        if(start >= end)
+            return;
+        auto first = std::lower_bound(segments.begin(), segments.end(), start, [](const Segment &segment, SlotIndex start)
+        {
+            return segment.end < start;
+        });
+        auto last = first;
+        while(last != segments.end() && last->start <= end)
+        {
+            start = std::min(start, last->start);
+            end = std::max(end, last->end);
+            ++last;
+        }
+        first = segments.erase(first, last);
+        segments.insert(first, Segment(start, end));
+    }
+    bool contains(SlotIndex slot) const
+    {
+        auto iter = findSegment(slot);
+        return iter != segments.end() && iter->start <= slot;
+    }
+    bool overlaps(SlotIndex start, SlotIndex end) const
+    {
+        if(start >= end)
+            return false;
+        auto iter = findSegment(start);
+        return iter != segments.end() && iter->start < end;
+    }
+    bool overlaps(const X86LiveInterval &rt) const
+    {
+        auto i = segments.begin();
+        auto j = rt.segments.begin();
+        while(i != segments.end() && j != rt.segments.end())
+        {
+            if(i->end <= j->start)
+                ++i;
+            else if(j->end <= i->start)
+                ++j;
+            else
+                return true;
+        }
+        return false;
+    }
+};
+
+#endif // X86_SLOT_INDEXES_H_INCLUDED
@@ -35,14 +35,13 @@ private:
     {
         Clearing,
         FillingSourceAndDest,
-        ConstructingPredecessorGraph,
         ConstructingDominatorGraph,
         FillDominatedValues,
         FillImmediateDominator,
     };
     Stage stage = Stage::Clearing;
     bool done = false;
-    std::unordered_map<std::shared_ptr<SSABasicBlock>, std::unordered_set<std::shared_ptr<SSABasicBlock>>> predecessorSetMap;
+    std::shared_ptr<SSABasicBlock> startBlock;
     std::unordered_map<std::shared_ptr<SSABasicBlock>, std::unordered_set<std::shared_ptr<SSABasicBlock>>> dominatingSetMap;
     std::unordered_map<std::shared_ptr<SSABasicBlock>, std::size_t> basicBlockNameMap;
     std::size_t nextName = 1;
@@ -126,37 +125,22 @@ private:
             }
             return;
         }
-        case Stage::ConstructingPredecessorGraph:
-        {
-            std::unordered_set<std::shared_ptr<SSABasicBlock>> &predecessorSet = predecessorSetMap[node];
-            for(std::weak_ptr<SSABasicBlock> sourceBlockW : node->sourceBlocks)
-            {
-                std::shared_ptr<SSABasicBlock> sourceBlock = sourceBlockW.lock();
-                if(sourceBlock == node)
-                    continue;
-                const std::unordered_set<std::shared_ptr<SSABasicBlock>> &sourcePredecessorSet = predecessorSetMap[sourceBlock];
-                if(std::get<1>(predecessorSet.insert(sourceBlock)))
-                    done = false;
-                for(std::shared_ptr<SSABasicBlock> sourcePredecessor : sourcePredecessorSet)
-                {
-                    if(sourcePredecessor == node)
-                        continue;
-                    if(std::get<1>(predecessorSet.insert(sourcePredecessor)))
-                        done = false;
-                }
-            }
-            return;
-        }
         case Stage::ConstructingDominatorGraph:
         {
             std::unordered_set<std::shared_ptr<SSABasicBlock>> newDominatorsSet;
             bool isFirst = true;
-            for(std::shared_ptr<SSABasicBlock> sourceBlock : predecessorSetMap[node])
+            for(std::weak_ptr<SSABasicBlock> sourceBlockW : node->sourceBlocks)
             {
-                const std::unordered_set<std::shared_ptr<SSABasicBlock>> &sourceDominators = dominatingSetMap[sourceBlock];
+                if(node == startBlock)
+                    break;
+                auto iter = dominatingSetMap.find(sourceBlockW.lock());
+                if(iter == dominatingSetMap.end()) // not visited yet : acts like the set of all blocks
+                    continue;
+                const std::unordered_set<std::shared_ptr<SSABasicBlock>> &sourceDominators = std::get<1>(*iter);
                 if(isFirst)
                 {
                     newDominatorsSet = sourceDominators;
+                    isFirst = false;
                 }
                 else
                 {
@@ -169,6 +153,8 @@ private:
                     }
                 }
             }
+            if(isFirst && node != startBlock) // unreachable so far
+                return;
             newDominatorsSet.insert(node);
             std::unordered_set<std::shared_ptr<SSABasicBlock>> &currentDominatorsSet = dominatingSetMap[node];
             if(currentDominatorsSet != newDominatorsSet)
@@ -180,7 +166,9 @@ private:
         }
         case Stage::FillDominatedValues:
         {
-            const std::unordered_set<std::shared_ptr<SSABasicBlock>> &currentDominatorsSet = dominatingSetMap[node];
+            std::unordered_set<std::shared_ptr<SSABasicBlock>> &currentDominatorsSet = dominatingSetMap[node];
+            if(currentDominatorsSet.empty()) // unreachable
+                currentDominatorsSet.insert(node);
             for(std::shared_ptr<SSABasicBlock> dominator : currentDominatorsSet)
             {
                 dominator->dominatedBlocks.push_back(node);
@@ -230,18 +218,8 @@ public:
         {
             visitSSABasicBlock(basicBlock);
         }
-        stage = Stage::ConstructingPredecessorGraph;
-        predecessorSetMap.clear();
-        do
-        {
-            done = true;
-            for(std::shared_ptr<SSABasicBlock> basicBlock : node->blocks)
-            {
-                visitSSABasicBlock(basicBlock);
-            }
-        }
-        while(!done);
         stage = Stage::ConstructingDominatorGraph;
+        startBlock = node->startBlock;
         dominatingSetMap.clear();
         do
         {
@@ -263,7 +241,7 @@ public:
             visitSSABasicBlock(basicBlock);
         }
         dominatingSetMap.clear();
-        predecessorSetMap.clear();
+        startBlock = nullptr;
     }
     void visitRTLFunction(std::shared_ptr<RTLFunction> function)
     {
@@ -20,6 +20,9 @@
 #define CONSTRUCT_LIVENESS_INFO_H_INCLUDED
 
 #include "rtl/rtl_nodes.h"
+#include "util/dataflow.h"
+#include <unordered_map>
+#include <vector>
 
 class ConstructLivenessInfo final
 {
@@ -48,33 +51,48 @@ public:
                 block->liveRegistersAtStart = block->usedRegistersAtStart;
             }
         }
-        bool done = false;
-        while(!done)
+        std::vector<std::shared_ptr<RTLRegister>> registers;
+        std::unordered_map<std::shared_ptr<RTLRegister>, std::size_t> registerIndexMap;
+        auto getRegisterIndex = [&](std::shared_ptr<RTLRegister> r)
         {
-            done = true;
-            for(std::shared_ptr<RTLBasicBlock> block : function->blocks)
+            auto iter = registerIndexMap.find(r);
+            if(iter != registerIndexMap.end())
+                return std::get<1>(*iter);
+            std::size_t index = registers.size();
+            registers.push_back(r);
+            registerIndexMap[r] = index;
+            return index;
+        };
+        for(std::shared_ptr<RTLBasicBlock> block : function->blocks)
+        {
+            for(std::shared_ptr<RTLRegister> r : block->usedRegistersAtStart)
+                getRegisterIndex(r);
+            for(std::shared_ptr<RTLRegister> r : block->assignedRegisters)
+                getRegisterIndex(r);
+        }
+        DataflowSolver<RTLBasicBlock> solver(function->startBlock, function->blocks, DataflowDirection::Backward);
+        std::vector<bit_vector> generated(solver.getBlockCount(), bit_vector(registers.size()));
+        std::vector<bit_vector> killed(solver.getBlockCount(), bit_vector(registers.size()));
+        for(std::size_t blockIndex = 0; blockIndex < solver.getBlockCount(); blockIndex++)
+        {
+            std::shared_ptr<RTLBasicBlock> block = solver.getBlock(blockIndex);
+            for(std::shared_ptr<RTLRegister> r : block->usedRegistersAtStart)
+                generated[blockIndex].set(registerIndexMap[r]);
+            for(std::shared_ptr<RTLRegister> r : block->assignedRegisters)
+                killed[blockIndex].set(registerIndexMap[r]);
+        }
+        solver.solve(generated, killed, registers.size());
+        for(std::size_t blockIndex = 0; blockIndex < solver.getBlockCount(); blockIndex++)
+        {
+            std::shared_ptr<RTLBasicBlock> block = solver.getBlock(blockIndex);
+            solver.getValueAtStart(blockIndex).for_each_set_bit([&](std::size_t index)
             {
-                for(std::shared_ptr<RTLRegister> r : block->liveRegistersAtEnd)
-                {
-                    if(block->assignedRegisters.count(r) != 0)
-                        continue;
-                    if(std::get<1>(block->liveRegistersAtStart.insert(r)))
-                    {
-                        done = false;
-                    }
-                }
-                for(std::weak_ptr<RTLBasicBlock> targetW : block->destBlocks)
-                {
-                    std::shared_ptr<RTLBasicBlock> target = targetW.lock();
-                    for(std::shared_ptr<RTLRegister> r : target->liveRegistersAtStart)
-                    {
-                        if(std::get<1>(block->liveRegistersAtEnd.insert(r)))
-                        {
-                            done = false;
-                        }
-                    }
-                }
-            }
+                block->liveRegistersAtStart.insert(registers[index]);
+            });
+            solver.getValueAtEnd(blockIndex).for_each_set_bit([&](std::size_t index)
+            {
+                block->liveRegistersAtEnd.insert(registers[index]);
+            });
         }
     }
 };
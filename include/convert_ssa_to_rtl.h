@@ -28,18 +28,39 @@
 #include "dump.h"
 #include "construct_liveness_info.h"
 #include "construct_basic_block_graph.h"
+#include "util/bit_vector.h"
+#include "util/dataflow.h"
 
 #include <unordered_map>
 #include <unordered_set>
 #include <cassert>
 #include <deque>
 #include <list>
+#include <vector>
+#include <utility>
 #include <sstream>
 #include <iostream>
 
+/** convert a SSA function to RTL
+ *
+ * Phi functions are removed by coalescing each phi with its inputs into congruence classes that share a register
+ * whenever their live ranges don't interfere. The inputs that can't be coalesced are copied into the phi's register
+ * by a parallel copy at the end of the source block, splitting the edge if the source block has more than one successor.
+ */
 class ConvertSSAToRTL final : public SSANodeVisitor
 {
 private:
+    struct ParallelCopy final
+    {
+        std::shared_ptr<RTLRegister> destRegister;
+        std::shared_ptr<RTLRegister> sourceRegister;
+        std::shared_ptr<TypeNode> type;
+        ParallelCopy(std::shared_ptr<RTLRegister> destRegister, std::shared_ptr<RTLRegister> sourceRegister, std::shared_ptr<TypeNode> type)
+            : destRegister(destRegister), sourceRegister(sourceRegister), type(type)
+        {
+        }
+    };
+    typedef std::unordered_set<std::shared_ptr<SSANode>> NodeSet;
     std::unordered_map<std::shared_ptr<SSAFunction>, std::shared_ptr<RTLFunction>> functionMap;
     std::unordered_map<std::shared_ptr<SSABasicBlock>, std::shared_ptr<RTLBasicBlock>> basicBlockMap;
     std::shared_ptr<RTLBasicBlock> getOrMakeRTLBasicBlock(std::shared_ptr<SSABasicBlock> node)
@@ -60,6 +81,13 @@ private:
     std::shared_ptr<RTLFunction> currentlyGeneratingFunction;
     std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<RTLRegister>> registerMap;
     std::unordered_map<std::shared_ptr<RTLRegister>, std::unordered_set<std::shared_ptr<SSANode>>> reverseRegisterMap;
+    std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<NodeSet>> nodeSetMap;
+    std::unordered_map<std::shared_ptr<SSABasicBlock>, std::vector<ParallelCopy>> parallelCopyMap; /// copies done before the block's control transfer instruction
+    std::unordered_map<std::shared_ptr<SSANode>, std::size_t> nodeIndexMap;
+    std::unordered_map<std::shared_ptr<SSANode>, std::pair<std::shared_ptr<SSABasicBlock>, std::size_t>> definitionMap;
+    std::unordered_map<std::shared_ptr<SSABasicBlock>, std::unordered_map<std::shared_ptr<SSANode>, std::size_t>> lastUseMap;
+    std::unordered_map<std::shared_ptr<SSABasicBlock>, bit_vector> liveInMap;
+    std::unordered_map<std::shared_ptr<SSABasicBlock>, bit_vector> liveOutMap;
     std::size_t nextVirtualRegisterName = 0;
     std::string makeVirtualRegisterName()
     {
@@ -67,6 +95,198 @@ private:
         ss << "virtual#" << ++nextVirtualRegisterName;
         return ss.str();
     }
+    std::size_t getNodeIndex(std::shared_ptr<SSANode> node)
+    {
+        auto iter = nodeIndexMap.find(node);
+        if(iter != nodeIndexMap.end())
+            return std::get<1>(*iter);
+        std::size_t retval = nodeIndexMap.size();
+        nodeIndexMap[node] = retval;
+        return retval;
+    }
+    /** calculate liveness of all the nodes
+     *
+     * positions count the non-phi instructions in a block starting at 1 : all the phi functions are defined at position 0
+     * and their inputs are used at the end of the corresponding source blocks.
+     */
+    void calculateLiveness(std::shared_ptr<SSAFunction> function)
+    {
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            std::unordered_map<std::shared_ptr<SSANode>, std::size_t> &lastUses = lastUseMap[block];
+            std::size_t position = 0;
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                getNodeIndex(node);
+                if(dynamic_cast<const SSAPhi *>(node.get()) == nullptr)
+                {
+                    position++;
+                    for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+                    {
+                        getNodeIndex(inputNode);
+                        lastUses[inputNode] = position;
+                    }
+                }
+                definitionMap[node] = std::make_pair(block, position);
+            }
+        }
+        std::unordered_map<std::shared_ptr<SSABasicBlock>, std::vector<std::size_t>> phiUsesMap;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+                if(phi == nullptr)
+                    break;
+                for(const SSAPhi::PhiInput &i : phi->inputs)
+                {
+                    phiUsesMap[i.block.lock()].push_back(getNodeIndex(i.node.lock()));
+                }
+            }
+        }
+        const std::size_t bitCount = nodeIndexMap.size();
+        DataflowSolver<SSABasicBlock> solver(function->startBlock, function->blocks, DataflowDirection::Backward);
+        solver.solve([&](std::size_t blockIndex, const bit_vector &input, bit_vector &output)
+        {
+            std::shared_ptr<SSABasicBlock> block = solver.getBlock(blockIndex);
+            for(std::size_t nodeIndex : phiUsesMap[block])
+                output.set(nodeIndex);
+            for(auto iter = block->instructions.rbegin(); iter != block->instructions.rend(); ++iter)
+            {
+                std::shared_ptr<SSANode> node = *iter;
+                output.reset(nodeIndexMap[node]);
+                if(dynamic_cast<const SSAPhi *>(node.get()) != nullptr)
+                    continue;
+                for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+                    output.set(nodeIndexMap[inputNode]);
+            }
+        }, bitCount);
+        for(std::size_t blockIndex = 0; blockIndex < solver.getBlockCount(); blockIndex++)
+        {
+            std::shared_ptr<SSABasicBlock> block = solver.getBlock(blockIndex);
+            liveInMap[block] = solver.getValueAtStart(blockIndex);
+            bit_vector &liveOut = liveOutMap[block];
+            liveOut = solver.getValueAtEnd(blockIndex);
+            for(std::size_t nodeIndex : phiUsesMap[block])
+                liveOut.set(nodeIndex);
+        }
+    }
+    /// is node live just after position in block : an input of the instruction at position counts as live
+    bool isLiveAfter(std::shared_ptr<SSANode> node, std::shared_ptr<SSABasicBlock> block, std::size_t position)
+    {
+        std::size_t nodeIndex = nodeIndexMap[node];
+        const std::pair<std::shared_ptr<SSABasicBlock>, std::size_t> &definition = definitionMap[node];
+        if(std::get<0>(definition) != block)
+        {
+            if(!liveInMap[block].test(nodeIndex))
+                return false;
+        }
+        else if(std::get<1>(definition) > position)
+            return false;
+        if(liveOutMap[block].test(nodeIndex))
+            return true;
+        const std::unordered_map<std::shared_ptr<SSANode>, std::size_t> &lastUses = lastUseMap[block];
+        auto iter = lastUses.find(node);
+        return iter != lastUses.end() && std::get<1>(*iter) >= position;
+    }
+    static std::shared_ptr<SSANode> getCopiedNode(std::shared_ptr<SSANode> node)
+    {
+        while(std::shared_ptr<SSAMove> move = std::dynamic_pointer_cast<SSAMove>(node))
+            node = move->source.lock();
+        return node;
+    }
+    bool interferes(std::shared_ptr<SSANode> a, std::shared_ptr<SSANode> b)
+    {
+        if(getCopiedNode(a) == getCopiedNode(b)) // same value so they can share a register
+            return false;
+        if(definitionMap.count(a) == 0 || definitionMap.count(b) == 0)
+            return true;
+        const std::pair<std::shared_ptr<SSABasicBlock>, std::size_t> &definitionA = definitionMap[a];
+        const std::pair<std::shared_ptr<SSABasicBlock>, std::size_t> &definitionB = definitionMap[b];
+        return isLiveAfter(a, std::get<0>(definitionB), std::get<1>(definitionB)) || isLiveAfter(b, std::get<0>(definitionA), std::get<1>(definitionA));
+    }
+    std::shared_ptr<NodeSet> getNodeSet(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<NodeSet> &retval = nodeSetMap[node];
+        if(retval == nullptr)
+        {
+            retval = std::make_shared<NodeSet>();
+            retval->insert(node);
+        }
+        return retval;
+    }
+    /// merge the congruence classes of a and b if they don't interfere
+    void tryCoalesce(std::shared_ptr<SSANode> a, std::shared_ptr<SSANode> b)
+    {
+        std::shared_ptr<NodeSet> setA = getNodeSet(a);
+        std::shared_ptr<NodeSet> setB = getNodeSet(b);
+        if(setA == setB)
+            return;
+        for(std::shared_ptr<SSANode> nodeA : *setA)
+        {
+            for(std::shared_ptr<SSANode> nodeB : *setB)
+            {
+                if(interferes(nodeA, nodeB))
+                    return;
+            }
+        }
+        if(setA->size() < setB->size())
+            setA.swap(setB);
+        for(std::shared_ptr<SSANode> node : *setB)
+        {
+            setA->insert(node);
+            nodeSetMap[node] = setA;
+        }
+    }
+    /** emit a parallel copy as a sequence of moves
+     *
+     * a copy is done once its destination isn't needed as a source anymore; the copies left form cycles,
+     * each of which is broken by moving one of its registers to a temporary register.
+     */
+    void emitParallelCopy(const std::vector<ParallelCopy> &copies)
+    {
+        std::unordered_map<std::shared_ptr<RTLRegister>, const ParallelCopy *> destinationMap;
+        std::unordered_map<std::shared_ptr<RTLRegister>, std::shared_ptr<RTLRegister>> locationMap; // where the original value of a source register is
+        std::vector<std::shared_ptr<RTLRegister>> todo, ready;
+        for(const ParallelCopy &copy : copies)
+        {
+            if(copy.destRegister == copy.sourceRegister)
+                continue;
+            destinationMap[copy.destRegister] = &copy;
+            locationMap[copy.sourceRegister] = copy.sourceRegister;
+            todo.push_back(copy.destRegister);
+        }
+        for(std::shared_ptr<RTLRegister> destRegister : todo)
+        {
+            if(locationMap.count(destRegister) == 0)
+                ready.push_back(destRegister);
+        }
+        while(!todo.empty())
+        {
+            while(!ready.empty())
+            {
+                std::shared_ptr<RTLRegister> destRegister = ready.back();
+                ready.pop_back();
+                const ParallelCopy &copy = *destinationMap[destRegister];
+                std::shared_ptr<RTLRegister> location = locationMap[copy.sourceRegister];
+                currentlyGeneratingBasicBlock->instructions.push_back(std::make_shared<RTLMove>(destRegister, location, copy.type));
+                locationMap[copy.sourceRegister] = destRegister;
+                if(location == copy.sourceRegister && destinationMap.count(copy.sourceRegister) != 0)
+                    ready.push_back(copy.sourceRegister);
+            }
+            std::shared_ptr<RTLRegister> destRegister = todo.back();
+            todo.pop_back();
+            auto iter = locationMap.find(destRegister);
+            if(iter != locationMap.end() && std::get<1>(*iter) == destRegister) // in a cycle that hasn't been copied yet
+            {
+                const ParallelCopy &copy = *destinationMap[destRegister];
+                std::shared_ptr<RTLRegister> temporaryRegister = std::make_shared<RTLRegister>(destRegister->context, makeVirtualRegisterName(), nullptr);
+                currentlyGeneratingBasicBlock->instructions.push_back(std::make_shared<RTLMove>(temporaryRegister, destRegister, copy.type));
+                std::get<1>(*iter) = temporaryRegister;
+                ready.push_back(destRegister);
+            }
+        }
+    }
 public:
     virtual void visitSSAUnconditionalJump(std::shared_ptr<SSAUnconditionalJump> node) override
     {
@@ -80,27 +300,7 @@ public:
     }
     virtual void visitSSAPhi(std::shared_ptr<SSAPhi> node) override
     {
-        std::shared_ptr<RTLRegister> sourceRegister;
-#ifndef NDEBUG
-        bool isFirst = true;
-        for(SSAPhi::PhiInput i : node->inputs)
-        {
-            if(isFirst)
-            {
-                isFirst = false;
-                sourceRegister = registerMap[i.node.lock()];
-            }
-            else
-            {
-                assert(sourceRegister == registerMap[i.node.lock()]);
-            }
-        }
-        assert(!isFirst);
-#else
-        sourceRegister = registerMap[node->inputs.front().node.lock()];
-#endif
-        std::shared_ptr<RTLNode> newNode = std::make_shared<RTLMove>(registerMap[node], sourceRegister, node->type);
-        currentlyGeneratingBasicBlock->instructions.push_back(newNode);
+        // the phi's register is written by the parallel copies in the source blocks
     }
     virtual void visitSSAConstant(std::shared_ptr<SSAConstant> node) override
     {
@@ -112,6 +312,11 @@ public:
         std::shared_ptr<RTLNode> newNode = std::make_shared<RTLMove>(registerMap[node], registerMap[node->source.lock()], node->type);
         currentlyGeneratingBasicBlock->instructions.push_back(newNode);
     }
+    virtual void visitSSASelect(std::shared_ptr<SSASelect> node) override
+    {
+        std::shared_ptr<RTLNode> newNode = std::make_shared<RTLSelect>(registerMap[node], registerMap[node->condition.lock()], registerMap[node->trueValue.lock()], registerMap[node->falseValue.lock()], node->type);
+        currentlyGeneratingBasicBlock->instructions.push_back(newNode);
+    }
     virtual void visitSSALoad(std::shared_ptr<SSALoad> node) override
     {
         std::shared_ptr<RTLNode> newNode = std::make_shared<RTLLoad>(registerMap[node], registerMap[node->address.lock()], node->address.lock()->type);
@@ -122,6 +327,16 @@ public:
         std::shared_ptr<RTLNode> newNode = std::make_shared<RTLStore>(registerMap[node->address.lock()], registerMap[node->value.lock()], node->address.lock()->type);
         currentlyGeneratingBasicBlock->instructions.push_back(newNode);
     }
+    virtual void visitSSAMemoryCopy(std::shared_ptr<SSAMemoryCopy> node) override
+    {
+        std::shared_ptr<RTLNode> newNode = std::make_shared<RTLMemoryCopy>(registerMap[node->destAddress.lock()], registerMap[node->sourceAddress.lock()], node->destAddress.lock()->type, node->count, node->mayOverlap);
+        currentlyGeneratingBasicBlock->instructions.push_back(newNode);
+    }
+    virtual void visitSSAMemoryFill(std::shared_ptr<SSAMemoryFill> node) override
+    {
+        std::shared_ptr<RTLNode> newNode = std::make_shared<RTLMemoryFill>(registerMap[node->destAddress.lock()], registerMap[node->value.lock()], node->destAddress.lock()->type, node->count);
+        currentlyGeneratingBasicBlock->instructions.push_back(newNode);
+    }
     virtual void visitSSACompare(std::shared_ptr<SSACompare> node) override
     {
         std::shared_ptr<RTLNode> newNode = std::make_shared<RTLCompare>(registerMap[node], registerMap[node->lhs.lock()], registerMap[node->rhs.lock()], node->compareOperator, node->lhs.lock()->type);
@@ -165,6 +380,8 @@ private:
         }
         for(std::shared_ptr<SSANode> node : block->instructions)
         {
+            if(node == block->controlTransferInstruction)
+                emitParallelCopy(parallelCopyMap[block]);
             visitSSANode(node);
         }
     }
@@ -174,116 +391,102 @@ private:
         currentlyGeneratingFunction = nullptr;
         registerMap.clear();
         reverseRegisterMap.clear();
+        nodeSetMap.clear();
+        parallelCopyMap.clear();
+        nodeIndexMap.clear();
+        definitionMap.clear();
+        lastUseMap.clear();
+        liveInMap.clear();
+        liveOutMap.clear();
     }
 public:
     std::shared_ptr<RTLFunction> visitSSAFunction(std::shared_ptr<SSAFunction> function)
     {
         clearAllButFunctionMap();
         PhiRemoval().visitSSAFunction(function);
+        ControlFlowSimplification().visitSSAFunction(function);
         ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
         currentlyGeneratingFunction = getOrMakeRTLFunction(function);
-        std::deque<std::pair<std::shared_ptr<SSABasicBlock>, std::shared_ptr<SSABasicBlock>>> fixPhiEdgesWorklist;
-        for(std::shared_ptr<SSABasicBlock> target : function->blocks)
+        calculateLiveness(function);
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
         {
-            getOrMakeRTLBasicBlock(target);
-            if(target->instructions.empty())
-                continue;
-            if(dynamic_cast<const SSAPhi *>(target->instructions.front().get()) == nullptr) // all phi functions must be at front
-                continue;
-            for(std::weak_ptr<SSABasicBlock> sourceW : target->sourceBlocks)
+            for(std::shared_ptr<SSANode> node : block->instructions)
             {
-                std::shared_ptr<SSABasicBlock> source = sourceW.lock();
-                fixPhiEdgesWorklist.emplace_back(source, target);
+                std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+                if(phi == nullptr)
+                    break;
+                for(const SSAPhi::PhiInput &i : phi->inputs)
+                    tryCoalesce(phi, i.node.lock());
             }
         }
-        for(std::pair<std::shared_ptr<SSABasicBlock>, std::shared_ptr<SSABasicBlock>> edge : fixPhiEdgesWorklist)
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
         {
-            std::shared_ptr<SSABasicBlock> source = std::get<0>(edge);
-            std::shared_ptr<SSABasicBlock> target = std::get<1>(edge);
-            if(source->destBlocks.size() > 1 || target->sourceBlocks.size() > 1)
+            for(std::shared_ptr<SSANode> node : block->instructions)
             {
-                function->splitEdge(source, target);
+                if(std::shared_ptr<SSAMove> move = std::dynamic_pointer_cast<SSAMove>(node))
+                    tryCoalesce(move, move->source.lock());
             }
         }
-        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
-        fixPhiEdgesWorklist.clear();
+        std::unordered_map<std::shared_ptr<NodeSet>, std::shared_ptr<RTLRegister>> nodeSetToRegisterMap;
         for(std::shared_ptr<SSABasicBlock> block : function->blocks)
         {
+            getOrMakeRTLBasicBlock(block);
             for(std::shared_ptr<SSANode> node : block->instructions)
             {
-                std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
-                if(phi == nullptr)
-                    break;
-                for(SSAPhi::PhiInput &i : phi->inputs)
+                std::shared_ptr<RTLRegister> &r = nodeSetToRegisterMap[getNodeSet(node)];
+                if(r == nullptr)
                 {
-                    std::shared_ptr<SSABasicBlock> fixupBlock = i.block.lock();
-                    assert(fixupBlock != nullptr);
-                    assert(fixupBlock->destBlocks.size() == 1);
-                    assert(fixupBlock->destBlocks.front().lock() == block);
-                    auto insertPosition = fixupBlock->instructions.end();
-                    --insertPosition; // skip control transfer instruction
-                    std::shared_ptr<SSANode> newNode = std::make_shared<SSAMove>(i.node.lock(), phi->spillLocation);
-                    i.node = newNode;
-                    fixupBlock->instructions.insert(insertPosition, newNode);
+                    r = std::make_shared<RTLRegister>(function->context, makeVirtualRegisterName(), node->spillLocation);
                 }
+                registerMap[node] = r;
+                reverseRegisterMap[r].insert(node);
             }
         }
-        ControlFlowSimplification().visitSSAFunction(function);
-        std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<std::unordered_set<std::shared_ptr<SSANode>>>> nodeSetMap;
-        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        nodeSetToRegisterMap.clear();
+        std::deque<std::pair<std::pair<std::shared_ptr<SSABasicBlock>, std::shared_ptr<SSABasicBlock>>, std::vector<ParallelCopy>>> edgeCopiesList;
+        for(std::shared_ptr<SSABasicBlock> target : function->blocks)
         {
-            for(std::shared_ptr<SSANode> node : block->instructions)
+            if(target->instructions.empty())
+                continue;
+            if(dynamic_cast<const SSAPhi *>(target->instructions.front().get()) == nullptr) // all phi functions must be at front
+                continue;
+            for(std::weak_ptr<SSABasicBlock> sourceW : target->sourceBlocks)
             {
-                std::shared_ptr<std::unordered_set<std::shared_ptr<SSANode>>> &returnNodeSet = nodeSetMap[node];
-                if(returnNodeSet == nullptr)
-                {
-                    returnNodeSet = std::make_shared<std::unordered_set<std::shared_ptr<SSANode>>>();
-                    returnNodeSet->insert(node);
-                }
-                std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
-                if(phi != nullptr)
+                std::shared_ptr<SSABasicBlock> source = sourceW.lock();
+                std::vector<ParallelCopy> copies;
+                for(std::shared_ptr<SSANode> node : target->instructions)
                 {
-                    std::shared_ptr<std::unordered_set<std::shared_ptr<SSANode>>> nodeSet = nullptr;
-                    for(SSAPhi::PhiInput i : phi->inputs)
+                    std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+                    if(phi == nullptr)
+                        break;
+                    for(const SSAPhi::PhiInput &i : phi->inputs)
                     {
-                        std::shared_ptr<SSANode> inputNode = i.node.lock();
-                        std::shared_ptr<std::unordered_set<std::shared_ptr<SSANode>>> &inputNodeSet = nodeSetMap[inputNode];
-                        if(inputNodeSet == nullptr)
-                        {
-                            inputNodeSet = std::make_shared<std::unordered_set<std::shared_ptr<SSANode>>>();
-                            inputNodeSet->insert(inputNode);
-                        }
-                        if(nodeSet == nullptr)
-                            nodeSet = inputNodeSet;
-                        if(inputNodeSet == nodeSet)
+                        if(i.block.lock() != source)
                             continue;
-                        std::shared_ptr<std::unordered_set<std::shared_ptr<SSANode>>> oldInputNodeSet = inputNodeSet;
-                        inputNodeSet = nodeSet;
-                        for(std::shared_ptr<SSANode> otherNode : *oldInputNodeSet)
-                        {
-                            nodeSetMap[otherNode] = inputNodeSet;
-                            returnNodeSet->insert(otherNode);
-                        }
+                        std::shared_ptr<RTLRegister> sourceRegister = registerMap[i.node.lock()];
+                        if(sourceRegister != registerMap[phi])
+                            copies.emplace_back(registerMap[phi], sourceRegister, phi->type);
                     }
                 }
+                if(!copies.empty())
+                    edgeCopiesList.emplace_back(std::make_pair(source, target), std::move(copies));
             }
         }
-        std::unordered_map<std::shared_ptr<std::unordered_set<std::shared_ptr<SSANode>>>, std::shared_ptr<RTLRegister>> nodeSetToRegisterMap;
-        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        for(auto &edgeCopies : edgeCopiesList)
         {
-            for(std::shared_ptr<SSANode> node : block->instructions)
+            std::shared_ptr<SSABasicBlock> source = std::get<0>(std::get<0>(edgeCopies));
+            std::shared_ptr<SSABasicBlock> target = std::get<1>(std::get<0>(edgeCopies));
+            if(source->destBlocks.size() > 1)
             {
-                std::shared_ptr<RTLRegister> &r = nodeSetToRegisterMap[nodeSetMap[node]];
-                if(r == nullptr)
-                {
-                    r = std::make_shared<RTLRegister>(function->context, makeVirtualRegisterName(), node->spillLocation);
-                }
-                registerMap[node] = r;
-                reverseRegisterMap[r].insert(node);
+                source = function->splitEdge(source, target);
+                getOrMakeRTLBasicBlock(source);
             }
+            assert(source->destBlocks.size() == 1);
+            std::vector<ParallelCopy> &copies = parallelCopyMap[source];
+            copies.insert(copies.end(), std::get<1>(edgeCopies).begin(), std::get<1>(edgeCopies).end());
         }
-        nodeSetMap.clear();
-        nodeSetToRegisterMap.clear();
+        edgeCopiesList.clear();
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
         currentlyGeneratingFunction->startBlock = getOrMakeRTLBasicBlock(function->startBlock);
         for(std::shared_ptr<SSABasicBlock> block : function->blocks)
         {
@@ -125,8 +125,11 @@ public:
     virtual void visitSSAPhi(std::shared_ptr<SSAPhi> node) override;
     virtual void visitSSAConstant(std::shared_ptr<SSAConstant> node) override;
     virtual void visitSSAMove(std::shared_ptr<SSAMove> node) override;
+    virtual void visitSSASelect(std::shared_ptr<SSASelect> node) override;
     virtual void visitSSALoad(std::shared_ptr<SSALoad> node) override;
     virtual void visitSSAStore(std::shared_ptr<SSAStore> node) override;
+    virtual void visitSSAMemoryCopy(std::shared_ptr<SSAMemoryCopy> node) override;
+    virtual void visitSSAMemoryFill(std::shared_ptr<SSAMemoryFill> node) override;
     virtual void visitSSACompare(std::shared_ptr<SSACompare> node) override;
     virtual void visitSSAAllocA(std::shared_ptr<SSAAllocA> node) override;
     virtual void visitSSATypeCast(std::shared_ptr<SSATypeCast> node) override;
@@ -137,6 +140,7 @@ public:
     virtual void visitTypeBoolean(std::shared_ptr<TypeBoolean> node) override;
     virtual void visitTypePointer(std::shared_ptr<TypePointer> node) override;
     virtual void visitTypeInteger(std::shared_ptr<TypeInteger> node) override;
+    virtual void visitTypeVector(std::shared_ptr<TypeVector> node) override;
     virtual void visitValueBoolean(std::shared_ptr<ValueBoolean> node) override;
     virtual void visitValueUnknown(std::shared_ptr<ValueUnknown> node) override;
     virtual void visitValueVariablePointer(std::shared_ptr<ValueVariablePointer> node) override;
@@ -144,10 +148,13 @@ public:
     virtual void visitValueInteger(std::shared_ptr<ValueInteger> node) override;
     virtual void visitRTLLoadConstant(std::shared_ptr<RTLLoadConstant> node) override;
     virtual void visitRTLMove(std::shared_ptr<RTLMove> node) override;
+    virtual void visitRTLSelect(std::shared_ptr<RTLSelect> node) override;
     virtual void visitRTLUnconditionalJump(std::shared_ptr<RTLUnconditionalJump> node) override;
     virtual void visitRTLConditionalJump(std::shared_ptr<RTLConditionalJump> node) override;
     virtual void visitRTLLoad(std::shared_ptr<RTLLoad> node) override;
     virtual void visitRTLStore(std::shared_ptr<RTLStore> node) override;
+    virtual void visitRTLMemoryCopy(std::shared_ptr<RTLMemoryCopy> node) override;
+    virtual void visitRTLMemoryFill(std::shared_ptr<RTLMemoryFill> node) override;
     virtual void visitRTLCompare(std::shared_ptr<RTLCompare> node) override;
     virtual void visitRTLTypeCast(std::shared_ptr<RTLTypeCast> node) override;
     virtual void visitRTLAdd(std::shared_ptr<RTLAdd> node) override;
@@ -0,0 +1,155 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef AGGRESSIVE_DEAD_CODE_H_INCLUDED
+#define AGGRESSIVE_DEAD_CODE_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "ssa/ssa_post_dominators.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "construct_basic_block_graph.h"
+
+/** removes everything that doesn't lead to a side effect, including conditional jumps
+ *
+ * Nodes with side effects, the return value and the parameters are live, and so are the inputs of live nodes,
+ * the control transfers of the blocks that live phi functions come from and the conditional jumps that decide
+ * if a block with live nodes runs. Control transfers that can lead into an infinite loop are always live.
+ * A conditional jump that isn't live is replaced by a jump to its nearest post-dominator with live nodes,
+ * which leaves the blocks in between unreachable.
+ */
+class AggressiveDeadCodeElimination final
+{
+public:
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        SSAPostDominatorTree postDominatorTree(function);
+        SSAControlDependenceGraph controlDependenceGraph(function, postDominatorTree);
+        std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<SSABasicBlock>> nodeBlocks;
+        std::unordered_set<std::shared_ptr<SSANode>> liveNodes;
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> liveBlocks;
+        std::vector<std::shared_ptr<SSANode>> workList;
+        auto markLive = [&](std::shared_ptr<SSANode> node)
+        {
+            if(node != nullptr && std::get<1>(liveNodes.insert(node)))
+                workList.push_back(node);
+        };
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            bool canLoopForever = !postDominatorTree.reachesExit(block);
+            for(std::weak_ptr<SSABasicBlock> destBlock : block->destBlocks)
+            {
+                if(!postDominatorTree.reachesExit(destBlock.lock()))
+                    canLoopForever = true;
+            }
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                nodeBlocks[node] = block;
+                if(node == block->controlTransferInstruction)
+                {
+                    if(canLoopForever)
+                        markLive(node);
+                }
+                else if(node->hasSideEffects())
+                    markLive(node);
+            }
+        }
+        markLive(function->returnValue);
+        for(std::shared_ptr<SSANode> node : function->parameters)
+            markLive(node);
+        while(!workList.empty())
+        {
+            std::shared_ptr<SSANode> node = workList.back();
+            workList.pop_back();
+            for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+                markLive(inputNode);
+            if(std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node))
+            {
+                for(const SSAPhi::PhiInput &input : phi->inputs)
+                    markLive(input.block.lock()->controlTransferInstruction);
+            }
+            auto iter = nodeBlocks.find(node);
+            if(iter == nodeBlocks.end() || !std::get<1>(liveBlocks.insert(std::get<1>(*iter))))
+                continue;
+            for(std::shared_ptr<SSABasicBlock> controllingBlock : controlDependenceGraph.getControllingBlocks(std::get<1>(*iter)))
+                markLive(controllingBlock->controlTransferInstruction);
+        }
+
+        // jump over the blocks that only have dead nodes
+        std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> replacements;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            std::shared_ptr<SSAControlTransfer> controlTransfer = block->controlTransferInstruction;
+            if(controlTransfer == nullptr || liveNodes.count(controlTransfer) != 0 || dynamic_cast<const SSAUnconditionalJump *>(controlTransfer.get()) != nullptr)
+                continue;
+            std::shared_ptr<SSABasicBlock> target = postDominatorTree.getImmediatePostDominator(block);
+            if(target == nullptr) // the branches end the function separately and both only have dead nodes
+                target = block->destBlocks.front().lock();
+            else
+            {
+                while(liveBlocks.count(target) == 0 && postDominatorTree.getImmediatePostDominator(target) != nullptr)
+                    target = postDominatorTree.getImmediatePostDominator(target);
+            }
+            std::shared_ptr<SSANode> jump = std::make_shared<SSAUnconditionalJump>(function->context, target);
+            replacements.emplace(controlTransfer, SSANode::ReplacementNode(jump, false));
+            liveNodes.insert(jump);
+        }
+        function->replaceNodes(replacements);
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> reachableBlocks{function->startBlock};
+        std::vector<std::shared_ptr<SSABasicBlock>> blockWorkList{function->startBlock};
+        while(!blockWorkList.empty())
+        {
+            std::shared_ptr<SSABasicBlock> block = blockWorkList.back();
+            blockWorkList.pop_back();
+            for(std::weak_ptr<SSABasicBlock> destBlockW : block->destBlocks)
+            {
+                std::shared_ptr<SSABasicBlock> destBlock = destBlockW.lock();
+                if(std::get<1>(reachableBlocks.insert(destBlock)))
+                    blockWorkList.push_back(destBlock);
+            }
+        }
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> removedBlocks;
+        for(auto i = function->blocks.begin(); i != function->blocks.end();)
+        {
+            if(reachableBlocks.count(*i) != 0)
+                ++i;
+            else
+            {
+                removedBlocks.insert(*i);
+                i = function->blocks.erase(i);
+            }
+        }
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            block->instructions.erase_if([&](const std::shared_ptr<SSANode> &node)
+            {
+                if(liveNodes.count(node) == 0 && node != block->controlTransferInstruction)
+                    return true;
+                node->removeBlocks(removedBlocks);
+                return false;
+            });
+        }
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+    }
+};
+
+#endif // AGGRESSIVE_DEAD_CODE_H_INCLUDED
@@ -247,16 +247,13 @@ public:
         }
         for(std::shared_ptr<SSABasicBlock> block : function->blocks)
         {
-            for(auto i = block->instructions.begin(); i != block->instructions.end();)
+            block->instructions.erase_if([&](const std::shared_ptr<SSANode> &node)
             {
-                if(usedNodes.count(*i) != 0)
-                {
-                    (*i)->removeBlocks(removedBlocks);
-                    ++i;
-                }
-                else
-                    i = block->instructions.erase(i);
-            }
+                if(usedNodes.count(node) == 0)
+                    return true;
+                node->removeBlocks(removedBlocks);
+                return false;
+            });
         }
         ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
     }
@@ -29,7 +29,7 @@
 #include <cassert>
 
 /** simplify control flow
- * @note this doesn't change phi functions : required for use in ConvertSSAToRTL
+ * @note empty blocks that jump to a block starting with phi functions are kept so the phi inputs' blocks stay valid
  */
 class ControlFlowSimplification final
 {
@@ -52,6 +52,8 @@ public:
                 {
                     if(firstBlock->instructions.size() != 1)
                         continue;
+                    if(dynamic_cast<const SSAPhi *>(secondBlock->instructions.front().get()) != nullptr)
+                        continue;
                     function->replaceBlock(firstBlock, secondBlock);
                     done = false;
                     break;
@@ -0,0 +1,240 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef IF_CONVERSION_H_INCLUDED
+#define IF_CONVERSION_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "construct_basic_block_graph.h"
+
+/** turns small diamonds and triangles into selects
+ *
+ * A conditional jump whose targets are either the join block or an arm block that only jumps to the join block
+ * is replaced by a jump to the join block. The arms' nodes are moved in front of the jump, so they have to be
+ * safe to run when their arm wouldn't have, and the join block's phi inputs from the arms become selects.
+ *
+ * Costs are in hundredths of a cycle. Running both arms and the selects has to be no more expensive than
+ * running the average arm plus the branch and its expected misprediction cost. Conditions computed from loaded
+ * values are assumed to be hard to predict.
+ */
+class IfConversion final
+{
+private:
+    static constexpr std::size_t maxArmNodeCount = 8;
+    static constexpr std::uint64_t nodeCost = 100;
+    static constexpr std::uint64_t selectCost = 200; /// test and cmov, or the widening around them
+    static constexpr std::uint64_t branchCost = 100;
+    static constexpr std::uint64_t mispredictPenalty = 15;
+    static constexpr std::uint64_t predictableMissPercent = 10;
+    static constexpr std::uint64_t unpredictableMissPercent = 25;
+    std::unordered_map<std::shared_ptr<SSANode>, bool> dependsOnLoadMap;
+    static bool canSpeculate(std::shared_ptr<SSANode> node)
+    {
+        if(node->hasSideEffects())
+            return false;
+        return dynamic_cast<const SSAConstant *>(node.get()) != nullptr
+            || dynamic_cast<const SSAMove *>(node.get()) != nullptr
+            || dynamic_cast<const SSASelect *>(node.get()) != nullptr
+            || dynamic_cast<const SSAAdd *>(node.get()) != nullptr
+            || dynamic_cast<const SSATypeCast *>(node.get()) != nullptr
+            || dynamic_cast<const SSACompare *>(node.get()) != nullptr;
+    }
+    static bool canSelect(std::shared_ptr<TypeNode> type)
+    {
+        type = type->toNonConstant()->toNonVolatile();
+        return dynamic_cast<const TypeInteger *>(type.get()) != nullptr
+            || dynamic_cast<const TypeBoolean *>(type.get()) != nullptr
+            || dynamic_cast<const TypePointer *>(type.get()) != nullptr;
+    }
+    bool dependsOnLoad(std::shared_ptr<SSANode> node)
+    {
+        std::vector<std::shared_ptr<SSANode>> workList{node};
+        std::unordered_set<std::shared_ptr<SSANode>> visited{node};
+        bool retval = false;
+        while(!workList.empty() && !retval)
+        {
+            std::shared_ptr<SSANode> currentNode = workList.back();
+            workList.pop_back();
+            auto iter = dependsOnLoadMap.find(currentNode);
+            if(iter != dependsOnLoadMap.end())
+            {
+                retval = std::get<1>(*iter);
+                continue;
+            }
+            if(dynamic_cast<const SSALoad *>(currentNode.get()) != nullptr)
+            {
+                retval = true;
+                continue;
+            }
+            for(std::shared_ptr<SSANode> input : currentNode->getInputs())
+            {
+                if(std::get<1>(visited.insert(input)))
+                    workList.push_back(input);
+            }
+        }
+        dependsOnLoadMap[node] = retval;
+        return retval;
+    }
+    /// @return true if arm is a block that can be moved into head and only jumps to join
+    static bool isArm(std::shared_ptr<SSABasicBlock> arm, std::shared_ptr<SSABasicBlock> head, std::shared_ptr<SSABasicBlock> &join)
+    {
+        if(arm->sourceBlocks.size() != 1 || arm->sourceBlocks.front().lock() != head)
+            return false;
+        if(dynamic_cast<const SSAUnconditionalJump *>(arm->controlTransferInstruction.get()) == nullptr || arm->destBlocks.size() != 1)
+            return false;
+        if(arm->instructions.size() > maxArmNodeCount + 1)
+            return false;
+        for(std::shared_ptr<SSANode> node : arm->instructions)
+        {
+            if(node != arm->controlTransferInstruction && !canSpeculate(node))
+                return false;
+        }
+        join = arm->destBlocks.front().lock();
+        return true;
+    }
+    static std::shared_ptr<SSANode> getPhiInput(std::shared_ptr<SSAPhi> phi, std::shared_ptr<SSABasicBlock> block)
+    {
+        for(const SSAPhi::PhiInput &input : phi->inputs)
+        {
+            if(input.block.lock() == block)
+                return input.node.lock();
+        }
+        return nullptr;
+    }
+    bool convert(std::shared_ptr<SSAFunction> function, std::shared_ptr<SSABasicBlock> head)
+    {
+        std::shared_ptr<SSAConditionalJump> conditionalJump = std::dynamic_pointer_cast<SSAConditionalJump>(head->controlTransferInstruction);
+        if(conditionalJump == nullptr)
+            return false;
+        std::shared_ptr<SSABasicBlock> trueBlock = conditionalJump->destBlocks.front().lock();
+        std::shared_ptr<SSABasicBlock> falseBlock = conditionalJump->destBlocks.back().lock();
+        if(trueBlock == falseBlock || trueBlock == head || falseBlock == head)
+            return false;
+        std::shared_ptr<SSABasicBlock> trueJoin, falseJoin;
+        bool isTrueArm = isArm(trueBlock, head, trueJoin);
+        bool isFalseArm = isArm(falseBlock, head, falseJoin);
+        std::shared_ptr<SSABasicBlock> join;
+        if(isTrueArm && isFalseArm && trueJoin == falseJoin) // diamond
+            join = trueJoin;
+        else if(isTrueArm && trueJoin == falseBlock) // triangle
+        {
+            join = falseBlock;
+            isFalseArm = false;
+        }
+        else if(isFalseArm && falseJoin == trueBlock)
+        {
+            join = trueBlock;
+            isTrueArm = false;
+        }
+        else
+            return false;
+        if(join == head)
+            return false;
+        std::shared_ptr<SSABasicBlock> trueEdgeBlock = isTrueArm ? trueBlock : head;
+        std::shared_ptr<SSABasicBlock> falseEdgeBlock = isFalseArm ? falseBlock : head;
+        std::vector<std::shared_ptr<SSAPhi>> phis;
+        for(std::shared_ptr<SSANode> node : join->instructions)
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+            if(phi == nullptr) // all phis are at the beginning
+                break;
+            phis.push_back(phi);
+        }
+
+        // cost model
+        std::uint64_t armCost = 0;
+        if(isTrueArm)
+            armCost += (trueBlock->instructions.size() - 1) * nodeCost;
+        if(isFalseArm)
+            armCost += (falseBlock->instructions.size() - 1) * nodeCost;
+        std::uint64_t selectCount = 0;
+        for(std::shared_ptr<SSAPhi> phi : phis)
+        {
+            std::shared_ptr<SSANode> trueValue = getPhiInput(phi, trueEdgeBlock), falseValue = getPhiInput(phi, falseEdgeBlock);
+            if(trueValue == nullptr || falseValue == nullptr || !canSelect(phi->type))
+                return false;
+            if(trueValue != falseValue)
+                selectCount++;
+        }
+        std::shared_ptr<SSANode> condition = conditionalJump->condition.lock();
+        std::uint64_t missPercent = dependsOnLoad(condition) ? unpredictableMissPercent : predictableMissPercent;
+        std::uint64_t convertedCost = armCost + selectCount * selectCost;
+        std::uint64_t branchyCost = armCost / 2 + branchCost + mispredictPenalty * missPercent;
+        if(convertedCost > branchyCost)
+            return false;
+
+        // move the arms into the head
+        head->instructions.pop_back();
+        for(std::shared_ptr<SSABasicBlock> arm : {trueBlock, falseBlock})
+        {
+            if(arm == join)
+                continue;
+            for(std::shared_ptr<SSANode> node : arm->instructions)
+            {
+                if(node != arm->controlTransferInstruction)
+                    head->instructions.push_back(node);
+            }
+        }
+        for(std::shared_ptr<SSAPhi> phi : phis)
+        {
+            std::shared_ptr<SSANode> trueValue = getPhiInput(phi, trueEdgeBlock), falseValue = getPhiInput(phi, falseEdgeBlock);
+            std::shared_ptr<SSANode> value = trueValue;
+            if(trueValue != falseValue)
+            {
+                value = std::make_shared<SSASelect>(condition, trueValue, falseValue, phi->spillLocation, phi->type);
+                head->instructions.push_back(value);
+            }
+            phi->inputs.remove_if([&](const SSAPhi::PhiInput &input)
+            {
+                return input.block.lock() == trueEdgeBlock || input.block.lock() == falseEdgeBlock;
+            });
+            phi->inputs.push_back(SSAPhi::PhiInput{value, head});
+        }
+        head->controlTransferInstruction = std::make_shared<SSAUnconditionalJump>(function->context, join);
+        head->instructions.push_back(head->controlTransferInstruction);
+        function->blocks.remove_if([&](std::shared_ptr<SSABasicBlock> block)
+        {
+            return (block == trueBlock && isTrueArm) || (block == falseBlock && isFalseArm);
+        });
+        return true;
+    }
+public:
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                if(convert(function, block))
+                {
+                    ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+                    done = false;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+#endif // IF_CONVERSION_H_INCLUDED
@@ -0,0 +1,419 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef INSTRUCTION_COMBINING_H_INCLUDED
+#define INSTRUCTION_COMBINING_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include "construct_basic_block_graph.h"
+
+/** algebraic simplification of single nodes
+ *
+ * Every node is run through the rule table until a rule changes it. A rule returns nullptr if it doesn't apply,
+ * the node itself if it changed the node in place or the node that replaces it. Replacements are made
+ * by rewriting the users of the old node, which go back on the work list along with the new nodes.
+ */
+class InstructionCombining final
+{
+private:
+    typedef std::shared_ptr<SSANode> (InstructionCombining::*Rule)(std::shared_ptr<SSANode> node);
+    const std::vector<Rule> rules =
+    {
+        &InstructionCombining::forwardMove,
+        &InstructionCombining::foldConstants,
+        &InstructionCombining::addZero,
+        &InstructionCombining::moveConstantToRight,
+        &InstructionCombining::combineAddedConstants,
+        &InstructionCombining::removeNoOpCast,
+        &InstructionCombining::combineCasts,
+        &InstructionCombining::compareWithSelf,
+        &InstructionCombining::compareWithBoolean,
+        &InstructionCombining::simplifySelect,
+        &InstructionCombining::selectToCast,
+        &InstructionCombining::selectToAdd,
+    };
+    std::shared_ptr<SSAFunction> function;
+    std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<SSABasicBlock>> nodeBlocks;
+    std::unordered_map<std::shared_ptr<SSANode>, std::vector<std::shared_ptr<SSANode>>> nodeUsers;
+    std::unordered_set<std::shared_ptr<SSANode>> removedNodes;
+    std::vector<std::shared_ptr<SSANode>> workList;
+    std::unordered_set<std::shared_ptr<SSANode>> workListSet;
+    std::shared_ptr<SSANode> currentNode;
+    void addToWorkList(std::shared_ptr<SSANode> node)
+    {
+        if(std::get<1>(workListSet.insert(node)))
+            workList.push_back(node);
+    }
+    /// puts newNode in front of the node that the rules are running on
+    std::shared_ptr<SSANode> insertNode(std::shared_ptr<SSANode> newNode)
+    {
+        std::shared_ptr<SSABasicBlock> block = nodeBlocks.at(currentNode);
+        block->instructions.insert(std::find(block->instructions.begin(), block->instructions.end(), currentNode), newNode);
+        nodeBlocks[newNode] = block;
+        for(std::shared_ptr<SSANode> input : newNode->getInputs())
+            nodeUsers[input].push_back(newNode);
+        addToWorkList(newNode);
+        return newNode;
+    }
+    std::shared_ptr<SSANode> makeConstant(std::shared_ptr<ValueNode> value)
+    {
+        return insertNode(std::make_shared<SSAConstant>(value, nullptr));
+    }
+    void replaceNode(std::shared_ptr<SSANode> node, std::shared_ptr<SSANode> replacement)
+    {
+        std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> replacements;
+        replacements.emplace(node, SSANode::ReplacementNode(replacement, true));
+        std::vector<std::shared_ptr<SSANode>> users;
+        users.swap(nodeUsers[node]);
+        std::vector<std::shared_ptr<SSANode>> &replacementUsers = nodeUsers[replacement];
+        for(std::shared_ptr<SSANode> user : users)
+        {
+            if(removedNodes.count(user) != 0)
+                continue;
+            user->replaceNodes(replacements);
+            replacementUsers.push_back(user);
+            addToWorkList(user);
+        }
+        if(function->returnValue == node)
+            function->returnValue = replacement;
+        removedNodes.insert(node);
+    }
+    /// so that rewriting the user doesn't keep both the node and its inputs alive
+    bool hasOneUser(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSANode> user;
+        for(std::shared_ptr<SSANode> currentUser : nodeUsers[node])
+        {
+            if(removedNodes.count(currentUser) != 0 || currentUser == user)
+                continue;
+            if(user != nullptr)
+                return false;
+            user = currentUser;
+        }
+        return node != function->returnValue;
+    }
+    static std::shared_ptr<ValueNode> getConstant(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSAConstant> constant = std::dynamic_pointer_cast<SSAConstant>(node);
+        if(constant == nullptr)
+            return nullptr;
+        return constant->value;
+    }
+    static bool isZero(std::shared_ptr<ValueNode> value)
+    {
+        std::shared_ptr<ValueInteger> valueInteger = std::dynamic_pointer_cast<ValueInteger>(value);
+        return valueInteger != nullptr && valueInteger->getSignedValue() == 0;
+    }
+    static bool isSameType(std::shared_ptr<TypeNode> a, std::shared_ptr<TypeNode> b)
+    {
+        return a->toNonConstant() == b->toNonConstant();
+    }
+    /// @return the integer or pointer type without qualifiers or nullptr
+    static std::shared_ptr<TypeNode> getScalarType(std::shared_ptr<TypeNode> type)
+    {
+        if(type->isVolatile)
+            return nullptr;
+        type = type->toNonConstant();
+        if(dynamic_cast<const TypeInteger *>(type.get()) == nullptr && dynamic_cast<const TypePointer *>(type.get()) == nullptr)
+            return nullptr;
+        return type;
+    }
+    static bool isInteger(std::shared_ptr<TypeNode> type)
+    {
+        return dynamic_cast<const TypeInteger *>(type->toNonConstant()->toNonVolatile().get()) != nullptr;
+    }
+    static bool isBoolean(std::shared_ptr<TypeNode> type)
+    {
+        return dynamic_cast<const TypeBoolean *>(type->toNonConstant()->toNonVolatile().get()) != nullptr;
+    }
+    static bool isIntegerConstant(std::shared_ptr<SSANode> node, std::int64_t value)
+    {
+        std::shared_ptr<ValueInteger> valueInteger = std::dynamic_pointer_cast<ValueInteger>(getConstant(node));
+        return valueInteger != nullptr && valueInteger->getSignedValue() == value;
+    }
+    /// @return the node that is true when condition is false
+    std::shared_ptr<SSANode> makeNot(std::shared_ptr<SSANode> condition)
+    {
+        return insertNode(std::make_shared<SSACompare>(condition, SSACompare::CompareOperator::E, makeConstant(std::make_shared<ValueBoolean>(condition->context, false)), nullptr));
+    }
+
+    /// move(x) -> x
+    std::shared_ptr<SSANode> forwardMove(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSAMove> move = std::dynamic_pointer_cast<SSAMove>(node);
+        if(move == nullptr || !isSameType(move->type, move->source.lock()->type))
+            return nullptr;
+        return move->source.lock();
+    }
+    /// an addition, type cast or comparison of constants -> the result
+    std::shared_ptr<SSANode> foldConstants(std::shared_ptr<SSANode> node)
+    {
+        if(dynamic_cast<const SSAAdd *>(node.get()) == nullptr && dynamic_cast<const SSATypeCast *>(node.get()) == nullptr && dynamic_cast<const SSACompare *>(node.get()) == nullptr)
+            return nullptr;
+        std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<ValueNode>> values;
+        for(std::shared_ptr<SSANode> input : node->getInputs())
+        {
+            std::shared_ptr<ValueNode> value = getConstant(input);
+            if(value == nullptr)
+                return nullptr;
+            values[input] = value;
+        }
+        std::shared_ptr<ValueNode> value = node->evaluateForConstants(values);
+        if(value == nullptr || dynamic_cast<const ValueUnknown *>(value.get()) != nullptr || !isSameType(value->type, node->type))
+            return nullptr;
+        return makeConstant(value);
+    }
+    /// x + 0 -> x
+    std::shared_ptr<SSANode> addZero(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSAAdd> add = std::dynamic_pointer_cast<SSAAdd>(node);
+        if(add == nullptr)
+            return nullptr;
+        if(isZero(getConstant(add->rhs.lock())) && isSameType(add->lhs.lock()->type, add->type))
+            return add->lhs.lock();
+        if(isZero(getConstant(add->lhs.lock())) && isSameType(add->rhs.lock()->type, add->type))
+            return add->rhs.lock();
+        return nullptr;
+    }
+    /// c + x -> x + c and c < x -> x > c
+    std::shared_ptr<SSANode> moveConstantToRight(std::shared_ptr<SSANode> node)
+    {
+        if(std::shared_ptr<SSAAdd> add = std::dynamic_pointer_cast<SSAAdd>(node))
+        {
+            if(!isInteger(add->type) || getConstant(add->lhs.lock()) == nullptr || getConstant(add->rhs.lock()) != nullptr)
+                return nullptr;
+            std::swap(add->lhs, add->rhs);
+            return add;
+        }
+        if(std::shared_ptr<SSACompare> compare = std::dynamic_pointer_cast<SSACompare>(node))
+        {
+            if(getConstant(compare->lhs.lock()) == nullptr || getConstant(compare->rhs.lock()) != nullptr)
+                return nullptr;
+            std::swap(compare->lhs, compare->rhs);
+            compare->compareOperator = SSACompare::swapOperands(compare->compareOperator);
+            return compare;
+        }
+        return nullptr;
+    }
+    /// (x + c1) + c2 -> x + (c1 + c2) if x + c1 isn't used anywhere else
+    std::shared_ptr<SSANode> combineAddedConstants(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSAAdd> add = std::dynamic_pointer_cast<SSAAdd>(node);
+        if(add == nullptr)
+            return nullptr;
+        std::shared_ptr<SSAAdd> innerAdd = std::dynamic_pointer_cast<SSAAdd>(add->lhs.lock());
+        std::shared_ptr<ValueInteger> outerConstant = std::dynamic_pointer_cast<ValueInteger>(getConstant(add->rhs.lock()));
+        if(innerAdd == nullptr || outerConstant == nullptr || !isSameType(innerAdd->type, add->type) || !hasOneUser(innerAdd))
+            return nullptr;
+        std::shared_ptr<ValueInteger> innerConstant = std::dynamic_pointer_cast<ValueInteger>(getConstant(innerAdd->rhs.lock()));
+        if(innerConstant == nullptr || !isSameType(innerConstant->type, outerConstant->type))
+            return nullptr;
+        std::shared_ptr<SSANode> sum = makeConstant(innerConstant->add(outerConstant));
+        return insertNode(std::make_shared<SSAAdd>(innerAdd->lhs.lock(), sum, nullptr, add->type));
+    }
+    /// cast(typeof(x), x) -> x
+    std::shared_ptr<SSANode> removeNoOpCast(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node);
+        if(typeCast == nullptr || !isSameType(typeCast->type, typeCast->arg.lock()->type))
+            return nullptr;
+        return typeCast->arg.lock();
+    }
+    /** cast(T, cast(U, x)) -> cast(T, x) if U is an integer at least as big as T
+     *
+     * The low bits of U are the same as the low bits of x, extended the same way as casting x to T would.
+     */
+    std::shared_ptr<SSANode> combineCasts(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node);
+        if(typeCast == nullptr)
+            return nullptr;
+        std::shared_ptr<SSATypeCast> innerTypeCast = std::dynamic_pointer_cast<SSATypeCast>(typeCast->arg.lock());
+        if(innerTypeCast == nullptr)
+            return nullptr;
+        std::shared_ptr<SSANode> arg = innerTypeCast->arg.lock();
+        std::shared_ptr<TypeNode> type = getScalarType(typeCast->type), innerType = getScalarType(innerTypeCast->type), argType = getScalarType(arg->type);
+        if(type == nullptr || innerType == nullptr || argType == nullptr || !isInteger(innerType))
+            return nullptr;
+        if(innerType->getTypeProperties().size < type->getTypeProperties().size)
+            return nullptr;
+        if(isSameType(arg->type, typeCast->type))
+            return arg;
+        return insertNode(std::make_shared<SSATypeCast>(arg, typeCast->type, nullptr));
+    }
+    /// x == x -> true and x < x -> false
+    std::shared_ptr<SSANode> compareWithSelf(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSACompare> compare = std::dynamic_pointer_cast<SSACompare>(node);
+        if(compare == nullptr || compare->lhs.lock() != compare->rhs.lock())
+            return nullptr;
+        bool result = compare->compareOperator == SSACompare::CompareOperator::E
+                   || compare->compareOperator == SSACompare::CompareOperator::LE
+                   || compare->compareOperator == SSACompare::CompareOperator::GE;
+        return makeConstant(std::make_shared<ValueBoolean>(compare->context, result));
+    }
+    /// b == true -> b and (x < y) == false -> x >= y
+    std::shared_ptr<SSANode> compareWithBoolean(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSACompare> compare = std::dynamic_pointer_cast<SSACompare>(node);
+        if(compare == nullptr)
+            return nullptr;
+        std::shared_ptr<ValueBoolean> value = std::dynamic_pointer_cast<ValueBoolean>(getConstant(compare->rhs.lock()));
+        if(value == nullptr || (compare->compareOperator != SSACompare::CompareOperator::E && compare->compareOperator != SSACompare::CompareOperator::NE))
+            return nullptr;
+        std::shared_ptr<SSANode> lhs = compare->lhs.lock();
+        if(!isSameType(lhs->type, compare->type))
+            return nullptr;
+        if(value->value == (compare->compareOperator == SSACompare::CompareOperator::E))
+            return lhs;
+        std::shared_ptr<SSACompare> innerCompare = std::dynamic_pointer_cast<SSACompare>(lhs);
+        if(innerCompare == nullptr)
+            return nullptr;
+        return insertNode(std::make_shared<SSACompare>(innerCompare->lhs.lock(), SSACompare::invert(innerCompare->compareOperator), innerCompare->rhs.lock(), nullptr));
+    }
+    /// select(true, a, b) -> a, select(c, x, x) -> x and select(c, true, false) -> c
+    std::shared_ptr<SSANode> simplifySelect(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSASelect> select = std::dynamic_pointer_cast<SSASelect>(node);
+        if(select == nullptr)
+            return nullptr;
+        std::shared_ptr<SSANode> condition = select->condition.lock(), trueValue = select->trueValue.lock(), falseValue = select->falseValue.lock();
+        if(std::shared_ptr<ValueBoolean> value = std::dynamic_pointer_cast<ValueBoolean>(getConstant(condition)))
+            return value->value ? trueValue : falseValue;
+        if(trueValue == falseValue)
+            return trueValue;
+        if(!isBoolean(select->type))
+            return nullptr;
+        std::shared_ptr<ValueBoolean> trueConstant = std::dynamic_pointer_cast<ValueBoolean>(getConstant(trueValue));
+        std::shared_ptr<ValueBoolean> falseConstant = std::dynamic_pointer_cast<ValueBoolean>(getConstant(falseValue));
+        if(trueConstant == nullptr || falseConstant == nullptr || trueConstant->value == falseConstant->value || !isSameType(condition->type, select->type))
+            return nullptr;
+        if(trueConstant->value)
+            return condition;
+        return makeNot(condition);
+    }
+    /// select(c, 1, 0) -> cast(T, c) and select(c, 0, 1) -> cast(T, c == false), which become setcc
+    std::shared_ptr<SSANode> selectToCast(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSASelect> select = std::dynamic_pointer_cast<SSASelect>(node);
+        if(select == nullptr || !isInteger(select->type))
+            return nullptr;
+        std::shared_ptr<SSANode> condition = select->condition.lock();
+        if(isIntegerConstant(select->trueValue.lock(), 1) && isIntegerConstant(select->falseValue.lock(), 0))
+            return insertNode(std::make_shared<SSATypeCast>(condition, select->type, nullptr));
+        if(isIntegerConstant(select->trueValue.lock(), 0) && isIntegerConstant(select->falseValue.lock(), 1))
+            return insertNode(std::make_shared<SSATypeCast>(makeNot(condition), select->type, nullptr));
+        return nullptr;
+    }
+    /** @return the node that adds 1 to x in value or nullptr
+     *
+     * value can also be cast(T, cast(U, x) + 1) with x of integer type T and U at least as big as T,
+     * which is how integer promotion adds 1.
+     */
+    static std::shared_ptr<SSAAdd> getIncrement(std::shared_ptr<SSANode> value, std::shared_ptr<SSANode> x)
+    {
+        std::shared_ptr<SSATypeCast> outerCast = std::dynamic_pointer_cast<SSATypeCast>(value);
+        if(outerCast != nullptr)
+            value = outerCast->arg.lock();
+        std::shared_ptr<SSAAdd> add = std::dynamic_pointer_cast<SSAAdd>(value);
+        if(add == nullptr || !isInteger(add->type) || !isIntegerConstant(add->rhs.lock(), 1))
+            return nullptr;
+        if(outerCast == nullptr)
+            return add->lhs.lock() == x ? add : nullptr;
+        std::shared_ptr<SSATypeCast> innerCast = std::dynamic_pointer_cast<SSATypeCast>(add->lhs.lock());
+        if(innerCast == nullptr || innerCast->arg.lock() != x || !isInteger(x->type) || !isSameType(outerCast->type, x->type))
+            return nullptr;
+        if(add->type->getTypeProperties().size < x->type->getTypeProperties().size)
+            return nullptr;
+        return add;
+    }
+    /// select(c, x + 1, x) -> x + cast(T, c) and select(c, x, x + 1) -> x + cast(T, c == false)
+    std::shared_ptr<SSANode> selectToAdd(std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSASelect> select = std::dynamic_pointer_cast<SSASelect>(node);
+        if(select == nullptr || !isInteger(select->type))
+            return nullptr;
+        std::shared_ptr<SSANode> condition = select->condition.lock(), trueValue = select->trueValue.lock(), falseValue = select->falseValue.lock();
+        std::shared_ptr<SSAAdd> add = getIncrement(trueValue, falseValue);
+        if(add == nullptr)
+        {
+            add = getIncrement(falseValue, trueValue);
+            if(add == nullptr)
+                return nullptr;
+            condition = makeNot(condition);
+        }
+        std::shared_ptr<SSANode> increment = insertNode(std::make_shared<SSATypeCast>(condition, add->type, nullptr));
+        std::shared_ptr<SSANode> sum = insertNode(std::make_shared<SSAAdd>(add->lhs.lock(), increment, nullptr, add->type));
+        if(isSameType(sum->type, select->type))
+            return sum;
+        return insertNode(std::make_shared<SSATypeCast>(sum, select->type, nullptr));
+    }
+public:
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        this->function = function;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                nodeBlocks[node] = block;
+                for(std::shared_ptr<SSANode> input : node->getInputs())
+                    nodeUsers[input].push_back(node);
+                addToWorkList(node);
+            }
+        }
+        std::reverse(workList.begin(), workList.end()); // start with the first node
+        while(!workList.empty())
+        {
+            currentNode = workList.back();
+            workList.pop_back();
+            workListSet.erase(currentNode);
+            if(removedNodes.count(currentNode) != 0 || dynamic_cast<const SSAPhi *>(currentNode.get()) != nullptr)
+                continue;
+            for(Rule rule : rules)
+            {
+                std::shared_ptr<SSANode> result = (this->*rule)(currentNode);
+                if(result == nullptr)
+                    continue;
+                if(result == currentNode)
+                {
+                    addToWorkList(currentNode);
+                    for(std::shared_ptr<SSANode> user : nodeUsers[currentNode])
+                        addToWorkList(user);
+                }
+                else
+                    replaceNode(currentNode, result);
+                break;
+            }
+        }
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            block->instructions.erase_if([&](const std::shared_ptr<SSANode> &node)
+            {
+                return removedNodes.count(node) != 0;
+            });
+        }
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+    }
+};
+
+#endif // INSTRUCTION_COMBINING_H_INCLUDED
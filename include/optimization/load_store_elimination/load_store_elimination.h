@@ -0,0 +1,172 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef LOAD_STORE_ELIMINATION_H_INCLUDED
+#define LOAD_STORE_ELIMINATION_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "ssa/ssa_alias_analysis.h"
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include "construct_basic_block_graph.h"
+
+/** removes the loads and stores that MemoryToRegister can't promote
+ *
+ * Blocks are visited down the dominator tree and a block with a single predecessor starts with what was
+ * known at the end of it. A load of the bytes that were just stored or loaded is replaced by that value,
+ * a store of the value that memory already has is removed, and a store that a later store in the same block
+ * overwrites before anything can read it is removed. Volatile accesses are never removed or forwarded.
+ */
+class LoadStoreElimination final
+{
+private:
+    typedef SSAAliasAnalysis::MemoryLocation MemoryLocation;
+    typedef SSAAliasAnalysis::AliasResult AliasResult;
+    struct AvailableValue final
+    {
+        MemoryLocation location;
+        std::shared_ptr<SSANode> value;
+    };
+    typedef std::vector<AvailableValue> AvailableValueList;
+    static void runBlock(std::shared_ptr<SSABasicBlock> block,
+                         AvailableValueList &availableValues,
+                         SSAAliasAnalysis &aliasAnalysis,
+                         std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> &replacements)
+    {
+        std::vector<std::pair<MemoryLocation, std::shared_ptr<SSANode>>> unreadStores;
+        auto write = [&](const MemoryLocation &location)
+        {
+            availableValues.erase(std::remove_if(availableValues.begin(), availableValues.end(), [&](const AvailableValue &availableValue)
+            {
+                return aliasAnalysis.alias(availableValue.location, location) != AliasResult::NoAlias;
+            }), availableValues.end());
+        };
+        auto read = [&](const MemoryLocation &location)
+        {
+            unreadStores.erase(std::remove_if(unreadStores.begin(), unreadStores.end(), [&](const std::pair<MemoryLocation, std::shared_ptr<SSANode>> &unreadStore)
+            {
+                return aliasAnalysis.alias(std::get<0>(unreadStore), location) != AliasResult::NoAlias;
+            }), unreadStores.end());
+        };
+        auto findAvailableValue = [&](const MemoryLocation &location) -> std::shared_ptr<SSANode>
+        {
+            for(const AvailableValue &availableValue : availableValues)
+            {
+                if(aliasAnalysis.alias(availableValue.location, location) == AliasResult::MustAlias)
+                    return availableValue.value;
+            }
+            return nullptr;
+        };
+        for(std::shared_ptr<SSANode> node : block->instructions)
+        {
+            if(std::shared_ptr<SSALoad> load = std::dynamic_pointer_cast<SSALoad>(node))
+            {
+                std::shared_ptr<SSANode> address = load->address.lock();
+                MemoryLocation location = aliasAnalysis.getLocation(address, load->type->getTypeProperties().size);
+                if(load->type->isVolatile || address->type->dereference()->isVolatile)
+                {
+                    read(location);
+                    continue;
+                }
+                std::shared_ptr<SSANode> value = findAvailableValue(location);
+                if(value != nullptr && value->type->toNonConstant() == load->type->toNonConstant())
+                {
+                    replacements.emplace(load, SSANode::ReplacementNode(value, true));
+                    continue;
+                }
+                read(location);
+                availableValues.push_back(AvailableValue{location, load});
+            }
+            else if(std::shared_ptr<SSAStore> store = std::dynamic_pointer_cast<SSAStore>(node))
+            {
+                std::shared_ptr<SSANode> address = store->address.lock();
+                MemoryLocation location = aliasAnalysis.getLocation(address, address->type->dereference()->getTypeProperties().size);
+                std::shared_ptr<SSANode> value = SSANode::replaceNode(replacements, store->value.lock());
+                if(address->type->dereference()->isVolatile)
+                {
+                    read(location);
+                    write(location);
+                    continue;
+                }
+                if(findAvailableValue(location) == value)
+                {
+                    replacements.emplace(store, SSANode::ReplacementNode(nullptr, true));
+                    continue;
+                }
+                for(auto i = unreadStores.begin(); i != unreadStores.end(); ++i)
+                {
+                    if(aliasAnalysis.alias(std::get<0>(*i), location) == AliasResult::MustAlias)
+                    {
+                        replacements.emplace(std::get<1>(*i), SSANode::ReplacementNode(nullptr, true));
+                        unreadStores.erase(i);
+                        break;
+                    }
+                }
+                write(location);
+                availableValues.push_back(AvailableValue{location, value});
+                unreadStores.emplace_back(location, store);
+            }
+            else if(std::shared_ptr<SSAMemoryCopy> memoryCopy = std::dynamic_pointer_cast<SSAMemoryCopy>(node))
+            {
+                std::shared_ptr<SSANode> destAddress = memoryCopy->destAddress.lock();
+                std::uint64_t size = memoryCopy->count * destAddress->type->dereference()->getTypeProperties().size;
+                read(aliasAnalysis.getLocation(memoryCopy->sourceAddress.lock(), size));
+                write(aliasAnalysis.getLocation(destAddress, size));
+            }
+            else if(std::shared_ptr<SSAMemoryFill> memoryFill = std::dynamic_pointer_cast<SSAMemoryFill>(node))
+            {
+                std::shared_ptr<SSANode> destAddress = memoryFill->destAddress.lock();
+                write(aliasAnalysis.getLocation(destAddress, memoryFill->count * destAddress->type->dereference()->getTypeProperties().size));
+            }
+            else if(node->hasSideEffects() && node != block->controlTransferInstruction && dynamic_cast<const SSAAllocA *>(node.get()) == nullptr)
+            {
+                availableValues.clear();
+                unreadStores.clear();
+            }
+        }
+    }
+public:
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        SSAAliasAnalysis aliasAnalysis(function);
+        std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> replacements;
+        std::unordered_map<std::shared_ptr<SSABasicBlock>, AvailableValueList> blockAvailableValues;
+        std::vector<std::shared_ptr<SSABasicBlock>> workList{function->startBlock};
+        while(!workList.empty())
+        {
+            std::shared_ptr<SSABasicBlock> block = workList.back();
+            workList.pop_back();
+            AvailableValueList &availableValues = blockAvailableValues[block];
+            if(block->sourceBlocks.size() == 1)
+                availableValues = blockAvailableValues[block->sourceBlocks.front().lock()];
+            runBlock(block, availableValues, aliasAnalysis, replacements);
+            for(std::weak_ptr<SSABasicBlock> dominatedBlockW : block->dominatedBlocks)
+            {
+                std::shared_ptr<SSABasicBlock> dominatedBlock = dominatedBlockW.lock();
+                if(dominatedBlock->immediateDominator.lock() == block && dominatedBlock != block)
+                    workList.push_back(dominatedBlock);
+            }
+        }
+        if(!replacements.empty())
+            function->replaceNodes(replacements);
+    }
+};
+
+#endif // LOAD_STORE_ELIMINATION_H_INCLUDED
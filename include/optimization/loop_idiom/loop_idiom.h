@@ -0,0 +1,236 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef LOOP_IDIOM_H_INCLUDED
+#define LOOP_IDIOM_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "ssa/ssa_loop.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "construct_basic_block_graph.h"
+#include <cassert>
+
+/** replace innermost loops with a constant trip count that copy or fill memory by SSAMemoryCopy and SSAMemoryFill
+ *
+ * The loop must still have its exit test in the header, so this runs before LoopRotation.
+ * Every header phi function has to be an induction variable with a constant step and the body has to be straight-line code
+ * that only stores an element loaded through one pointer induction variable, or a value that doesn't change in the loop,
+ * through another pointer induction variable. Both pointers have to step by one element.
+ * The new node goes at the end of the preheader, which then jumps to the exit, and the header phi functions
+ * are replaced by their values after the last iteration.
+ */
+class LoopIdiomRecognition final
+{
+private:
+    const std::size_t maxTripCount = 1 << 20;
+    /// @return the type that phi points to if it can be copied or filled a whole element at a time
+    static std::shared_ptr<TypeNode> getElementType(std::shared_ptr<SSAPhi> phi)
+    {
+        if(dynamic_cast<const TypePointer *>(phi->type->toNonConstant()->toNonVolatile().get()) == nullptr)
+            return nullptr;
+        std::shared_ptr<TypeNode> elementType = phi->type->dereference();
+        if(elementType->isVolatile)
+            return nullptr;
+        std::shared_ptr<TypeNode> nonConstantElementType = elementType->toNonConstant();
+        if(dynamic_cast<const TypeInteger *>(nonConstantElementType.get()) == nullptr && dynamic_cast<const TypePointer *>(nonConstantElementType.get()) == nullptr)
+            return nullptr;
+        if(elementType->getTypeProperties().size > phi->type->getTypeProperties().size) // rep stos can't store more than a register
+            return nullptr;
+        return elementType;
+    }
+    bool recognizeLoop(std::shared_ptr<SSAFunction> function, const SSALoop &loop)
+    {
+        if(loop.exitingBlock != loop.header)
+            return false;
+        std::shared_ptr<SSABasicBlock> preheader = loop.getPreheader();
+        if(preheader == nullptr || std::dynamic_pointer_cast<SSAUnconditionalJump>(preheader->controlTransferInstruction) == nullptr)
+            return false;
+        std::unordered_set<std::shared_ptr<SSANode>> loopNodes;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            if(block != loop.header && std::dynamic_pointer_cast<SSAUnconditionalJump>(block->controlTransferInstruction) == nullptr)
+                return false; // the body has to be straight-line code
+            loopNodes.insert(block->instructions.begin(), block->instructions.end());
+        }
+        SSALoop::ValueMap values = loop.getConstantValues(function);
+        SSALoop::InductionVariableMap inductionVariables;
+        if(!loop.getInductionVariables(values, preheader, inductionVariables))
+            return false;
+        std::unordered_set<std::shared_ptr<SSANode>> stepNodes;
+        for(const auto &v : inductionVariables)
+            stepNodes.insert(std::get<1>(v).stepNode);
+
+        // the only nodes with side effects can be one load and one store
+        std::shared_ptr<SSALoad> load;
+        std::shared_ptr<SSAStore> store;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                if(node == block->controlTransferInstruction || values.count(node) != 0 || stepNodes.count(node) != 0)
+                    continue;
+                if(dynamic_cast<const SSAPhi *>(node.get()) != nullptr)
+                {
+                    if(block == loop.header)
+                        continue;
+                    return false;
+                }
+                if(block == loop.header)
+                {
+                    if(dynamic_cast<const SSACompare *>(node.get()) != nullptr)
+                        continue;
+                    return false;
+                }
+                if(load == nullptr && std::dynamic_pointer_cast<SSALoad>(node) != nullptr)
+                    load = std::static_pointer_cast<SSALoad>(node);
+                else if(store == nullptr && std::dynamic_pointer_cast<SSAStore>(node) != nullptr)
+                    store = std::static_pointer_cast<SSAStore>(node);
+                else
+                    return false;
+            }
+        }
+        if(store == nullptr)
+            return false;
+        auto getAccessedPhi = [&](std::shared_ptr<SSANode> address) -> std::shared_ptr<SSAPhi>
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(address);
+            if(phi == nullptr || inductionVariables.count(phi) == 0 || inductionVariables.at(phi).step->getSignedValue() != 1)
+                return nullptr;
+            if(getElementType(phi) == nullptr)
+                return nullptr;
+            return phi;
+        };
+        std::shared_ptr<SSAPhi> storedPhi = getAccessedPhi(store->address.lock());
+        if(storedPhi == nullptr)
+            return false;
+        std::shared_ptr<SSAPhi> loadedPhi;
+        std::shared_ptr<SSANode> value = store->value.lock();
+        if(load != nullptr)
+        {
+            loadedPhi = getAccessedPhi(load->address.lock());
+            if(loadedPhi == nullptr || loadedPhi == storedPhi || value != load)
+                return false;
+            if(getElementType(loadedPhi)->getTypeProperties().size != getElementType(storedPhi)->getTypeProperties().size)
+                return false;
+        }
+        else if(loopNodes.count(value) != 0 && values.count(value) == 0)
+            return false;
+        std::size_t tripCount = loop.getTripCount(function, maxTripCount);
+        if(tripCount < 3)
+            return false;
+        std::uint64_t count = tripCount - 1; // the header runs once more than the body
+
+        // the loop can only be removed if nothing after it uses its values other than the header phi functions
+        std::unordered_set<std::shared_ptr<SSAPhi>> usedPhis;
+        auto checkUse = [&](std::shared_ptr<SSANode> node) -> bool
+        {
+            if(loopNodes.count(node) == 0)
+                return true;
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+            if(phi == nullptr || inductionVariables.count(phi) == 0)
+                return false;
+            usedPhis.insert(phi);
+            return true;
+        };
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            if(loop.blockSet.count(block) != 0)
+                continue;
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                for(std::shared_ptr<SSANode> input : node->getInputs())
+                {
+                    if(!checkUse(input))
+                        return false;
+                }
+            }
+        }
+        if(function->returnValue != nullptr && !checkUse(function->returnValue))
+            return false;
+
+        // build the memory operation and the exit values at the end of the preheader
+        CompilerContext *context = function->context;
+        std::uint64_t elementSize = getElementType(storedPhi)->getTypeProperties().size;
+        std::shared_ptr<SSANode> storedAddress = inductionVariables.at(storedPhi).initialValue;
+        preheader->instructions.pop_back();
+        if(loadedPhi != nullptr)
+        {
+            std::shared_ptr<SSANode> loadedAddress = inductionVariables.at(loadedPhi).initialValue;
+            bool mayOverlap = true;
+            std::uint64_t storedStart, loadedStart;
+            if(SSALoop::getConstantAddress(values, storedAddress, storedStart) && SSALoop::getConstantAddress(values, loadedAddress, loadedStart))
+                mayOverlap = storedStart + count * elementSize > loadedStart && loadedStart + count * elementSize > storedStart;
+            preheader->instructions.push_back(std::make_shared<SSAMemoryCopy>(storedAddress, loadedAddress, count, mayOverlap));
+        }
+        else
+        {
+            if(loopNodes.count(value) != 0)
+            {
+                value = std::make_shared<SSAConstant>(values.at(value), nullptr);
+                preheader->instructions.push_back(value);
+            }
+            preheader->instructions.push_back(std::make_shared<SSAMemoryFill>(storedAddress, value, count));
+        }
+        std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> replacements;
+        for(std::shared_ptr<SSAPhi> phi : usedPhis)
+        {
+            const SSALoop::InductionVariable &inductionVariable = inductionVariables.at(phi);
+            std::shared_ptr<SSANode> offset = std::make_shared<SSAConstant>(std::make_shared<ValueInteger>(context, inductionVariable.step->isUnsigned, inductionVariable.step->width, static_cast<std::uint64_t>(inductionVariable.step->getSignedValue() * static_cast<std::int64_t>(count))), nullptr);
+            std::shared_ptr<SSANode> exitValue = std::make_shared<SSAAdd>(inductionVariable.initialValue, offset, nullptr, phi->type);
+            preheader->instructions.push_back(offset);
+            preheader->instructions.push_back(exitValue);
+            replacements.emplace(phi, SSANode::ReplacementNode(exitValue, true));
+        }
+        preheader->instructions.push_back(preheader->controlTransferInstruction);
+        preheader->controlTransferInstruction->replaceBlock(loop.header, loop.exitBlock);
+        loop.exitBlock->replaceBlock(loop.header, preheader);
+        function->blocks.remove_if([&](std::shared_ptr<SSABasicBlock> block)
+        {
+            return loop.blockSet.count(block) != 0;
+        });
+        function->replaceNodes(replacements);
+        return true;
+    }
+public:
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> visitedHeaders;
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                SSALoop loop;
+                if(!std::get<1>(visitedHeaders.insert(block)) || !SSALoop::find(block, loop))
+                    continue;
+                if(recognizeLoop(function, loop))
+                {
+                    ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+                    done = false;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+#endif // LOOP_IDIOM_H_INCLUDED
@@ -0,0 +1,237 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef LOOP_ROTATION_H_INCLUDED
+#define LOOP_ROTATION_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "ssa/ssa_duplicate.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "construct_basic_block_graph.h"
+#include <cassert>
+
+/** rotate loops so they test their exit condition at the bottom
+ *
+ * A loop whose header ends in a conditional jump to the body or the exit and that has one preheader and one latch
+ * gets a copy of the header's instructions in the preheader as a guard. The preheader then jumps straight to the body
+ * or the exit, and the original header is only entered from the latch so it becomes the loop's bottom test.
+ * Values defined in the header get phi functions in the body and the exit that merge the guard's copy with the original.
+ */
+class LoopRotation final
+{
+private:
+    const std::size_t maxDuplicatedInstructions = 16;
+    static bool dominates(std::shared_ptr<SSABasicBlock> dominator, std::shared_ptr<SSABasicBlock> block)
+    {
+        for(; block != nullptr; block = block->immediateDominator.lock())
+        {
+            if(block == dominator)
+                return true;
+        }
+        return false;
+    }
+    bool rotateLoop(std::shared_ptr<SSAFunction> function, std::shared_ptr<SSABasicBlock> header)
+    {
+        std::shared_ptr<SSAConditionalJump> conditionalJump = std::dynamic_pointer_cast<SSAConditionalJump>(header->controlTransferInstruction);
+        if(conditionalJump == nullptr || header->sourceBlocks.size() != 2)
+            return false;
+        std::shared_ptr<SSABasicBlock> preheader, latch;
+        for(std::weak_ptr<SSABasicBlock> sourceBlockW : header->sourceBlocks)
+        {
+            std::shared_ptr<SSABasicBlock> sourceBlock = sourceBlockW.lock();
+            if(dominates(header, sourceBlock))
+                latch = sourceBlock;
+            else
+                preheader = sourceBlock;
+        }
+        if(latch == nullptr || preheader == nullptr || latch == header)
+            return false;
+        if(preheader->destBlocks.size() != 1 || std::dynamic_pointer_cast<SSAUnconditionalJump>(latch->controlTransferInstruction) == nullptr)
+            return false;
+        std::shared_ptr<SSABasicBlock> bodyBlock = conditionalJump->destBlocks.front().lock();
+        std::shared_ptr<SSABasicBlock> exitBlock = conditionalJump->destBlocks.back().lock();
+        if(dominates(exitBlock, latch))
+            std::swap(bodyBlock, exitBlock);
+        if(!dominates(bodyBlock, latch) || dominates(exitBlock, latch))
+            return false;
+        if(bodyBlock == header || exitBlock == header || bodyBlock->sourceBlocks.size() != 1 || exitBlock->sourceBlocks.size() != 1)
+            return false;
+        std::size_t duplicatedInstructionCount = 0;
+        for(std::shared_ptr<SSANode> node : header->instructions)
+        {
+            if(!SSANodeDuplicator::canDuplicate(node))
+                return false;
+            if(dynamic_cast<const SSAPhi *>(node.get()) == nullptr && node != header->controlTransferInstruction)
+                duplicatedInstructionCount++;
+        }
+        if(duplicatedInstructionCount > maxDuplicatedInstructions)
+            return false;
+
+        // copy the header into the preheader, using the phi functions' inputs from the preheader
+        std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> guardReplacements;
+        std::unordered_set<std::shared_ptr<SSANode>> headerNodes;
+        auto insertPosition = preheader->instructions.end();
+        --insertPosition; // skip control transfer instruction
+        for(std::shared_ptr<SSANode> node : header->instructions)
+        {
+            if(node == header->controlTransferInstruction)
+                break;
+            headerNodes.insert(node);
+            if(std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node))
+            {
+                for(const SSAPhi::PhiInput &i : phi->inputs)
+                {
+                    if(i.block.lock() == preheader)
+                        guardReplacements.emplace(phi, SSANode::ReplacementNode(i.node.lock(), true));
+                }
+                assert(guardReplacements.count(phi) != 0);
+                continue;
+            }
+            std::shared_ptr<SSANode> newNode = SSANodeDuplicator::duplicate(node, guardReplacements);
+            guardReplacements.emplace(node, SSANode::ReplacementNode(newNode, false));
+            preheader->instructions.insert(insertPosition, newNode);
+        }
+        std::shared_ptr<SSAConditionalJump> guardJump = std::make_shared<SSAConditionalJump>(function->context,
+                                                                                               SSANode::replaceNode(guardReplacements, conditionalJump->condition.lock()),
+                                                                                               conditionalJump->destBlocks.front().lock(),
+                                                                                               conditionalJump->destBlocks.back().lock());
+        preheader->instructions.back() = guardJump;
+        preheader->controlTransferInstruction = guardJump;
+
+        // values defined in the header now reach the body and the exit from both the guard and the header
+        std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> bodyReplacements, exitReplacements;
+        auto getMergedNode = [&](std::shared_ptr<SSANode> node, bool isInBody) -> std::shared_ptr<SSANode>
+        {
+            std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> &replacements = isInBody ? bodyReplacements : exitReplacements;
+            auto iter = replacements.find(node);
+            if(iter != replacements.end())
+                return std::get<1>(*iter).newNode;
+            std::shared_ptr<SSAPhi> phi = std::make_shared<SSAPhi>(node->type, node->spillLocation);
+            phi->inputs.push_back(SSAPhi::PhiInput{SSANode::replaceNode(guardReplacements, node), preheader});
+            phi->inputs.push_back(SSAPhi::PhiInput{node, header});
+            replacements.emplace(node, SSANode::ReplacementNode(phi, false));
+            return phi;
+        };
+        std::vector<std::shared_ptr<SSANode>> bodyUses, exitUses;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            if(block == header)
+                continue;
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                if(std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node))
+                {
+                    for(SSAPhi::PhiInput &i : phi->inputs)
+                    {
+                        std::shared_ptr<SSABasicBlock> inputBlock = i.block.lock();
+                        if(inputBlock == header || headerNodes.count(i.node.lock()) == 0)
+                            continue;
+                        i.node = getMergedNode(i.node.lock(), dominates(bodyBlock, inputBlock));
+                    }
+                    continue;
+                }
+                for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+                {
+                    if(headerNodes.count(inputNode) == 0)
+                        continue;
+                    (dominates(bodyBlock, block) ? bodyUses : exitUses).push_back(node);
+                    break;
+                }
+            }
+        }
+        // header phi inputs from the latch are uses at the end of the latch, inside the body
+        for(std::shared_ptr<SSANode> node : header->instructions)
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+            if(phi == nullptr)
+                break;
+            for(auto i = phi->inputs.begin(); i != phi->inputs.end();)
+            {
+                if(i->block.lock() == preheader)
+                {
+                    i = phi->inputs.erase(i);
+                    continue;
+                }
+                if(headerNodes.count(i->node.lock()) != 0)
+                    i->node = getMergedNode(i->node.lock(), true);
+                ++i;
+            }
+        }
+        for(std::shared_ptr<SSANode> node : bodyUses)
+        {
+            for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+            {
+                if(headerNodes.count(inputNode) != 0)
+                    getMergedNode(inputNode, true);
+            }
+            node->replaceNodes(bodyReplacements);
+        }
+        for(std::shared_ptr<SSANode> node : exitUses)
+        {
+            for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+            {
+                if(headerNodes.count(inputNode) != 0)
+                    getMergedNode(inputNode, false);
+            }
+            node->replaceNodes(exitReplacements);
+        }
+
+        // existing phi functions in the body and the exit only had the header as a source block
+        for(std::shared_ptr<SSABasicBlock> block : {bodyBlock, exitBlock})
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+                if(phi == nullptr)
+                    break;
+                if(phi->inputs.size() != 1 || phi->inputs.front().block.lock() != header)
+                    continue;
+                std::shared_ptr<SSANode> inputNode = phi->inputs.front().node.lock();
+                phi->inputs.push_back(SSAPhi::PhiInput{SSANode::replaceNode(guardReplacements, inputNode), preheader});
+            }
+        }
+        for(auto &replacement : bodyReplacements)
+            bodyBlock->instructions.push_front(std::get<1>(replacement).newNode);
+        for(auto &replacement : exitReplacements)
+            exitBlock->instructions.push_front(std::get<1>(replacement).newNode);
+        return true;
+    }
+public:
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                if(rotateLoop(function, block))
+                {
+                    ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+                    done = false;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+#endif // LOOP_ROTATION_H_INCLUDED
@@ -0,0 +1,270 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef LOOP_UNROLLING_H_INCLUDED
+#define LOOP_UNROLLING_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "ssa/ssa_duplicate.h"
+#include "ssa/ssa_loop.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include "construct_basic_block_graph.h"
+#include <cassert>
+
+/** unroll innermost loops that have a constant trip count
+ *
+ * The trip count comes from SSALoop::getTripCount, so any induction variable that folds to constants works.
+ * Loops that fit in the code size budget after being copied once per iteration are fully unrolled,
+ * other loops get unrollFactor copies of their body chained together. Because the trip count is known,
+ * only the copy that the last iteration ends in keeps its exit branch, so no remainder loop is needed.
+ */
+class LoopUnrolling final
+{
+private:
+    const std::size_t unrollFactor;
+    const std::size_t maxUnrolledInstructions;
+    const std::size_t maxTripCount = 1024;
+    typedef std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> ReplacementMap;
+    bool unrollLoop(std::shared_ptr<SSAFunction> function, const SSALoop &loop)
+    {
+        std::size_t instructionCount = 0;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                if(!SSANodeDuplicator::canDuplicate(node))
+                    return false;
+                if(dynamic_cast<const SSAPhi *>(node.get()) == nullptr && node != block->controlTransferInstruction)
+                    instructionCount++;
+            }
+        }
+        std::size_t tripCount = loop.getTripCount(function, maxTripCount);
+        if(tripCount == 0)
+            return false;
+        std::size_t copyCount;
+        bool isFullUnroll = false;
+        if(tripCount * instructionCount <= maxUnrolledInstructions)
+        {
+            copyCount = tripCount;
+            isFullUnroll = true;
+        }
+        else
+        {
+            copyCount = std::min(unrollFactor, maxUnrolledInstructions / std::max<std::size_t>(instructionCount, 1));
+            if(copyCount < 2 || copyCount >= tripCount)
+                return false;
+        }
+
+        // make the copies : copy 0 is the original loop and the back edge of copy n goes to the header of copy n + 1
+        std::vector<std::unordered_map<std::shared_ptr<SSABasicBlock>, std::shared_ptr<SSABasicBlock>>> blockMaps(copyCount);
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> copiedBlocks = loop.blockSet;
+        std::vector<ReplacementMap> replacementMaps(copyCount);
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+            blockMaps[0][block] = block;
+        auto insertPosition = function->blocks.begin();
+        while(*insertPosition != loop.latch)
+            ++insertPosition;
+        ++insertPosition;
+        for(std::size_t copy = 1; copy < copyCount; copy++)
+        {
+            for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+            {
+                std::shared_ptr<SSABasicBlock> newBlock = std::make_shared<SSABasicBlock>(function->context);
+                blockMaps[copy][block] = newBlock;
+                copiedBlocks.insert(newBlock);
+                function->blocks.insert(insertPosition, newBlock);
+            }
+        }
+        auto mapBlock = [&](std::size_t copy, std::shared_ptr<SSABasicBlock> block) -> std::shared_ptr<SSABasicBlock>
+        {
+            if(block == loop.header)
+                return blockMaps[(copy + 1) % copyCount][block];
+            auto iter = blockMaps[copy].find(block);
+            if(iter == blockMaps[copy].end())
+                return block;
+            return std::get<1>(*iter);
+        };
+        for(std::size_t copy = 1; copy < copyCount; copy++)
+        {
+            ReplacementMap &replacements = replacementMaps[copy];
+            for(std::shared_ptr<SSANode> node : loop.header->instructions)
+            {
+                std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+                if(phi == nullptr)
+                    break;
+                replacements.emplace(phi, SSANode::ReplacementNode(SSANode::replaceNode(replacementMaps[copy - 1], loop.getLatchInput(phi)), true));
+            }
+            for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+            {
+                std::shared_ptr<SSABasicBlock> newBlock = blockMaps[copy][block];
+                for(std::shared_ptr<SSANode> node : block->instructions)
+                {
+                    std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+                    if(phi != nullptr && block == loop.header)
+                        continue;
+                    std::shared_ptr<SSANode> newNode = SSANodeDuplicator::duplicate(node, replacements);
+                    if(phi != nullptr)
+                    {
+                        for(SSAPhi::PhiInput &i : std::static_pointer_cast<SSAPhi>(newNode)->inputs)
+                            i.block = blockMaps[copy][i.block.lock()];
+                    }
+                    else if(node == block->controlTransferInstruction)
+                    {
+                        std::shared_ptr<SSAControlTransfer> newControlTransfer = std::static_pointer_cast<SSAControlTransfer>(newNode);
+                        std::list<std::weak_ptr<SSABasicBlock>> destBlocks = newControlTransfer->destBlocks;
+                        for(std::weak_ptr<SSABasicBlock> destBlock : destBlocks)
+                            newControlTransfer->replaceBlock(destBlock.lock(), mapBlock(copy, destBlock.lock()));
+                        newBlock->controlTransferInstruction = newControlTransfer;
+                    }
+                    replacements.emplace(node, SSANode::ReplacementNode(newNode, false));
+                    newBlock->instructions.push_back(newNode);
+                }
+            }
+        }
+        loop.latch->controlTransferInstruction->replaceBlock(loop.header, mapBlock(0, loop.header));
+        for(std::shared_ptr<SSANode> node : loop.header->instructions)
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+            if(phi == nullptr)
+                break;
+            for(SSAPhi::PhiInput &i : phi->inputs)
+            {
+                if(i.block.lock() != loop.latch)
+                    continue;
+                i.node = SSANode::replaceNode(replacementMaps[copyCount - 1], i.node.lock());
+                i.block = blockMaps[copyCount - 1][loop.latch];
+            }
+        }
+
+        // every copy of the exiting block can reach the exit block
+        std::unordered_set<std::shared_ptr<SSANode>> loopNodes;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+                loopNodes.insert(node);
+        }
+        ReplacementMap exitReplacements;
+        std::vector<std::shared_ptr<SSAPhi>> newExitPhis;
+        auto getExitNode = [&](std::shared_ptr<SSANode> node) -> std::shared_ptr<SSANode>
+        {
+            auto iter = exitReplacements.find(node);
+            if(iter != exitReplacements.end())
+                return std::get<1>(*iter).newNode;
+            std::shared_ptr<SSAPhi> phi = std::make_shared<SSAPhi>(node->type, node->spillLocation);
+            for(std::size_t copy = 0; copy < copyCount; copy++)
+                phi->inputs.push_back(SSAPhi::PhiInput{SSANode::replaceNode(replacementMaps[copy], node), blockMaps[copy][loop.exitingBlock]});
+            exitReplacements.emplace(node, SSANode::ReplacementNode(phi, false));
+            newExitPhis.push_back(phi);
+            return phi;
+        };
+        std::vector<std::shared_ptr<SSANode>> exitUses;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            if(copiedBlocks.count(block) != 0)
+                continue;
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                if(std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node))
+                {
+                    std::vector<SSAPhi::PhiInput> newInputs;
+                    for(SSAPhi::PhiInput &i : phi->inputs)
+                    {
+                        std::shared_ptr<SSANode> inputNode = i.node.lock();
+                        if(i.block.lock() == loop.exitingBlock)
+                        {
+                            for(std::size_t copy = 1; copy < copyCount; copy++)
+                                newInputs.push_back(SSAPhi::PhiInput{SSANode::replaceNode(replacementMaps[copy], inputNode), blockMaps[copy][loop.exitingBlock]});
+                        }
+                        else if(loopNodes.count(inputNode) != 0)
+                            i.node = getExitNode(inputNode);
+                    }
+                    phi->inputs.insert(phi->inputs.end(), newInputs.begin(), newInputs.end());
+                    continue;
+                }
+                for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+                {
+                    if(loopNodes.count(inputNode) == 0)
+                        continue;
+                    exitUses.push_back(node);
+                    break;
+                }
+            }
+        }
+        for(std::shared_ptr<SSANode> node : exitUses)
+        {
+            for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+            {
+                if(loopNodes.count(inputNode) != 0)
+                    getExitNode(inputNode);
+            }
+            node->replaceNodes(exitReplacements);
+        }
+        for(std::shared_ptr<SSAPhi> phi : newExitPhis)
+            loop.exitBlock->instructions.push_front(phi);
+
+        // the trip count says which copy the loop is left from
+        std::shared_ptr<SSABasicBlock> loopTarget;
+        for(std::weak_ptr<SSABasicBlock> destBlock : loop.exitingBlock->destBlocks)
+        {
+            if(destBlock.lock() != loop.exitBlock)
+                loopTarget = destBlock.lock();
+        }
+        for(std::size_t copy = 0; copy < copyCount; copy++)
+        {
+            std::shared_ptr<SSABasicBlock> exitingBlock = blockMaps[copy][loop.exitingBlock];
+            if(isFullUnroll && copy == copyCount - 1)
+                SSALoop::foldBranch(exitingBlock, loop.exitBlock);
+            else if(copy != (tripCount - 1) % copyCount)
+                SSALoop::foldBranch(exitingBlock, mapBlock(copy, loopTarget));
+        }
+        SSALoop::removeUnreachableBlocks(function);
+        return true;
+    }
+public:
+    explicit LoopUnrolling(std::size_t unrollFactor = 4, std::size_t maxUnrolledInstructions = 128)
+        : unrollFactor(unrollFactor), maxUnrolledInstructions(maxUnrolledInstructions)
+    {
+    }
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> visitedHeaders;
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                SSALoop loop;
+                if(!std::get<1>(visitedHeaders.insert(block)) || !SSALoop::find(block, loop))
+                    continue;
+                if(unrollLoop(function, loop))
+                {
+                    ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+                    done = false;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+#endif // LOOP_UNROLLING_H_INCLUDED
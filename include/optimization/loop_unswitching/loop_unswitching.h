@@ -0,0 +1,287 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef LOOP_UNSWITCHING_H_INCLUDED
+#define LOOP_UNSWITCHING_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "ssa/ssa_duplicate.h"
+#include "ssa/ssa_loop.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "construct_basic_block_graph.h"
+#include <cassert>
+
+/** move loop-invariant conditional jumps out of innermost loops
+ *
+ * The loop is copied and a new block in front of both headers tests the condition, which is moved there
+ * if it's computed in the loop from values that don't change. The original loop is
+ * the version where the condition is true and the copy is the version where it's false, so each has the
+ * branch replaced by a jump. The loop's exit test can't be unswitched because it doesn't go to another
+ * block in the loop. Every copy counts against a code size budget for the whole function,
+ * so loops with several invariant conditions stop being split when it runs out.
+ */
+class LoopUnswitching final
+{
+private:
+    const std::size_t maxLoopInstructions;
+    std::size_t remainingInstructions;
+    typedef std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> ReplacementMap;
+    /// @return true if node can be computed before the loop, adding the loop nodes it needs to nodes in the order they have to run
+    static bool getInvariantNodes(std::shared_ptr<SSANode> node,
+                                  const std::unordered_set<std::shared_ptr<SSANode>> &loopNodes,
+                                  std::unordered_set<std::shared_ptr<SSANode>> &visitedNodes,
+                                  std::vector<std::shared_ptr<SSANode>> &nodes)
+    {
+        if(loopNodes.count(node) == 0 || !std::get<1>(visitedNodes.insert(node)))
+            return true;
+        if(node->hasSideEffects())
+            return false;
+        if(dynamic_cast<const SSAConstant *>(node.get()) == nullptr
+            && dynamic_cast<const SSAMove *>(node.get()) == nullptr
+            && dynamic_cast<const SSASelect *>(node.get()) == nullptr
+            && dynamic_cast<const SSAAdd *>(node.get()) == nullptr
+            && dynamic_cast<const SSATypeCast *>(node.get()) == nullptr
+            && dynamic_cast<const SSACompare *>(node.get()) == nullptr)
+            return false;
+        for(std::shared_ptr<SSANode> input : node->getInputs())
+        {
+            if(!getInvariantNodes(input, loopNodes, visitedNodes, nodes))
+                return false;
+        }
+        nodes.push_back(node);
+        return true;
+    }
+    bool unswitchLoop(std::shared_ptr<SSAFunction> function, const SSALoop &loop)
+    {
+        std::shared_ptr<SSABasicBlock> preheader = loop.getPreheader();
+        if(preheader == nullptr)
+            return false;
+        std::unordered_set<std::shared_ptr<SSANode>> loopNodes;
+        std::size_t instructionCount = 0;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                if(!SSANodeDuplicator::canDuplicate(node))
+                    return false;
+                loopNodes.insert(node);
+                if(dynamic_cast<const SSAPhi *>(node.get()) == nullptr)
+                    instructionCount++;
+            }
+        }
+        if(instructionCount > maxLoopInstructions || instructionCount > remainingInstructions)
+            return false;
+        std::shared_ptr<SSABasicBlock> switchBlock;
+        std::shared_ptr<SSANode> condition;
+        std::vector<std::shared_ptr<SSANode>> hoistedNodes;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            if(block == loop.exitingBlock)
+                continue;
+            std::shared_ptr<SSAConditionalJump> conditionalJump = std::dynamic_pointer_cast<SSAConditionalJump>(block->controlTransferInstruction);
+            if(conditionalJump == nullptr || conditionalJump->destBlocks.front().lock() == conditionalJump->destBlocks.back().lock())
+                continue;
+            condition = conditionalJump->condition.lock();
+            if(dynamic_cast<const SSAConstant *>(condition.get()) != nullptr)
+                continue;
+            std::unordered_set<std::shared_ptr<SSANode>> visitedNodes;
+            hoistedNodes.clear();
+            if(!getInvariantNodes(condition, loopNodes, visitedNodes, hoistedNodes))
+                continue;
+            switchBlock = block;
+            break;
+        }
+        if(switchBlock == nullptr)
+            return false;
+        remainingInstructions -= instructionCount;
+
+        // the nodes computing the condition move in front of both loops
+        std::unordered_set<std::shared_ptr<SSANode>> hoistedNodeSet(hoistedNodes.begin(), hoistedNodes.end());
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            block->instructions.erase_if([&](std::shared_ptr<SSANode> &node)
+            {
+                return hoistedNodeSet.count(node) != 0;
+            });
+        }
+        for(std::shared_ptr<SSANode> node : hoistedNodes)
+            loopNodes.erase(node);
+        std::shared_ptr<SSABasicBlock> trueTarget = switchBlock->controlTransferInstruction->destBlocks.front().lock();
+        std::shared_ptr<SSABasicBlock> falseTarget = switchBlock->controlTransferInstruction->destBlocks.back().lock();
+
+        // copy the loop : the copy is entered from the new block like the original
+        std::shared_ptr<SSABasicBlock> unswitchBlock = std::make_shared<SSABasicBlock>(function->context);
+        std::unordered_map<std::shared_ptr<SSABasicBlock>, std::shared_ptr<SSABasicBlock>> blockMap;
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> newBlocks{unswitchBlock};
+        auto insertPosition = function->blocks.begin();
+        while(*insertPosition != loop.header)
+            ++insertPosition;
+        function->blocks.insert(insertPosition, unswitchBlock);
+        while(*insertPosition != loop.latch)
+            ++insertPosition;
+        ++insertPosition;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            std::shared_ptr<SSABasicBlock> newBlock = std::make_shared<SSABasicBlock>(function->context);
+            blockMap[block] = newBlock;
+            newBlocks.insert(newBlock);
+            function->blocks.insert(insertPosition, newBlock);
+        }
+        auto mapBlock = [&](std::shared_ptr<SSABasicBlock> block) -> std::shared_ptr<SSABasicBlock>
+        {
+            auto iter = blockMap.find(block);
+            if(iter == blockMap.end())
+                return block;
+            return std::get<1>(*iter);
+        };
+        ReplacementMap replacements;
+        std::vector<std::shared_ptr<SSANode>> newNodes;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            std::shared_ptr<SSABasicBlock> newBlock = blockMap[block];
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                std::shared_ptr<SSANode> newNode = SSANodeDuplicator::duplicate(node, replacements);
+                if(std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(newNode))
+                {
+                    for(SSAPhi::PhiInput &i : phi->inputs)
+                        i.block = i.block.lock() == preheader && block == loop.header ? unswitchBlock : mapBlock(i.block.lock());
+                }
+                else if(node == block->controlTransferInstruction)
+                {
+                    std::shared_ptr<SSAControlTransfer> newControlTransfer = std::static_pointer_cast<SSAControlTransfer>(newNode);
+                    std::list<std::weak_ptr<SSABasicBlock>> destBlocks = newControlTransfer->destBlocks;
+                    for(std::weak_ptr<SSABasicBlock> destBlock : destBlocks)
+                        newControlTransfer->replaceBlock(destBlock.lock(), mapBlock(destBlock.lock()));
+                    newBlock->controlTransferInstruction = newControlTransfer;
+                }
+                replacements.emplace(node, SSANode::ReplacementNode(newNode, false));
+                newBlock->instructions.push_back(newNode);
+                newNodes.push_back(newNode);
+            }
+        }
+        for(std::shared_ptr<SSANode> node : newNodes) // the latch inputs of the header phi functions come after them
+            node->replaceNodes(replacements);
+        for(std::shared_ptr<SSANode> node : loop.header->instructions)
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+            if(phi == nullptr)
+                break;
+            phi->replaceBlock(preheader, unswitchBlock);
+        }
+        preheader->controlTransferInstruction->replaceBlock(loop.header, unswitchBlock);
+        for(std::shared_ptr<SSANode> node : hoistedNodes)
+            unswitchBlock->instructions.push_back(node);
+        unswitchBlock->controlTransferInstruction = std::make_shared<SSAConditionalJump>(function->context, condition, loop.header, blockMap[loop.header]);
+        unswitchBlock->instructions.push_back(unswitchBlock->controlTransferInstruction);
+
+        // both exiting blocks jump to the exit block
+        ReplacementMap exitReplacements;
+        std::vector<std::shared_ptr<SSAPhi>> newExitPhis;
+        auto getExitNode = [&](std::shared_ptr<SSANode> node) -> std::shared_ptr<SSANode>
+        {
+            auto iter = exitReplacements.find(node);
+            if(iter != exitReplacements.end())
+                return std::get<1>(*iter).newNode;
+            std::shared_ptr<SSAPhi> phi = std::make_shared<SSAPhi>(node->type, node->spillLocation);
+            phi->inputs.push_back(SSAPhi::PhiInput{node, loop.exitingBlock});
+            phi->inputs.push_back(SSAPhi::PhiInput{SSANode::replaceNode(replacements, node), blockMap[loop.exitingBlock]});
+            exitReplacements.emplace(node, SSANode::ReplacementNode(phi, false));
+            newExitPhis.push_back(phi);
+            return phi;
+        };
+        std::vector<std::shared_ptr<SSANode>> exitUses;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            if(loop.blockSet.count(block) != 0 || newBlocks.count(block) != 0)
+                continue;
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                if(std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node))
+                {
+                    std::vector<SSAPhi::PhiInput> newInputs;
+                    for(SSAPhi::PhiInput &i : phi->inputs)
+                    {
+                        std::shared_ptr<SSANode> inputNode = i.node.lock();
+                        if(i.block.lock() == loop.exitingBlock)
+                            newInputs.push_back(SSAPhi::PhiInput{SSANode::replaceNode(replacements, inputNode), blockMap[loop.exitingBlock]});
+                        else if(loopNodes.count(inputNode) != 0)
+                            i.node = getExitNode(inputNode);
+                    }
+                    phi->inputs.insert(phi->inputs.end(), newInputs.begin(), newInputs.end());
+                    continue;
+                }
+                for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+                {
+                    if(loopNodes.count(inputNode) == 0)
+                        continue;
+                    exitUses.push_back(node);
+                    break;
+                }
+            }
+        }
+        for(std::shared_ptr<SSANode> node : exitUses)
+        {
+            for(std::shared_ptr<SSANode> inputNode : node->getInputs())
+            {
+                if(loopNodes.count(inputNode) != 0)
+                    getExitNode(inputNode);
+            }
+            node->replaceNodes(exitReplacements);
+        }
+        for(std::shared_ptr<SSAPhi> phi : newExitPhis)
+            loop.exitBlock->instructions.push_front(phi);
+
+        SSALoop::foldBranch(switchBlock, trueTarget);
+        SSALoop::foldBranch(blockMap[switchBlock], blockMap[falseTarget]);
+        SSALoop::removeUnreachableBlocks(function);
+        return true;
+    }
+public:
+    explicit LoopUnswitching(std::size_t maxLoopInstructions = 64, std::size_t maxAddedInstructions = 128)
+        : maxLoopInstructions(maxLoopInstructions), remainingInstructions(maxAddedInstructions)
+    {
+    }
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> visitedHeaders;
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                SSALoop loop;
+                if(!std::get<1>(visitedHeaders.insert(block)) || !SSALoop::find(block, loop))
+                    continue;
+                if(unswitchLoop(function, loop))
+                {
+                    visitedHeaders.erase(block); // the original loop can have more invariant conditions
+                    ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+                    done = false;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+#endif // LOOP_UNSWITCHING_H_INCLUDED
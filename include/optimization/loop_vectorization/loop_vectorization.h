@@ -0,0 +1,445 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef LOOP_VECTORIZATION_H_INCLUDED
+#define LOOP_VECTORIZATION_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "ssa/ssa_loop.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include "construct_basic_block_graph.h"
+#include <cassert>
+
+/** vectorize innermost loops with a constant trip count that copy, widen and add elements through pointers
+ *
+ * The loop must still have its exit test in the header, so this runs before LoopRotation.
+ * Every header phi function has to be an induction variable with a constant step, and the body can only
+ * load from and store to pointer induction variables that step by one element, with integer type casts
+ * and additions in between. A new counted loop runs the body on vectorSize bytes at a time,
+ * then the original loop runs the remaining iterations as the scalar epilogue.
+ * Additions and casts whose results are only stored narrower are done at the narrower width.
+ * Pointers that are stored through are checked to not overlap the other accessed pointers,
+ * at compile time if both start at constant addresses or else by a guard in front of the vector loop.
+ */
+class LoopVectorization final
+{
+private:
+    const std::size_t vectorSize;
+    const std::size_t maxTripCount = 65536;
+    const std::uint64_t minVectorSize = 4; /// the smallest vector that can be loaded into a register
+    static std::shared_ptr<TypeInteger> getIntegerType(std::shared_ptr<TypeNode> type)
+    {
+        if(type->isVolatile)
+            return nullptr;
+        return std::dynamic_pointer_cast<TypeInteger>(type->toNonConstant());
+    }
+    static IntegerWidth getIntegerWidth(std::uint64_t size)
+    {
+        switch(size)
+        {
+        case 1:
+            return IntegerWidth::Int8;
+        case 2:
+            return IntegerWidth::Int16;
+        case 4:
+            return IntegerWidth::Int32;
+        default:
+            assert(size == 8);
+            return IntegerWidth::Int64;
+        }
+    }
+    bool vectorizeLoop(std::shared_ptr<SSAFunction> function, const SSALoop &loop)
+    {
+        CompilerContext *context = function->context;
+        if(loop.exitingBlock != loop.header || loop.blocks.size() < 2)
+            return false;
+        std::shared_ptr<SSABasicBlock> preheader = loop.getPreheader();
+        if(preheader == nullptr || std::dynamic_pointer_cast<SSAUnconditionalJump>(preheader->controlTransferInstruction) == nullptr)
+            return false;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            if(block != loop.header && std::dynamic_pointer_cast<SSAUnconditionalJump>(block->controlTransferInstruction) == nullptr)
+                return false; // the body has to be straight-line code
+        }
+        SSALoop::ValueMap values = loop.getConstantValues(function);
+        SSALoop::InductionVariableMap inductionVariables;
+        if(!loop.getInductionVariables(values, preheader, inductionVariables))
+            return false;
+        std::vector<std::shared_ptr<SSAPhi>> headerPhis;
+        std::unordered_set<std::shared_ptr<SSANode>> stepNodes;
+        for(std::shared_ptr<SSANode> node : loop.header->instructions)
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+            if(phi == nullptr)
+                break;
+            headerPhis.push_back(phi);
+            stepNodes.insert(inductionVariables.at(phi).stepNode);
+        }
+
+        // find the nodes that are vectorized : everything else is only used by the scalar loop
+        auto getAccessedPhi = [&](std::shared_ptr<SSANode> address) -> std::shared_ptr<SSAPhi>
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(address);
+            if(phi == nullptr || inductionVariables.count(phi) == 0 || inductionVariables.at(phi).step->getSignedValue() != 1)
+                return nullptr;
+            if(dynamic_cast<const TypePointer *>(phi->type->toNonConstant()->toNonVolatile().get()) == nullptr)
+                return nullptr;
+            if(getIntegerType(phi->type->dereference()) == nullptr)
+                return nullptr;
+            return phi;
+        };
+        std::vector<std::shared_ptr<SSANode>> vectorNodes; /// in program order
+        std::unordered_set<std::shared_ptr<SSANode>> vectorValueSet;
+        std::vector<std::shared_ptr<SSAPhi>> accessedPhis, storedPhis;
+        std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<SSAPhi>> accessedPhiMap;
+        for(std::shared_ptr<SSABasicBlock> block : loop.blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                if(node == block->controlTransferInstruction || values.count(node) != 0 || stepNodes.count(node) != 0)
+                    continue;
+                if(dynamic_cast<const SSAPhi *>(node.get()) != nullptr)
+                {
+                    if(block == loop.header)
+                        continue;
+                    return false;
+                }
+                if(block == loop.header)
+                {
+                    if(dynamic_cast<const SSACompare *>(node.get()) != nullptr)
+                        continue;
+                    return false;
+                }
+                std::shared_ptr<SSAPhi> accessedPhi;
+                if(std::shared_ptr<SSALoad> load = std::dynamic_pointer_cast<SSALoad>(node))
+                {
+                    accessedPhi = getAccessedPhi(load->address.lock());
+                    if(accessedPhi == nullptr)
+                        return false;
+                }
+                else if(std::shared_ptr<SSAStore> store = std::dynamic_pointer_cast<SSAStore>(node))
+                {
+                    accessedPhi = getAccessedPhi(store->address.lock());
+                    if(accessedPhi == nullptr || vectorValueSet.count(store->value.lock()) == 0)
+                        return false;
+                    if(std::find(storedPhis.begin(), storedPhis.end(), accessedPhi) == storedPhis.end())
+                        storedPhis.push_back(accessedPhi);
+                }
+                else if(std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node))
+                {
+                    if(vectorValueSet.count(typeCast->arg.lock()) == 0 || getIntegerType(typeCast->type) == nullptr)
+                        return false;
+                }
+                else if(std::shared_ptr<SSAAdd> add = std::dynamic_pointer_cast<SSAAdd>(node))
+                {
+                    if(vectorValueSet.count(add->lhs.lock()) == 0 || vectorValueSet.count(add->rhs.lock()) == 0 || getIntegerType(add->type) == nullptr)
+                        return false;
+                }
+                else
+                    return false;
+                if(accessedPhi != nullptr)
+                {
+                    accessedPhiMap[node] = accessedPhi;
+                    if(std::find(accessedPhis.begin(), accessedPhis.end(), accessedPhi) == accessedPhis.end())
+                        accessedPhis.push_back(accessedPhi);
+                }
+                vectorNodes.push_back(node);
+                if(dynamic_cast<const SSAStore *>(node.get()) == nullptr)
+                    vectorValueSet.insert(node);
+            }
+        }
+        if(storedPhis.empty())
+            return false;
+
+        // the low bits of an addition only depend on the low bits of its operands, so only compute the bits that are stored
+        std::unordered_map<std::shared_ptr<SSANode>, std::uint64_t> demandedSizes;
+        auto getSize = [](std::shared_ptr<SSANode> node) -> std::uint64_t
+        {
+            return node->type->getTypeProperties().size;
+        };
+        auto getElementSize = [&](std::shared_ptr<SSANode> node) -> std::uint64_t
+        {
+            std::uint64_t demandedSize = demandedSizes[node];
+            if(demandedSize == 0)
+                return getSize(node);
+            return std::min(getSize(node), demandedSize);
+        };
+        auto demand = [&](std::shared_ptr<SSANode> node, std::uint64_t size)
+        {
+            std::uint64_t &demandedSize = demandedSizes[node];
+            demandedSize = std::max(demandedSize, size);
+        };
+        for(auto i = vectorNodes.rbegin(); i != vectorNodes.rend(); ++i)
+        {
+            std::shared_ptr<SSANode> node = *i;
+            if(std::shared_ptr<SSAStore> store = std::dynamic_pointer_cast<SSAStore>(node))
+                demand(store->value.lock(), store->address.lock()->type->dereference()->getTypeProperties().size);
+            else if(std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node))
+                demand(typeCast->arg.lock(), std::min(getSize(typeCast->arg.lock()), getElementSize(node)));
+            else if(std::shared_ptr<SSAAdd> add = std::dynamic_pointer_cast<SSAAdd>(node))
+            {
+                demand(add->lhs.lock(), getElementSize(node));
+                demand(add->rhs.lock(), getElementSize(node));
+            }
+        }
+        std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<TypeNode>> elementTypes;
+        std::uint64_t maxElementSize = 1, minElementSize = 8;
+        for(std::shared_ptr<SSANode> node : vectorNodes)
+        {
+            if(std::shared_ptr<SSAStore> store = std::dynamic_pointer_cast<SSAStore>(node))
+            {
+                if(getElementSize(store->value.lock()) != store->address.lock()->type->dereference()->getTypeProperties().size)
+                    return false;
+                continue;
+            }
+            std::uint64_t elementSize = getElementSize(node);
+            if(dynamic_cast<const SSALoad *>(node.get()) != nullptr)
+            {
+                if(elementSize != getSize(node))
+                    return false;
+            }
+            else if(std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node))
+            {
+                std::shared_ptr<SSANode> arg = typeCast->arg.lock();
+                std::uint64_t argElementSize = getElementSize(arg);
+                if(elementSize < argElementSize) // truncating isn't implemented
+                    return false;
+                if(elementSize > argElementSize && !getIntegerType(arg->type)->isUnsigned && elementSize > 4) // SSE2 can't sign extend to 64 bits
+                    return false;
+            }
+            else if(std::shared_ptr<SSAAdd> add = std::dynamic_pointer_cast<SSAAdd>(node))
+            {
+                if(getElementSize(add->lhs.lock()) != elementSize || getElementSize(add->rhs.lock()) != elementSize)
+                    return false;
+            }
+            elementTypes[node] = TypeInteger::make(context, getIntegerType(node->type)->isUnsigned, getIntegerWidth(elementSize));
+            maxElementSize = std::max(maxElementSize, elementSize);
+            minElementSize = std::min(minElementSize, elementSize);
+        }
+        std::size_t vectorLength = vectorSize / maxElementSize;
+        if(vectorLength < 2 || minElementSize * vectorLength < minVectorSize)
+            return false;
+        std::size_t tripCount = loop.getTripCount(function, maxTripCount);
+        if(tripCount < 2)
+            return false;
+        std::size_t vectorTripCount = (tripCount - 1) / vectorLength; // the header runs once more than the body
+        if(vectorTripCount == 0)
+            return false;
+        std::size_t vectorizedIterationCount = vectorTripCount * vectorLength;
+
+        // each stored range has to be disjoint from the other accessed ranges
+        auto getAccessedSize = [&](std::shared_ptr<SSAPhi> phi) -> std::uint64_t
+        {
+            return vectorizedIterationCount * phi->type->dereference()->getTypeProperties().size;
+        };
+        std::vector<std::pair<std::shared_ptr<SSAPhi>, std::shared_ptr<SSAPhi>>> guardedPairs;
+        for(std::shared_ptr<SSAPhi> storedPhi : storedPhis)
+        {
+            for(std::shared_ptr<SSAPhi> accessedPhi : accessedPhis)
+            {
+                if(accessedPhi == storedPhi)
+                    continue;
+                if(std::find(guardedPairs.begin(), guardedPairs.end(), std::make_pair(accessedPhi, storedPhi)) != guardedPairs.end())
+                    continue;
+                std::uint64_t storedAddress, accessedAddress;
+                if(SSALoop::getConstantAddress(values, inductionVariables.at(storedPhi).initialValue, storedAddress)
+                    && SSALoop::getConstantAddress(values, inductionVariables.at(accessedPhi).initialValue, accessedAddress))
+                {
+                    if(storedAddress + getAccessedSize(storedPhi) <= accessedAddress || accessedAddress + getAccessedSize(accessedPhi) <= storedAddress)
+                        continue;
+                    return false;
+                }
+                guardedPairs.emplace_back(storedPhi, accessedPhi);
+            }
+        }
+
+        // build the guards, then the vector loop or block, then the block that starts the scalar loop where the vector loop stopped
+        std::shared_ptr<TypeNode> sizeType = TypeInteger::make(context, true, IntegerWidth::IntNativeSize);
+        std::list<std::shared_ptr<SSABasicBlock>> newBlocks;
+        std::vector<std::shared_ptr<SSABasicBlock>> guardFailBlocks;
+        std::shared_ptr<SSABasicBlock> vectorPreheader = std::make_shared<SSABasicBlock>(context);
+        std::shared_ptr<SSABasicBlock> vectorBody = std::make_shared<SSABasicBlock>(context);
+        std::shared_ptr<SSABasicBlock> vectorExit = std::make_shared<SSABasicBlock>(context);
+        auto addNode = [](std::shared_ptr<SSABasicBlock> block, std::shared_ptr<SSANode> node) -> std::shared_ptr<SSANode>
+        {
+            block->instructions.push_back(node);
+            return node;
+        };
+        auto addControlTransfer = [](std::shared_ptr<SSABasicBlock> block, std::shared_ptr<SSAControlTransfer> controlTransfer)
+        {
+            block->instructions.push_back(controlTransfer);
+            block->controlTransferInstruction = controlTransfer;
+        };
+        auto makeConstant = [&](std::shared_ptr<SSABasicBlock> block, bool isUnsigned, IntegerWidth width, std::int64_t value) -> std::shared_ptr<SSANode>
+        {
+            return addNode(block, std::make_shared<SSAConstant>(std::make_shared<ValueInteger>(context, isUnsigned, width, static_cast<std::uint64_t>(value)), nullptr));
+        };
+        bool isLoop = vectorTripCount > 1; // a single vector iteration is emitted as straight-line code
+        std::shared_ptr<SSABasicBlock> entryBlock = isLoop ? vectorPreheader : vectorBody;
+        for(auto i = guardedPairs.rbegin(); i != guardedPairs.rend(); ++i)
+        {
+            std::shared_ptr<SSAPhi> storedPhi = std::get<0>(*i), accessedPhi = std::get<1>(*i);
+            std::shared_ptr<SSABasicBlock> storedBeforeBlock = std::make_shared<SSABasicBlock>(context);
+            std::shared_ptr<SSABasicBlock> storedAfterBlock = std::make_shared<SSABasicBlock>(context);
+            std::shared_ptr<SSANode> storedStart = addNode(storedBeforeBlock, std::make_shared<SSATypeCast>(inductionVariables.at(storedPhi).initialValue, sizeType, nullptr));
+            std::shared_ptr<SSANode> accessedStart = addNode(storedBeforeBlock, std::make_shared<SSATypeCast>(inductionVariables.at(accessedPhi).initialValue, sizeType, nullptr));
+            std::shared_ptr<SSANode> storedEnd = addNode(storedBeforeBlock, std::make_shared<SSAAdd>(storedStart, makeConstant(storedBeforeBlock, true, IntegerWidth::IntNativeSize, getAccessedSize(storedPhi)), nullptr, sizeType));
+            std::shared_ptr<SSANode> compare = addNode(storedBeforeBlock, std::make_shared<SSACompare>(storedEnd, SSACompare::CompareOperator::LE, accessedStart, nullptr));
+            addControlTransfer(storedBeforeBlock, std::make_shared<SSAConditionalJump>(context, compare, entryBlock, storedAfterBlock));
+            std::shared_ptr<SSANode> accessedEnd = addNode(storedAfterBlock, std::make_shared<SSAAdd>(accessedStart, makeConstant(storedAfterBlock, true, IntegerWidth::IntNativeSize, getAccessedSize(accessedPhi)), nullptr, sizeType));
+            compare = addNode(storedAfterBlock, std::make_shared<SSACompare>(accessedEnd, SSACompare::CompareOperator::LE, storedStart, nullptr));
+            addControlTransfer(storedAfterBlock, std::make_shared<SSAConditionalJump>(context, compare, entryBlock, loop.header));
+            guardFailBlocks.push_back(storedAfterBlock);
+            newBlocks.push_front(storedAfterBlock);
+            newBlocks.push_front(storedBeforeBlock);
+            entryBlock = storedBeforeBlock;
+        }
+        if(isLoop)
+            newBlocks.push_back(vectorPreheader);
+        newBlocks.push_back(vectorBody);
+        newBlocks.push_back(vectorExit);
+
+        std::unordered_map<std::shared_ptr<SSAPhi>, std::shared_ptr<SSANode>> vectorAddresses;
+        std::unordered_map<std::shared_ptr<SSAPhi>, std::shared_ptr<SSANode>> vectorSteps;
+        std::unordered_map<std::shared_ptr<SSAPhi>, std::shared_ptr<SSANode>> exitValues;
+        std::shared_ptr<SSAPhi> counter;
+        if(isLoop)
+        {
+            counter = std::make_shared<SSAPhi>(sizeType, nullptr);
+            counter->inputs.push_back(SSAPhi::PhiInput{makeConstant(vectorPreheader, true, IntegerWidth::IntNativeSize, 0), vectorPreheader});
+            addNode(vectorBody, counter);
+        }
+        for(std::shared_ptr<SSAPhi> phi : accessedPhis)
+        {
+            const SSALoop::InductionVariable &inductionVariable = inductionVariables.at(phi);
+            if(!isLoop)
+            {
+                vectorAddresses[phi] = inductionVariable.initialValue;
+                continue;
+            }
+            std::shared_ptr<SSAPhi> vectorPhi = std::make_shared<SSAPhi>(phi->type, nullptr);
+            vectorPhi->inputs.push_back(SSAPhi::PhiInput{inductionVariable.initialValue, vectorPreheader});
+            vectorAddresses[phi] = vectorPhi;
+            vectorSteps[phi] = makeConstant(vectorPreheader, inductionVariable.step->isUnsigned, inductionVariable.step->width, vectorLength);
+            addNode(vectorBody, vectorPhi);
+        }
+        std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<SSANode>> vectorValues;
+        for(std::shared_ptr<SSANode> node : vectorNodes)
+        {
+            if(std::shared_ptr<SSAStore> store = std::dynamic_pointer_cast<SSAStore>(node))
+            {
+                std::shared_ptr<SSANode> value = vectorValues.at(store->value.lock());
+                std::shared_ptr<SSANode> address = addNode(vectorBody, std::make_shared<SSATypeCast>(vectorAddresses.at(accessedPhiMap.at(node)), TypePointer::make(value->type), nullptr));
+                addNode(vectorBody, std::make_shared<SSAStore>(address, value));
+                continue;
+            }
+            std::shared_ptr<TypeNode> vectorType = TypeVector::make(elementTypes.at(node), vectorLength);
+            std::shared_ptr<SSANode> vectorValue;
+            if(dynamic_cast<const SSALoad *>(node.get()) != nullptr)
+            {
+                std::shared_ptr<SSANode> address = addNode(vectorBody, std::make_shared<SSATypeCast>(vectorAddresses.at(accessedPhiMap.at(node)), TypePointer::make(vectorType), nullptr));
+                vectorValue = std::make_shared<SSALoad>(address, nullptr);
+            }
+            else if(std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node))
+                vectorValue = std::make_shared<SSATypeCast>(vectorValues.at(typeCast->arg.lock()), vectorType, nullptr);
+            else
+            {
+                std::shared_ptr<SSAAdd> add = std::static_pointer_cast<SSAAdd>(node);
+                vectorValue = std::make_shared<SSAAdd>(vectorValues.at(add->lhs.lock()), vectorValues.at(add->rhs.lock()), nullptr, vectorType);
+            }
+            vectorValues[node] = addNode(vectorBody, vectorValue);
+        }
+        if(isLoop)
+        {
+            for(std::shared_ptr<SSAPhi> phi : accessedPhis)
+            {
+                std::shared_ptr<SSAPhi> vectorPhi = std::static_pointer_cast<SSAPhi>(vectorAddresses.at(phi));
+                std::shared_ptr<SSANode> next = addNode(vectorBody, std::make_shared<SSAAdd>(vectorPhi, vectorSteps.at(phi), nullptr, phi->type));
+                vectorPhi->inputs.push_back(SSAPhi::PhiInput{next, vectorBody});
+                exitValues[phi] = next;
+            }
+            std::shared_ptr<SSANode> counterStep = makeConstant(vectorPreheader, true, IntegerWidth::IntNativeSize, 1);
+            std::shared_ptr<SSANode> counterEnd = makeConstant(vectorPreheader, true, IntegerWidth::IntNativeSize, vectorTripCount);
+            addControlTransfer(vectorPreheader, std::make_shared<SSAUnconditionalJump>(context, vectorBody));
+            std::shared_ptr<SSANode> counterNext = addNode(vectorBody, std::make_shared<SSAAdd>(counter, counterStep, nullptr, sizeType));
+            counter->inputs.push_back(SSAPhi::PhiInput{counterNext, vectorBody});
+            std::shared_ptr<SSANode> compare = addNode(vectorBody, std::make_shared<SSACompare>(counterNext, SSACompare::CompareOperator::L, counterEnd, nullptr));
+            addControlTransfer(vectorBody, std::make_shared<SSAConditionalJump>(context, compare, vectorBody, vectorExit));
+        }
+        else
+            addControlTransfer(vectorBody, std::make_shared<SSAUnconditionalJump>(context, vectorExit));
+
+        for(std::shared_ptr<SSAPhi> phi : headerPhis)
+        {
+            const SSALoop::InductionVariable &inductionVariable = inductionVariables.at(phi);
+            std::shared_ptr<SSANode> exitValue = exitValues[phi];
+            if(exitValue == nullptr)
+            {
+                std::shared_ptr<SSANode> offset = makeConstant(vectorExit, inductionVariable.step->isUnsigned, inductionVariable.step->width, inductionVariable.step->getSignedValue() * static_cast<std::int64_t>(vectorizedIterationCount));
+                exitValue = addNode(vectorExit, std::make_shared<SSAAdd>(inductionVariable.initialValue, offset, nullptr, phi->type));
+            }
+            for(auto i = phi->inputs.begin(); i != phi->inputs.end(); ++i)
+            {
+                if(i->block.lock() == preheader)
+                {
+                    phi->inputs.erase(i);
+                    break;
+                }
+            }
+            phi->inputs.push_back(SSAPhi::PhiInput{exitValue, vectorExit});
+            for(std::shared_ptr<SSABasicBlock> block : guardFailBlocks)
+                phi->inputs.push_back(SSAPhi::PhiInput{inductionVariable.initialValue, block});
+        }
+        addControlTransfer(vectorExit, std::make_shared<SSAUnconditionalJump>(context, loop.header));
+        preheader->controlTransferInstruction->replaceBlock(loop.header, entryBlock);
+        function->blocks.splice(std::find(function->blocks.begin(), function->blocks.end(), loop.header), newBlocks);
+        return true;
+    }
+public:
+    explicit LoopVectorization(std::size_t vectorSize = 16)
+        : vectorSize(vectorSize)
+    {
+    }
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> visitedHeaders;
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                SSALoop loop;
+                if(!std::get<1>(visitedHeaders.insert(block)) || !SSALoop::find(block, loop))
+                    continue;
+                if(vectorizeLoop(function, loop))
+                {
+                    ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+                    done = false;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+#endif // LOOP_VECTORIZATION_H_INCLUDED
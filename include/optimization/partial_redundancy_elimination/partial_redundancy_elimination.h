@@ -0,0 +1,457 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef PARTIAL_REDUNDANCY_ELIMINATION_H_INCLUDED
+#define PARTIAL_REDUNDANCY_ELIMINATION_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "ssa/ssa_duplicate.h"
+#include "util/bit_vector.h"
+#include "util/dataflow.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include "construct_basic_block_graph.h"
+#include <cassert>
+
+/** partial redundancy elimination by lazy code motion
+ *
+ * Pure expressions are numbered by their operation, type and the numbers of their operands, with constants
+ * numbered by value, so all computations of an expression from the same SSA values get the same number.
+ * The other values are the leaves, and an expression isn't transparent in the blocks defining its leaves.
+ * Type casts are numbered so the expressions using them match, but aren't moved by themselves.
+ *
+ * Computations are placed with the edge-based form of lazy code motion : they start on the earliest edges
+ * where the expression is anticipated and not available and are delayed as long as no path computes it twice,
+ * which keeps the new values live for as short as possible. Inserting on a critical edge splits it.
+ * The computations that are then redundant are replaced by the value reaching their block,
+ * with phi functions where the values from different predecessors meet.
+ */
+class PartialRedundancyElimination final
+{
+private:
+    typedef std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> ReplacementMap;
+    struct ValueClass final
+    {
+        std::shared_ptr<SSANode> node; /// the first node numbered
+        std::vector<std::size_t> leaves; /// sorted
+        std::size_t depth = 0;
+        bool isExpression = false;
+        bool isConstant = false;
+    };
+    std::vector<ValueClass> valueClasses;
+    std::unordered_map<std::shared_ptr<SSANode>, std::size_t> valueClassMap;
+    std::map<std::vector<std::uintptr_t>, std::size_t> expressionMap;
+    std::vector<std::size_t> constantClasses;
+    std::vector<std::size_t> expressions; /// the value class of every bit, for expressions with leaves
+    std::vector<std::vector<std::shared_ptr<SSANode>>> liveNodes; /// the nodes in the function computing every expression
+    std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<SSABasicBlock>> nodeBlocks;
+    std::size_t currentValueClass = 0;
+    std::unordered_map<std::shared_ptr<SSABasicBlock>, std::shared_ptr<SSANode>> definitions, startValues;
+    static std::uintptr_t getKind(std::shared_ptr<SSANode> node)
+    {
+        if(node->hasSideEffects())
+            return 0;
+        if(dynamic_cast<const SSAAdd *>(node.get()) != nullptr)
+            return 1;
+        if(dynamic_cast<const SSATypeCast *>(node.get()) != nullptr)
+            return 2;
+        if(dynamic_cast<const SSACompare *>(node.get()) != nullptr)
+            return 3;
+        if(dynamic_cast<const SSASelect *>(node.get()) != nullptr)
+            return 4;
+        return 0;
+    }
+    static bool dominates(std::shared_ptr<SSABasicBlock> dominator, std::shared_ptr<SSABasicBlock> block)
+    {
+        for(; block != nullptr; block = block->immediateDominator.lock())
+        {
+            if(block == dominator)
+                return true;
+        }
+        return false;
+    }
+    std::size_t addValueClass(const ValueClass &valueClass)
+    {
+        std::size_t retval = valueClasses.size();
+        valueClasses.push_back(valueClass);
+        liveNodes.emplace_back();
+        return retval;
+    }
+    std::size_t getValueClass(std::shared_ptr<SSANode> node)
+    {
+        auto iter = valueClassMap.find(node);
+        if(iter != valueClassMap.end())
+            return std::get<1>(*iter);
+        std::size_t retval;
+        ValueClass valueClass;
+        valueClass.node = node;
+        std::uintptr_t kind = getKind(node);
+        if(std::shared_ptr<SSAConstant> constant = std::dynamic_pointer_cast<SSAConstant>(node))
+        {
+            retval = valueClasses.size();
+            for(std::size_t i : constantClasses)
+            {
+                std::shared_ptr<ValueNode> value = std::static_pointer_cast<SSAConstant>(valueClasses[i].node)->value;
+                if(valueClasses[i].node->type == node->type && *value == *constant->value)
+                {
+                    retval = i;
+                    break;
+                }
+            }
+            if(retval == valueClasses.size())
+            {
+                valueClass.isConstant = true;
+                constantClasses.push_back(addValueClass(valueClass));
+            }
+        }
+        else if(kind != 0)
+        {
+            std::vector<std::uintptr_t> key{kind, reinterpret_cast<std::uintptr_t>(node->type.get())};
+            if(std::shared_ptr<SSACompare> compare = std::dynamic_pointer_cast<SSACompare>(node))
+                key.push_back(static_cast<std::uintptr_t>(compare->compareOperator));
+            std::vector<std::uintptr_t> operands;
+            for(std::shared_ptr<SSANode> input : node->getInputs())
+            {
+                std::size_t operand = getValueClass(input);
+                operands.push_back(operand);
+                valueClass.leaves.insert(valueClass.leaves.end(), valueClasses[operand].leaves.begin(), valueClasses[operand].leaves.end());
+                valueClass.depth = std::max(valueClass.depth, valueClasses[operand].depth + 1);
+            }
+            if(kind == 1) // add is commutative
+                std::sort(operands.begin(), operands.end());
+            key.insert(key.end(), operands.begin(), operands.end());
+            auto iter = expressionMap.find(key);
+            if(iter != expressionMap.end())
+                retval = std::get<1>(*iter);
+            else
+            {
+                std::sort(valueClass.leaves.begin(), valueClass.leaves.end());
+                valueClass.leaves.erase(std::unique(valueClass.leaves.begin(), valueClass.leaves.end()), valueClass.leaves.end());
+                valueClass.isExpression = true;
+                retval = addValueClass(valueClass);
+                expressionMap.emplace(key, retval);
+                // expressions of only constants are left to constant propagation, and a type cast alone
+                // is cheaper to compute again than to keep in a register
+                if(!valueClass.leaves.empty() && kind != 2)
+                    expressions.push_back(retval);
+            }
+        }
+        else
+        {
+            retval = valueClasses.size();
+            valueClass.leaves.push_back(retval);
+            addValueClass(valueClass);
+        }
+        valueClassMap[node] = retval;
+        return retval;
+    }
+    void addNode(std::shared_ptr<SSANode> node, std::size_t valueClass, std::shared_ptr<SSABasicBlock> block)
+    {
+        valueClassMap[node] = valueClass;
+        nodeBlocks[node] = block;
+        liveNodes[valueClass].push_back(node);
+    }
+    static void insertAtEnd(std::shared_ptr<SSABasicBlock> block, std::shared_ptr<SSANode> node)
+    {
+        assert(block->instructions.back() == block->controlTransferInstruction);
+        block->instructions.pop_back();
+        block->instructions.push_back(node);
+        block->instructions.push_back(block->controlTransferInstruction);
+    }
+    /// @return a node with the value of valueClass at the end of block, computing it there if needed
+    std::shared_ptr<SSANode> materialize(std::size_t valueClass, std::shared_ptr<SSABasicBlock> block)
+    {
+        if(valueClasses[valueClass].isConstant)
+        {
+            std::shared_ptr<SSAConstant> constant = std::static_pointer_cast<SSAConstant>(valueClasses[valueClass].node);
+            std::shared_ptr<SSANode> node = std::make_shared<SSAConstant>(constant->value, constant->spillLocation);
+            insertAtEnd(block, node);
+            addNode(node, valueClass, block);
+            return node;
+        }
+        if(!valueClasses[valueClass].isExpression) // leaves dominate the places their expressions are anticipated
+            return valueClasses[valueClass].node;
+        for(std::shared_ptr<SSANode> node : liveNodes[valueClass])
+        {
+            if(dominates(nodeBlocks[node], block))
+                return node;
+        }
+        assert(!liveNodes[valueClass].empty());
+        std::shared_ptr<SSANode> representative = liveNodes[valueClass].front();
+        ReplacementMap inputReplacements;
+        for(std::shared_ptr<SSANode> input : representative->getInputs())
+        {
+            if(inputReplacements.count(input) != 0)
+                continue;
+            auto iter = valueClassMap.find(input);
+            assert(iter != valueClassMap.end());
+            inputReplacements.emplace(input, SSANode::ReplacementNode(materialize(std::get<1>(*iter), block), false));
+        }
+        std::shared_ptr<SSANode> node = SSANodeDuplicator::duplicate(representative, inputReplacements);
+        insertAtEnd(block, node);
+        addNode(node, valueClass, block);
+        return node;
+    }
+    std::shared_ptr<SSANode> getValueAtEnd(std::shared_ptr<SSABasicBlock> block)
+    {
+        auto iter = definitions.find(block);
+        if(iter != definitions.end())
+            return std::get<1>(*iter);
+        return getValueAtStart(block);
+    }
+    std::shared_ptr<SSANode> getValueAtStart(std::shared_ptr<SSABasicBlock> block)
+    {
+        auto iter = startValues.find(block);
+        if(iter != startValues.end())
+            return std::get<1>(*iter);
+        assert(!block->sourceBlocks.empty()); // lazy code motion makes the value available everywhere it's used
+        if(block->sourceBlocks.size() == 1)
+        {
+            std::shared_ptr<SSANode> retval = getValueAtEnd(block->sourceBlocks.front().lock());
+            startValues[block] = retval;
+            return retval;
+        }
+        std::shared_ptr<SSANode> representative = liveNodes[currentValueClass].front();
+        std::shared_ptr<SSAPhi> phi = std::make_shared<SSAPhi>(representative->type, representative->spillLocation);
+        startValues[block] = phi; // set before the inputs so loops end at the phi function
+        for(std::weak_ptr<SSABasicBlock> sourceBlock : block->sourceBlocks)
+            phi->inputs.push_back(SSAPhi::PhiInput{getValueAtEnd(sourceBlock.lock()), sourceBlock});
+        block->instructions.push_front(phi);
+        addNode(phi, currentValueClass, block);
+        return phi;
+    }
+    /// @return true if a later computation in the same block was replaced by an earlier one
+    bool removeLocalRedundancies(std::shared_ptr<SSAFunction> function)
+    {
+        ReplacementMap replacements;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            std::unordered_map<std::size_t, std::shared_ptr<SSANode>> blockNodes;
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                nodeBlocks[node] = block;
+                std::size_t valueClass = getValueClass(node);
+                if(!valueClasses[valueClass].isExpression)
+                    continue;
+                auto iter = blockNodes.find(valueClass);
+                if(iter != blockNodes.end())
+                    replacements.emplace(node, SSANode::ReplacementNode(std::get<1>(*iter), true));
+                else
+                {
+                    blockNodes.emplace(valueClass, node);
+                    liveNodes[valueClass].push_back(node);
+                }
+            }
+        }
+        if(replacements.empty())
+            return false;
+        function->replaceNodes(replacements);
+        return true;
+    }
+    static std::shared_ptr<SSABasicBlock> splitEdge(std::shared_ptr<SSAFunction> function, std::shared_ptr<SSABasicBlock> sourceBlock, std::shared_ptr<SSABasicBlock> destBlock)
+    {
+        std::shared_ptr<SSABasicBlock> newBlock = std::make_shared<SSABasicBlock>(function->context);
+        newBlock->controlTransferInstruction = std::make_shared<SSAUnconditionalJump>(function->context, destBlock);
+        newBlock->instructions.push_back(newBlock->controlTransferInstruction);
+        sourceBlock->controlTransferInstruction->replaceBlock(destBlock, newBlock);
+        for(std::shared_ptr<SSANode> node : destBlock->instructions)
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+            if(phi == nullptr)
+                break;
+            phi->replaceBlock(sourceBlock, newBlock);
+        }
+        auto insertPosition = function->blocks.begin();
+        while(*insertPosition != sourceBlock)
+            ++insertPosition;
+        function->blocks.insert(++insertPosition, newBlock);
+        return newBlock;
+    }
+public:
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        if(function->startBlock == nullptr || !function->startBlock->sourceBlocks.empty())
+            return;
+        if(removeLocalRedundancies(function))
+            ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        std::size_t bitCount = expressions.size();
+        if(bitCount == 0)
+            return;
+
+        // local properties : every block computes an expression at most once now
+        std::unordered_map<std::shared_ptr<SSABasicBlock>, std::unordered_map<std::size_t, std::shared_ptr<SSANode>>> blockComputations;
+        std::unordered_map<std::shared_ptr<SSABasicBlock>, bit_vector> computed, notTransparent, locallyAnticipated;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            computed[block] = bit_vector(bitCount);
+            notTransparent[block] = bit_vector(bitCount);
+        }
+        for(std::size_t bit = 0; bit < bitCount; bit++)
+        {
+            for(std::size_t leaf : valueClasses[expressions[bit]].leaves)
+            {
+                auto iter = nodeBlocks.find(valueClasses[leaf].node);
+                if(iter != nodeBlocks.end())
+                    notTransparent[std::get<1>(*iter)].set(bit);
+            }
+            for(std::shared_ptr<SSANode> node : liveNodes[expressions[bit]])
+            {
+                computed[nodeBlocks[node]].set(bit);
+                blockComputations[nodeBlocks[node]][bit] = node;
+            }
+        }
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            locallyAnticipated[block] = computed[block];
+            locallyAnticipated[block].subtract(notTransparent[block]);
+        }
+
+        // global properties
+        DataflowSolver<SSABasicBlock> availableSolver(function->startBlock, function->blocks, DataflowDirection::Forward, DataflowMeet::Intersection);
+        DataflowSolver<SSABasicBlock> anticipatedSolver(function->startBlock, function->blocks, DataflowDirection::Backward, DataflowMeet::Intersection);
+        DataflowSolver<SSABasicBlock> laterSolver(function->startBlock, function->blocks, DataflowDirection::Forward, DataflowMeet::Intersection);
+        auto getBlockValues = [](const DataflowSolver<SSABasicBlock> &solver, std::unordered_map<std::shared_ptr<SSABasicBlock>, bit_vector> &values)
+        {
+            std::vector<bit_vector> retval;
+            for(std::size_t i = 0; i < solver.getBlockCount(); i++)
+                retval.push_back(values[solver.getBlock(i)]);
+            return retval;
+        };
+        availableSolver.solve(getBlockValues(availableSolver, computed), getBlockValues(availableSolver, notTransparent), bitCount);
+        anticipatedSolver.solve(getBlockValues(anticipatedSolver, locallyAnticipated), getBlockValues(anticipatedSolver, notTransparent), bitCount);
+        std::unordered_map<std::shared_ptr<SSABasicBlock>, bit_vector> anticipatedIn, earliestOut;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            anticipatedIn[block] = anticipatedSolver.getValueAtStart(anticipatedSolver.getBlockIndex(block));
+            // earliest(block, successor) = anticipatedIn(successor) & earliestOut(block)
+            bit_vector notEarliest = anticipatedSolver.getValueAtEnd(anticipatedSolver.getBlockIndex(block));
+            bit_vector transparent(bitCount, true);
+            transparent.subtract(notTransparent[block]);
+            notEarliest.merge_intersection(transparent);
+            notEarliest.merge_union(availableSolver.getValueAtEnd(availableSolver.getBlockIndex(block)));
+            earliestOut[block] = bit_vector(bitCount, true);
+            earliestOut[block].subtract(notEarliest);
+        }
+        // later(block, successor) = anticipatedIn(successor) & laterOut(block), so laterIn(block) = anticipatedIn(block) & the meet
+        std::vector<bit_vector> laterAnticipatedIn = getBlockValues(laterSolver, anticipatedIn);
+        std::vector<bit_vector> laterLocallyAnticipated = getBlockValues(laterSolver, locallyAnticipated);
+        std::vector<bit_vector> laterEarliestOut = getBlockValues(laterSolver, earliestOut);
+        laterSolver.solve([&](std::size_t blockIndex, const bit_vector &input, bit_vector &output)
+        {
+            output.merge_intersection(laterAnticipatedIn[blockIndex]);
+            output.subtract(laterLocallyAnticipated[blockIndex]);
+            output.merge_union(laterEarliestOut[blockIndex]);
+        }, bit_vector(bitCount, true)); // the edge into the start block is the earliest place for everything anticipated there
+        std::unordered_map<std::shared_ptr<SSABasicBlock>, bit_vector> laterIn;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            laterIn[block] = laterSolver.getValueAtStart(laterSolver.getBlockIndex(block));
+            laterIn[block].merge_intersection(anticipatedIn[block]);
+        }
+
+        // insert on the edges where later(block, successor) & ~laterIn(successor) and delete locallyAnticipated & ~laterIn
+        std::vector<std::pair<std::shared_ptr<SSABasicBlock>, bit_vector>> insertions;
+        std::unordered_map<std::shared_ptr<SSABasicBlock>, bit_vector> deletions;
+        std::vector<std::vector<std::shared_ptr<SSABasicBlock>>> insertionBlocks(bitCount), deletionBlocks(bitCount);
+        bool anyChanges = false;
+        std::vector<std::shared_ptr<SSABasicBlock>> blocks(function->blocks.begin(), function->blocks.end());
+        for(std::shared_ptr<SSABasicBlock> block : blocks)
+        {
+            deletions[block] = locallyAnticipated[block];
+            deletions[block].subtract(laterIn[block]);
+            if(deletions[block].any())
+                anyChanges = true;
+            std::list<std::weak_ptr<SSABasicBlock>> destBlocks = block->destBlocks;
+            for(std::weak_ptr<SSABasicBlock> destBlockW : destBlocks)
+            {
+                std::shared_ptr<SSABasicBlock> destBlock = destBlockW.lock();
+                bit_vector inserted = laterSolver.getValueAtEnd(laterSolver.getBlockIndex(block));
+                inserted.merge_intersection(anticipatedIn[destBlock]);
+                inserted.subtract(laterIn[destBlock]);
+                if(!inserted.any())
+                    continue;
+                anyChanges = true;
+                if(destBlocks.size() == 1)
+                    insertions.emplace_back(block, inserted);
+                else // destBlock has other predecessors or laterIn(destBlock) would be later(block, destBlock)
+                    insertions.emplace_back(splitEdge(function, block, destBlock), inserted);
+            }
+        }
+        if(!anyChanges)
+            return;
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+        for(const std::pair<std::shared_ptr<SSABasicBlock>, bit_vector> &insertion : insertions)
+        {
+            std::get<1>(insertion).for_each_set_bit([&](std::size_t bit)
+            {
+                insertionBlocks[bit].push_back(std::get<0>(insertion));
+            });
+        }
+        for(const std::pair<const std::shared_ptr<SSABasicBlock>, bit_vector> &deletion : deletions)
+        {
+            std::get<1>(deletion).for_each_set_bit([&](std::size_t bit)
+            {
+                deletionBlocks[bit].push_back(std::get<0>(deletion));
+            });
+        }
+
+        // inner expressions first, so the expressions using them can find their values
+        std::vector<std::size_t> bits;
+        for(std::size_t bit = 0; bit < bitCount; bit++)
+        {
+            if(!insertionBlocks[bit].empty() || !deletionBlocks[bit].empty())
+                bits.push_back(bit);
+        }
+        std::stable_sort(bits.begin(), bits.end(), [&](std::size_t a, std::size_t b)
+        {
+            return valueClasses[expressions[a]].depth < valueClasses[expressions[b]].depth;
+        });
+        for(std::size_t bit : bits)
+        {
+            currentValueClass = expressions[bit];
+            definitions.clear();
+            startValues.clear();
+            std::unordered_set<std::shared_ptr<SSANode>> deletedNodes;
+            for(std::shared_ptr<SSABasicBlock> block : deletionBlocks[bit])
+                deletedNodes.insert(blockComputations[block][bit]);
+            for(std::shared_ptr<SSANode> node : liveNodes[currentValueClass])
+            {
+                if(deletedNodes.count(node) == 0)
+                    definitions[nodeBlocks[node]] = node;
+            }
+            for(std::shared_ptr<SSABasicBlock> block : insertionBlocks[bit])
+                definitions[block] = materialize(currentValueClass, block);
+            ReplacementMap replacements;
+            for(std::shared_ptr<SSABasicBlock> block : deletionBlocks[bit])
+                replacements.emplace(blockComputations[block][bit], SSANode::ReplacementNode(getValueAtStart(block), true));
+            std::vector<std::shared_ptr<SSANode>> &nodes = liveNodes[currentValueClass];
+            nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [&](std::shared_ptr<SSANode> node)
+            {
+                return deletedNodes.count(node) != 0;
+            }), nodes.end());
+            if(!replacements.empty())
+                function->replaceNodes(replacements);
+        }
+    }
+};
+
+#endif // PARTIAL_REDUNDANCY_ELIMINATION_H_INCLUDED
@@ -0,0 +1,202 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef VALUE_RANGE_PROPAGATION_H_INCLUDED
+#define VALUE_RANGE_PROPAGATION_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "ssa/ssa_value_range_analysis.h"
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include "construct_basic_block_graph.h"
+
+/** uses the ranges from SSAValueRangeAnalysis to simplify nodes
+ *
+ * Values with only one possible value become constants, which lets ConstantPropagationAndDeadCodeElimination
+ * remove the branches that can't be taken. Extending an integer and truncating it back is removed if the
+ * value fits, comparisons of extended integers are done on the narrower integers instead and signed integers
+ * that can't be negative are zero extended.
+ */
+class ValueRangePropagation final
+{
+private:
+    typedef SSAValueRangeAnalysis::ValueRange ValueRange;
+    std::shared_ptr<ValueNode> makeValue(std::shared_ptr<TypeNode> type, std::uint64_t value)
+    {
+        type = type->toNonConstant()->toNonVolatile();
+        if(dynamic_cast<const TypeBoolean *>(type.get()) != nullptr)
+            return std::make_shared<ValueBoolean>(type->context, value != 0);
+        std::shared_ptr<TypeInteger> typeInteger = std::dynamic_pointer_cast<TypeInteger>(type);
+        assert(typeInteger != nullptr);
+        return std::make_shared<ValueInteger>(type->context, typeInteger->isUnsigned, typeInteger->width, value);
+    }
+    /// @return true if casting node to type keeps its value
+    static bool isValueKept(const SSAValueRangeAnalysis &valueRanges, std::shared_ptr<SSANode> node, std::shared_ptr<TypeNode> type)
+    {
+        ValueRange range, typeRange;
+        if(!valueRanges.getRange(node, range) || !SSAValueRangeAnalysis::getTypeRange(type, typeRange))
+            return false;
+        if(dynamic_cast<const TypeBoolean *>(type->toNonConstant()->toNonVolatile().get()) != nullptr || dynamic_cast<const TypeBoolean *>(node->type->toNonConstant()->toNonVolatile().get()) != nullptr)
+            return false;
+        return range.isInside(typeRange);
+    }
+    /// @return the unsigned integer type with the same width as type or nullptr if type isn't a signed integer
+    static std::shared_ptr<TypeNode> getUnsignedType(std::shared_ptr<TypeNode> type)
+    {
+        std::shared_ptr<TypeInteger> typeInteger = std::dynamic_pointer_cast<TypeInteger>(type->toNonConstant()->toNonVolatile());
+        if(typeInteger == nullptr || typeInteger->isUnsigned)
+            return nullptr;
+        return TypeInteger::make(type->context, true, typeInteger->width);
+    }
+    /// @return the node that was cast if casting it kept its value, going through all the casts that keep it
+    static std::shared_ptr<SSANode> getUncastNode(const SSAValueRangeAnalysis &valueRanges, std::shared_ptr<SSANode> node)
+    {
+        std::shared_ptr<SSANode> retval = nullptr;
+        for(std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node); typeCast != nullptr; typeCast = std::dynamic_pointer_cast<SSATypeCast>(retval))
+        {
+            if(!isValueKept(valueRanges, typeCast->arg.lock(), typeCast->type))
+                break;
+            retval = typeCast->arg.lock();
+        }
+        return retval;
+    }
+public:
+    void visitSSAFunction(std::shared_ptr<SSAFunction> function)
+    {
+        SSAValueRangeAnalysis valueRanges(function);
+        std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> nodeReplacementMap;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            if(!valueRanges.isReachable(block))
+                continue;
+            std::vector<std::shared_ptr<SSANode>> phiConstants;
+            for(auto iter = block->instructions.begin(); iter != block->instructions.end(); ++iter)
+            {
+                std::shared_ptr<SSANode> node = *iter;
+                if(node->hasSideEffects() || dynamic_cast<const SSAConstant *>(node.get()) != nullptr || dynamic_cast<const SSAControlTransfer *>(node.get()) != nullptr)
+                    continue;
+                ValueRange range;
+                if(valueRanges.getRange(node, range) && range.isSingleValue())
+                {
+                    std::shared_ptr<SSANode> constant = std::make_shared<SSAConstant>(makeValue(node->type, range.min), nullptr);
+                    if(dynamic_cast<const SSAPhi *>(node.get()) != nullptr) // constants go after the phis
+                    {
+                        phiConstants.push_back(constant);
+                        nodeReplacementMap.emplace(node, SSANode::ReplacementNode(constant, true));
+                    }
+                    else
+                        nodeReplacementMap.emplace(node, SSANode::ReplacementNode(constant, false));
+                    continue;
+                }
+                if(std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node))
+                {
+                    std::shared_ptr<SSANode> arg = typeCast->arg.lock();
+                    std::shared_ptr<TypeNode> unsignedType = getUnsignedType(arg->type);
+                    // cast(T, x) -> cast(T, cast(unsigned, x)) if T is wider and x isn't negative, so it can be zero extended
+                    if(unsignedType != nullptr && dynamic_cast<const TypeInteger *>(typeCast->type->toNonConstant()->toNonVolatile().get()) != nullptr
+                       && typeCast->type->getTypeProperties().size > arg->type->getTypeProperties().size && isValueKept(valueRanges, arg, unsignedType))
+                    {
+                        std::shared_ptr<SSANode> unsignedArg = std::make_shared<SSATypeCast>(arg, unsignedType, nullptr);
+                        iter = block->instructions.insert(iter, unsignedArg);
+                        ++iter;
+                        typeCast->arg = unsignedArg;
+                        continue;
+                    }
+                    // cast(T, cast(U, x)) -> cast(T, x) if x fits in U and T
+                    arg = getUncastNode(valueRanges, arg);
+                    if(arg == nullptr || !isValueKept(valueRanges, arg, typeCast->type))
+                        continue;
+                    unsignedType = getUnsignedType(arg->type);
+                    if(unsignedType != nullptr && unsignedType == typeCast->arg.lock()->type->toNonConstant()->toNonVolatile()
+                       && typeCast->type->getTypeProperties().size > arg->type->getTypeProperties().size) // made by the rule above
+                        continue;
+                    if(arg->type->toNonConstant()->toNonVolatile() == typeCast->type->toNonConstant()->toNonVolatile())
+                        nodeReplacementMap.emplace(node, SSANode::ReplacementNode(arg, true));
+                    else
+                        typeCast->arg = arg;
+                }
+                else if(std::shared_ptr<SSACompare> compare = std::dynamic_pointer_cast<SSACompare>(node))
+                {
+                    // cast(T, x) < cast(T, y) -> x < y and cast(T, x) < y -> x < cast(typeof(x), y) if the casts keep the values
+                    std::shared_ptr<SSANode> lhs = getUncastNode(valueRanges, compare->lhs.lock());
+                    std::shared_ptr<SSANode> rhs = getUncastNode(valueRanges, compare->rhs.lock());
+                    if(lhs != nullptr && rhs != nullptr)
+                    {
+                        if(lhs->type->toNonConstant()->toNonVolatile() != rhs->type->toNonConstant()->toNonVolatile())
+                            continue;
+                        compare->lhs = lhs;
+                        compare->rhs = rhs;
+                        continue;
+                    }
+                    std::shared_ptr<SSANode> uncast = lhs != nullptr ? lhs : rhs;
+                    if(uncast == nullptr)
+                        continue;
+                    std::shared_ptr<TypeNode> type = uncast->type->toNonConstant()->toNonVolatile();
+                    std::shared_ptr<SSANode> other = lhs != nullptr ? compare->rhs.lock() : compare->lhs.lock();
+                    if(!isValueKept(valueRanges, other, type))
+                        continue;
+                    std::shared_ptr<SSANode> newOther;
+                    if(std::shared_ptr<SSAConstant> constant = std::dynamic_pointer_cast<SSAConstant>(other))
+                    {
+                        ValueRange constantRange;
+                        if(!SSAValueRangeAnalysis::getValueRange(constant->value, constantRange))
+                            continue;
+                        newOther = std::make_shared<SSAConstant>(makeValue(type, constantRange.min), nullptr);
+                    }
+                    else
+                        newOther = std::make_shared<SSATypeCast>(other, type, nullptr);
+                    iter = block->instructions.insert(iter, newOther);
+                    ++iter;
+                    if(lhs != nullptr)
+                    {
+                        compare->lhs = lhs;
+                        compare->rhs = newOther;
+                    }
+                    else
+                    {
+                        compare->lhs = newOther;
+                        compare->rhs = rhs;
+                    }
+                }
+            }
+            if(!phiConstants.empty())
+            {
+                auto iter = std::find_if(block->instructions.begin(), block->instructions.end(), [](const std::shared_ptr<SSANode> &node)
+                {
+                    return dynamic_cast<const SSAPhi *>(node.get()) == nullptr;
+                });
+                block->instructions.insert(iter, phiConstants.begin(), phiConstants.end());
+            }
+            // the condition can be known in this block even if it isn't everywhere
+            std::shared_ptr<SSAConditionalJump> conditionalJump = std::dynamic_pointer_cast<SSAConditionalJump>(block->controlTransferInstruction);
+            if(conditionalJump == nullptr || nodeReplacementMap.count(conditionalJump->condition.lock()) != 0 || dynamic_cast<const SSAConstant *>(conditionalJump->condition.lock().get()) != nullptr)
+                continue;
+            ValueRange condition;
+            if(!valueRanges.getRangeInBlock(conditionalJump->condition.lock(), block, condition) || !condition.isSingleValue())
+                continue;
+            std::shared_ptr<SSANode> newCondition = std::make_shared<SSAConstant>(makeValue(TypeBoolean::make(function->context), condition.min), nullptr);
+            block->instructions.insert(std::find(block->instructions.begin(), block->instructions.end(), conditionalJump), newCondition);
+            conditionalJump->condition = newCondition;
+        }
+        function->replaceNodes(nodeReplacementMap);
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(function);
+    }
+};
+
+#endif // VALUE_RANGE_PROPAGATION_H_INCLUDED
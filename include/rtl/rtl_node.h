@@ -106,8 +106,11 @@ public:
 
 class RTLLoadConstant;
 class RTLMove;
+class RTLSelect;
 class RTLLoad;
 class RTLStore;
+class RTLMemoryCopy;
+class RTLMemoryFill;
 class RTLUnconditionalJump;
 class RTLConditionalJump;
 class RTLCompare;
@@ -119,9 +122,12 @@ class RTLNodeVisitor
 public:
     virtual void visitRTLLoadConstant(std::shared_ptr<RTLLoadConstant> node) = 0;
     virtual void visitRTLMove(std::shared_ptr<RTLMove> node) = 0;
+    virtual void visitRTLSelect(std::shared_ptr<RTLSelect> node) = 0;
     virtual void visitRTLUnconditionalJump(std::shared_ptr<RTLUnconditionalJump> node) = 0;
     virtual void visitRTLLoad(std::shared_ptr<RTLLoad> node) = 0;
     virtual void visitRTLStore(std::shared_ptr<RTLStore> node) = 0;
+    virtual void visitRTLMemoryCopy(std::shared_ptr<RTLMemoryCopy> node) = 0;
+    virtual void visitRTLMemoryFill(std::shared_ptr<RTLMemoryFill> node) = 0;
     virtual void visitRTLConditionalJump(std::shared_ptr<RTLConditionalJump> node) = 0;
     virtual void visitRTLCompare(std::shared_ptr<RTLCompare> node) = 0;
     virtual void visitRTLTypeCast(std::shared_ptr<RTLTypeCast> node) = 0;
@@ -281,6 +287,50 @@ public:
     }
 };
 
+class RTLSelect final : public RTLNode
+{
+public:
+    std::shared_ptr<RTLRegister> destRegister;
+    std::shared_ptr<RTLRegister> conditionRegister;
+    std::shared_ptr<RTLRegister> trueRegister;
+    std::shared_ptr<RTLRegister> falseRegister;
+    std::shared_ptr<TypeNode> type;
+    RTLSelect(std::shared_ptr<RTLRegister> destRegister, std::shared_ptr<RTLRegister> conditionRegister, std::shared_ptr<RTLRegister> trueRegister, std::shared_ptr<RTLRegister> falseRegister, std::shared_ptr<TypeNode> type)
+        : RTLNode(type->context), destRegister(destRegister), conditionRegister(conditionRegister), trueRegister(trueRegister), falseRegister(falseRegister), type(type)
+    {
+    }
+    virtual std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>> getOutputRegisters() const override
+    {
+        return std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>>{std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>{destRegister, type}};
+    }
+    virtual std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>> getInputRegisters() const override
+    {
+        return std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>>{std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>{conditionRegister, TypeBoolean::make(context)}, std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>{trueRegister, type}, std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>{falseRegister, type}};
+    }
+    virtual void visit(RTLNodeVisitor &visitor) override
+    {
+        visitor.visitRTLSelect(std::static_pointer_cast<RTLSelect>(shared_from_this()));
+    }
+    virtual std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>>> evaluateForConstants(const std::unordered_map<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>> &values) override
+    {
+        std::shared_ptr<ValueNode> value = nullptr;
+        auto iter = values.find(conditionRegister);
+        if(iter != values.end())
+        {
+            if(std::shared_ptr<ValueBoolean> conditionValue = std::dynamic_pointer_cast<ValueBoolean>(std::get<1>(*iter)))
+            {
+                iter = values.find(conditionValue->value ? trueRegister : falseRegister);
+                if(iter != values.end())
+                    value = std::get<1>(*iter);
+            }
+        }
+        return std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>>>
+        {
+            std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>>(destRegister, value)
+        };
+    }
+};
+
 class RTLLoad final : public RTLNode
 {
 public:
@@ -347,6 +397,78 @@ public:
     }
 };
 
+/// copies count elements one at a time in increasing address order
+class RTLMemoryCopy final : public RTLNode
+{
+public:
+    std::shared_ptr<RTLRegister> destAddressRegister;
+    std::shared_ptr<RTLRegister> sourceAddressRegister;
+    std::shared_ptr<TypeNode> addressType;
+    std::uint64_t count;
+    bool mayOverlap;
+    RTLMemoryCopy(std::shared_ptr<RTLRegister> destAddressRegister, std::shared_ptr<RTLRegister> sourceAddressRegister, std::shared_ptr<TypeNode> addressType, std::uint64_t count, bool mayOverlap)
+        : RTLNode(addressType->context), destAddressRegister(destAddressRegister), sourceAddressRegister(sourceAddressRegister), addressType(addressType), count(count), mayOverlap(mayOverlap)
+    {
+    }
+    virtual std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>> getOutputRegisters() const override
+    {
+        return std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>>{};
+    }
+    virtual std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>> getInputRegisters() const override
+    {
+        return std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>>{std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>{destAddressRegister, addressType}, std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>{sourceAddressRegister, addressType}};
+    }
+    virtual void visit(RTLNodeVisitor &visitor) override
+    {
+        visitor.visitRTLMemoryCopy(std::static_pointer_cast<RTLMemoryCopy>(shared_from_this()));
+    }
+    virtual bool hasSideEffects() const override
+    {
+        return true;
+    }
+    virtual std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>>> evaluateForConstants(const std::unordered_map<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>> &values) override
+    {
+        return std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>>>
+        {
+        };
+    }
+};
+
+class RTLMemoryFill final : public RTLNode
+{
+public:
+    std::shared_ptr<RTLRegister> destAddressRegister;
+    std::shared_ptr<RTLRegister> valueRegister;
+    std::shared_ptr<TypeNode> addressType;
+    std::uint64_t count;
+    RTLMemoryFill(std::shared_ptr<RTLRegister> destAddressRegister, std::shared_ptr<RTLRegister> valueRegister, std::shared_ptr<TypeNode> addressType, std::uint64_t count)
+        : RTLNode(addressType->context), destAddressRegister(destAddressRegister), valueRegister(valueRegister), addressType(addressType), count(count)
+    {
+    }
+    virtual std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>> getOutputRegisters() const override
+    {
+        return std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>>{};
+    }
+    virtual std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>> getInputRegisters() const override
+    {
+        return std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>>{std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>{destAddressRegister, addressType}, std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<TypeNode>>{valueRegister, addressType->dereference()}};
+    }
+    virtual void visit(RTLNodeVisitor &visitor) override
+    {
+        visitor.visitRTLMemoryFill(std::static_pointer_cast<RTLMemoryFill>(shared_from_this()));
+    }
+    virtual bool hasSideEffects() const override
+    {
+        return true;
+    }
+    virtual std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>>> evaluateForConstants(const std::unordered_map<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>> &values) override
+    {
+        return std::list<std::pair<std::shared_ptr<RTLRegister>, std::shared_ptr<ValueNode>>>
+        {
+        };
+    }
+};
+
 class RTLCompare final : public RTLNode
 {
 public:
@@ -0,0 +1,246 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef SSA_ALIAS_ANALYSIS_H_INCLUDED
+#define SSA_ALIAS_ANALYSIS_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include "util/variable.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <cassert>
+
+/** finds which memory accesses can touch the same bytes
+ *
+ * Addresses are split into a base and a constant byte offset by looking through pointer type casts
+ * and additions of constants. The base is a variable, a constant address or any other node.
+ * Distinct variables never overlap, and local variables can't be at a constant address.
+ * A local variable whose address is only used to load, store, copy or fill doesn't escape,
+ * so pointers that aren't derived from its address can't point into it.
+ */
+class SSAAliasAnalysis final
+{
+public:
+    struct MemoryLocation final
+    {
+        enum class Kind
+        {
+            Variable,
+            Constant,
+            Node,
+        };
+        Kind kind = Kind::Node;
+        std::shared_ptr<VariableDescriptor> variable;
+        std::shared_ptr<SSANode> base;
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+    };
+    enum class AliasResult
+    {
+        NoAlias,
+        MayAlias,
+        MustAlias,
+    };
+private:
+    typedef std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<ValueNode>> ValueMap;
+    ValueMap values;
+    std::unordered_map<std::shared_ptr<SSANode>, MemoryLocation> addressLocations;
+    std::unordered_set<std::shared_ptr<VariableDescriptor>> escapedVariables;
+    static bool isPointer(std::shared_ptr<TypeNode> type)
+    {
+        return dynamic_cast<const TypePointer *>(type->toNonConstant()->toNonVolatile().get()) != nullptr;
+    }
+    std::shared_ptr<ValueInteger> getConstantInteger(std::shared_ptr<SSANode> node) const
+    {
+        auto iter = values.find(node);
+        if(iter == values.end())
+            return nullptr;
+        return std::dynamic_pointer_cast<ValueInteger>(std::get<1>(*iter));
+    }
+    MemoryLocation makeAddressLocation(std::shared_ptr<SSANode> address)
+    {
+        std::uint64_t offset = 0;
+        MemoryLocation retval;
+        for(std::shared_ptr<SSANode> node = address; ; )
+        {
+            if(std::shared_ptr<SSAAllocA> allocA = std::dynamic_pointer_cast<SSAAllocA>(node))
+            {
+                retval.kind = MemoryLocation::Kind::Variable;
+                retval.variable = allocA->getVariableDescriptor();
+                break;
+            }
+            if(std::shared_ptr<SSAConstant> constant = std::dynamic_pointer_cast<SSAConstant>(node))
+            {
+                if(std::shared_ptr<ValueVariablePointer> value = std::dynamic_pointer_cast<ValueVariablePointer>(constant->value))
+                {
+                    retval.kind = MemoryLocation::Kind::Variable;
+                    retval.variable = value->location.variable;
+                    offset += value->location.offset;
+                    break;
+                }
+                if(dynamic_cast<const ValueNullPointer *>(constant->value.get()) != nullptr)
+                {
+                    retval.kind = MemoryLocation::Kind::Constant;
+                    break;
+                }
+            }
+            else if(std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node))
+            {
+                std::shared_ptr<SSANode> arg = typeCast->arg.lock();
+                if(isPointer(typeCast->type) && isPointer(arg->type))
+                {
+                    node = arg;
+                    continue;
+                }
+                std::shared_ptr<ValueInteger> value = getConstantInteger(arg);
+                if(isPointer(typeCast->type) && value != nullptr)
+                {
+                    retval.kind = MemoryLocation::Kind::Constant;
+                    offset += static_cast<std::uint64_t>(value->getSignedValue());
+                    break;
+                }
+            }
+            else if(std::shared_ptr<SSAAdd> add = std::dynamic_pointer_cast<SSAAdd>(node))
+            {
+                std::shared_ptr<SSANode> pointer = add->lhs.lock(), index = add->rhs.lock();
+                if(!isPointer(pointer->type))
+                    std::swap(pointer, index);
+                std::shared_ptr<ValueInteger> value = getConstantInteger(index);
+                if(isPointer(add->type) && isPointer(pointer->type) && value != nullptr)
+                {
+                    offset += static_cast<std::uint64_t>(value->getSignedValue()) * pointer->type->dereference()->getTypeProperties().size;
+                    node = pointer;
+                    continue;
+                }
+            }
+            retval.kind = MemoryLocation::Kind::Node;
+            retval.base = node;
+            break;
+        }
+        std::uint64_t pointerSize = address->type->getTypeProperties().size;
+        if(retval.kind == MemoryLocation::Kind::Constant && pointerSize < 8)
+            offset &= (static_cast<std::uint64_t>(1) << (pointerSize * 8)) - 1;
+        retval.offset = offset;
+        return retval;
+    }
+    /// @return true if user only accesses memory through address or derives another address from it
+    bool isNonEscapingUse(std::shared_ptr<SSANode> user, std::shared_ptr<SSANode> address)
+    {
+        if(dynamic_cast<const SSALoad *>(user.get()) != nullptr || dynamic_cast<const SSAMemoryCopy *>(user.get()) != nullptr)
+            return true;
+        if(std::shared_ptr<SSAStore> store = std::dynamic_pointer_cast<SSAStore>(user))
+            return store->value.lock() != address;
+        if(std::shared_ptr<SSAMemoryFill> memoryFill = std::dynamic_pointer_cast<SSAMemoryFill>(user))
+            return memoryFill->value.lock() != address;
+        if(dynamic_cast<const SSATypeCast *>(user.get()) != nullptr || dynamic_cast<const SSAAdd *>(user.get()) != nullptr)
+        {
+            const MemoryLocation &location = getAddressLocation(user);
+            return location.kind == MemoryLocation::Kind::Variable && location.variable == getAddressLocation(address).variable;
+        }
+        return false;
+    }
+    static bool rangesOverlap(const MemoryLocation &a, const MemoryLocation &b)
+    {
+        return a.offset - b.offset < b.size || b.offset - a.offset < a.size;
+    }
+    bool isNonEscapingLocal(const MemoryLocation &location) const
+    {
+        return location.kind == MemoryLocation::Kind::Variable && location.variable->getKind() == VariableDescriptor::Kind::LocalVariable
+            && escapedVariables.count(location.variable) == 0;
+    }
+public:
+    explicit SSAAliasAnalysis(std::shared_ptr<SSAFunction> function)
+    {
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                for(std::shared_ptr<SSANode> node : block->instructions)
+                {
+                    if(dynamic_cast<const SSAPhi *>(node.get()) != nullptr || values.count(node) != 0)
+                        continue;
+                    std::shared_ptr<ValueNode> value = node->evaluateForConstants(values);
+                    if(value == nullptr || dynamic_cast<const ValueUnknown *>(value.get()) != nullptr)
+                        continue;
+                    values[node] = value;
+                    done = false;
+                }
+            }
+        }
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                for(std::shared_ptr<SSANode> input : node->getInputs())
+                {
+                    if(!isPointer(input->type))
+                        continue;
+                    const MemoryLocation &location = getAddressLocation(input);
+                    if(location.kind == MemoryLocation::Kind::Variable && !isNonEscapingUse(node, input))
+                        escapedVariables.insert(location.variable);
+                }
+            }
+        }
+        if(function->returnValue != nullptr && isPointer(function->returnValue->type))
+        {
+            const MemoryLocation &location = getAddressLocation(function->returnValue);
+            if(location.kind == MemoryLocation::Kind::Variable)
+                escapedVariables.insert(location.variable);
+        }
+    }
+    const MemoryLocation &getAddressLocation(std::shared_ptr<SSANode> address)
+    {
+        auto iter = addressLocations.find(address);
+        if(iter == addressLocations.end())
+            iter = std::get<0>(addressLocations.emplace(address, makeAddressLocation(address)));
+        return std::get<1>(*iter);
+    }
+    /// @return the bytes from address to address + size
+    MemoryLocation getLocation(std::shared_ptr<SSANode> address, std::uint64_t size)
+    {
+        MemoryLocation retval = getAddressLocation(address);
+        retval.size = size;
+        return retval;
+    }
+    AliasResult alias(const MemoryLocation &a, const MemoryLocation &b) const
+    {
+        if(a.size == 0 || b.size == 0)
+            return AliasResult::NoAlias;
+        if(a.kind == b.kind && a.variable == b.variable && a.base == b.base)
+        {
+            if(a.offset == b.offset && a.size == b.size)
+                return AliasResult::MustAlias;
+            if(!rangesOverlap(a, b))
+                return AliasResult::NoAlias;
+            return AliasResult::MayAlias;
+        }
+        if(a.kind == MemoryLocation::Kind::Variable && b.kind == MemoryLocation::Kind::Variable)
+            return AliasResult::NoAlias;
+        if(a.kind == MemoryLocation::Kind::Constant && b.kind == MemoryLocation::Kind::Variable && b.variable->getKind() == VariableDescriptor::Kind::LocalVariable)
+            return AliasResult::NoAlias;
+        if(b.kind == MemoryLocation::Kind::Constant && a.kind == MemoryLocation::Kind::Variable && a.variable->getKind() == VariableDescriptor::Kind::LocalVariable)
+            return AliasResult::NoAlias;
+        if(isNonEscapingLocal(a) || isNonEscapingLocal(b))
+            return AliasResult::NoAlias;
+        return AliasResult::MayAlias;
+    }
+};
+
+#endif // SSA_ALIAS_ANALYSIS_H_INCLUDED
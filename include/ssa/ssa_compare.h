@@ -36,6 +36,42 @@ public:
     std::weak_ptr<SSANode> lhs;
     std::weak_ptr<SSANode> rhs;
     CompareOperator compareOperator;
+    /// @return the operator that gives the same result with lhs and rhs swapped
+    static CompareOperator swapOperands(CompareOperator compareOperator)
+    {
+        switch(compareOperator)
+        {
+        case CompareOperator::L:
+            return CompareOperator::G;
+        case CompareOperator::LE:
+            return CompareOperator::GE;
+        case CompareOperator::G:
+            return CompareOperator::L;
+        case CompareOperator::GE:
+            return CompareOperator::LE;
+        default:
+            return compareOperator;
+        }
+    }
+    /// @return the operator that gives the opposite result
+    static CompareOperator invert(CompareOperator compareOperator)
+    {
+        switch(compareOperator)
+        {
+        case CompareOperator::E:
+            return CompareOperator::NE;
+        case CompareOperator::NE:
+            return CompareOperator::E;
+        case CompareOperator::L:
+            return CompareOperator::GE;
+        case CompareOperator::LE:
+            return CompareOperator::G;
+        case CompareOperator::G:
+            return CompareOperator::LE;
+        default: // GE
+            return CompareOperator::L;
+        }
+    }
     SSACompare(std::shared_ptr<SSANode> lhs, CompareOperator compareOperator, std::shared_ptr<SSANode> rhs, SpillLocation spillLocation)
         : SSANode(lhs->context, TypeBoolean::make(lhs->context), spillLocation), lhs(lhs), rhs(rhs), compareOperator(compareOperator)
     {
@@ -0,0 +1,108 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef SSA_DUPLICATE_H_INCLUDED
+#define SSA_DUPLICATE_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include <unordered_map>
+#include <cassert>
+
+/// makes a copy of a SSA node with its inputs remapped through a replacement map
+class SSANodeDuplicator final : public SSANodeVisitor
+{
+private:
+    std::shared_ptr<SSANode> retval;
+    SSANodeDuplicator()
+    {
+    }
+public:
+    virtual void visitSSAUnconditionalJump(std::shared_ptr<SSAUnconditionalJump> node) override
+    {
+        retval = std::make_shared<SSAUnconditionalJump>(node->context, node->destBlocks.front().lock());
+    }
+    virtual void visitSSAConditionalJump(std::shared_ptr<SSAConditionalJump> node) override
+    {
+        retval = std::make_shared<SSAConditionalJump>(node->context, node->condition.lock(), node->destBlocks.front().lock(), node->destBlocks.back().lock());
+    }
+    virtual void visitSSAPhi(std::shared_ptr<SSAPhi> node) override
+    {
+        std::shared_ptr<SSAPhi> phi = std::make_shared<SSAPhi>(node->type, node->spillLocation);
+        phi->inputs = node->inputs;
+        retval = phi;
+    }
+    virtual void visitSSAConstant(std::shared_ptr<SSAConstant> node) override
+    {
+        retval = std::make_shared<SSAConstant>(node->value, node->spillLocation);
+    }
+    virtual void visitSSAMove(std::shared_ptr<SSAMove> node) override
+    {
+        retval = std::make_shared<SSAMove>(node->source.lock(), node->spillLocation);
+    }
+    virtual void visitSSASelect(std::shared_ptr<SSASelect> node) override
+    {
+        retval = std::make_shared<SSASelect>(node->condition.lock(), node->trueValue.lock(), node->falseValue.lock(), node->spillLocation, node->type);
+    }
+    virtual void visitSSALoad(std::shared_ptr<SSALoad> node) override
+    {
+        retval = std::make_shared<SSALoad>(node->address.lock(), node->spillLocation);
+    }
+    virtual void visitSSAStore(std::shared_ptr<SSAStore> node) override
+    {
+        retval = std::make_shared<SSAStore>(node->address.lock(), node->value.lock());
+    }
+    virtual void visitSSAMemoryCopy(std::shared_ptr<SSAMemoryCopy> node) override
+    {
+        retval = std::make_shared<SSAMemoryCopy>(node->destAddress.lock(), node->sourceAddress.lock(), node->count, node->mayOverlap);
+    }
+    virtual void visitSSAMemoryFill(std::shared_ptr<SSAMemoryFill> node) override
+    {
+        retval = std::make_shared<SSAMemoryFill>(node->destAddress.lock(), node->value.lock(), node->count);
+    }
+    virtual void visitSSACompare(std::shared_ptr<SSACompare> node) override
+    {
+        retval = std::make_shared<SSACompare>(node->lhs.lock(), node->compareOperator, node->rhs.lock(), node->spillLocation);
+    }
+    virtual void visitSSAAllocA(std::shared_ptr<SSAAllocA> node) override
+    {
+        retval = nullptr; // a copy would be a different variable
+    }
+    virtual void visitSSATypeCast(std::shared_ptr<SSATypeCast> node) override
+    {
+        retval = std::make_shared<SSATypeCast>(node->arg.lock(), node->type, node->spillLocation);
+    }
+    virtual void visitSSAAdd(std::shared_ptr<SSAAdd> node) override
+    {
+        retval = std::make_shared<SSAAdd>(node->lhs.lock(), node->rhs.lock(), node->spillLocation, node->type);
+    }
+    static bool canDuplicate(std::shared_ptr<SSANode> node)
+    {
+        return dynamic_cast<const SSAAllocA *>(node.get()) == nullptr;
+    }
+    /// @return the copy of node with its inputs replaced using replacements
+    static std::shared_ptr<SSANode> duplicate(std::shared_ptr<SSANode> node, const std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> &replacements)
+    {
+        assert(canDuplicate(node));
+        SSANodeDuplicator duplicator;
+        node->visit(duplicator);
+        duplicator.retval->replaceNodes(replacements);
+        return duplicator.retval;
+    }
+};
+
+#endif // SSA_DUPLICATE_H_INCLUDED
@@ -0,0 +1,351 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef SSA_LOOP_H_INCLUDED
+#define SSA_LOOP_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cassert>
+
+/** a natural loop with a single latch and a single exit edge
+ *
+ * needs the dominator tree from ConstructBasicBlockGraphVisitor
+ */
+struct SSALoop final
+{
+    std::shared_ptr<SSABasicBlock> header, latch, exitingBlock, exitBlock;
+    std::vector<std::shared_ptr<SSABasicBlock>> blocks; /// in reverse post-order starting at the header
+    std::unordered_set<std::shared_ptr<SSABasicBlock>> blockSet;
+    typedef std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<ValueNode>> ValueMap;
+    /// a header phi function that adds a constant step every iteration
+    struct InductionVariable final
+    {
+        std::shared_ptr<SSANode> initialValue;
+        std::shared_ptr<ValueInteger> step;
+        std::shared_ptr<SSAAdd> stepNode;
+    };
+    typedef std::unordered_map<std::shared_ptr<SSAPhi>, InductionVariable> InductionVariableMap;
+    static std::shared_ptr<ValueNode> getValue(const ValueMap &values, std::shared_ptr<SSANode> node)
+    {
+        auto iter = values.find(node);
+        if(iter == values.end())
+            return nullptr;
+        return std::get<1>(*iter);
+    }
+    /// @return true if node is a pointer cast from a constant integer
+    static bool getConstantAddress(const ValueMap &values, std::shared_ptr<SSANode> node, std::uint64_t &address)
+    {
+        std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node);
+        if(typeCast == nullptr)
+            return false;
+        std::shared_ptr<ValueInteger> value = std::dynamic_pointer_cast<ValueInteger>(getValue(values, typeCast->arg.lock()));
+        if(value == nullptr)
+            return false;
+        address = static_cast<std::uint64_t>(value->getSignedValue());
+        std::uint64_t pointerSize = node->type->getTypeProperties().size;
+        if(pointerSize < 8)
+            address &= (static_cast<std::uint64_t>(1) << (pointerSize * 8)) - 1;
+        return true;
+    }
+    static bool dominates(std::shared_ptr<SSABasicBlock> dominator, std::shared_ptr<SSABasicBlock> block)
+    {
+        for(; block != nullptr; block = block->immediateDominator.lock())
+        {
+            if(block == dominator)
+                return true;
+        }
+        return false;
+    }
+    static void removeUnreachableBlocks(std::shared_ptr<SSAFunction> function)
+    {
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> reachableBlocks;
+        std::vector<std::shared_ptr<SSABasicBlock>> workList{function->startBlock};
+        while(!workList.empty())
+        {
+            std::shared_ptr<SSABasicBlock> block = workList.back();
+            workList.pop_back();
+            if(!std::get<1>(reachableBlocks.insert(block)) || block->controlTransferInstruction == nullptr)
+                continue;
+            for(std::weak_ptr<SSABasicBlock> destBlockW : block->controlTransferInstruction->destBlocks)
+                workList.push_back(destBlockW.lock());
+        }
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> removedBlocks;
+        for(auto i = function->blocks.begin(); i != function->blocks.end();)
+        {
+            if(reachableBlocks.count(*i) != 0)
+                ++i;
+            else
+            {
+                removedBlocks.insert(*i);
+                i = function->blocks.erase(i);
+            }
+        }
+        if(removedBlocks.empty())
+            return;
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+                node->removeBlocks(removedBlocks);
+        }
+    }
+    /// replace the conditional jump ending block with a jump to target
+    static void foldBranch(std::shared_ptr<SSABasicBlock> block, std::shared_ptr<SSABasicBlock> target)
+    {
+        std::shared_ptr<SSAControlTransfer> oldControlTransfer = block->controlTransferInstruction;
+        for(std::weak_ptr<SSABasicBlock> oldTargetW : oldControlTransfer->destBlocks)
+        {
+            std::shared_ptr<SSABasicBlock> oldTarget = oldTargetW.lock();
+            if(oldTarget == target)
+                continue;
+            for(std::shared_ptr<SSANode> node : oldTarget->instructions)
+            {
+                std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+                if(phi == nullptr)
+                    break;
+                phi->removeBlocks(std::unordered_set<std::shared_ptr<SSABasicBlock>>{block});
+            }
+        }
+        std::shared_ptr<SSAUnconditionalJump> jump = std::make_shared<SSAUnconditionalJump>(block->context, target);
+        block->instructions.back() = jump;
+        block->controlTransferInstruction = jump;
+    }
+    std::shared_ptr<SSANode> getLatchInput(std::shared_ptr<SSAPhi> phi) const
+    {
+        for(const SSAPhi::PhiInput &i : phi->inputs)
+        {
+            if(i.block.lock() == latch)
+                return i.node.lock();
+        }
+        assert(false);
+        return nullptr;
+    }
+    /// @return the only block outside of the loop that jumps to the header or nullptr
+    std::shared_ptr<SSABasicBlock> getPreheader() const
+    {
+        std::shared_ptr<SSABasicBlock> preheader;
+        for(std::weak_ptr<SSABasicBlock> sourceBlockW : header->sourceBlocks)
+        {
+            std::shared_ptr<SSABasicBlock> sourceBlock = sourceBlockW.lock();
+            if(sourceBlock == latch)
+                continue;
+            if(preheader != nullptr)
+                return nullptr;
+            preheader = sourceBlock;
+        }
+        return preheader;
+    }
+    /// @return true if header starts an innermost loop that exits through a conditional jump in a block dominating the latch
+    static bool find(std::shared_ptr<SSABasicBlock> header, SSALoop &loop)
+    {
+        loop.header = header;
+        for(std::weak_ptr<SSABasicBlock> sourceBlockW : header->sourceBlocks)
+        {
+            std::shared_ptr<SSABasicBlock> sourceBlock = sourceBlockW.lock();
+            if(!dominates(header, sourceBlock))
+                continue;
+            if(loop.latch != nullptr)
+                return false;
+            loop.latch = sourceBlock;
+        }
+        if(loop.latch == nullptr || loop.latch == header)
+            return false;
+        loop.blockSet.insert(header);
+        std::vector<std::shared_ptr<SSABasicBlock>> workList{loop.latch};
+        while(!workList.empty())
+        {
+            std::shared_ptr<SSABasicBlock> block = workList.back();
+            workList.pop_back();
+            if(!std::get<1>(loop.blockSet.insert(block)))
+                continue;
+            for(std::weak_ptr<SSABasicBlock> sourceBlockW : block->sourceBlocks)
+                workList.push_back(sourceBlockW.lock());
+        }
+        for(std::shared_ptr<SSABasicBlock> block : loop.blockSet)
+        {
+            for(std::weak_ptr<SSABasicBlock> destBlockW : block->destBlocks)
+            {
+                std::shared_ptr<SSABasicBlock> destBlock = destBlockW.lock();
+                if(destBlock != header && loop.blockSet.count(destBlock) != 0 && dominates(destBlock, block))
+                    return false; // not an innermost loop
+                if(loop.blockSet.count(destBlock) != 0)
+                    continue;
+                if(loop.exitingBlock != nullptr)
+                    return false;
+                loop.exitingBlock = block;
+                loop.exitBlock = destBlock;
+            }
+        }
+        if(loop.exitingBlock == nullptr || !dominates(loop.exitingBlock, loop.latch))
+            return false;
+        if(std::dynamic_pointer_cast<SSAConditionalJump>(loop.exitingBlock->controlTransferInstruction) == nullptr)
+            return false;
+        std::vector<std::shared_ptr<SSABasicBlock>> postOrder;
+        std::unordered_set<std::shared_ptr<SSABasicBlock>> visitedBlocks;
+        std::vector<std::pair<std::shared_ptr<SSABasicBlock>, std::list<std::weak_ptr<SSABasicBlock>>::iterator>> stack;
+        visitedBlocks.insert(header);
+        stack.emplace_back(header, header->destBlocks.begin());
+        while(!stack.empty())
+        {
+            std::shared_ptr<SSABasicBlock> block = std::get<0>(stack.back());
+            auto &iter = std::get<1>(stack.back());
+            if(iter == block->destBlocks.end())
+            {
+                postOrder.push_back(block);
+                stack.pop_back();
+                continue;
+            }
+            std::shared_ptr<SSABasicBlock> destBlock = (iter++)->lock();
+            if(loop.blockSet.count(destBlock) == 0 || !std::get<1>(visitedBlocks.insert(destBlock)))
+                continue;
+            stack.emplace_back(destBlock, destBlock->destBlocks.begin());
+        }
+        loop.blocks.assign(postOrder.rbegin(), postOrder.rend());
+        return true;
+    }
+    /// @return the constant values of the nodes outside of the loop, not counting phi functions
+    ValueMap getInvariantValues(std::shared_ptr<SSAFunction> function) const
+    {
+        ValueMap values;
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                if(blockSet.count(block) != 0)
+                    continue;
+                for(std::shared_ptr<SSANode> node : block->instructions)
+                {
+                    if(dynamic_cast<const SSAPhi *>(node.get()) != nullptr || values.count(node) != 0)
+                        continue;
+                    std::shared_ptr<ValueNode> value = node->evaluateForConstants(values);
+                    if(value == nullptr || dynamic_cast<const ValueUnknown *>(value.get()) != nullptr)
+                        continue;
+                    values[node] = value;
+                    done = false;
+                }
+            }
+        }
+        return values;
+    }
+    /// @return the invariant values and the values of the nodes in the loop that fold to constants without the phi functions
+    ValueMap getConstantValues(std::shared_ptr<SSAFunction> function) const
+    {
+        ValueMap values = getInvariantValues(function);
+        for(std::shared_ptr<SSABasicBlock> block : blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                if(dynamic_cast<const SSAPhi *>(node.get()) != nullptr || node == block->controlTransferInstruction)
+                    continue;
+                std::shared_ptr<ValueNode> value = node->evaluateForConstants(values);
+                if(value == nullptr || dynamic_cast<const ValueUnknown *>(value.get()) != nullptr)
+                    continue;
+                values[node] = value;
+            }
+        }
+        return values;
+    }
+    /// @return false if a header phi function isn't an induction variable
+    bool getInductionVariables(const ValueMap &values, std::shared_ptr<SSABasicBlock> preheader, InductionVariableMap &inductionVariables) const
+    {
+        for(std::shared_ptr<SSANode> node : header->instructions)
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+            if(phi == nullptr)
+                break;
+            InductionVariable inductionVariable;
+            for(const SSAPhi::PhiInput &i : phi->inputs)
+            {
+                if(i.block.lock() == preheader)
+                    inductionVariable.initialValue = i.node.lock();
+            }
+            inductionVariable.stepNode = std::dynamic_pointer_cast<SSAAdd>(getLatchInput(phi));
+            if(inductionVariable.stepNode == nullptr || inductionVariable.initialValue == nullptr)
+                return false;
+            if(inductionVariable.stepNode->lhs.lock() == phi)
+                inductionVariable.step = std::dynamic_pointer_cast<ValueInteger>(getValue(values, inductionVariable.stepNode->rhs.lock()));
+            else if(inductionVariable.stepNode->rhs.lock() == phi)
+                inductionVariable.step = std::dynamic_pointer_cast<ValueInteger>(getValue(values, inductionVariable.stepNode->lhs.lock()));
+            if(inductionVariable.step == nullptr)
+                return false;
+            inductionVariables.emplace(phi, inductionVariable);
+        }
+        return true;
+    }
+    /** finds how many times the exiting block is run
+     *
+     * The trip count is found by running the header phi functions through evaluateForConstants
+     * until the exit branch is taken, so any induction variable that folds to constants works.
+     * @return the trip count or 0 if it is unknown or more than maxTripCount
+     */
+    std::size_t getTripCount(std::shared_ptr<SSAFunction> function, std::size_t maxTripCount) const
+    {
+        ValueMap values = getInvariantValues(function);
+        std::vector<std::shared_ptr<SSAPhi>> headerPhis;
+        std::vector<std::shared_ptr<ValueNode>> headerPhiValues;
+        for(std::shared_ptr<SSANode> node : header->instructions)
+        {
+            std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node);
+            if(phi == nullptr)
+                break;
+            headerPhis.push_back(phi);
+            std::shared_ptr<ValueNode> value = nullptr;
+            bool isFirst = true;
+            for(const SSAPhi::PhiInput &i : phi->inputs)
+            {
+                if(i.block.lock() == latch)
+                    continue;
+                std::shared_ptr<ValueNode> inputValue = getValue(values, i.node.lock());
+                if(isFirst)
+                    value = inputValue;
+                else if(value == nullptr || inputValue == nullptr || *value != *inputValue)
+                    value = nullptr;
+                isFirst = false;
+            }
+            headerPhiValues.push_back(value);
+        }
+        for(std::size_t tripCount = 1; tripCount <= maxTripCount; tripCount++)
+        {
+            for(std::size_t i = 0; i < headerPhis.size(); i++)
+                values[headerPhis[i]] = headerPhiValues[i];
+            for(std::shared_ptr<SSABasicBlock> block : blocks)
+            {
+                for(std::shared_ptr<SSANode> node : block->instructions)
+                {
+                    if(block == header && dynamic_cast<const SSAPhi *>(node.get()) != nullptr)
+                        continue;
+                    values[node] = node->evaluateForConstants(values);
+                }
+            }
+            std::list<std::weak_ptr<SSABasicBlock>> targets = exitingBlock->controlTransferInstruction->evaluateControlForConstants(values);
+            if(targets.size() != 1)
+                return 0;
+            if(targets.front().lock() == exitBlock)
+                return tripCount;
+            for(std::size_t i = 0; i < headerPhis.size(); i++)
+                headerPhiValues[i] = getValue(values, getLatchInput(headerPhis[i]));
+        }
+        return 0;
+    }
+};
+
+#endif // SSA_LOOP_H_INCLUDED
@@ -55,6 +55,67 @@ public:
     }
 };
 
+/// evaluates to trueValue if condition is true and falseValue otherwise; both are always evaluated
+class SSASelect final : public SSANode
+{
+public:
+    std::weak_ptr<SSANode> condition;
+    std::weak_ptr<SSANode> trueValue;
+    std::weak_ptr<SSANode> falseValue;
+    SSASelect(std::shared_ptr<SSANode> condition, std::shared_ptr<SSANode> trueValue, std::shared_ptr<SSANode> falseValue, SpillLocation spillLocation, std::shared_ptr<TypeNode> type)
+        : SSANode(trueValue->context, type, spillLocation), condition(condition), trueValue(trueValue), falseValue(falseValue)
+    {
+    }
+    virtual void visit(SSANodeVisitor &visitor) override
+    {
+        visitor.visitSSASelect(std::static_pointer_cast<SSASelect>(shared_from_this()));
+    }
+    virtual std::shared_ptr<ValueNode> evaluateForConstants(const std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<ValueNode>> &values) const override
+    {
+        std::shared_ptr<ValueNode> conditionValue = nullptr, trueValueValue = nullptr, falseValueValue = nullptr;
+        auto iter = values.find(condition.lock());
+        if(iter != values.end())
+            conditionValue = std::get<1>(*iter);
+        iter = values.find(trueValue.lock());
+        if(iter != values.end())
+            trueValueValue = std::get<1>(*iter);
+        iter = values.find(falseValue.lock());
+        if(iter != values.end())
+            falseValueValue = std::get<1>(*iter);
+        if(std::shared_ptr<ValueBoolean> conditionBoolean = std::dynamic_pointer_cast<ValueBoolean>(conditionValue))
+            return conditionBoolean->value ? trueValueValue : falseValueValue;
+        if(dynamic_cast<const ValueUnknown *>(conditionValue.get()) != nullptr)
+            return conditionValue;
+        /// the condition isn't known : merge like a phi
+        if(dynamic_cast<const ValueUnknown *>(trueValueValue.get()) != nullptr)
+            return falseValueValue;
+        if(dynamic_cast<const ValueUnknown *>(falseValueValue.get()) != nullptr)
+            return trueValueValue;
+        if(trueValueValue == nullptr || falseValueValue == nullptr || *trueValueValue != *falseValueValue)
+            return nullptr;
+        return trueValueValue;
+    }
+    virtual std::list<std::shared_ptr<SSANode>> getInputs() const override
+    {
+        return std::list<std::shared_ptr<SSANode>>{condition.lock(), trueValue.lock(), falseValue.lock()};
+    }
+    virtual void replaceNodes(const std::unordered_map<std::shared_ptr<SSANode>, ReplacementNode> &replacements) override
+    {
+        condition = replaceNode(replacements, condition.lock());
+        trueValue = replaceNode(replacements, trueValue.lock());
+        falseValue = replaceNode(replacements, falseValue.lock());
+    }
+    virtual void verify(std::shared_ptr<SSABasicBlock> containingBlock, std::shared_ptr<SSAFunction> containingFunction) override
+    {
+        assert(condition.lock());
+        assert(trueValue.lock());
+        assert(falseValue.lock());
+        assert(dynamic_cast<const TypeBoolean *>(condition.lock()->type->toNonConstant()->toNonVolatile().get()) != nullptr);
+        assert(trueValue.lock()->type->toNonConstant()->toNonVolatile() == type->toNonConstant()->toNonVolatile());
+        assert(falseValue.lock()->type->toNonConstant()->toNonVolatile() == type->toNonConstant()->toNonVolatile());
+    }
+};
+
 class SSALoad final : public SSANode
 {
 public:
@@ -122,4 +183,87 @@ public:
     }
 };
 
+/** copies count elements of the type destAddress points to
+ *
+ * The elements are copied one at a time in increasing address order, so overlapping ranges act like the loop this came from.
+ * mayOverlap is false if the ranges are known to be disjoint.
+ */
+class SSAMemoryCopy final : public SSANode
+{
+public:
+    std::weak_ptr<SSANode> destAddress;
+    std::weak_ptr<SSANode> sourceAddress;
+    std::uint64_t count;
+    bool mayOverlap;
+    SSAMemoryCopy(std::shared_ptr<SSANode> destAddress, std::shared_ptr<SSANode> sourceAddress, std::uint64_t count, bool mayOverlap)
+        : SSANode(destAddress->context, TypeVoid::make(destAddress->context), nullptr), destAddress(destAddress), sourceAddress(sourceAddress), count(count), mayOverlap(mayOverlap)
+    {
+    }
+    virtual void visit(SSANodeVisitor &visitor) override
+    {
+        visitor.visitSSAMemoryCopy(std::static_pointer_cast<SSAMemoryCopy>(shared_from_this()));
+    }
+    virtual std::shared_ptr<ValueNode> evaluateForConstants(const std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<ValueNode>> &values) const override
+    {
+        return nullptr;
+    }
+    virtual std::list<std::shared_ptr<SSANode>> getInputs() const override
+    {
+        return std::list<std::shared_ptr<SSANode>>{destAddress.lock(), sourceAddress.lock()};
+    }
+    virtual void replaceNodes(const std::unordered_map<std::shared_ptr<SSANode>, ReplacementNode> &replacements) override
+    {
+        destAddress = replaceNode(replacements, destAddress.lock());
+        sourceAddress = replaceNode(replacements, sourceAddress.lock());
+    }
+    virtual bool hasSideEffects() const override
+    {
+        return true;
+    }
+    virtual void verify(std::shared_ptr<SSABasicBlock> containingBlock, std::shared_ptr<SSAFunction> containingFunction) override
+    {
+        assert(destAddress.lock());
+        assert(sourceAddress.lock());
+    }
+};
+
+/// stores value to count elements starting at destAddress
+class SSAMemoryFill final : public SSANode
+{
+public:
+    std::weak_ptr<SSANode> destAddress;
+    std::weak_ptr<SSANode> value;
+    std::uint64_t count;
+    SSAMemoryFill(std::shared_ptr<SSANode> destAddress, std::shared_ptr<SSANode> value, std::uint64_t count)
+        : SSANode(destAddress->context, TypeVoid::make(destAddress->context), nullptr), destAddress(destAddress), value(value), count(count)
+    {
+    }
+    virtual void visit(SSANodeVisitor &visitor) override
+    {
+        visitor.visitSSAMemoryFill(std::static_pointer_cast<SSAMemoryFill>(shared_from_this()));
+    }
+    virtual std::shared_ptr<ValueNode> evaluateForConstants(const std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<ValueNode>> &values) const override
+    {
+        return nullptr;
+    }
+    virtual std::list<std::shared_ptr<SSANode>> getInputs() const override
+    {
+        return std::list<std::shared_ptr<SSANode>>{destAddress.lock(), value.lock()};
+    }
+    virtual void replaceNodes(const std::unordered_map<std::shared_ptr<SSANode>, ReplacementNode> &replacements) override
+    {
+        destAddress = replaceNode(replacements, destAddress.lock());
+        value = replaceNode(replacements, value.lock());
+    }
+    virtual bool hasSideEffects() const override
+    {
+        return true;
+    }
+    virtual void verify(std::shared_ptr<SSABasicBlock> containingBlock, std::shared_ptr<SSAFunction> containingFunction) override
+    {
+        assert(destAddress.lock());
+        assert(value.lock());
+    }
+};
+
 #endif // SSA_MOVE_H_INCLUDED
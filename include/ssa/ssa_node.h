@@ -29,7 +29,7 @@
 #include "types/type.h"
 #include "values/value.h"
 #include "util/variable.h"
-#include "util/stable_vector.h"
+#include "util/random_access_list.h"
 
 class SSANodeVisitor;
 class SSAControlTransfer;
@@ -92,10 +92,24 @@ public:
 
 class SSABasicBlock : public std::enable_shared_from_this<SSABasicBlock>
 {
+public:
+    typedef random_access_list<std::shared_ptr<SSANode>> InstructionList;
+private:
+    /// all blocks share one pool so moving instructions between blocks is O(log n)
+    static std::shared_ptr<memory_pool> getInstructionPool(CompilerContext *context)
+    {
+        struct tag_t
+        {
+        };
+        std::shared_ptr<memory_pool> retval = context->getValue<memory_pool, tag_t>();
+        if(retval == nullptr)
+            context->setValue<memory_pool, tag_t>(retval = std::make_shared<memory_pool>());
+        return retval;
+    }
 public:
     CompilerContext *const context;
     explicit SSABasicBlock(CompilerContext *context)
-        : context(context)
+        : context(context), instructions(InstructionList::allocator_type(getInstructionPool(context)))
     {
     }
     std::list<std::weak_ptr<SSABasicBlock>> sourceBlocks;
@@ -103,31 +117,27 @@ public:
     std::list<std::weak_ptr<SSABasicBlock>> dominatedBlocks;
     std::list<std::weak_ptr<SSABasicBlock>> destBlocks;
     std::shared_ptr<SSAControlTransfer> controlTransferInstruction;
-    stable_vector<std::shared_ptr<SSANode>> instructions; /// all SSAPhi nodes must be first and the only allowed SSAControlTransfer must be last
+    InstructionList instructions; /// all SSAPhi nodes must be first and the only allowed SSAControlTransfer must be last
     void replaceNodes(const std::unordered_map<std::shared_ptr<SSANode>, SSANode::ReplacementNode> &replacements)
     {
         auto iter = replacements.find(std::static_pointer_cast<SSANode>(controlTransferInstruction));
         if(iter != replacements.end())
             controlTransferInstruction = std::dynamic_pointer_cast<SSAControlTransfer>(std::get<1>(*iter).newNode);
-        for(auto i = instructions.begin(); i != instructions.end();)
+        instructions.erase_if([&](std::shared_ptr<SSANode> &node)
         {
-            std::shared_ptr<SSANode> &node = *i;
             auto iter = replacements.find(node);
             if(iter == replacements.end())
             {
                 node->replaceNodes(replacements);
-                ++i;
-                continue;
+                return false;
             }
             SSANode::ReplacementNode replacementNode = std::get<1>(*iter);
             if(replacementNode.isPreexistingNode && replacementNode.newNode != node)
-            {
-                i = instructions.erase(i);
-                continue;
-            }
+                return true;
             node = replacementNode.newNode;
             node->replaceNodes(replacements);
-        }
+            return false;
+        });
     }
     void replaceBlock(std::shared_ptr<SSABasicBlock> searchFor, std::shared_ptr<SSABasicBlock> replaceWith)
     {
@@ -0,0 +1,166 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef SSA_POST_DOMINATORS_H_INCLUDED
+#define SSA_POST_DOMINATORS_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include <unordered_map>
+#include <vector>
+#include <utility>
+
+/** the immediate post-dominators of the blocks that can reach the end of the function
+ *
+ * needs the source and dest blocks from ConstructBasicBlockGraphVisitor
+ */
+class SSAPostDominatorTree final
+{
+private:
+    std::unordered_map<std::shared_ptr<SSABasicBlock>, std::shared_ptr<SSABasicBlock>> immediatePostDominators; /// nullptr is the end of the function
+public:
+    explicit SSAPostDominatorTree(std::shared_ptr<SSAFunction> function)
+    {
+        // number the blocks in post-order of the reversed graph starting at a virtual exit block that gets the last index
+        std::vector<std::shared_ptr<SSABasicBlock>> postOrder;
+        std::unordered_map<std::shared_ptr<SSABasicBlock>, std::size_t> postOrderIndexes;
+        std::vector<std::pair<std::shared_ptr<SSABasicBlock>, std::list<std::weak_ptr<SSABasicBlock>>::iterator>> stack;
+        for(std::shared_ptr<SSABasicBlock> exitBlock : function->blocks)
+        {
+            if(!exitBlock->destBlocks.empty() || postOrderIndexes.count(exitBlock) != 0)
+                continue;
+            postOrderIndexes[exitBlock] = 0;
+            stack.emplace_back(exitBlock, exitBlock->sourceBlocks.begin());
+            while(!stack.empty())
+            {
+                std::shared_ptr<SSABasicBlock> block = std::get<0>(stack.back());
+                auto &iter = std::get<1>(stack.back());
+                if(iter == block->sourceBlocks.end())
+                {
+                    postOrderIndexes[block] = postOrder.size();
+                    postOrder.push_back(block);
+                    stack.pop_back();
+                    continue;
+                }
+                std::shared_ptr<SSABasicBlock> sourceBlock = (iter++)->lock();
+                if(!std::get<1>(postOrderIndexes.emplace(sourceBlock, 0)))
+                    continue;
+                stack.emplace_back(sourceBlock, sourceBlock->sourceBlocks.begin());
+            }
+        }
+        const std::size_t exitIndex = postOrder.size(), undefinedIndex = exitIndex + 1;
+        std::vector<std::size_t> immediatePostDominatorIndexes(postOrder.size(), undefinedIndex);
+        auto intersect = [&](std::size_t a, std::size_t b) -> std::size_t
+        {
+            while(a != b)
+            {
+                while(a < b)
+                    a = immediatePostDominatorIndexes[a];
+                while(b < a)
+                    b = immediatePostDominatorIndexes[b];
+            }
+            return a;
+        };
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::size_t i = postOrder.size(); i-- > 0;)
+            {
+                std::shared_ptr<SSABasicBlock> block = postOrder[i];
+                std::size_t newIndex = undefinedIndex;
+                if(block->destBlocks.empty())
+                    newIndex = exitIndex;
+                for(std::weak_ptr<SSABasicBlock> destBlockW : block->destBlocks)
+                {
+                    std::size_t destIndex = postOrderIndexes.at(destBlockW.lock());
+                    if(destIndex != exitIndex && immediatePostDominatorIndexes[destIndex] == undefinedIndex)
+                        continue; // not processed yet
+                    if(newIndex == undefinedIndex)
+                        newIndex = destIndex;
+                    else
+                        newIndex = intersect(newIndex, destIndex);
+                }
+                if(immediatePostDominatorIndexes[i] != newIndex)
+                {
+                    immediatePostDominatorIndexes[i] = newIndex;
+                    done = false;
+                }
+            }
+        }
+        for(std::size_t i = 0; i < postOrder.size(); i++)
+        {
+            std::size_t index = immediatePostDominatorIndexes[i];
+            immediatePostDominators[postOrder[i]] = index == exitIndex ? nullptr : postOrder[index];
+        }
+    }
+    /// @return false if the block is in an infinite loop
+    bool reachesExit(std::shared_ptr<SSABasicBlock> block) const
+    {
+        return immediatePostDominators.count(block) != 0;
+    }
+    /// @return the immediate post-dominator or nullptr for the end of the function
+    std::shared_ptr<SSABasicBlock> getImmediatePostDominator(std::shared_ptr<SSABasicBlock> block) const
+    {
+        auto iter = immediatePostDominators.find(block);
+        if(iter == immediatePostDominators.end())
+            return nullptr;
+        return std::get<1>(*iter);
+    }
+};
+
+/** for each block, the blocks whose conditional jumps decide if it runs
+ *
+ * Only blocks that reach the end of the function are included.
+ */
+class SSAControlDependenceGraph final
+{
+private:
+    std::unordered_map<std::shared_ptr<SSABasicBlock>, std::vector<std::shared_ptr<SSABasicBlock>>> controllingBlocks;
+    const std::vector<std::shared_ptr<SSABasicBlock>> emptyBlockList;
+public:
+    SSAControlDependenceGraph(std::shared_ptr<SSAFunction> function, const SSAPostDominatorTree &postDominatorTree)
+    {
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            if(!postDominatorTree.reachesExit(block))
+                continue;
+            std::shared_ptr<SSABasicBlock> immediatePostDominator = postDominatorTree.getImmediatePostDominator(block);
+            for(std::weak_ptr<SSABasicBlock> destBlockW : block->destBlocks)
+            {
+                std::shared_ptr<SSABasicBlock> destBlock = destBlockW.lock();
+                if(!postDominatorTree.reachesExit(destBlock))
+                    continue;
+                for(std::shared_ptr<SSABasicBlock> i = destBlock; i != nullptr && i != immediatePostDominator; i = postDominatorTree.getImmediatePostDominator(i))
+                {
+                    std::vector<std::shared_ptr<SSABasicBlock>> &blocks = controllingBlocks[i];
+                    if(blocks.empty() || blocks.back() != block)
+                        blocks.push_back(block);
+                }
+            }
+        }
+    }
+    const std::vector<std::shared_ptr<SSABasicBlock>> &getControllingBlocks(std::shared_ptr<SSABasicBlock> block) const
+    {
+        auto iter = controllingBlocks.find(block);
+        if(iter == controllingBlocks.end())
+            return emptyBlockList;
+        return std::get<1>(*iter);
+    }
+};
+
+#endif // SSA_POST_DOMINATORS_H_INCLUDED
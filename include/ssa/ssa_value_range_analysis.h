@@ -0,0 +1,587 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef SSA_VALUE_RANGE_ANALYSIS_H_INCLUDED
+#define SSA_VALUE_RANGE_ANALYSIS_H_INCLUDED
+
+#include "ssa/ssa_nodes.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+
+/** the ranges of the integer and boolean values in a function
+ *
+ * Ranges are propagated through the blocks that can be reached like ConstantPropagationAndDeadCodeElimination
+ * propagates constants. A value used in a block is narrowed by the comparisons that jumped into the blocks
+ * dominating it and a value passed to a phi is narrowed by the comparison on that edge.
+ *
+ * A phi whose range keeps growing in a loop is widened to the next bound of a value that is compared against,
+ * to one before the limit of its type so that incrementing it doesn't wrap around, or to the limit of its type,
+ * then all the ranges are narrowed again by calculating them from their inputs.
+ *
+ * needs the dominators and source blocks from ConstructBasicBlockGraphVisitor
+ */
+class SSAValueRangeAnalysis final
+{
+public:
+    /// the bounds are inclusive and sign or zero extended to 64 bits. an empty range is for values that are never calculated
+    struct ValueRange final
+    {
+        bool isEmpty = true;
+        bool isUnsigned = true;
+        std::uint64_t min = 0;
+        std::uint64_t max = 0;
+        static bool isLess(std::uint64_t a, bool aIsUnsigned, std::uint64_t b, bool bIsUnsigned)
+        {
+            bool aIsNegative = !aIsUnsigned && static_cast<std::int64_t>(a) < 0;
+            bool bIsNegative = !bIsUnsigned && static_cast<std::int64_t>(b) < 0;
+            if(aIsNegative != bIsNegative)
+                return aIsNegative;
+            if(aIsNegative)
+                return static_cast<std::int64_t>(a) < static_cast<std::int64_t>(b);
+            return a < b;
+        }
+        bool isLess(std::uint64_t a, std::uint64_t b) const
+        {
+            return isLess(a, isUnsigned, b, isUnsigned);
+        }
+        bool isSingleValue() const
+        {
+            return !isEmpty && min == max;
+        }
+        /// @return true if every value in this range is in bounds
+        bool isInside(const ValueRange &bounds) const
+        {
+            if(isEmpty)
+                return true;
+            if(bounds.isEmpty)
+                return false;
+            return !isLess(min, isUnsigned, bounds.min, bounds.isUnsigned) && !isLess(bounds.max, bounds.isUnsigned, max, isUnsigned);
+        }
+        bool operator ==(const ValueRange &rt) const
+        {
+            if(isEmpty || rt.isEmpty)
+                return isEmpty == rt.isEmpty;
+            return isUnsigned == rt.isUnsigned && min == rt.min && max == rt.max;
+        }
+        bool operator !=(const ValueRange &rt) const
+        {
+            return !operator ==(rt);
+        }
+        ValueRange unionWith(const ValueRange &rt) const
+        {
+            if(isEmpty)
+                return rt;
+            if(rt.isEmpty)
+                return *this;
+            ValueRange retval = *this;
+            if(isLess(rt.min, min))
+                retval.min = rt.min;
+            if(isLess(max, rt.max))
+                retval.max = rt.max;
+            return retval;
+        }
+        ValueRange intersectWith(const ValueRange &rt) const
+        {
+            if(isEmpty || rt.isEmpty)
+                return ValueRange();
+            ValueRange retval = *this;
+            if(isLess(min, rt.min))
+                retval.min = rt.min;
+            if(isLess(rt.max, max))
+                retval.max = rt.max;
+            if(retval.isLess(retval.max, retval.min))
+                return ValueRange();
+            return retval;
+        }
+    };
+private:
+    static constexpr std::size_t maxChangeCount = 3; /// then the range is widened
+    static constexpr std::size_t maxThresholdChangeCount = 8; /// then the thresholds aren't used anymore
+    static constexpr std::size_t narrowingPassCount = 2;
+    std::unordered_map<std::shared_ptr<SSANode>, ValueRange> ranges;
+    std::unordered_map<std::shared_ptr<SSANode>, ValueRange> typeRanges;
+    std::unordered_map<std::shared_ptr<SSANode>, std::shared_ptr<SSABasicBlock>> nodeBlocks;
+    std::unordered_map<std::shared_ptr<SSABasicBlock>, std::unordered_set<std::shared_ptr<SSABasicBlock>>> reachableTargets;
+    std::unordered_set<std::shared_ptr<SSABasicBlock>> reachableBlocks;
+    std::vector<std::shared_ptr<SSACompare>> compares;
+public:
+    /// @return false if the values of type aren't tracked
+    static bool getTypeRange(std::shared_ptr<TypeNode> type, ValueRange &range)
+    {
+        type = type->toNonConstant()->toNonVolatile();
+        range = ValueRange();
+        range.isEmpty = false;
+        if(dynamic_cast<const TypeBoolean *>(type.get()) != nullptr)
+        {
+            range.max = 1;
+            return true;
+        }
+        const TypeInteger *typeInteger = dynamic_cast<const TypeInteger *>(type.get());
+        if(typeInteger == nullptr)
+            return false;
+        std::uint64_t bitCount = type->getTypeProperties().size * 8;
+        range.isUnsigned = typeInteger->isUnsigned;
+        if(range.isUnsigned)
+            range.max = bitCount >= 64 ? ~static_cast<std::uint64_t>(0) : (static_cast<std::uint64_t>(1) << bitCount) - 1;
+        else
+        {
+            range.max = (static_cast<std::uint64_t>(1) << (bitCount - 1)) - 1;
+            range.min = ~range.max;
+        }
+        return true;
+    }
+    static bool getValueRange(std::shared_ptr<ValueNode> value, ValueRange &range)
+    {
+        range = ValueRange();
+        range.isEmpty = false;
+        if(std::shared_ptr<ValueBoolean> valueBoolean = std::dynamic_pointer_cast<ValueBoolean>(value))
+        {
+            range.min = range.max = valueBoolean->value ? 1 : 0;
+            return true;
+        }
+        if(std::shared_ptr<ValueInteger> valueInteger = std::dynamic_pointer_cast<ValueInteger>(value))
+        {
+            range.isUnsigned = valueInteger->isUnsigned;
+            range.min = range.max = static_cast<std::uint64_t>(valueInteger->getSignedValue());
+            return true;
+        }
+        return false;
+    }
+    static ValueRange add(const ValueRange &lhs, const ValueRange &rhs, const ValueRange &typeRange)
+    {
+        if(lhs.isEmpty || rhs.isEmpty)
+            return ValueRange();
+        if(lhs.isUnsigned != typeRange.isUnsigned || rhs.isUnsigned != typeRange.isUnsigned || !lhs.isInside(typeRange) || !rhs.isInside(typeRange))
+            return typeRange;
+        ValueRange retval = typeRange;
+        if(typeRange.isUnsigned)
+        {
+            if(lhs.max > typeRange.max - rhs.max) // could wrap around
+                return typeRange;
+            retval.min = lhs.min + rhs.min;
+            retval.max = lhs.max + rhs.max;
+            return retval;
+        }
+        std::int64_t lhsMin = static_cast<std::int64_t>(lhs.min), lhsMax = static_cast<std::int64_t>(lhs.max);
+        std::int64_t rhsMin = static_cast<std::int64_t>(rhs.min), rhsMax = static_cast<std::int64_t>(rhs.max);
+        std::int64_t typeMin = static_cast<std::int64_t>(typeRange.min), typeMax = static_cast<std::int64_t>(typeRange.max);
+        if(rhsMax > 0 && lhsMax > typeMax - rhsMax)
+            return typeRange;
+        if(rhsMin < 0 && lhsMin < typeMin - rhsMin)
+            return typeRange;
+        retval.min = static_cast<std::uint64_t>(lhsMin + rhsMin);
+        retval.max = static_cast<std::uint64_t>(lhsMax + rhsMax);
+        return retval;
+    }
+    static ValueRange typeCast(const ValueRange &source, const ValueRange &typeRange)
+    {
+        if(source.isEmpty)
+            return source;
+        if(!source.isInside(typeRange))
+            return typeRange;
+        ValueRange retval = source;
+        retval.isUnsigned = typeRange.isUnsigned;
+        return retval;
+    }
+    static ValueRange compare(const ValueRange &lhs, SSACompare::CompareOperator compareOperator, const ValueRange &rhs)
+    {
+        if(lhs.isEmpty || rhs.isEmpty)
+            return ValueRange();
+        ValueRange retval;
+        retval.isEmpty = false;
+        retval.max = 1;
+        if(lhs.isUnsigned != rhs.isUnsigned)
+            return retval;
+        bool isAlwaysTrue = false, isAlwaysFalse = false;
+        switch(compareOperator)
+        {
+        case SSACompare::CompareOperator::E:
+            isAlwaysTrue = lhs.isSingleValue() && lhs == rhs;
+            isAlwaysFalse = lhs.isLess(lhs.max, rhs.min) || lhs.isLess(rhs.max, lhs.min);
+            break;
+        case SSACompare::CompareOperator::NE:
+            isAlwaysTrue = lhs.isLess(lhs.max, rhs.min) || lhs.isLess(rhs.max, lhs.min);
+            isAlwaysFalse = lhs.isSingleValue() && lhs == rhs;
+            break;
+        case SSACompare::CompareOperator::L:
+            isAlwaysTrue = lhs.isLess(lhs.max, rhs.min);
+            isAlwaysFalse = !lhs.isLess(lhs.min, rhs.max);
+            break;
+        case SSACompare::CompareOperator::LE:
+            isAlwaysTrue = !lhs.isLess(rhs.min, lhs.max);
+            isAlwaysFalse = lhs.isLess(rhs.max, lhs.min);
+            break;
+        case SSACompare::CompareOperator::G:
+            isAlwaysTrue = lhs.isLess(rhs.max, lhs.min);
+            isAlwaysFalse = !lhs.isLess(rhs.min, lhs.max);
+            break;
+        case SSACompare::CompareOperator::GE:
+            isAlwaysTrue = !lhs.isLess(lhs.min, rhs.max);
+            isAlwaysFalse = lhs.isLess(lhs.max, rhs.min);
+            break;
+        }
+        if(isAlwaysTrue)
+            retval.min = 1;
+        if(isAlwaysFalse)
+            retval.max = 0;
+        return retval;
+    }
+    /// @return range narrowed to the values where `value compareOperator other` is true
+    static ValueRange refine(const ValueRange &range, SSACompare::CompareOperator compareOperator, const ValueRange &other)
+    {
+        if(range.isEmpty || other.isEmpty || range.isUnsigned != other.isUnsigned)
+            return range;
+        ValueRange retval = range;
+        switch(compareOperator)
+        {
+        case SSACompare::CompareOperator::E:
+            return range.intersectWith(other);
+        case SSACompare::CompareOperator::NE:
+            if(!other.isSingleValue())
+                return range;
+            if(range.isSingleValue() && range.min == other.min)
+                return ValueRange();
+            if(range.min == other.min)
+                retval.min++;
+            else if(range.max == other.min)
+                retval.max--;
+            return retval;
+        case SSACompare::CompareOperator::L:
+            if(!range.isLess(range.min, other.max))
+                return ValueRange();
+            if(!range.isLess(other.max, range.max) && other.max != range.max)
+                return range;
+            retval.max = other.max - 1;
+            return retval;
+        case SSACompare::CompareOperator::LE:
+            if(range.isLess(other.max, range.min))
+                return ValueRange();
+            if(range.isLess(other.max, range.max))
+                retval.max = other.max;
+            return retval;
+        case SSACompare::CompareOperator::G:
+            if(!range.isLess(other.min, range.max))
+                return ValueRange();
+            if(range.isLess(other.min, range.min))
+                return range;
+            retval.min = other.min + 1;
+            return retval;
+        case SSACompare::CompareOperator::GE:
+            if(range.isLess(range.max, other.min))
+                return ValueRange();
+            if(range.isLess(range.min, other.min))
+                retval.min = other.min;
+            return retval;
+        }
+        return range;
+    }
+private:
+    ValueRange refineOnEdge(const ValueRange &range, std::shared_ptr<SSANode> node, std::shared_ptr<SSABasicBlock> sourceBlock, std::shared_ptr<SSABasicBlock> destBlock) const
+    {
+        std::shared_ptr<SSAConditionalJump> conditionalJump = std::dynamic_pointer_cast<SSAConditionalJump>(sourceBlock->controlTransferInstruction);
+        if(conditionalJump == nullptr || conditionalJump->destBlocks.front().lock() == conditionalJump->destBlocks.back().lock())
+            return range;
+        std::shared_ptr<SSACompare> compare = std::dynamic_pointer_cast<SSACompare>(conditionalJump->condition.lock());
+        if(compare == nullptr)
+            return range;
+        SSACompare::CompareOperator compareOperator = compare->compareOperator;
+        std::shared_ptr<SSANode> compared = compare->lhs.lock(), other = compare->rhs.lock();
+        std::shared_ptr<SSANode> uncastNode = getUncastNode(node);
+        if(compared != node && getUncastNode(compared) != uncastNode)
+        {
+            std::swap(compared, other);
+            compareOperator = SSACompare::swapOperands(compareOperator);
+            if(compared != node && getUncastNode(compared) != uncastNode)
+                return range;
+        }
+        if(conditionalJump->destBlocks.front().lock() != destBlock)
+            compareOperator = SSACompare::invert(compareOperator);
+        ValueRange otherRange;
+        if(!getRange(other, otherRange))
+            return range;
+        if(compared == node)
+            return refine(range, compareOperator, otherRange);
+        // both are casts of the same value that keep it, so node gets the same limits
+        return typeCast(refine(typeCast(range, typeRanges.at(compared)), compareOperator, otherRange), typeRanges.at(node));
+    }
+    /// @return the node that node was cast from, going through the casts that keep the value
+    std::shared_ptr<SSANode> getUncastNode(std::shared_ptr<SSANode> node) const
+    {
+        for(std::shared_ptr<SSATypeCast> typeCast = std::dynamic_pointer_cast<SSATypeCast>(node); typeCast != nullptr; typeCast = std::dynamic_pointer_cast<SSATypeCast>(node))
+        {
+            ValueRange argRange;
+            auto iter = typeRanges.find(typeCast);
+            if(iter == typeRanges.end() || !getRange(typeCast->arg.lock(), argRange) || argRange.isEmpty || !argRange.isInside(std::get<1>(*iter)))
+                break;
+            node = typeCast->arg.lock();
+        }
+        return node;
+    }
+    /// @return the bounds of the values compared against that have stopped changing and their neighbors
+    std::vector<std::uint64_t> getThresholds(const std::unordered_set<std::shared_ptr<SSANode>> &changingNodes) const
+    {
+        std::vector<std::uint64_t> retval;
+        for(std::shared_ptr<SSACompare> compare : compares)
+        {
+            for(std::shared_ptr<SSANode> input : compare->getInputs())
+            {
+                auto iter = ranges.find(input);
+                if(iter == ranges.end() || std::get<1>(*iter).isEmpty || changingNodes.count(input) != 0)
+                    continue;
+                for(std::uint64_t bound : {std::get<1>(*iter).min, std::get<1>(*iter).max})
+                {
+                    retval.push_back(bound - 1);
+                    retval.push_back(bound);
+                    retval.push_back(bound + 1);
+                }
+            }
+        }
+        return retval;
+    }
+    /// the thresholds can change too, so after maxThresholdChangeCount changes they aren't used anymore
+    ValueRange widen(std::shared_ptr<SSANode> node, const ValueRange &oldRange, ValueRange newRange, std::size_t changeCount, const std::unordered_set<std::shared_ptr<SSANode>> &changingNodes) const
+    {
+        if(oldRange.isEmpty)
+            return newRange;
+        std::vector<std::uint64_t> thresholds;
+        if(changeCount <= maxThresholdChangeCount)
+            thresholds = getThresholds(changingNodes);
+        const ValueRange &typeRange = typeRanges.at(node);
+        if(newRange.isLess(newRange.min, oldRange.min))
+        {
+            std::uint64_t min = typeRange.min;
+            if(!newRange.isLess(newRange.min, typeRange.min + 1)) // stop before the limit so counting down doesn't wrap around
+                min = typeRange.min + 1;
+            for(std::uint64_t threshold : thresholds)
+            {
+                if(!newRange.isLess(newRange.min, threshold) && newRange.isLess(min, threshold))
+                    min = threshold;
+            }
+            newRange.min = min;
+        }
+        if(newRange.isLess(oldRange.max, newRange.max))
+        {
+            std::uint64_t max = typeRange.max;
+            if(!newRange.isLess(typeRange.max - 1, newRange.max))
+                max = typeRange.max - 1;
+            for(std::uint64_t threshold : thresholds)
+            {
+                if(!newRange.isLess(threshold, newRange.max) && newRange.isLess(threshold, max))
+                    max = threshold;
+            }
+            newRange.max = max;
+        }
+        return newRange;
+    }
+    ValueRange evaluate(std::shared_ptr<SSANode> node, std::shared_ptr<SSABasicBlock> block) const
+    {
+        const ValueRange &typeRange = typeRanges.at(node);
+        if(std::shared_ptr<SSAConstant> constant = std::dynamic_pointer_cast<SSAConstant>(node))
+        {
+            ValueRange retval;
+            if(getValueRange(constant->value, retval))
+                return retval;
+            return typeRange;
+        }
+        if(std::shared_ptr<SSAPhi> phi = std::dynamic_pointer_cast<SSAPhi>(node))
+        {
+            ValueRange retval;
+            for(const SSAPhi::PhiInput &input : phi->inputs)
+            {
+                std::shared_ptr<SSABasicBlock> inputBlock = input.block.lock();
+                if(!isEdgeReachable(inputBlock, block))
+                    continue;
+                ValueRange inputRange;
+                if(!getRangeInBlock(input.node.lock(), inputBlock, inputRange))
+                    return typeRange;
+                retval = retval.unionWith(refineOnEdge(inputRange, input.node.lock(), inputBlock, block));
+            }
+            return retval;
+        }
+        if(std::shared_ptr<SSAMove> move = std::dynamic_pointer_cast<SSAMove>(node))
+        {
+            ValueRange retval;
+            if(getRangeInBlock(move->source.lock(), block, retval))
+                return typeCast(retval, typeRange);
+            return typeRange;
+        }
+        if(std::shared_ptr<SSASelect> select = std::dynamic_pointer_cast<SSASelect>(node))
+        {
+            ValueRange trueValue, falseValue;
+            if(getRangeInBlock(select->trueValue.lock(), block, trueValue) && getRangeInBlock(select->falseValue.lock(), block, falseValue))
+                return typeCast(trueValue.unionWith(falseValue), typeRange);
+            return typeRange;
+        }
+        if(std::shared_ptr<SSAAdd> addNode = std::dynamic_pointer_cast<SSAAdd>(node))
+        {
+            ValueRange lhs, rhs;
+            if(getRangeInBlock(addNode->lhs.lock(), block, lhs) && getRangeInBlock(addNode->rhs.lock(), block, rhs))
+                return add(lhs, rhs, typeRange);
+            return typeRange;
+        }
+        if(std::shared_ptr<SSATypeCast> typeCastNode = std::dynamic_pointer_cast<SSATypeCast>(node))
+        {
+            ValueRange arg;
+            if(dynamic_cast<const TypeBoolean *>(node->type->toNonConstant()->toNonVolatile().get()) != nullptr)
+                return typeRange;
+            if(getRangeInBlock(typeCastNode->arg.lock(), block, arg))
+                return typeCast(arg, typeRange);
+            return typeRange;
+        }
+        if(std::shared_ptr<SSACompare> compareNode = std::dynamic_pointer_cast<SSACompare>(node))
+        {
+            ValueRange lhs, rhs;
+            if(getRangeInBlock(compareNode->lhs.lock(), block, lhs) && getRangeInBlock(compareNode->rhs.lock(), block, rhs))
+                return compare(lhs, compareNode->compareOperator, rhs);
+            return typeRange;
+        }
+        return typeRange;
+    }
+    std::vector<std::shared_ptr<SSABasicBlock>> getReachableTargets(std::shared_ptr<SSABasicBlock> block) const
+    {
+        std::vector<std::shared_ptr<SSABasicBlock>> retval;
+        std::shared_ptr<SSAControlTransfer> controlTransfer = block->controlTransferInstruction;
+        if(controlTransfer == nullptr)
+            return retval;
+        if(std::shared_ptr<SSAConditionalJump> conditionalJump = std::dynamic_pointer_cast<SSAConditionalJump>(controlTransfer))
+        {
+            ValueRange condition;
+            if(getRangeInBlock(conditionalJump->condition.lock(), block, condition))
+            {
+                if(condition.isEmpty)
+                    return retval;
+                if(condition.min == 1)
+                    return std::vector<std::shared_ptr<SSABasicBlock>>{conditionalJump->destBlocks.front().lock()};
+                if(condition.max == 0)
+                    return std::vector<std::shared_ptr<SSABasicBlock>>{conditionalJump->destBlocks.back().lock()};
+            }
+        }
+        for(std::weak_ptr<SSABasicBlock> destBlock : controlTransfer->destBlocks)
+            retval.push_back(destBlock.lock());
+        return retval;
+    }
+public:
+    explicit SSAValueRangeAnalysis(std::shared_ptr<SSAFunction> function)
+    {
+        for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+        {
+            for(std::shared_ptr<SSANode> node : block->instructions)
+            {
+                nodeBlocks[node] = block;
+                ValueRange typeRange;
+                if(!getTypeRange(node->type, typeRange))
+                    continue;
+                typeRanges[node] = typeRange;
+                ranges[node] = ValueRange();
+                if(std::shared_ptr<SSACompare> compare = std::dynamic_pointer_cast<SSACompare>(node))
+                    compares.push_back(compare);
+            }
+        }
+        std::unordered_map<std::shared_ptr<SSANode>, std::size_t> changeCounts;
+        std::unordered_set<std::shared_ptr<SSANode>> changedNodes, lastChangedNodes;
+        reachableBlocks.insert(function->startBlock);
+        for(bool done = false; !done;)
+        {
+            done = true;
+            lastChangedNodes.swap(changedNodes);
+            changedNodes.clear();
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                if(reachableBlocks.count(block) == 0)
+                    continue;
+                for(std::shared_ptr<SSANode> node : block->instructions)
+                {
+                    auto iter = ranges.find(node);
+                    if(iter == ranges.end())
+                        continue;
+                    ValueRange &range = std::get<1>(*iter);
+                    ValueRange newRange = range.unionWith(evaluate(node, block));
+                    if(newRange == range)
+                        continue;
+                    // every loop goes through a phi, so the other nodes keep the exact ranges of their inputs
+                    if(dynamic_cast<const SSAPhi *>(node.get()) != nullptr && ++changeCounts[node] > maxChangeCount)
+                        newRange = widen(node, range, newRange, changeCounts[node], lastChangedNodes);
+                    range = newRange;
+                    changedNodes.insert(node);
+                    done = false;
+                }
+                std::unordered_set<std::shared_ptr<SSABasicBlock>> &targets = reachableTargets[block];
+                for(std::shared_ptr<SSABasicBlock> target : getReachableTargets(block))
+                {
+                    if(!std::get<1>(targets.insert(target)))
+                        continue;
+                    reachableBlocks.insert(target);
+                    done = false;
+                }
+            }
+        }
+        for(std::size_t i = 0; i < narrowingPassCount; i++)
+        {
+            for(std::shared_ptr<SSABasicBlock> block : function->blocks)
+            {
+                if(reachableBlocks.count(block) == 0)
+                    continue;
+                for(std::shared_ptr<SSANode> node : block->instructions)
+                {
+                    auto iter = ranges.find(node);
+                    if(iter != ranges.end())
+                        std::get<1>(*iter) = std::get<1>(*iter).intersectWith(evaluate(node, block));
+                }
+            }
+        }
+    }
+    bool isReachable(std::shared_ptr<SSABasicBlock> block) const
+    {
+        return reachableBlocks.count(block) != 0;
+    }
+    bool isEdgeReachable(std::shared_ptr<SSABasicBlock> sourceBlock, std::shared_ptr<SSABasicBlock> destBlock) const
+    {
+        auto iter = reachableTargets.find(sourceBlock);
+        return iter != reachableTargets.end() && std::get<1>(*iter).count(destBlock) != 0;
+    }
+    /// @return false if the range of node isn't tracked
+    bool getRange(std::shared_ptr<SSANode> node, ValueRange &range) const
+    {
+        auto iter = ranges.find(node);
+        if(iter == ranges.end())
+            return false;
+        range = std::get<1>(*iter);
+        return true;
+    }
+    /// @return false if the range of node isn't tracked
+    bool getRangeInBlock(std::shared_ptr<SSANode> node, std::shared_ptr<SSABasicBlock> block, ValueRange &range) const
+    {
+        if(!getRange(node, range))
+            return false;
+        std::shared_ptr<SSABasicBlock> definingBlock = nodeBlocks.at(node);
+        while(block != nullptr && block != definingBlock)
+        {
+            if(block->sourceBlocks.size() == 1)
+                range = refineOnEdge(range, node, block->sourceBlocks.front().lock(), block);
+            std::shared_ptr<SSABasicBlock> immediateDominator = block->immediateDominator.lock();
+            if(immediateDominator == block)
+                break;
+            block = immediateDominator;
+        }
+        return true;
+    }
+};
+
+#endif // SSA_VALUE_RANGE_ANALYSIS_H_INCLUDED
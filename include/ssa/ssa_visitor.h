@@ -25,8 +25,11 @@ class SSAConditionalJump;
 class SSAPhi;
 class SSAConstant;
 class SSAMove;
+class SSASelect;
 class SSALoad;
 class SSAStore;
+class SSAMemoryCopy;
+class SSAMemoryFill;
 class SSACompare;
 class SSAAllocA;
 class SSATypeCast;
@@ -41,8 +44,11 @@ public:
     virtual void visitSSAPhi(std::shared_ptr<SSAPhi> node) = 0;
     virtual void visitSSAConstant(std::shared_ptr<SSAConstant> node) = 0;
     virtual void visitSSAMove(std::shared_ptr<SSAMove> node) = 0;
+    virtual void visitSSASelect(std::shared_ptr<SSASelect> node) = 0;
     virtual void visitSSALoad(std::shared_ptr<SSALoad> node) = 0;
     virtual void visitSSAStore(std::shared_ptr<SSAStore> node) = 0;
+    virtual void visitSSAMemoryCopy(std::shared_ptr<SSAMemoryCopy> node) = 0;
+    virtual void visitSSAMemoryFill(std::shared_ptr<SSAMemoryFill> node) = 0;
     virtual void visitSSACompare(std::shared_ptr<SSACompare> node) = 0;
     virtual void visitSSAAllocA(std::shared_ptr<SSAAllocA> node) = 0;
     virtual void visitSSATypeCast(std::shared_ptr<SSATypeCast> node) = 0;
@@ -31,6 +31,7 @@ class TypeVoid;
 class TypeBoolean;
 class TypePointer;
 class TypeInteger;
+class TypeVector;
 class ValueNode;
 
 class TypeVisitor
@@ -43,6 +44,7 @@ public:
     virtual void visitTypeBoolean(std::shared_ptr<TypeBoolean> node) = 0;
     virtual void visitTypePointer(std::shared_ptr<TypePointer> node) = 0;
     virtual void visitTypeInteger(std::shared_ptr<TypeInteger> node) = 0;
+    virtual void visitTypeVector(std::shared_ptr<TypeVector> node) = 0;
 };
 
 #include "context.h"
@@ -108,7 +110,7 @@ public:
     }
 private:
     TypeProperties typeProperties;
-    bool hasTypeProperties;
+    bool hasTypeProperties = false;
 public:
     TypeProperties getTypeProperties()
     {
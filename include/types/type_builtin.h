@@ -165,4 +165,51 @@ public:
     virtual bool canTypeCastTo(std::shared_ptr<TypeNode> destType, bool isImplicit) const override;
 };
 
+/// a fixed number of elements that are operated on together; only made by the optimizer
+class TypeVector final : public TypeNode
+{
+    friend class CompilerContext;
+private:
+    std::shared_ptr<TypeNode> elementType;
+    TypeVector(CompilerContext *context, std::shared_ptr<TypeNode> elementType, std::size_t elementCount)
+        : TypeNode(context, false, false), elementType(elementType), elementCount(elementCount)
+    {
+    }
+public:
+    const std::size_t elementCount;
+    static std::shared_ptr<TypeNode> make(std::shared_ptr<TypeNode> elementType, std::size_t elementCount)
+    {
+        if(elementType == nullptr)
+            return nullptr;
+        return elementType->context->constructTypeNode<TypeVector>(elementType->toNonConstant()->toNonVolatile(), elementCount);
+    }
+    std::shared_ptr<TypeNode> getElementType() const
+    {
+        return elementType;
+    }
+    virtual void visit(TypeVisitor &visitor) override
+    {
+        visitor.visitTypeVector(std::static_pointer_cast<TypeVector>(shared_from_this()));
+    }
+    virtual bool operator ==(const TypeNode &rt) const override
+    {
+        const TypeVector *prt = dynamic_cast<const TypeVector *>(&rt);
+        if(prt != nullptr)
+        {
+            return elementCount == prt->elementCount && *elementType == *prt->elementType;
+        }
+        return false;
+    }
+    virtual std::size_t getHash() const override
+    {
+        return static_cast<std::size_t>(0x5a3c0e17) + elementCount * 3 + elementType->getHash();
+    }
+    virtual std::shared_ptr<ValueNode> makeDefaultValue() override
+    {
+        return nullptr;
+    }
+    virtual BinaryOperatorTypeRetval getArithCombinedType(std::shared_ptr<TypeNode> rt) override;
+    virtual bool canTypeCastTo(std::shared_ptr<TypeNode> destType, bool isImplicit) const override;
+};
+
 #endif // TYPE_BUILTIN_H_INCLUDED
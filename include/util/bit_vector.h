@@ -0,0 +1,147 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef BIT_VECTOR_H_INCLUDED
+#define BIT_VECTOR_H_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+
+/// fixed-size dense set of small integers, used for dataflow analysis
+class bit_vector final
+{
+public:
+    typedef std::size_t size_type;
+private:
+    typedef std::uint64_t word_type;
+    static constexpr size_type word_bits = 64;
+    std::vector<word_type> words;
+    size_type bit_count;
+    static size_type get_word_count(size_type bit_count)
+    {
+        return (bit_count + word_bits - 1) / word_bits;
+    }
+    void clear_unused_bits()
+    {
+        if(bit_count % word_bits != 0)
+            words.back() &= ((word_type)1 << (bit_count % word_bits)) - 1;
+    }
+public:
+    explicit bit_vector(size_type bit_count = 0, bool value = false)
+        : words(get_word_count(bit_count), value ? ~(word_type)0 : (word_type)0), bit_count(bit_count)
+    {
+        clear_unused_bits();
+    }
+    size_type size() const
+    {
+        return bit_count;
+    }
+    bool test(size_type index) const
+    {
+        assert(index < bit_count);
+        return (words[index / word_bits] >> (index % word_bits)) & 1;
+    }
+    void set(size_type index)
+    {
+        assert(index < bit_count);
+        words[index / word_bits] |= (word_type)1 << (index % word_bits);
+    }
+    void reset(size_type index)
+    {
+        assert(index < bit_count);
+        words[index / word_bits] &= ~((word_type)1 << (index % word_bits));
+    }
+    void set_all()
+    {
+        for(word_type &word : words)
+            word = ~(word_type)0;
+        clear_unused_bits();
+    }
+    void reset_all()
+    {
+        for(word_type &word : words)
+            word = 0;
+    }
+    bool any() const
+    {
+        for(word_type word : words)
+            if(word != 0)
+                return true;
+        return false;
+    }
+    /// this |= rt; returns if this changed
+    bool merge_union(const bit_vector &rt)
+    {
+        assert(bit_count == rt.bit_count);
+        word_type changed = 0;
+        for(size_type i = 0; i < words.size(); i++)
+        {
+            word_type new_word = words[i] | rt.words[i];
+            changed |= new_word ^ words[i];
+            words[i] = new_word;
+        }
+        return changed != 0;
+    }
+    /// this &= rt; returns if this changed
+    bool merge_intersection(const bit_vector &rt)
+    {
+        assert(bit_count == rt.bit_count);
+        word_type changed = 0;
+        for(size_type i = 0; i < words.size(); i++)
+        {
+            word_type new_word = words[i] & rt.words[i];
+            changed |= new_word ^ words[i];
+            words[i] = new_word;
+        }
+        return changed != 0;
+    }
+    /// this &= ~rt
+    void subtract(const bit_vector &rt)
+    {
+        assert(bit_count == rt.bit_count);
+        for(size_type i = 0; i < words.size(); i++)
+            words[i] &= ~rt.words[i];
+    }
+    /// calls fn(index) for every set bit in increasing order
+    template <typename Fn>
+    void for_each_set_bit(Fn fn) const
+    {
+        for(size_type i = 0; i < words.size(); i++)
+        {
+            word_type word = words[i];
+            while(word != 0)
+            {
+                size_type bit = __builtin_ctzll(word);
+                word &= word - 1;
+                fn(i * word_bits + bit);
+            }
+        }
+    }
+    friend bool operator ==(const bit_vector &a, const bit_vector &b)
+    {
+        return a.bit_count == b.bit_count && a.words == b.words;
+    }
+    friend bool operator !=(const bit_vector &a, const bit_vector &b)
+    {
+        return !(a == b);
+    }
+};
+
+#endif // BIT_VECTOR_H_INCLUDED
@@ -0,0 +1,227 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef DATAFLOW_H_INCLUDED
+#define DATAFLOW_H_INCLUDED
+
+#include "util/bit_vector.h"
+#include <memory>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cassert>
+
+enum class DataflowDirection
+{
+    Forward,
+    Backward
+};
+
+enum class DataflowMeet
+{
+    Union,
+    Intersection
+};
+
+/** iterative bit-vector dataflow solver over a control flow graph
+ *
+ * BlockType needs sourceBlocks and destBlocks lists of std::weak_ptr<BlockType>.
+ * Blocks are numbered in reverse postorder from the start block, followed by any unreachable blocks;
+ * forward problems are visited in that order and backward problems in the reverse order.
+ */
+template <typename BlockType>
+class DataflowSolver final
+{
+public:
+    typedef std::shared_ptr<BlockType> BlockPointer;
+private:
+    std::vector<BlockPointer> blocks;
+    std::unordered_map<BlockPointer, std::size_t> blockIndexMap;
+    std::vector<std::vector<std::size_t>> successors;
+    std::vector<std::vector<std::size_t>> predecessors;
+    std::vector<bit_vector> valuesAtStart;
+    std::vector<bit_vector> valuesAtEnd;
+    const DataflowDirection direction;
+    const DataflowMeet meet;
+    void addBlock(BlockPointer block)
+    {
+        blockIndexMap[block] = blocks.size();
+        blocks.push_back(block);
+    }
+    void numberBlocks(BlockPointer startBlock, const std::list<BlockPointer> &allBlocks)
+    {
+        std::vector<BlockPointer> postorder;
+        std::unordered_map<BlockPointer, bool> visitedMap;
+        for(BlockPointer block : allBlocks)
+            visitedMap[block] = false;
+        if(startBlock != nullptr)
+        {
+            typedef typename std::list<std::weak_ptr<BlockType>>::const_iterator SuccessorIterator;
+            std::vector<std::pair<BlockPointer, SuccessorIterator>> stack;
+            visitedMap[startBlock] = true;
+            stack.push_back(std::make_pair(startBlock, startBlock->destBlocks.cbegin()));
+            while(!stack.empty())
+            {
+                BlockPointer block = std::get<0>(stack.back());
+                SuccessorIterator &iter = std::get<1>(stack.back());
+                if(iter == block->destBlocks.cend())
+                {
+                    postorder.push_back(block);
+                    stack.pop_back();
+                    continue;
+                }
+                BlockPointer successor = iter->lock();
+                ++iter;
+                bool &visited = visitedMap[successor];
+                if(visited)
+                    continue;
+                visited = true;
+                stack.push_back(std::make_pair(successor, successor->destBlocks.cbegin()));
+            }
+        }
+        for(auto iter = postorder.rbegin(); iter != postorder.rend(); ++iter)
+            addBlock(*iter);
+        for(BlockPointer block : allBlocks)
+            if(!visitedMap[block])
+                addBlock(block);
+    }
+    std::size_t getNeighborIndex(std::weak_ptr<BlockType> neighborW) const
+    {
+        auto iter = blockIndexMap.find(neighborW.lock());
+        assert(iter != blockIndexMap.end());
+        return std::get<1>(*iter);
+    }
+public:
+    DataflowSolver(BlockPointer startBlock, const std::list<BlockPointer> &allBlocks, DataflowDirection direction, DataflowMeet meet = DataflowMeet::Union)
+        : direction(direction), meet(meet)
+    {
+        numberBlocks(startBlock, allBlocks);
+        successors.resize(blocks.size());
+        predecessors.resize(blocks.size());
+        for(std::size_t i = 0; i < blocks.size(); i++)
+        {
+            for(std::weak_ptr<BlockType> successor : blocks[i]->destBlocks)
+                successors[i].push_back(getNeighborIndex(successor));
+            for(std::weak_ptr<BlockType> predecessor : blocks[i]->sourceBlocks)
+                predecessors[i].push_back(getNeighborIndex(predecessor));
+        }
+    }
+    std::size_t getBlockCount() const
+    {
+        return blocks.size();
+    }
+    BlockPointer getBlock(std::size_t blockIndex) const
+    {
+        return blocks[blockIndex];
+    }
+    std::size_t getBlockIndex(BlockPointer block) const
+    {
+        auto iter = blockIndexMap.find(block);
+        assert(iter != blockIndexMap.end());
+        return std::get<1>(*iter);
+    }
+    const bit_vector &getValueAtStart(std::size_t blockIndex) const
+    {
+        return valuesAtStart[blockIndex];
+    }
+    const bit_vector &getValueAtEnd(std::size_t blockIndex) const
+    {
+        return valuesAtEnd[blockIndex];
+    }
+    /** solve with a custom transfer function
+     *
+     * transfer(blockIndex, input, output) computes the value at the block end from the value at the block start
+     * for forward problems and the value at the block start from the value at the block end for backward problems.
+     * Blocks without predecessors (forward) or successors (backward) start from boundaryValue,
+     * whose size is the number of bits in the problem.
+     */
+    template <typename TransferFunction>
+    void solve(TransferFunction transfer, const bit_vector &boundaryValue)
+    {
+        std::size_t bitCount = boundaryValue.size();
+        bool isForward = direction == DataflowDirection::Forward;
+        bit_vector initialValue(bitCount, meet == DataflowMeet::Intersection);
+        valuesAtStart.assign(blocks.size(), initialValue);
+        valuesAtEnd.assign(blocks.size(), initialValue);
+        std::vector<bool> isPending(blocks.size(), true);
+        bit_vector output(bitCount);
+        bool done = false;
+        while(!done)
+        {
+            done = true;
+            for(std::size_t orderIndex = 0; orderIndex < blocks.size(); orderIndex++)
+            {
+                std::size_t blockIndex = isForward ? orderIndex : blocks.size() - 1 - orderIndex;
+                if(!isPending[blockIndex])
+                    continue;
+                isPending[blockIndex] = false;
+                const std::vector<std::size_t> &inputBlocks = isForward ? predecessors[blockIndex] : successors[blockIndex];
+                const std::vector<std::size_t> &outputBlocks = isForward ? successors[blockIndex] : predecessors[blockIndex];
+                std::vector<bit_vector> &inputValues = isForward ? valuesAtEnd : valuesAtStart;
+                bit_vector &input = isForward ? valuesAtStart[blockIndex] : valuesAtEnd[blockIndex];
+                bit_vector &storedOutput = isForward ? valuesAtEnd[blockIndex] : valuesAtStart[blockIndex];
+                if(inputBlocks.empty())
+                {
+                    input = boundaryValue;
+                }
+                else
+                {
+                    input = inputValues[inputBlocks.front()];
+                    for(std::size_t inputBlock : inputBlocks)
+                    {
+                        if(meet == DataflowMeet::Union)
+                            input.merge_union(inputValues[inputBlock]);
+                        else
+                            input.merge_intersection(inputValues[inputBlock]);
+                    }
+                }
+                output = input;
+                transfer(blockIndex, static_cast<const bit_vector &>(input), output);
+                if(output == storedOutput)
+                    continue;
+                storedOutput = output;
+                for(std::size_t outputBlock : outputBlocks)
+                {
+                    if(!isPending[outputBlock])
+                    {
+                        isPending[outputBlock] = true;
+                        done = false;
+                    }
+                }
+            }
+        }
+    }
+    template <typename TransferFunction>
+    void solve(TransferFunction transfer, std::size_t bitCount)
+    {
+        solve(transfer, bit_vector(bitCount));
+    }
+    /// solve the classic output = generated | (input & ~killed) problem
+    void solve(const std::vector<bit_vector> &generated, const std::vector<bit_vector> &killed, std::size_t bitCount)
+    {
+        assert(generated.size() == blocks.size() && killed.size() == blocks.size());
+        solve([&](std::size_t blockIndex, const bit_vector &input, bit_vector &output)
+        {
+            output.subtract(killed[blockIndex]);
+            output.merge_union(generated[blockIndex]);
+        }, bit_vector(bitCount));
+    }
+};
+
+#endif // DATAFLOW_H_INCLUDED
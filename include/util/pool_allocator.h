@@ -0,0 +1,177 @@
+/* Copyright (c) 2015 Jacob R. Lifshay
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgement in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef POOL_ALLOCATOR_H_INCLUDED
+#define POOL_ALLOCATOR_H_INCLUDED
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <cassert>
+
+/** slab allocator for small objects
+ *
+ * memory is carved out of geometrically growing chunks in allocation order;
+ * freed blocks go on per-size free lists and all chunks are released at once when the pool dies.
+ */
+class memory_pool final
+{
+    memory_pool(const memory_pool &) = delete;
+    memory_pool &operator =(const memory_pool &) = delete;
+public:
+    static constexpr std::size_t alignment = alignof(std::max_align_t);
+    static constexpr std::size_t size_class_count = 32;
+    static constexpr std::size_t max_pooled_size = size_class_count * alignment;
+private:
+    static constexpr std::size_t initial_chunk_size = 256;
+    static constexpr std::size_t max_chunk_size = 16384;
+    struct chunk_header final
+    {
+        chunk_header *next;
+    };
+    struct free_block final
+    {
+        free_block *next;
+    };
+    static constexpr std::size_t chunk_header_size = (sizeof(chunk_header) + alignment - 1) / alignment * alignment;
+    chunk_header *chunks = nullptr;
+    char *current = nullptr;
+    char *current_end = nullptr;
+    std::size_t next_chunk_size = initial_chunk_size;
+    free_block *free_lists[size_class_count] = {};
+    static std::size_t get_size_class(std::size_t size)
+    {
+        return (size + alignment - 1) / alignment - 1;
+    }
+    void allocate_chunk(std::size_t needed_size)
+    {
+        std::size_t chunk_size = next_chunk_size;
+        while(chunk_size < needed_size + chunk_header_size)
+            chunk_size *= 2;
+        if(next_chunk_size < max_chunk_size)
+            next_chunk_size *= 2;
+        char *memory = static_cast<char *>(::operator new(chunk_size));
+        chunk_header *chunk = reinterpret_cast<chunk_header *>(memory);
+        chunk->next = chunks;
+        chunks = chunk;
+        current = memory + chunk_header_size;
+        current_end = memory + chunk_size;
+    }
+public:
+    memory_pool() = default;
+    ~memory_pool()
+    {
+        while(chunks != nullptr)
+        {
+            chunk_header *chunk = chunks;
+            chunks = chunk->next;
+            ::operator delete(static_cast<void *>(chunk));
+        }
+    }
+    void *allocate(std::size_t size)
+    {
+        if(size == 0)
+            size = 1;
+        if(size > max_pooled_size)
+            return ::operator new(size);
+        std::size_t size_class = get_size_class(size);
+        free_block *block = free_lists[size_class];
+        if(block != nullptr)
+        {
+            free_lists[size_class] = block->next;
+            return static_cast<void *>(block);
+        }
+        std::size_t rounded_size = (size_class + 1) * alignment;
+        if(static_cast<std::size_t>(current_end - current) < rounded_size)
+            allocate_chunk(rounded_size);
+        void *retval = static_cast<void *>(current);
+        current += rounded_size;
+        return retval;
+    }
+    void deallocate(void *memory, std::size_t size)
+    {
+        if(memory == nullptr)
+            return;
+        if(size == 0)
+            size = 1;
+        if(size > max_pooled_size)
+        {
+            ::operator delete(memory);
+            return;
+        }
+        std::size_t size_class = get_size_class(size);
+        free_block *block = static_cast<free_block *>(memory);
+        block->next = free_lists[size_class];
+        free_lists[size_class] = block;
+    }
+};
+
+/** allocator that shares a memory_pool between all its copies and rebinds
+ *
+ * a default constructed pool_allocator makes a new pool, so containers get per-container pools by default;
+ * pass the same pool to several containers to share it.
+ */
+template <typename T>
+class pool_allocator final
+{
+    template <typename U>
+    friend class pool_allocator;
+private:
+    std::shared_ptr<memory_pool> pool;
+public:
+    typedef T value_type;
+    pool_allocator()
+        : pool(std::make_shared<memory_pool>())
+    {
+    }
+    explicit pool_allocator(std::shared_ptr<memory_pool> pool)
+        : pool(pool)
+    {
+        assert(pool != nullptr);
+    }
+    template <typename U>
+    pool_allocator(const pool_allocator<U> &rt)
+        : pool(rt.pool)
+    {
+    }
+    std::shared_ptr<memory_pool> get_pool() const
+    {
+        return pool;
+    }
+    T *allocate(std::size_t count)
+    {
+        static_assert(alignof(T) <= memory_pool::alignment, "type is overaligned for memory_pool");
+        if(count > static_cast<std::size_t>(-1) / sizeof(T))
+            throw std::bad_alloc();
+        return static_cast<T *>(pool->allocate(count * sizeof(T)));
+    }
+    void deallocate(T *memory, std::size_t count)
+    {
+        pool->deallocate(static_cast<void *>(memory), count * sizeof(T));
+    }
+    friend bool operator ==(const pool_allocator &a, const pool_allocator &b)
+    {
+        return a.pool == b.pool;
+    }
+    friend bool operator !=(const pool_allocator &a, const pool_allocator &b)
+    {
+        return a.pool != b.pool;
+    }
+};
+
+#endif // POOL_ALLOCATOR_H_INCLUDED
@@ -30,6 +30,9 @@
 #include <unordered_map>
 #include <vector>
 #include <iostream>
+#include <memory>
+#include <new>
+#include "util/pool_allocator.h"
 
 class random_access_list_base
 {
@@ -651,6 +654,223 @@ protected:
         assert(!empty());
         remove_imp(last_imp());
     }
+    static int subtree_height(const node_base *tree)
+    {
+        if(tree)
+            return tree->tree_depth;
+        return -1;
+    }
+    static node_base *rotate_left_detached(node_base *tree)
+    {
+        node_base *pivot = tree->right;
+        assert(pivot);
+        tree->right = pivot->left;
+        if(tree->right)
+            tree->right->parent = tree;
+        pivot->left = tree;
+        pivot->parent = tree->parent;
+        tree->parent = pivot;
+        tree->calc_depth_and_node_count();
+        pivot->calc_depth_and_node_count();
+        return pivot;
+    }
+    static node_base *rotate_right_detached(node_base *tree)
+    {
+        node_base *pivot = tree->left;
+        assert(pivot);
+        tree->left = pivot->right;
+        if(tree->left)
+            tree->left->parent = tree;
+        pivot->right = tree;
+        pivot->parent = tree->parent;
+        tree->parent = pivot;
+        tree->calc_depth_and_node_count();
+        pivot->calc_depth_and_node_count();
+        return pivot;
+    }
+    /// restores the AVL property at the root of a tree whose subtrees differ in height by at most 2
+    static node_base *rebalance_detached(node_base *tree)
+    {
+        tree->calc_depth_and_node_count();
+        int balance = subtree_height(tree->left) - subtree_height(tree->right);
+        if(balance > 1)
+        {
+            if(subtree_height(tree->left->left) < subtree_height(tree->left->right))
+                tree->left = rotate_left_detached(tree->left);
+            return rotate_right_detached(tree);
+        }
+        if(balance < -1)
+        {
+            if(subtree_height(tree->right->right) < subtree_height(tree->right->left))
+                tree->right = rotate_right_detached(tree->right);
+            return rotate_left_detached(tree);
+        }
+        return tree;
+    }
+    /// joins left, middle and right into one tree in O(|height(left) - height(right)| + 1); the returned root's parent is stale
+    static node_base *join_trees(node_base *left, node_base *middle, node_base *right)
+    {
+        assert(middle);
+        int left_height = subtree_height(left);
+        int right_height = subtree_height(right);
+        if(left_height > right_height + 1)
+        {
+            left->right = join_trees(left->right, middle, right);
+            left->right->parent = left;
+            return rebalance_detached(left);
+        }
+        if(right_height > left_height + 1)
+        {
+            right->left = join_trees(left, middle, right->left);
+            right->left->parent = right;
+            return rebalance_detached(right);
+        }
+        middle->left = left;
+        middle->right = right;
+        if(left)
+            left->parent = middle;
+        if(right)
+            right->parent = middle;
+        middle->calc_depth_and_node_count();
+        return middle;
+    }
+    static node_base *remove_first_detached(node_base *tree, node_base *&removed_node)
+    {
+        assert(tree);
+        if(tree->left == nullptr)
+        {
+            removed_node = tree;
+            return tree->right;
+        }
+        tree->left = remove_first_detached(tree->left, removed_node);
+        if(tree->left)
+            tree->left->parent = tree;
+        return rebalance_detached(tree);
+    }
+    static node_base *concat_trees(node_base *left, node_base *right)
+    {
+        if(left == nullptr)
+            return right;
+        if(right == nullptr)
+            return left;
+        node_base *middle;
+        right = remove_first_detached(right, middle);
+        return join_trees(left, middle, right);
+    }
+    /// splits tree into the first split_index nodes and the rest in O(log n)
+    static void split_tree(node_base *tree, std::size_t split_index, node_base *&left, node_base *&right)
+    {
+        if(tree == nullptr)
+        {
+            left = right = nullptr;
+            return;
+        }
+        node_base *tree_left = tree->left;
+        node_base *tree_right = tree->right;
+        std::size_t left_count = tree->left_node_count();
+        if(split_index <= left_count)
+        {
+            node_base *middle;
+            split_tree(tree_left, split_index, left, middle);
+            right = join_trees(middle, tree, tree_right);
+        }
+        else
+        {
+            node_base *middle;
+            split_tree(tree_right, split_index - left_count - 1, middle, right);
+            left = join_trees(tree_left, tree, middle);
+        }
+    }
+    /// builds a perfectly balanced tree out of nodes[first, last), which must already be linked in order
+    static node_base *build_tree(node_base *const *nodes, std::size_t first, std::size_t last)
+    {
+        if(first == last)
+            return nullptr;
+        std::size_t middle = first + (last - first) / 2;
+        node_base *tree = nodes[middle];
+        tree->left = build_tree(nodes, first, middle);
+        tree->right = build_tree(nodes, middle + 1, last);
+        if(tree->left)
+            tree->left->parent = tree;
+        if(tree->right)
+            tree->right->parent = tree;
+        tree->calc_depth_and_node_count();
+        return tree;
+    }
+    /// makes tree the whole list; the nodes must already be linked in order except for the first and last nodes
+    void set_tree(node_base *tree)
+    {
+        end_node.tree_base = tree;
+        if(tree == nullptr)
+        {
+            end_node.prev = end_node.next = &end_node;
+            return;
+        }
+        tree->parent = nullptr;
+        node_base *first = tree;
+        while(first->left)
+            first = first->left;
+        node_base *last = tree;
+        while(last->right)
+            last = last->right;
+        first->prev = &end_node;
+        end_node.next = first;
+        last->next = &end_node;
+        end_node.prev = last;
+    }
+    /// replaces the contents of this empty list with nodes in O(n)
+    void build_imp(node_base *const *nodes, std::size_t count)
+    {
+        assert(empty());
+        for(std::size_t i = 1; i < count; i++)
+        {
+            nodes[i - 1]->next = nodes[i];
+            nodes[i]->prev = nodes[i - 1];
+        }
+        set_tree(build_tree(nodes, 0, count));
+    }
+    /// moves [split_at, end) into the empty list other in O(log n)
+    void split_imp(iterator_imp split_at, random_access_list_base &other)
+    {
+        assert(other.empty());
+        if(split_at.node->is_end())
+            return;
+        node_base *left, *right;
+        split_tree(end_node.tree_base, split_at.position(), left, right);
+        set_tree(left);
+        other.set_tree(right);
+    }
+    /// moves all of other before insert_before_iter in O(log n)
+    void splice_all_imp(iterator_imp insert_before_iter, random_access_list_base &other)
+    {
+        assert(&other != this);
+        if(other.empty())
+            return;
+        if(empty())
+        {
+            swap(other);
+            return;
+        }
+        node_base *inserted_first = other.end_node.next;
+        node_base *inserted_last = other.end_node.prev;
+        node_base *inserted = other.end_node.tree_base;
+        other.set_tree(nullptr);
+        node_base *before = insert_before_iter.node->prev;
+        node_base *after = insert_before_iter.node;
+        node_base *left, *right;
+        split_tree(end_node.tree_base, insert_before_iter.position(), left, right);
+        if(!before->is_end())
+        {
+            before->next = inserted_first;
+            inserted_first->prev = before;
+        }
+        if(!after->is_end())
+        {
+            inserted_last->next = after;
+            after->prev = inserted_last;
+        }
+        set_tree(concat_trees(concat_trees(left, inserted), right));
+    }
     random_access_list_base() = default;
     random_access_list_base(random_access_list_base &&rt)
     {
@@ -755,7 +975,7 @@ protected:
 #endif
 };
 
-template <typename T>
+template <typename T, typename Allocator = pool_allocator<T>>
 class random_access_list final : private random_access_list_base
 {
 public:
@@ -766,6 +986,7 @@ public:
     typedef const value_type &const_reference;
     typedef value_type *pointer;
     typedef const value_type *const_pointer;
+    typedef Allocator allocator_type;
 private:
     struct node_type final : public node_base
     {
@@ -776,6 +997,61 @@ private:
         {
         }
     };
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node_type> node_allocator_type;
+    typedef std::allocator_traits<node_allocator_type> node_allocator_traits;
+    node_allocator_type node_allocator;
+    template <typename ...Args>
+    node_type *create_node(Args &&...args)
+    {
+        node_type *node = node_allocator_traits::allocate(node_allocator, 1);
+        try
+        {
+            ::new(static_cast<void *>(node)) node_type(std::forward<Args>(args)...);
+        }
+        catch(...)
+        {
+            node_allocator_traits::deallocate(node_allocator, node, 1);
+            throw;
+        }
+        return node;
+    }
+    void destroy_node(node_type *node)
+    {
+        node->~node_type();
+        node_allocator_traits::deallocate(node_allocator, node, 1);
+    }
+    void destroy_nodes(node_base *first, node_base *end)
+    {
+        while(first != end)
+        {
+            node_base *next = first->next;
+            destroy_node(static_cast<node_type *>(first));
+            first = next;
+        }
+    }
+    template <typename InputIterator>
+    void append_range(InputIterator first, InputIterator last)
+    {
+        std::vector<node_base *> nodes;
+        try
+        {
+            for(; first != last; ++first)
+            {
+                nodes.push_back(nullptr);
+                nodes.back() = create_node(*first);
+            }
+        }
+        catch(...)
+        {
+            for(node_base *node : nodes)
+                if(node != nullptr)
+                    destroy_node(static_cast<node_type *>(node));
+            throw;
+        }
+        random_access_list appended(get_allocator());
+        appended.build_imp(nodes.data(), nodes.size());
+        splice_all_imp(end_imp(), appended);
+    }
 public:
     class const_iterator;
     class iterator final : public std::iterator<std::random_access_iterator_tag, T>
@@ -1079,50 +1355,50 @@ public:
     {
         node_type *node = static_cast<node_type *>(last_imp().node);
         pop_back_imp();
-        delete node;
+        destroy_node(node);
     }
     void pop_front()
     {
         node_type *node = static_cast<node_type *>(begin_imp().node);
         pop_front_imp();
-        delete node;
+        destroy_node(node);
     }
     void push_back(const T &v)
     {
-        node_type *node = new node_type(v);
+        node_type *node = create_node(v);
         push_back_imp(node);
     }
     void push_back(T &&v)
     {
-        node_type *node = new node_type(std::move(v));
+        node_type *node = create_node(std::move(v));
         push_back_imp(node);
     }
     template <typename ...Args>
     void emplace_back(Args &&...args)
     {
-        node_type *node = new node_type(std::forward<Args>(args)...);
+        node_type *node = create_node(std::forward<Args>(args)...);
         push_back_imp(node);
     }
     void push_front(const T &v)
     {
-        node_type *node = new node_type(v);
+        node_type *node = create_node(v);
         push_front_imp(node);
     }
     void push_front(T &&v)
     {
-        node_type *node = new node_type(std::move(v));
+        node_type *node = create_node(std::move(v));
         push_front_imp(node);
     }
     template <typename ...Args>
     void emplace_front(Args &&...args)
     {
-        node_type *node = new node_type(std::forward<Args>(args)...);
+        node_type *node = create_node(std::forward<Args>(args)...);
         push_front_imp(node);
     }
     template <typename ...Args>
     iterator emplace(const_iterator pos, Args &&...args)
     {
-        node_type *node = new node_type(std::forward<Args>(args)...);
+        node_type *node = create_node(std::forward<Args>(args)...);
         insert_imp(node, pos.iter);
         return iterator(iterator_imp(node));
     }
@@ -1140,7 +1416,7 @@ public:
         iterator retval(pos.iter);
         ++retval;
         remove_imp(pos.iter);
-        delete node;
+        destroy_node(node);
         return retval;
     }
     void resize(std::size_t count)
@@ -1173,30 +1449,119 @@ public:
     }
     void clear()
     {
-        while(!empty())
-            pop_back();
+        node_base *first = begin_imp().node;
+        node_base *end = end_imp().node;
+        set_tree(nullptr);
+        destroy_nodes(first, end);
+    }
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        if(first == last)
+            return iterator(last.iter);
+        random_access_list tail = split(last);
+        random_access_list erased = split(first);
+        iterator retval = tail.begin();
+        splice_all_imp(end_imp(), tail);
+        if(retval == tail.end())
+            return end();
+        return retval;
+    }
+    /// erases every element that pred returns true for in O(n); pred may modify the elements it keeps
+    template <typename Predicate>
+    size_type erase_if(Predicate pred)
+    {
+        std::vector<node_base *> kept_nodes;
+        kept_nodes.reserve(size());
+        node_base *node = begin_imp().node;
+        node_base *end = end_imp().node;
+        set_tree(nullptr);
+        size_type erased_count = 0;
+        try
+        {
+            while(node != end)
+            {
+                node_base *next = node->next;
+                if(pred(static_cast<node_type *>(node)->value))
+                {
+                    destroy_node(static_cast<node_type *>(node));
+                    erased_count++;
+                }
+                else
+                    kept_nodes.push_back(node);
+                node = next;
+            }
+        }
+        catch(...)
+        {
+            while(node != end)
+            {
+                kept_nodes.push_back(node);
+                node = node->next;
+            }
+            build_imp(kept_nodes.data(), kept_nodes.size());
+            throw;
+        }
+        build_imp(kept_nodes.data(), kept_nodes.size());
+        return erased_count;
+    }
+    template <typename InputIterator>
+    void assign(InputIterator first, InputIterator last)
+    {
+        clear();
+        append_range(first, last);
+    }
+    template <typename InputIterator>
+    iterator insert(const_iterator pos, InputIterator first, InputIterator last)
+    {
+        random_access_list inserted(first, last, get_allocator());
+        if(inserted.empty())
+            return iterator(pos.iter);
+        iterator retval = inserted.begin();
+        splice_all_imp(pos.iter, inserted);
+        return retval;
+    }
+    /// moves [pos, end) into a new list in O(log n)
+    random_access_list split(const_iterator pos)
+    {
+        random_access_list retval(get_allocator());
+        split_imp(pos.iter, retval);
+        return retval;
     }
     random_access_list()
+        : random_access_list(Allocator())
+    {
+    }
+    explicit random_access_list(const Allocator &allocator)
+        : node_allocator(allocator)
     {
     }
     random_access_list(const random_access_list &rt)
+        : random_access_list()
     {
-        for(const T &v : rt)
-        {
-            push_back(v);
-        }
+        append_range(rt.begin(), rt.end());
+    }
+    template <typename InputIterator>
+    random_access_list(InputIterator first, InputIterator last, const Allocator &allocator = Allocator())
+        : random_access_list(allocator)
+    {
+        append_range(first, last);
     }
     random_access_list(random_access_list &&rt)
-        : random_access_list_base(std::move(rt))
+        : random_access_list_base(std::move(rt)), node_allocator(rt.node_allocator)
     {
     }
     ~random_access_list()
     {
         clear();
     }
+    allocator_type get_allocator() const
+    {
+        return allocator_type(node_allocator);
+    }
     void swap(random_access_list &rt)
     {
         random_access_list_base::swap(rt);
+        std::swap(node_allocator, rt.node_allocator);
     }
     random_access_list &operator =(random_access_list &&rt)
     {
@@ -1212,46 +1577,54 @@ public:
         random_access_list(rt).swap(*this);
         return *this;
     }
+    /// elements only keep their addresses when both lists share an allocator; otherwise they are moved into new nodes
     void splice(const_iterator pos, random_access_list &other, const_iterator it)
     {
         if(&other == this && it == pos)
             return;
-        node_type *node = static_cast<node_type *>(pos.iter.node);
-        other.remove_imp(it.iter.node);
+        node_type *node = static_cast<node_type *>(it.iter.node);
+        if(node_allocator != other.node_allocator)
+        {
+            emplace(pos, std::move(node->value));
+            other.erase(it);
+            return;
+        }
+        other.remove_imp(it.iter);
         insert_imp(node, pos.iter);
     }
     void splice(const_iterator pos, random_access_list &&other, const_iterator it)
     {
-        if(&other == this && it == pos)
-            return;
-        node_type *node = static_cast<node_type *>(pos.iter.node);
-        other.remove_imp(it.iter.node);
-        insert_imp(node, pos.iter);
+        splice(pos, other, it);
     }
+    /// O(log n) when both lists share an allocator
     void splice(const_iterator pos, random_access_list &other)
     {
-        auto iter = other.begin();
-        while(iter != other.end())
+        if(&other == this || other.empty())
+            return;
+        if(node_allocator == other.node_allocator)
         {
-            auto next_iter = iter;
-            ++next_iter;
-            splice(pos, other, iter);
-            iter = next_iter;
+            splice_all_imp(pos.iter, other);
+            return;
         }
+        splice(pos, other, other.cbegin(), other.cend());
     }
     void splice(const_iterator pos, random_access_list &&other)
     {
-        auto iter = other.begin();
-        while(iter != other.end())
-        {
-            auto next_iter = iter;
-            ++next_iter;
-            splice(pos, other, iter);
-            iter = next_iter;
-        }
+        splice(pos, other);
     }
+    /// O(log n) when both lists are different and share an allocator
     void splice(const_iterator pos, random_access_list &other, const_iterator first, const_iterator last)
     {
+        if(first == last)
+            return;
+        if(&other != this && node_allocator == other.node_allocator)
+        {
+            random_access_list tail = other.split(last);
+            random_access_list moved = other.split(first);
+            other.splice_all_imp(other.end_imp(), tail);
+            splice_all_imp(pos.iter, moved);
+            return;
+        }
         auto iter = first;
         while(iter != last)
         {
@@ -1263,14 +1636,7 @@ public:
     }
     void splice(const_iterator pos, random_access_list &&other, const_iterator first, const_iterator last)
     {
-        auto iter = first;
-        while(iter != last)
-        {
-            auto next_iter = iter;
-            ++next_iter;
-            splice(pos, other, iter);
-            iter = next_iter;
-        }
+        splice(pos, other, first, last);
     }
     void verify_all() // check data structure consistency
     {
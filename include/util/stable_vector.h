@@ -25,8 +25,12 @@
 #include <utility>
 #include <stdexcept>
 #include <cassert>
+#include <vector>
+#include <memory>
+#include <new>
+#include "util/pool_allocator.h"
 
-template <typename T>
+template <typename T, typename Allocator = pool_allocator<T>>
 class stable_vector final
 {
 public:
@@ -37,6 +41,7 @@ public:
     typedef const value_type &const_reference;
     typedef value_type *pointer;
     typedef const value_type *const_pointer;
+    typedef Allocator allocator_type;
 private:
     struct base_node_type;
     struct cell_type final
@@ -68,10 +73,49 @@ private:
     {
         using base_node_type::base_node_type;
     };
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node_type> node_allocator_type;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<cell_type> cell_allocator_type;
+    typedef std::allocator_traits<node_allocator_type> node_allocator_traits;
+    typedef std::allocator_traits<cell_allocator_type> cell_allocator_traits;
     cell_type *cells;
     size_type allocated, used;
     end_node_type end_node;
     cell_type empty_cell;
+    node_allocator_type node_allocator;
+    cell_allocator_type cell_allocator;
+    template <typename ...Args>
+    node_type *create_node(Args &&...args)
+    {
+        node_type *node = node_allocator_traits::allocate(node_allocator, 1);
+        try
+        {
+            ::new(static_cast<void *>(node)) node_type(std::forward<Args>(args)...);
+        }
+        catch(...)
+        {
+            node_allocator_traits::deallocate(node_allocator, node, 1);
+            throw;
+        }
+        return node;
+    }
+    void destroy_node(base_node_type *node)
+    {
+        node_type *value_node = static_cast<node_type *>(node);
+        value_node->~node_type();
+        node_allocator_traits::deallocate(node_allocator, value_node, 1);
+    }
+    cell_type *create_cells(size_type count)
+    {
+        cell_type *retval = cell_allocator_traits::allocate(cell_allocator, count);
+        for(size_type i = 0; i < count; i++)
+            ::new(static_cast<void *>(&retval[i])) cell_type();
+        return retval;
+    }
+    void destroy_cells()
+    {
+        if(cells != &empty_cell)
+            cell_allocator_traits::deallocate(cell_allocator, cells, allocated);
+    }
     size_type get_new_size(size_type needed_size)
     {
         size_type retval = allocated + allocated / 2;
@@ -84,7 +128,7 @@ private:
         if(needed_size >= allocated && needed_size > 0)
         {
             size_type new_allocated = get_new_size(needed_size + 1);
-            cell_type *new_cells = new cell_type[new_allocated];
+            cell_type *new_cells = create_cells(new_allocated);
             for(size_type i = 0; i < used; i++)
             {
                 new_cells[i].node = cells[i].node;
@@ -92,8 +136,7 @@ private:
             }
             new_cells[used].node = &end_node;
             end_node.cell = &new_cells[used];
-            if(cells != &empty_cell)
-                delete []cells;
+            destroy_cells();
             cells = new_cells;
             allocated = new_allocated;
         }
@@ -105,7 +148,7 @@ private:
         if(used + space_size >= allocated)
         {
             size_type new_allocated = get_new_size(used + space_size + 1);
-            cell_type *new_cells = new cell_type[new_allocated];
+            cell_type *new_cells = create_cells(new_allocated);
             for(size_type i = 0; i < space_start; i++)
             {
                 new_cells[i].node = cells[i].node;
@@ -117,8 +160,7 @@ private:
                 new_cells[j].node = cells[i].node;
                 new_cells[j].node->cell = &new_cells[j];
             }
-            if(cells != &empty_cell)
-                delete []cells;
+            destroy_cells();
             used += space_size;
             new_cells[used].node = &end_node;
             end_node.cell = &new_cells[used];
@@ -159,8 +201,12 @@ private:
         end_node.cell = &cells[used];
     }
 public:
-    constexpr stable_vector()
-        : cells(&empty_cell), allocated(1), used(0), end_node(&empty_cell), empty_cell(&end_node)
+    stable_vector()
+        : stable_vector(Allocator())
+    {
+    }
+    explicit stable_vector(const Allocator &allocator)
+        : cells(&empty_cell), allocated(1), used(0), end_node(&empty_cell), empty_cell(&end_node), node_allocator(allocator), cell_allocator(allocator)
     {
     }
     explicit stable_vector(size_type count)
@@ -181,7 +227,7 @@ public:
             push_back(value);
     }
     stable_vector(stable_vector &&rt)
-        : stable_vector()
+        : stable_vector(rt.get_allocator())
     {
         if(rt.cells == &rt.empty_cell)
             return;
@@ -200,8 +246,7 @@ public:
     ~stable_vector()
     {
         clear();
-        if(cells != &empty_cell)
-            delete []cells;
+        destroy_cells();
     }
     stable_vector &operator =(const stable_vector &rt)
     {
@@ -514,11 +559,11 @@ public:
     }
     const_iterator end() const
     {
-        return const_iterator(&end_node);
+        return const_iterator(const_cast<end_node_type *>(&end_node));
     }
     const_iterator cend() const
     {
-        return const_iterator(&end_node);
+        return const_iterator(const_cast<end_node_type *>(&end_node));
     }
     typedef std::reverse_iterator<iterator> reverse_iterator;
     typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
@@ -578,7 +623,7 @@ public:
         make_space_for_insert(index, 1);
         try
         {
-            node_type *node = new node_type(std::move(value));
+            node_type *node = create_node(std::move(value));
             cells[index].node = node;
             node->cell = &cells[index];
             return iterator(node);
@@ -600,7 +645,7 @@ public:
         {
             try
             {
-                node_type *node = new node_type(value);
+                node_type *node = create_node(value);
                 cells[index + i].node = node;
                 node->cell = &cells[index + i];
             }
@@ -620,7 +665,7 @@ public:
         make_space_for_insert(index, 1);
         try
         {
-            node_type *node = new node_type(std::forward<Args>(args)...);
+            node_type *node = create_node(std::forward<Args>(args)...);
             cells[index].node = node;
             node->cell = &cells[index];
             return iterator(node);
@@ -645,7 +690,7 @@ public:
         {
             try
             {
-                delete static_cast<node_type *>(cells[index + i].node);
+                destroy_node(cells[index + i].node);
             }
             catch(...)
             {
@@ -656,6 +701,94 @@ public:
         remove_space_after_erase(index, remove_count);
         return iterator(last.node);
     }
+    /// erases every element that pred returns true for in one pass; pred may modify the elements it keeps
+    template <typename Predicate>
+    size_type erase_if(Predicate pred)
+    {
+        size_type kept = 0;
+        size_type i = 0;
+        try
+        {
+            for(; i < used; i++)
+            {
+                base_node_type *node = cells[i].node;
+                if(pred(static_cast<node_type *>(node)->value))
+                {
+                    cells[i].node = nullptr;
+                    destroy_node(node);
+                    continue;
+                }
+                cells[kept].node = node;
+                node->cell = &cells[kept];
+                kept++;
+            }
+        }
+        catch(...)
+        {
+            if(cells[i].node != nullptr)
+            {
+                cells[kept].node = cells[i].node;
+                cells[kept].node->cell = &cells[kept];
+                kept++;
+            }
+            remove_space_after_erase(kept, i + 1 - kept);
+            throw;
+        }
+        size_type erased_count = used - kept;
+        remove_space_after_erase(kept, erased_count);
+        return erased_count;
+    }
+    /** inserts every value of [first, last) before its position in one pass
+     *
+     * the elements of [first, last) are pairs of a const_iterator into this and a value;
+     * the positions must be in non-decreasing order and values for the same position keep their order
+     */
+    template <typename ForwardIterator>
+    void insert_batch(ForwardIterator first, ForwardIterator last)
+    {
+        size_type count = static_cast<size_type>(std::distance(first, last));
+        if(count == 0)
+            return;
+        std::vector<size_type> indexes;
+        std::vector<node_type *> new_nodes;
+        indexes.reserve(count);
+        new_nodes.reserve(count);
+        try
+        {
+            for(ForwardIterator iter = first; iter != last; ++iter)
+            {
+                size_type index = const_iterator(std::get<0>(*iter)) - cbegin();
+                assert(index <= used);
+                assert(indexes.empty() || indexes.back() <= index);
+                indexes.push_back(index);
+                new_nodes.push_back(create_node(std::get<1>(*iter)));
+            }
+            reserve(used + count);
+        }
+        catch(...)
+        {
+            for(node_type *node : new_nodes)
+                destroy_node(node);
+            throw;
+        }
+        size_type source = used;
+        size_type dest = used + count;
+        size_type remaining = count;
+        cells[dest].node = &end_node;
+        end_node.cell = &cells[dest];
+        while(remaining > 0)
+        {
+            dest--;
+            base_node_type *node;
+            if(indexes[remaining - 1] == source)
+                node = new_nodes[--remaining];
+            else
+                node = cells[--source].node;
+            cells[dest].node = node;
+            node->cell = &cells[dest];
+        }
+        used += count;
+    }
     void push_back(const T &value)
     {
         insert(end(), value);
@@ -712,8 +845,14 @@ public:
         else
             erase(begin() + count, end());
     }
+    allocator_type get_allocator() const
+    {
+        return allocator_type(node_allocator);
+    }
     void swap(stable_vector &rt)
     {
+        std::swap(node_allocator, rt.node_allocator);
+        std::swap(cell_allocator, rt.cell_allocator);
         if(cells == &empty_cell)
         {
             if(rt.cells == &rt.empty_cell)
@@ -771,10 +910,17 @@ public:
         reserve(size() + other.size());
         splice(pos, other, other.begin(), other.end());
     }
+    /// elements only keep their addresses when both containers share an allocator; otherwise they are moved into new nodes
     void splice(const_iterator pos, stable_vector &other, const_iterator it)
     {
         if(&other == this && (it == pos || it + 1 == pos))
             return;
+        if(node_allocator != other.node_allocator)
+        {
+            emplace(pos, std::move(static_cast<node_type *>(it.node)->value));
+            other.erase(it);
+            return;
+        }
         size_type it_index = it - other.begin();
         assert(it_index < other.used);
         if(this == &other)
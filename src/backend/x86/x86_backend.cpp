@@ -22,6 +22,8 @@
 #include "backend/x86/x86_asm_writer.h"
 #include "backend/x86/x86_register_allocator.h"
 #include "backend/x86/x86_dead_code.h"
+#include "backend/x86/x86_extension_elimination.h"
+#include "backend/x86/x86_frame_layout.h"
 
 void BackendX86::outputAsAssembly(std::ostream &os, std::list<std::shared_ptr<RTLFunction>> functionsIn) const
 {
@@ -37,6 +39,16 @@ void BackendX86::outputAsAssembly(std::ostream &os, std::list<std::shared_ptr<RT
     {
         ra.visitX86AsmFunction(function);
     }
+    X86ExtensionElimination extensionElimination(this);
+    for(std::shared_ptr<X86AsmFunction> function : functions)
+    {
+        extensionElimination.visitX86AsmFunction(function);
+    }
+    X86FrameLayout frameLayout(this);
+    for(std::shared_ptr<X86AsmFunction> function : functions)
+    {
+        frameLayout.visitX86AsmFunction(function);
+    }
     switch(assemblyDialect)
     {
     case AssemblyDialect::GAS_Intel:
@@ -135,6 +147,12 @@ TypeProperties BackendX86::getTypeProperties(std::shared_ptr<TypeNode> type) con
             }
             assert(false);
         }
+        virtual void visitTypeVector(std::shared_ptr<TypeVector> node) override
+        {
+            TypeProperties elementProperties = node->getElementType()->getTypeProperties();
+            retval.alignment = elementProperties.alignment;
+            retval.size = elementProperties.size * node->elementCount;
+        }
     };
     MyVisitor v(architecture);
     type->visit(v);
@@ -68,6 +68,11 @@ void DumpVisitor::visitSSAMove(std::shared_ptr<SSAMove> node)
     dumpInstructionName("SSAMove", node);
     os << "(source=" << getSSANodeDisplayValue(node->source.lock()) << ")";
 }
+void DumpVisitor::visitSSASelect(std::shared_ptr<SSASelect> node)
+{
+    dumpInstructionName("SSASelect", node);
+    os << "(condition=" << getSSANodeDisplayValue(node->condition.lock()) << ",trueValue=" << getSSANodeDisplayValue(node->trueValue.lock()) << ",falseValue=" << getSSANodeDisplayValue(node->falseValue.lock()) << ")";
+}
 void DumpVisitor::visitSSALoad(std::shared_ptr<SSALoad> node)
 {
     dumpInstructionName("SSALoad", node);
@@ -78,6 +83,16 @@ void DumpVisitor::visitSSAStore(std::shared_ptr<SSAStore> node)
     dumpInstructionName("SSAStore", node);
     os << "(address=" << getSSANodeDisplayValue(node->address.lock()) << ",value=" << getSSANodeDisplayValue(node->value.lock()) << ")";
 }
+void DumpVisitor::visitSSAMemoryCopy(std::shared_ptr<SSAMemoryCopy> node)
+{
+    dumpInstructionName("SSAMemoryCopy", node);
+    os << "(destAddress=" << getSSANodeDisplayValue(node->destAddress.lock()) << ",sourceAddress=" << getSSANodeDisplayValue(node->sourceAddress.lock()) << ",count=" << node->count << ",mayOverlap=" << (node->mayOverlap ? "true" : "false") << ")";
+}
+void DumpVisitor::visitSSAMemoryFill(std::shared_ptr<SSAMemoryFill> node)
+{
+    dumpInstructionName("SSAMemoryFill", node);
+    os << "(destAddress=" << getSSANodeDisplayValue(node->destAddress.lock()) << ",value=" << getSSANodeDisplayValue(node->value.lock()) << ",count=" << node->count << ")";
+}
 void DumpVisitor::visitSSACompare(std::shared_ptr<SSACompare> node)
 {
     dumpInstructionName("SSACompare", node);
@@ -171,6 +186,12 @@ void DumpVisitor::visitTypeInteger(std::shared_ptr<TypeInteger> node)
     }
     os << ")";
 }
+void DumpVisitor::visitTypeVector(std::shared_ptr<TypeVector> node)
+{
+    os << "TypeVector(elementType=";
+    node->getElementType()->visit(*this);
+    os << ",elementCount=" << node->elementCount << ")";
+}
 void DumpVisitor::visitValueBoolean(std::shared_ptr<ValueBoolean> node)
 {
     os << "ValueBoolean(value=";
@@ -272,6 +293,18 @@ void DumpVisitor::visitRTLMove(std::shared_ptr<RTLMove> node)
     dumpRTLRegister(node->sourceRegister);
     os << ")";
 }
+void DumpVisitor::visitRTLSelect(std::shared_ptr<RTLSelect> node)
+{
+    os << "RTLSelect(destRegister=";
+    dumpRTLRegister(node->destRegister);
+    os << ",conditionRegister=";
+    dumpRTLRegister(node->conditionRegister);
+    os << ",trueRegister=";
+    dumpRTLRegister(node->trueRegister);
+    os << ",falseRegister=";
+    dumpRTLRegister(node->falseRegister);
+    os << ")";
+}
 void DumpVisitor::visitRTLTypeCast(std::shared_ptr<RTLTypeCast> node)
 {
     os << "RTLTypeCast(destRegister=";
@@ -300,6 +333,22 @@ void DumpVisitor::visitRTLStore(std::shared_ptr<RTLStore> node)
     dumpRTLRegister(node->valueRegister);
     os << ")";
 }
+void DumpVisitor::visitRTLMemoryCopy(std::shared_ptr<RTLMemoryCopy> node)
+{
+    os << "RTLMemoryCopy(destAddressRegister=";
+    dumpRTLRegister(node->destAddressRegister);
+    os << ",sourceAddressRegister=";
+    dumpRTLRegister(node->sourceAddressRegister);
+    os << ",count=" << node->count << ",mayOverlap=" << (node->mayOverlap ? "true" : "false") << ")";
+}
+void DumpVisitor::visitRTLMemoryFill(std::shared_ptr<RTLMemoryFill> node)
+{
+    os << "RTLMemoryFill(destAddressRegister=";
+    dumpRTLRegister(node->destAddressRegister);
+    os << ",valueRegister=";
+    dumpRTLRegister(node->valueRegister);
+    os << ",count=" << node->count << ")";
+}
 void DumpVisitor::visitRTLUnconditionalJump(std::shared_ptr<RTLUnconditionalJump> node)
 {
     os << "RTLUnconditionalJump(target=";
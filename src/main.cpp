@@ -27,10 +27,21 @@
 #include "optimization/const_dead_code/const_dead_code.h"
 #include "optimization/phi_removal/phi_removal.h"
 #include "optimization/control_flow_simplification/control_flow_simplification.h"
+#include "optimization/aggressive_dead_code/aggressive_dead_code.h"
 #include "convert_ssa_to_rtl.h"
 #include "backend/backend.h"
 #include "backend/x86/x86_backend.h"
 #include "optimization/memory_to_register/memory_to_register.h"
+#include "optimization/load_store_elimination/load_store_elimination.h"
+#include "optimization/instruction_combining/instruction_combining.h"
+#include "optimization/if_conversion/if_conversion.h"
+#include "optimization/loop_idiom/loop_idiom.h"
+#include "optimization/loop_rotation/loop_rotation.h"
+#include "optimization/loop_unrolling/loop_unrolling.h"
+#include "optimization/loop_unswitching/loop_unswitching.h"
+#include "optimization/loop_vectorization/loop_vectorization.h"
+#include "optimization/partial_redundancy_elimination/partial_redundancy_elimination.h"
+#include "optimization/value_range_propagation/value_range_propagation.h"
 #include <getopt.h>
 
 std::string getSourceCode()
@@ -48,19 +59,19 @@ std::string getSourceCode()
 struct ArchitectureDescriptor final
 {
     const char *name;
-    std::shared_ptr<Backend> (*backendMaker)();
+    std::shared_ptr<Backend> (*backendMaker)(bool omitFramePointer);
 };
 
 const ArchitectureDescriptor architectures[] =
 {
-    {"x86_64", []()->std::shared_ptr<Backend>
+    {"x86_64", [](bool omitFramePointer)->std::shared_ptr<Backend>
         {
-            return std::make_shared<BackendX86>(BackendX86::AssemblyDialect::GAS_Intel, BackendX86::X86_64);
+            return std::make_shared<BackendX86>(BackendX86::AssemblyDialect::GAS_Intel, BackendX86::X86_64, omitFramePointer);
         }
     },
-    {"x86_32", []()->std::shared_ptr<Backend>
+    {"x86_32", [](bool omitFramePointer)->std::shared_ptr<Backend>
         {
-            return std::make_shared<BackendX86>(BackendX86::AssemblyDialect::GAS_Intel, BackendX86::X86_32);
+            return std::make_shared<BackendX86>(BackendX86::AssemblyDialect::GAS_Intel, BackendX86::X86_32, omitFramePointer);
         }
     },
 };
@@ -74,6 +85,7 @@ int usage(bool isError)
         "Options:\n"
         "-h|--help                       show this help.\n"
         "-a <arch>|--arch=<arch>         use the specified architecture.\n"
+        "--no-omit-frame-pointer         keep a frame pointer in every function.\n"
         "\n"
         "Architectures:\n";
     const char *seperator = "";
@@ -105,12 +117,14 @@ int main(int argc, char **argv)
         std::istream *pis = &is;
         std::string archName = "";
         bool gotArch = false;
+        bool omitFramePointer = true;
         for(;;)
         {
             static const option longOptions[] =
             {
                 {"help", no_argument, nullptr, 'h'},
                 {"arch", required_argument, nullptr, 'a'},
+                {"no-omit-frame-pointer", no_argument, nullptr, 'F'},
                 {nullptr, 0, nullptr, 0}
             };
             int longOptionIndex = -1;
@@ -129,6 +143,9 @@ int main(int argc, char **argv)
                 archName = optarg;
                 gotArch = true;
                 break;
+            case 'F':
+                omitFramePointer = false;
+                break;
             default:
                 return usageAndError("invalid option");
             }
@@ -146,7 +163,7 @@ int main(int argc, char **argv)
         {
             if(archName == arch.name)
             {
-                backend = arch.backendMaker();
+                backend = arch.backendMaker(omitFramePointer);
                 break;
             }
         }
@@ -185,9 +202,54 @@ int main(int argc, char **argv)
         PhiRemoval().visitSSAFunction(fn);
         ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
         fn->verify();
+        LoadStoreElimination().visitSSAFunction(fn);
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+        fn->verify();
+        if(i == 0) // before if-conversion turns the invariant branches into selects
+        {
+            LoopUnswitching().visitSSAFunction(fn);
+            ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+            fn->verify();
+        }
+        IfConversion().visitSSAFunction(fn);
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+        fn->verify();
+        InstructionCombining().visitSSAFunction(fn);
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+        fn->verify();
+        if(i == 0) // needs the exit test still in the header
+        {
+            LoopIdiomRecognition().visitSSAFunction(fn);
+            ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+            fn->verify();
+            LoopVectorization().visitSSAFunction(fn);
+            ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+            fn->verify();
+        }
+        LoopRotation().visitSSAFunction(fn);
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+        fn->verify();
+        if(i == 0) // later iterations would unroll the unrolled loops again
+        {
+            LoopUnrolling().visitSSAFunction(fn);
+            ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+            fn->verify();
+        }
+        PartialRedundancyElimination().visitSSAFunction(fn);
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+        fn->verify();
+        PhiRemoval().visitSSAFunction(fn); // the phi functions added for hoisted loop-invariant values only merge one value
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+        fn->verify();
+        ValueRangePropagation().visitSSAFunction(fn);
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+        fn->verify();
         ConstantPropagationAndDeadCodeElimination().visitSSAFunction(fn);
         ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
         fn->verify();
+        AggressiveDeadCodeElimination().visitSSAFunction(fn);
+        ConstructBasicBlockGraphVisitor().visitSSAFunction(fn);
+        fn->verify();
     }
     std::shared_ptr<RTLFunction> rtlFn = ConvertSSAToRTL().visitSSAFunction(fn);
     ConstantPropagationAndDeadCodeElimination().visitRTLFunction(rtlFn);
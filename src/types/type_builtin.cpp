@@ -230,3 +230,28 @@ bool TypeInteger::canTypeCastTo(std::shared_ptr<TypeNode> destType, bool isImpli
 }
 
 
+
+TypeNode::BinaryOperatorTypeRetval TypeVector::getArithCombinedType(std::shared_ptr<TypeNode> rt)
+{
+    if(const TypeVector *rtVector = dynamic_cast<const TypeVector *>(rt->toNonConstant()->toNonVolatile().get()))
+    {
+        if(rtVector->elementCount != elementCount)
+            return BinaryOperatorTypeRetval();
+        BinaryOperatorTypeRetval elementRetval = elementType->getArithCombinedType(rtVector->elementType);
+        if(!elementRetval)
+            return BinaryOperatorTypeRetval();
+        return BinaryOperatorTypeRetval(make(elementRetval.lhsType, elementCount), make(elementRetval.rhsType, elementCount), make(elementRetval.resultType, elementCount));
+    }
+    return BinaryOperatorTypeRetval();
+}
+
+bool TypeVector::canTypeCastTo(std::shared_ptr<TypeNode> destType, bool isImplicit) const
+{
+    if(const TypeVector *destVector = dynamic_cast<const TypeVector *>(destType->toNonConstant()->toNonVolatile().get()))
+    {
+        if(destVector->elementCount != elementCount)
+            return false;
+        return elementType->canTypeCastTo(destVector->elementType, isImplicit);
+    }
+    return false;
+}